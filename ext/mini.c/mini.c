@@ -25,6 +25,7 @@
 #ifndef MINI_C
 #define MINI_C
 
+#include <ctype.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -39,7 +40,8 @@ mini_t *mini_finit(FILE *stream) {
 
     mini->_buf_size = MINI_BUFFER_SIZE;
     mini->_buf = malloc(mini->_buf_size);
-    if(!mini->_buf) { mini_free(mini); return NULL; }
+    mini->_block = malloc(MINI_BLOCK_SIZE);
+    if(!mini->_buf || !mini->_block) { mini_free(mini); return NULL; }
 
     mini->stream = stream;
 
@@ -58,6 +60,7 @@ mini_t *mini_init(const char *path) {
 void mini_free(mini_t *mini) {
     if(mini == NULL) { return; }
     free(mini->_buf);
+    free(mini->_block);
     free(mini->section);
     if(mini->stream && mini->_free_stream) { fclose(mini->stream); }
     free(mini);
@@ -84,37 +87,57 @@ static size_t _mini_strtrim(char *str, size_t len) {
     return newlen;
 }
 
-/* fgetc wrapper that retries on EINTR */
-static int _mini_fgetc(FILE *stream) {
-    int c, errno_orig = errno;
-    do { errno = 0; c = fgetc(stream); } while(c == EOF && errno == EINTR);
-    if(c != EOF || feof(stream) ) { errno = errno_orig; }
-    return c;
+/* fread wrapper that retries on EINTR */
+static size_t _mini_fread(char *buf, size_t size, FILE *stream) {
+    int errno_orig = errno;
+    size_t len;
+    for(;;) {
+        errno = 0;
+        len = fread(buf, 1, size, stream);
+        if(!ferror(stream) || errno != EINTR) { break; }
+        clearerr(stream);
+        if(len > 0) { break; }
+    }
+    if(len > 0 || feof(stream)) { errno = errno_orig; }
+    return len;
 }
 
-/* fgets replacement to handle signal interrupts */
-static char *_mini_fgets(char *buf, size_t size, FILE *stream) {
-    char *s = buf;
-    int c;
+/* copy the next line from the block buffer into _buf, refilling the block
+ * buffer as needed, with the same limits as fgets(_buf, _buf_size) */
+static char *_mini_getline(mini_t *mini) {
+    size_t used = 0, room = mini->_buf_size - 1;
+
+    for(;;) {
+        char *start = mini->_block + mini->_block_pos;
+        size_t avail = mini->_block_len - mini->_block_pos;
+        char *nl = memchr(start, '\n', avail);
+        size_t len = nl ? (size_t)(nl - start) + 1 : avail;
+
+        if(len > room - used) {
+            /* consume what fits so the next call resumes mid-line */
+            len = room - used;
+            memcpy(mini->_buf + used, start, len);
+            mini->_block_pos += len;
+            errno = EOVERFLOW;
+            return NULL;
+        }
 
-    if(size == 1) {
-        *s = '\0';
-        return buf;
-    } else if(size < 1) {
-        return NULL;
+        memcpy(mini->_buf + used, start, len);
+        mini->_block_pos += len;
+        used += len;
+        if(nl) { break; }
+
+        mini->_block_pos = 0;
+        mini->_block_len = _mini_fread(mini->_block, MINI_BLOCK_SIZE, mini->stream);
+        if(mini->_block_len == 0) {
+            if(!feof(mini->stream)) { return NULL; }
+            if(used == 0) { mini->eof = 1; return NULL; }
+            break;
+        }
     }
 
-    do {
-        c = _mini_fgetc(stream);
-        if(c != EOF) { *(s++) = (char) c; }
-    } while(--size > 1 && c != EOF && c != '\n');
-
-    if(s == buf || ( c == EOF && !feof(stream) )) {
-        return NULL;
-    } else {
-        *s = '\0';
-        return buf;
-    }
+    mini->_buf[used] = '\0';
+    return mini->_buf;
 }
 
 mini_t *mini_next(mini_t *mini) {
@@ -124,18 +147,11 @@ mini_t *mini_next(mini_t *mini) {
     mini->key = NULL;
     mini->value = NULL;
 
-    if(_mini_fgets(mini->_buf, mini->_buf_size, mini->stream) == NULL) {
-        mini->eof = feof(mini->stream);
-        return NULL;
-    }
+    if(_mini_getline(mini) == NULL) { return NULL; }
 
     mini->lineno++;
 
     buflen = strlen(mini->_buf);
-    if(mini->_buf[buflen - 1] != '\n' && !feof(mini->stream)) {
-        errno = EOVERFLOW;
-        return NULL;
-    }
 
     if((c = strchr(mini->_buf, '#'))) {
         *c = '\0';
@@ -164,31 +180,79 @@ mini_t *mini_next(mini_t *mini) {
     return mini;
 }
 
-mini_t *mini_lookup_key(mini_t *mini, const char *section, const char *key) {
-    int in_section = (section == NULL);
+static int _mini_strcasecmp(const char *s1, const char *s2) {
+    while(*s1 && tolower((unsigned char) *s1) == tolower((unsigned char) *s2)) {
+        s1++;
+        s2++;
+    }
+    return tolower((unsigned char) *s1) - tolower((unsigned char) *s2);
+}
 
-    rewind(mini->stream);
-    free(mini->section);
-    mini->section = NULL;
-    mini->key = NULL;
-    mini->value = NULL;
-    mini->lineno = 0;
-    mini->eof = 0;
+static int _mini_in_section(mini_t *mini, const char *section) {
+    if(section == NULL) {
+        return mini->section == NULL;
+    } else {
+        return mini->section != NULL && strcmp(mini->section, section) == 0;
+    }
+}
 
-    if(!key) { return NULL; }
+mini_t *mini_next_key(mini_t *mini, const char *section,
+        const char *const *keys, int flags) {
+    int in_section = (flags & MINI_ANY_SECTION) || _mini_in_section(mini, section);
 
     while(mini_next(mini)) {
+        const char *const *k;
+
         if(!mini->key) {
             /* starting a new section */
-            in_section = (strcmp(mini->section, section) == 0);
-        } else if(in_section && strcmp(mini->key, key) == 0) {
+            in_section = (flags & MINI_ANY_SECTION) || _mini_in_section(mini, section);
+            continue;
+        } else if(!in_section) {
+            continue;
+        } else if(!keys) {
             return mini;
         }
+
+        for(k = keys; *k; k++) {
+            if((flags & MINI_ICASE) ? _mini_strcasecmp(mini->key, *k) == 0
+                    : strcmp(mini->key, *k) == 0) {
+                return mini;
+            }
+        }
     }
 
     return NULL;
 }
 
+static void _mini_rewind(mini_t *mini) {
+    rewind(mini->stream);
+    free(mini->section);
+    mini->section = NULL;
+    mini->key = NULL;
+    mini->value = NULL;
+    mini->lineno = 0;
+    mini->eof = 0;
+    mini->_block_len = 0;
+    mini->_block_pos = 0;
+}
+
+mini_t *mini_lookup_keys(mini_t *mini, const char *section,
+        const char *const *keys, int flags) {
+    _mini_rewind(mini);
+    return mini_next_key(mini, section, keys, flags);
+}
+
+mini_t *mini_lookup_key(mini_t *mini, const char *section, const char *key) {
+    const char *keys[2];
+
+    _mini_rewind(mini);
+    if(!key) { return NULL; }
+
+    keys[0] = key;
+    keys[1] = NULL;
+    return mini_next_key(mini, section, keys, 0);
+}
+
 int mini_fparse_cb(FILE *stream, mini_cb_t cb, void *data) {
     mini_t *mini = mini_finit(stream);
     int ret = 0;
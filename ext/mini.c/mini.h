@@ -36,6 +36,14 @@
 #endif
 #endif
 
+#if !defined(MINI_BLOCK_SIZE) || (MINI_BLOCK_SIZE < 1)
+#define MINI_BLOCK_SIZE 65536
+#endif
+
+/* mini_next_key flags */
+#define MINI_ANY_SECTION (1 << 0)
+#define MINI_ICASE       (1 << 1)
+
 typedef struct {
     FILE *stream;
     unsigned int lineno;
@@ -44,6 +52,8 @@ typedef struct {
     /* private */
     char *_buf;
     size_t _buf_size;
+    char *_block;
+    size_t _block_len, _block_pos;
     int _free_stream;
 } mini_t;
 
@@ -56,6 +66,10 @@ mini_t *mini_next(mini_t *ctx);
 void mini_free(mini_t *ctx);
 
 mini_t *mini_lookup_key(mini_t *ctx, const char *section, const char *key);
+mini_t *mini_next_key(mini_t *ctx, const char *section,
+        const char *const *keys, int flags);
+mini_t *mini_lookup_keys(mini_t *ctx, const char *section,
+        const char *const *keys, int flags);
 
 int mini_fparse_cb(FILE *stream, mini_cb_t cb, void *data);
 int mini_parse_cb(const char *path, mini_cb_t cb, void *data);
@@ -0,0 +1,59 @@
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "tap.c/tap.c"
+
+/* lines will span several blocks */
+#define MINI_BLOCK_SIZE 3
+#define MINI_BUFFER_SIZE 16
+
+#include "mini.c"
+
+int main(void)
+{
+    char buf[] =
+        "[section]\n"
+        "key = value\n"
+        "fourteen chars\n"
+        "sixteen chars!!!\n"
+        "last";
+    FILE *stream;
+    mini_t *ini;
+
+    tap_plan(15);
+
+    if((stream = fmemopen(buf, strlen(buf), "r")) == NULL) {
+        tap_bail("error: could not open memory stream (%s)\n", strerror(errno));
+        return 1;
+    }
+    if((ini = mini_finit(stream)) == NULL) {
+        tap_bail("error: could not init mini parser (%s)\n", strerror(errno));
+        return 1;
+    }
+
+    tap_ok(mini_next(ini) != NULL, "section");
+    tap_is_str(ini->section, "section", "section name");
+    tap_ok(mini_next(ini) != NULL, "key");
+    tap_is_str(ini->key, "key", "key name");
+    tap_is_str(ini->value, "value", "key value");
+    tap_ok(mini_next(ini) != NULL, "longest line");
+    tap_is_str(ini->key, "fourteen chars", "longest line key");
+
+    errno = 0;
+    tap_ok(mini_next(ini) == NULL, "line too long");
+    tap_is_int(errno, EOVERFLOW, "errno == EOVERFLOW");
+    tap_is_int(ini->eof, 0, "not eof");
+
+    tap_ok(mini_next(ini) != NULL, "remainder of long line");
+    tap_is_str(ini->key, "!", "remainder key");
+    tap_ok(mini_next(ini) != NULL, "line without newline");
+    tap_is_str(ini->key, "last", "last key");
+    tap_ok(mini_next(ini) == NULL && ini->eof, "eof");
+
+    mini_free(ini);
+    fclose(stream);
+
+    return 0;
+}
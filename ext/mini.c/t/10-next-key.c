@@ -0,0 +1,64 @@
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "tap.c/tap.c"
+
+#include "mini.c"
+
+int main(void)
+{
+    char buf[] =
+        "Include = global\n"
+        "[options]\n"
+        "Architecture = auto\n"
+        "HoldPkg = pacman\n"
+        "include = options\n"
+        "[core]\n"
+        "Server = first\n"
+        "Include = core\n"
+        "Server = second\n";
+    const char *server[] = { "Server", NULL };
+    const char *keys[] = { "Include", "HoldPkg", NULL };
+    FILE *stream;
+    mini_t *ini;
+
+    tap_plan(19);
+
+    if((stream = fmemopen(buf, strlen(buf), "r")) == NULL) {
+        tap_bail("error: could not open memory stream (%s)\n", strerror(errno));
+        return 1;
+    }
+    if((ini = mini_finit(stream)) == NULL) {
+        tap_bail("error: could not init mini parser (%s)\n", strerror(errno));
+        return 1;
+    }
+
+#define CHECKNEXT(r, ln, k, v) {                                      \
+        tap_ok((r) != NULL, "line %d found", ln);                     \
+        tap_is_int(ini->lineno, ln, "line %d lineno", ln);            \
+        tap_is_str(ini->key, k, "line %d key", ln);                   \
+        tap_is_str(ini->value, v, "line %d value", ln);               \
+    }
+
+    CHECKNEXT(mini_lookup_keys(ini, "core", server, 0), 7, "Server", "first");
+    CHECKNEXT(mini_next_key(ini, "core", server, 0), 9, "Server", "second");
+    tap_ok(mini_next_key(ini, "core", server, 0) == NULL, "no more servers");
+    tap_ok(ini->eof, "eof");
+
+    CHECKNEXT(mini_lookup_keys(ini, "options", keys, MINI_ICASE),
+            4, "HoldPkg", "pacman");
+    CHECKNEXT(mini_next_key(ini, "options", keys, MINI_ICASE),
+            5, "include", "options");
+
+    tap_is_str(mini_lookup_keys(ini, NULL, keys, 0)->value, "global",
+            "NULL section");
+
+#undef CHECKNEXT
+
+    mini_free(ini);
+    fclose(stream);
+
+    return 0;
+}
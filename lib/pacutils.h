@@ -32,12 +32,21 @@
 
 #include <alpm.h>
 
+#include "pacutils/arena.h"
+#include "pacutils/cachemeta.h"
+#include "pacutils/confcache.h"
 #include "pacutils/config.h"
+#include "pacutils/daemon.h"
+#include "pacutils/dbsnap.h"
 #include "pacutils/depends.h"
+#include "pacutils/depgraph.h"
 #include "pacutils/log.h"
 #include "pacutils/mtree.h"
+#include "pacutils/parallel.h"
+#include "pacutils/trigram.h"
 #include "pacutils/ui.h"
 #include "pacutils/util.h"
+#include "pacutils/walk.h"
 
 char *pu_version(void);
 void pu_print_version(const char *progname, const char *progver);
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2026 Andrew Gregory <andrew.gregory.8@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#define _PU_ARENA_ALIGN _Alignof(max_align_t)
+
+struct _pu_arena_chunk {
+  struct _pu_arena_chunk *next;
+  size_t used, size;
+  _Alignas(max_align_t) unsigned char data[];
+};
+
+/* chunk_size 0 selects a default suited to parser output */
+pu_arena_t *pu_arena_new(size_t chunk_size) {
+  pu_arena_t *arena = calloc(1, sizeof(pu_arena_t));
+  if (arena == NULL) { return NULL; }
+  arena->chunk_size = chunk_size ? chunk_size : 64 * 1024;
+  return arena;
+}
+
+void *pu_arena_alloc(pu_arena_t *arena, size_t size) {
+  struct _pu_arena_chunk *c = arena->_chunks;
+  void *ptr;
+
+  if (size > SIZE_MAX - sizeof(struct _pu_arena_chunk) - _PU_ARENA_ALIGN) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  size = (size + _PU_ARENA_ALIGN - 1) & ~(_PU_ARENA_ALIGN - 1);
+
+  if (c == NULL || c->size - c->used < size) {
+    size_t csize = size > arena->chunk_size ? size : arena->chunk_size;
+    if ((c = malloc(sizeof(struct _pu_arena_chunk) + csize)) == NULL) {
+      return NULL;
+    }
+    c->used = 0;
+    c->size = csize;
+    if (arena->_chunks && size > arena->chunk_size) {
+      /* keep allocating from the current chunk after an oversized request */
+      c->next = arena->_chunks->next;
+      arena->_chunks->next = c;
+    } else {
+      c->next = arena->_chunks;
+      arena->_chunks = c;
+    }
+  }
+
+  ptr = c->data + c->used;
+  c->used += size;
+  return ptr;
+}
+
+void *pu_arena_calloc(pu_arena_t *arena, size_t nmemb, size_t size) {
+  void *ptr;
+  if (size && nmemb > SIZE_MAX / size) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  if ((ptr = pu_arena_alloc(arena, nmemb * size)) != NULL) {
+    memset(ptr, 0, nmemb * size);
+  }
+  return ptr;
+}
+
+char *pu_arena_strndup(pu_arena_t *arena, const char *str, size_t len) {
+  char *dup;
+  len = strnlen(str, len);
+  if ((dup = pu_arena_alloc(arena, len + 1)) != NULL) {
+    memcpy(dup, str, len);
+    dup[len] = '\0';
+  }
+  return dup;
+}
+
+char *pu_arena_strdup(pu_arena_t *arena, const char *str) {
+  return pu_arena_strndup(arena, str, SIZE_MAX);
+}
+
+/* releases everything allocated so far, keeping one chunk for reuse */
+void pu_arena_reset(pu_arena_t *arena) {
+  struct _pu_arena_chunk *c, *next, *keep = NULL;
+  for (c = arena->_chunks; c; c = next) {
+    next = c->next;
+    if (keep == NULL && c->size == arena->chunk_size) {
+      keep = c;
+    } else {
+      free(c);
+    }
+  }
+  if (keep) {
+    keep->used = 0;
+    keep->next = NULL;
+  }
+  arena->_chunks = keep;
+}
+
+void pu_arena_free(pu_arena_t *arena) {
+  struct _pu_arena_chunk *c, *next;
+  if (arena == NULL) { return; }
+  for (c = arena->_chunks; c; c = next) {
+    next = c->next;
+    free(c);
+  }
+  free(arena);
+}
+
+/* vim: set ts=2 sw=2 et: */
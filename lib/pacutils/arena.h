@@ -0,0 +1,46 @@
+/*
+ * Copyright 2026 Andrew Gregory <andrew.gregory.8@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef PACUTILS_ARENA_H
+#define PACUTILS_ARENA_H
+
+#include <stddef.h>
+
+/* Bump allocator: memory is handed out from large chunks and only released
+ * all at once by pu_arena_reset() or pu_arena_free(). */
+typedef struct pu_arena_t {
+  size_t chunk_size;
+
+  struct _pu_arena_chunk *_chunks;
+} pu_arena_t;
+
+pu_arena_t *pu_arena_new(size_t chunk_size);
+void *pu_arena_alloc(pu_arena_t *arena, size_t size);
+void *pu_arena_calloc(pu_arena_t *arena, size_t nmemb, size_t size);
+char *pu_arena_strdup(pu_arena_t *arena, const char *str);
+char *pu_arena_strndup(pu_arena_t *arena, const char *str, size_t len);
+void pu_arena_reset(pu_arena_t *arena);
+void pu_arena_free(pu_arena_t *arena);
+
+#endif /* PACUTILS_ARENA_H */
+
+/* vim: set ts=2 sw=2 et: */
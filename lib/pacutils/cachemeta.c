@@ -0,0 +1,569 @@
+/*
+ * Copyright 2026 Andrew Gregory <andrew.gregory.8@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#define _GNU_SOURCE /* getline */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cachemeta.h"
+#include "parallel.h"
+#include "util.h"
+
+#define PU_CACHEMETA_HEADER "PUCACHEMETA 2"
+
+char *pu_cachemeta_default_path(alpm_handle_t *handle) {
+  return pu_prepend_dir(alpm_option_get_dbpath(handle), "pacutils-cachemeta");
+}
+
+void pu_cachemeta_pkg_free(pu_cachemeta_pkg_t *pkg) {
+  if (pkg == NULL) { return; }
+  free(pkg->path);
+  free(pkg->name);
+  free(pkg->version);
+  free(pkg->base);
+  free(pkg->desc);
+  free(pkg->arch);
+  free(pkg->packager);
+  free(pkg->url);
+  FREELIST(pkg->groups);
+  FREELIST(pkg->licenses);
+  FREELIST(pkg->depends);
+  FREELIST(pkg->optdepends);
+  FREELIST(pkg->provides);
+  FREELIST(pkg->conflicts);
+  FREELIST(pkg->replaces);
+  FREELIST(pkg->files);
+  free(pkg->_rawfiles);
+  free(pkg);
+}
+
+void pu_cachemeta_free(pu_cachemeta_t *meta) {
+  size_t i;
+  if (meta == NULL) { return; }
+  for (i = 0; i < meta->_count; i++) {
+    pu_cachemeta_pkg_free(meta->_pkgs[i]);
+  }
+  free(meta->_pkgs);
+  free(meta->path);
+  free(meta);
+}
+
+static int _pu_cachemeta_pkgcmp(const void *p1, const void *p2) {
+  const pu_cachemeta_pkg_t *pkg1 = *(pu_cachemeta_pkg_t * const *) p1;
+  const pu_cachemeta_pkg_t *pkg2 = *(pu_cachemeta_pkg_t * const *) p2;
+  return strcmp(pkg1->path, pkg2->path);
+}
+
+static int _pu_cachemeta_add(pu_cachemeta_t *meta, pu_cachemeta_pkg_t *pkg) {
+  if (meta->_count == meta->_size) {
+    size_t newsize = meta->_size ? meta->_size * 2 : 64;
+    pu_cachemeta_pkg_t **newpkgs = realloc(meta->_pkgs,
+            newsize * sizeof(pu_cachemeta_pkg_t *));
+    if (newpkgs == NULL) { return -1; }
+    meta->_pkgs = newpkgs;
+    meta->_size = newsize;
+  }
+  meta->_pkgs[meta->_count++] = pkg;
+  return 0;
+}
+
+pu_cachemeta_pkg_t *pu_cachemeta_find(pu_cachemeta_t *meta, const char *path) {
+  pu_cachemeta_pkg_t needle = { .path = (char *) path }, *n = &needle, **found;
+  found = bsearch(&n, meta->_pkgs, meta->_count, sizeof(pu_cachemeta_pkg_t *),
+          _pu_cachemeta_pkgcmp);
+  return found ? *found : NULL;
+}
+
+/* values are written with '\\' and '\n' escaped so that each one stays on
+ * a single line */
+static void _pu_cachemeta_unescape(char *s) {
+  char *d = s;
+  for (; *s; s++) {
+    if (s[0] == '\\' && s[1] == 'n') {
+      *(d++) = '\n';
+      s++;
+    } else if (s[0] == '\\' && s[1] == '\\') {
+      *(d++) = '\\';
+      s++;
+    } else {
+      *(d++) = *s;
+    }
+  }
+  *d = '\0';
+}
+
+static int _pu_cachemeta_keep_raw(pu_cachemeta_pkg_t *pkg, const char *line,
+    size_t len) {
+  size_t need = pkg->_rawfileslen + len + 1;
+  if (need > pkg->_rawfilessize) {
+    size_t newsize = pkg->_rawfilessize ? pkg->_rawfilessize : 256;
+    char *raw;
+    while (newsize < need) { newsize *= 2; }
+    if ((raw = realloc(pkg->_rawfiles, newsize)) == NULL) { return -1; }
+    pkg->_rawfiles = raw;
+    pkg->_rawfilessize = newsize;
+  }
+  memcpy(pkg->_rawfiles + pkg->_rawfileslen, line, len);
+  pkg->_rawfiles[pkg->_rawfileslen + len] = '\n';
+  pkg->_rawfileslen = need;
+  return 0;
+}
+
+static int _pu_cachemeta_parse_line(pu_cachemeta_pkg_t *pkg, const char *key,
+    const char *value, int files) {
+#define STR(k, f) if (strcmp(key, k) == 0) { \
+    free(pkg->f); return (pkg->f = strdup(value)) ? 0 : -1; }
+#define NUM(k, f) if (strcmp(key, k) == 0) { \
+    pkg->f = strtoll(value, NULL, 10); return 0; }
+#define LIST(k, f) if (strcmp(key, k) == 0) { \
+    return pu_list_append_str(&pkg->f, value) ? 0 : -1; }
+  STR("NAME", name);
+  STR("VERSION", version);
+  STR("BASE", base);
+  STR("DESC", desc);
+  STR("ARCH", arch);
+  STR("PACKAGER", packager);
+  STR("URL", url);
+  NUM("ERROR", error);
+  NUM("SIZE", size);
+  NUM("ISIZE", isize);
+  NUM("BUILDDATE", builddate);
+  LIST("GROUP", groups);
+  LIST("LICENSE", licenses);
+  LIST("DEPEND", depends);
+  LIST("OPTDEPEND", optdepends);
+  LIST("PROVIDES", provides);
+  LIST("CONFLICT", conflicts);
+  LIST("REPLACES", replaces);
+  if (strcmp(key, "HASFILES") == 0) {
+    pkg->has_files = files;
+    pkg->_has_rawfiles = !files;
+    return 0;
+  }
+  if (strcmp(key, "PATH") == 0) {
+    return pu_list_append_str(&pkg->files, value) ? 0 : -1;
+  }
+#undef STR
+#undef NUM
+#undef LIST
+  /* ignore unknown keys from newer versions */
+  return 0;
+}
+
+/* Loads the store at path.  A missing store is treated as empty.  File lists
+ * are only loaded if files is non-zero, otherwise they are carried along
+ * unparsed so that writing the store back does not lose them. */
+pu_cachemeta_t *pu_cachemeta_open(const char *path, int files) {
+  pu_cachemeta_t *meta;
+  pu_cachemeta_pkg_t *pkg = NULL;
+  char *buf = NULL;
+  size_t buflen = 0;
+  ssize_t len;
+  FILE *stream;
+
+  if ((meta = calloc(sizeof(pu_cachemeta_t), 1)) == NULL) { return NULL; }
+  if ((meta->path = strdup(path)) == NULL) { free(meta); return NULL; }
+
+  if ((stream = fopen(path, "r")) == NULL) {
+    if (errno == ENOENT) { return meta; }
+    pu_cachemeta_free(meta);
+    return NULL;
+  }
+
+  if ((len = getline(&buf, &buflen, stream)) == -1
+      || (size_t) len != strlen(PU_CACHEMETA_HEADER "\n")
+      || memcmp(buf, PU_CACHEMETA_HEADER "\n", len) != 0) {
+    /* unknown format; start over */
+    meta->modified = 1;
+    goto done;
+  }
+
+  while ((len = getline(&buf, &buflen, stream)) != -1) {
+    char *value;
+    if (len && buf[len - 1] == '\n') { buf[--len] = '\0'; }
+    if (!files && pkg && strncmp(buf, "PATH ", 5) == 0) {
+      if (_pu_cachemeta_keep_raw(pkg, buf, len) != 0) { goto error; }
+      continue;
+    }
+    if ((value = strchr(buf, ' '))) { *(value++) = '\0'; }
+    else { value = buf + len; }
+    _pu_cachemeta_unescape(value);
+
+    if (strcmp(buf, "FILE") == 0) {
+      intmax_t size, sec;
+      long nsec;
+      int off = 0;
+      if ((pkg = calloc(sizeof(pu_cachemeta_pkg_t), 1)) == NULL
+          || _pu_cachemeta_add(meta, pkg) != 0) {
+        goto error;
+      }
+      if (sscanf(value, "%jd %jd %ld %n", &size, &sec, &nsec, &off) != 3
+          || (pkg->path = strdup(value + off)) == NULL) {
+        goto error;
+      }
+      pkg->filesize = size;
+      pkg->mtime.tv_sec = sec;
+      pkg->mtime.tv_nsec = nsec;
+    } else if (pkg && _pu_cachemeta_parse_line(pkg, buf, value, files) != 0) {
+      goto error;
+    }
+  }
+
+  qsort(meta->_pkgs, meta->_count, sizeof(pu_cachemeta_pkg_t *),
+      _pu_cachemeta_pkgcmp);
+
+done:
+  free(buf);
+  fclose(stream);
+  return meta;
+
+error:
+  free(buf);
+  fclose(stream);
+  pu_cachemeta_free(meta);
+  return NULL;
+}
+
+static int _pu_cachemeta_deplist(alpm_list_t **dest, alpm_list_t *deps) {
+  for (; deps; deps = deps->next) {
+    char *depstr = alpm_dep_compute_string(deps->data);
+    if (depstr == NULL || alpm_list_append(dest, depstr) == NULL) {
+      free(depstr);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static int _pu_cachemeta_strlist(alpm_list_t **dest, alpm_list_t *strs) {
+  for (; strs; strs = strs->next) {
+    if (pu_list_append_str(dest, strs->data) == NULL) { return -1; }
+  }
+  return 0;
+}
+
+static int _pu_cachemeta_strdup(char **dest, const char *src) {
+  return src == NULL || (*dest = strdup(src)) ? 0 : -1;
+}
+
+static pu_cachemeta_pkg_t *_pu_cachemeta_pkg_new(char *path,
+    struct stat *st) {
+  pu_cachemeta_pkg_t *rec;
+  if ((rec = calloc(sizeof(pu_cachemeta_pkg_t), 1)) == NULL) { return NULL; }
+  rec->path = path;
+  rec->filesize = st->st_size;
+  rec->mtime = st->st_mtim;
+  rec->_seen = 1;
+  return rec;
+}
+
+/* fills rec from a loaded package, pkg is freed */
+static int _pu_cachemeta_pkg_fill(pu_cachemeta_pkg_t *rec, alpm_pkg_t *pkg,
+    alpm_errno_t error, int files) {
+  if (pkg == NULL) {
+    rec->error = error ? error : ALPM_ERR_PKG_INVALID;
+    return 0;
+  }
+
+  if (_pu_cachemeta_strdup(&rec->name, alpm_pkg_get_name(pkg)) != 0
+      || _pu_cachemeta_strdup(&rec->version, alpm_pkg_get_version(pkg)) != 0
+      || _pu_cachemeta_strdup(&rec->base, alpm_pkg_get_base(pkg)) != 0
+      || _pu_cachemeta_strdup(&rec->desc, alpm_pkg_get_desc(pkg)) != 0
+      || _pu_cachemeta_strdup(&rec->arch, alpm_pkg_get_arch(pkg)) != 0
+      || _pu_cachemeta_strdup(&rec->packager, alpm_pkg_get_packager(pkg)) != 0
+      || _pu_cachemeta_strdup(&rec->url, alpm_pkg_get_url(pkg)) != 0
+      || _pu_cachemeta_strlist(&rec->groups, alpm_pkg_get_groups(pkg)) != 0
+      || _pu_cachemeta_strlist(&rec->licenses, alpm_pkg_get_licenses(pkg)) != 0
+      || _pu_cachemeta_deplist(&rec->depends, alpm_pkg_get_depends(pkg)) != 0
+      || _pu_cachemeta_deplist(&rec->optdepends, alpm_pkg_get_optdepends(pkg)) != 0
+      || _pu_cachemeta_deplist(&rec->provides, alpm_pkg_get_provides(pkg)) != 0
+      || _pu_cachemeta_deplist(&rec->conflicts, alpm_pkg_get_conflicts(pkg)) != 0
+      || _pu_cachemeta_deplist(&rec->replaces, alpm_pkg_get_replaces(pkg)) != 0) {
+    goto error;
+  }
+  rec->size = alpm_pkg_get_size(pkg);
+  rec->isize = alpm_pkg_get_isize(pkg);
+  rec->builddate = alpm_pkg_get_builddate(pkg);
+
+  if (files) {
+    alpm_filelist_t *filelist = alpm_pkg_get_files(pkg);
+    size_t i;
+    for (i = 0; filelist && i < filelist->count; i++) {
+      if (pu_list_append_str(&rec->files, filelist->files[i].name) == NULL) {
+        goto error;
+      }
+    }
+    rec->has_files = 1;
+  }
+
+  alpm_pkg_free(pkg);
+  return 0;
+
+error:
+  alpm_pkg_free(pkg);
+  return -1;
+}
+
+/* loads the packages for the new records in added, in parallel */
+static int _pu_cachemeta_load_added(alpm_handle_t *handle, alpm_list_t *added,
+    int files) {
+  size_t i, count = alpm_list_count(added);
+  pu_pkg_load_t *loads;
+  alpm_list_t *l, *handles = NULL;
+  int ret = 0;
+
+  if (count == 0) { return 0; }
+  if ((loads = calloc(count, sizeof(pu_pkg_load_t))) == NULL) { return -1; }
+  for (i = 0, l = added; l; l = l->next, i++) {
+    pu_cachemeta_pkg_t *rec = l->data;
+    loads[i].path = rec->path;
+  }
+
+  /* the records are copied out, the packages never reach a transaction */
+  pu_pkg_load_many_detached(handle, loads, count, files, 0, &handles);
+
+  for (i = 0, l = added; l; l = l->next, i++) {
+    if (ret == 0) {
+      ret = _pu_cachemeta_pkg_fill(l->data, loads[i].pkg, loads[i].error, files);
+    } else {
+      alpm_pkg_free(loads[i].pkg);
+    }
+  }
+  free(loads);
+  pu_pkg_load_release(handles);
+
+  return ret;
+}
+
+static int _pu_cachemeta_in_dir(pu_cachemeta_pkg_t *pkg, const char *dir,
+    size_t dirlen) {
+  return strncmp(pkg->path, dir, dirlen) == 0
+    && strchr(pkg->path + dirlen, '/') == NULL;
+}
+
+/* Brings the records for the packages in cachedir up to date, loading only
+ * files that are new or have changed since they were last recorded.  The
+ * records for cachedir are appended to pkgs, sorted by path; they remain
+ * owned by meta. */
+int pu_cachemeta_scan_dir(pu_cachemeta_t *meta, alpm_handle_t *handle,
+    const char *cachedir, int files, alpm_list_t **pkgs) {
+  size_t i, j, dirlen = strlen(cachedir);
+  alpm_list_t *l, *added = NULL;
+  struct dirent *entry;
+  DIR *dir;
+
+  if ((dir = opendir(cachedir)) == NULL) { return -1; }
+
+  for (i = 0; i < meta->_count; i++) {
+    if (_pu_cachemeta_in_dir(meta->_pkgs[i], cachedir, dirlen)) {
+      meta->_pkgs[i]->_seen = 0;
+    }
+  }
+
+  errno = 0;
+  while ((entry = readdir(dir))) {
+    const char *name = entry->d_name;
+    size_t namelen = strlen(name);
+    pu_cachemeta_pkg_t *rec;
+    struct stat st;
+    char *path;
+
+    if (strcmp(".", name) == 0 || strcmp("..", name) == 0) { continue; }
+    if (namelen >= 4 && strcmp(name + namelen - 4, ".sig") == 0) { continue; }
+    if (fstatat(dirfd(dir), name, &st, 0) != 0 || !S_ISREG(st.st_mode)) {
+      errno = 0;
+      continue;
+    }
+    if ((path = pu_asprintf("%s%s", cachedir, name)) == NULL) { goto error; }
+
+    rec = pu_cachemeta_find(meta, path);
+    if (rec && rec->filesize == st.st_size
+        && rec->mtime.tv_sec == st.st_mtim.tv_sec
+        && rec->mtime.tv_nsec == st.st_mtim.tv_nsec
+        && (!files || rec->has_files || rec->error)) {
+      rec->_seen = 1;
+      free(path);
+    } else if ((rec = _pu_cachemeta_pkg_new(path, &st)) == NULL
+        || alpm_list_append(&added, rec) == NULL) {
+      if (rec) { pu_cachemeta_pkg_free(rec); } else { free(path); }
+      goto error;
+    }
+    errno = 0;
+  }
+  if (errno != 0) { goto error; }
+  if (_pu_cachemeta_load_added(handle, added, files) != 0) { goto error; }
+  closedir(dir);
+
+  /* drop records for files that have vanished or been replaced */
+  for (i = 0, j = 0; i < meta->_count; i++) {
+    pu_cachemeta_pkg_t *rec = meta->_pkgs[i];
+    if (!rec->_seen && _pu_cachemeta_in_dir(rec, cachedir, dirlen)) {
+      pu_cachemeta_pkg_free(rec);
+      meta->modified = 1;
+    } else {
+      meta->_pkgs[j++] = rec;
+    }
+  }
+  meta->_count = j;
+
+  for (l = added; l; l = l->next) {
+    if (_pu_cachemeta_add(meta, l->data) != 0) {
+      alpm_list_free_inner(l, (alpm_list_fn_free) pu_cachemeta_pkg_free);
+      alpm_list_free(added);
+      return -1;
+    }
+    meta->modified = 1;
+  }
+  alpm_list_free(added);
+  qsort(meta->_pkgs, meta->_count, sizeof(pu_cachemeta_pkg_t *),
+      _pu_cachemeta_pkgcmp);
+
+  for (i = 0; i < meta->_count; i++) {
+    if (_pu_cachemeta_in_dir(meta->_pkgs[i], cachedir, dirlen)
+        && alpm_list_append(pkgs, meta->_pkgs[i]) == NULL) {
+      return -1;
+    }
+  }
+
+  return 0;
+
+error:
+  {
+    int err = errno;
+    closedir(dir);
+    alpm_list_free_inner(added, (alpm_list_fn_free) pu_cachemeta_pkg_free);
+    alpm_list_free(added);
+    errno = err;
+  }
+  return -1;
+}
+
+static void _pu_cachemeta_write_value(FILE *stream, const char *value) {
+  for (; *value; value++) {
+    switch (*value) {
+      case '\n': fputs("\\n", stream); break;
+      case '\\': fputs("\\\\", stream); break;
+      default: fputc(*value, stream); break;
+    }
+  }
+  fputc('\n', stream);
+}
+
+static void _pu_cachemeta_write_list(FILE *stream, const char *key,
+    alpm_list_t *list) {
+  for (; list; list = list->next) {
+    fprintf(stream, "%s ", key);
+    _pu_cachemeta_write_value(stream, list->data);
+  }
+}
+
+static void _pu_cachemeta_write_pkg(FILE *stream, pu_cachemeta_pkg_t *pkg) {
+  fprintf(stream, "FILE %jd %jd %ld ", (intmax_t) pkg->filesize,
+      (intmax_t) pkg->mtime.tv_sec, (long) pkg->mtime.tv_nsec);
+  _pu_cachemeta_write_value(stream, pkg->path);
+  if (pkg->error) {
+    fprintf(stream, "ERROR %d\n", (int) pkg->error);
+    return;
+  }
+#define STR(k, f) if (pkg->f) { \
+    fprintf(stream, "%s ", k); _pu_cachemeta_write_value(stream, pkg->f); }
+  STR("NAME", name);
+  STR("VERSION", version);
+  STR("BASE", base);
+  STR("DESC", desc);
+  STR("ARCH", arch);
+  STR("PACKAGER", packager);
+  STR("URL", url);
+#undef STR
+  fprintf(stream, "SIZE %jd\n", (intmax_t) pkg->size);
+  fprintf(stream, "ISIZE %jd\n", (intmax_t) pkg->isize);
+  fprintf(stream, "BUILDDATE %jd\n", (intmax_t) pkg->builddate);
+  _pu_cachemeta_write_list(stream, "GROUP", pkg->groups);
+  _pu_cachemeta_write_list(stream, "LICENSE", pkg->licenses);
+  _pu_cachemeta_write_list(stream, "DEPEND", pkg->depends);
+  _pu_cachemeta_write_list(stream, "OPTDEPEND", pkg->optdepends);
+  _pu_cachemeta_write_list(stream, "PROVIDES", pkg->provides);
+  _pu_cachemeta_write_list(stream, "CONFLICT", pkg->conflicts);
+  _pu_cachemeta_write_list(stream, "REPLACES", pkg->replaces);
+  if (pkg->has_files) {
+    fputs("HASFILES\n", stream);
+    _pu_cachemeta_write_list(stream, "PATH", pkg->files);
+  } else if (pkg->_has_rawfiles) {
+    fputs("HASFILES\n", stream);
+    if (pkg->_rawfileslen) {
+      fwrite(pkg->_rawfiles, pkg->_rawfileslen, 1, stream);
+    }
+  }
+}
+
+/* Atomically replaces the store on disk if it has been modified. */
+int pu_cachemeta_write(pu_cachemeta_t *meta) {
+  FILE *stream = NULL;
+  char *tmp;
+  size_t i;
+  int fd;
+
+  if (!meta->modified) { return 0; }
+
+  if ((tmp = pu_asprintf("%s.XXXXXX", meta->path)) == NULL) { return -1; }
+  if ((fd = mkstemp(tmp)) == -1) { free(tmp); return -1; }
+  if (fchmod(fd, 0644) != 0 || (stream = fdopen(fd, "w")) == NULL) {
+    close(fd);
+    goto error;
+  }
+
+  fputs(PU_CACHEMETA_HEADER "\n", stream);
+  for (i = 0; i < meta->_count; i++) {
+    _pu_cachemeta_write_pkg(stream, meta->_pkgs[i]);
+  }
+
+  if (fflush(stream) != 0 || ferror(stream) || fsync(fileno(stream)) != 0) {
+    goto error;
+  }
+  if (fclose(stream) != 0) { stream = NULL; goto error; }
+  stream = NULL;
+  if (rename(tmp, meta->path) != 0) { goto error; }
+
+  free(tmp);
+  meta->modified = 0;
+  return 0;
+
+error:
+  {
+    int err = errno;
+    if (stream) { fclose(stream); }
+    unlink(tmp);
+    free(tmp);
+    errno = err;
+  }
+  return -1;
+}
+
+/* vim: set ts=2 sw=2 et: */
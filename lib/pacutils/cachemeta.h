@@ -0,0 +1,87 @@
+/*
+ * Copyright 2026 Andrew Gregory <andrew.gregory.8@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef PACUTILS_CACHEMETA_H
+#define PACUTILS_CACHEMETA_H
+
+#include <sys/types.h>
+#include <time.h>
+
+#include <alpm.h>
+
+/* Package metadata for a single cache file.  Records are keyed by the
+ * package path, size and mtime; a record whose file could not be loaded
+ * carries the libalpm error in 'error' and no metadata. */
+typedef struct pu_cachemeta_pkg_t {
+  char *path;
+  off_t filesize;
+  struct timespec mtime;
+  alpm_errno_t error;
+
+  char *name;
+  char *version;
+  char *base;
+  char *desc;
+  char *arch;
+  char *packager;
+  char *url;
+  off_t size;
+  off_t isize;
+  alpm_time_t builddate;
+  alpm_list_t *groups;
+  alpm_list_t *licenses;
+  alpm_list_t *depends;
+  alpm_list_t *optdepends;
+  alpm_list_t *provides;
+  alpm_list_t *conflicts;
+  alpm_list_t *replaces;
+  alpm_list_t *files;
+  int has_files;
+
+  int _seen;
+  /* stored PATH lines kept verbatim when opened without file lists */
+  int _has_rawfiles;
+  char *_rawfiles;
+  size_t _rawfileslen, _rawfilessize;
+} pu_cachemeta_pkg_t;
+
+typedef struct pu_cachemeta_t {
+  char *path;
+  int modified;
+
+  pu_cachemeta_pkg_t **_pkgs; /* sorted by path */
+  size_t _count;
+  size_t _size;
+} pu_cachemeta_t;
+
+char *pu_cachemeta_default_path(alpm_handle_t *handle);
+pu_cachemeta_t *pu_cachemeta_open(const char *path, int files);
+int pu_cachemeta_scan_dir(pu_cachemeta_t *meta, alpm_handle_t *handle,
+    const char *cachedir, int files, alpm_list_t **pkgs);
+pu_cachemeta_pkg_t *pu_cachemeta_find(pu_cachemeta_t *meta, const char *path);
+int pu_cachemeta_write(pu_cachemeta_t *meta);
+void pu_cachemeta_free(pu_cachemeta_t *meta);
+void pu_cachemeta_pkg_free(pu_cachemeta_pkg_t *pkg);
+
+#endif /* PACUTILS_CACHEMETA_H */
+
+/* vim: set ts=2 sw=2 et: */
@@ -0,0 +1,490 @@
+/*
+ * Copyright 2026 Andrew Gregory <andrew.gregory.8@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "confcache.h"
+#include "util.h"
+
+#define PU_CONFCACHE_MAGIC "PUCONFC1"
+
+struct _pu_confcache_out {
+  FILE *stream;
+  int error;
+};
+
+struct _pu_confcache_in {
+  const unsigned char *pos, *end;
+  int error;
+};
+
+static void _pu_confcache_put(struct _pu_confcache_out *out,
+    const void *buf, size_t len) {
+  if (!out->error && fwrite(buf, 1, len, out->stream) != len) {
+    out->error = 1;
+  }
+}
+
+static void _pu_confcache_put_u32(struct _pu_confcache_out *out, uint32_t v) {
+  _pu_confcache_put(out, &v, sizeof(v));
+}
+
+static void _pu_confcache_put_u64(struct _pu_confcache_out *out, uint64_t v) {
+  _pu_confcache_put(out, &v, sizeof(v));
+}
+
+static void _pu_confcache_put_int(struct _pu_confcache_out *out, int v) {
+  int32_t i = v;
+  _pu_confcache_put(out, &i, sizeof(i));
+}
+
+static void _pu_confcache_put_str(struct _pu_confcache_out *out,
+    const char *s) {
+  if (s == NULL) {
+    _pu_confcache_put_u32(out, UINT32_MAX);
+  } else {
+    size_t len = strlen(s);
+    _pu_confcache_put_u32(out, len);
+    _pu_confcache_put(out, s, len);
+  }
+}
+
+static void _pu_confcache_put_list(struct _pu_confcache_out *out,
+    alpm_list_t *l) {
+  _pu_confcache_put_u32(out, alpm_list_count(l));
+  for (; l; l = l->next) { _pu_confcache_put_str(out, l->data); }
+}
+
+static const void *_pu_confcache_get(struct _pu_confcache_in *in, size_t len) {
+  const void *p = in->pos;
+  if (in->error || (size_t) (in->end - in->pos) < len) {
+    in->error = 1;
+    return NULL;
+  }
+  in->pos += len;
+  return p;
+}
+
+static uint32_t _pu_confcache_get_u32(struct _pu_confcache_in *in) {
+  const void *p = _pu_confcache_get(in, sizeof(uint32_t));
+  uint32_t v = 0;
+  if (p) { memcpy(&v, p, sizeof(v)); }
+  return v;
+}
+
+static uint64_t _pu_confcache_get_u64(struct _pu_confcache_in *in) {
+  const void *p = _pu_confcache_get(in, sizeof(uint64_t));
+  uint64_t v = 0;
+  if (p) { memcpy(&v, p, sizeof(v)); }
+  return v;
+}
+
+static int _pu_confcache_get_int(struct _pu_confcache_in *in) {
+  const void *p = _pu_confcache_get(in, sizeof(int32_t));
+  int32_t v = 0;
+  if (p) { memcpy(&v, p, sizeof(v)); }
+  return v;
+}
+
+static char *_pu_confcache_get_str(struct _pu_confcache_in *in) {
+  uint32_t len = _pu_confcache_get_u32(in);
+  const char *p;
+  char *s;
+  if (in->error || len == UINT32_MAX) { return NULL; }
+  if ((p = _pu_confcache_get(in, len)) == NULL) { return NULL; }
+  if ((s = strndup(p, len)) == NULL) { in->error = 1; }
+  return s;
+}
+
+static alpm_list_t *_pu_confcache_get_list(struct _pu_confcache_in *in) {
+  uint32_t count = _pu_confcache_get_u32(in);
+  alpm_list_t *list = NULL;
+  while (count-- > 0 && !in->error) {
+    char *s = _pu_confcache_get_str(in);
+    if (s == NULL || alpm_list_append(&list, s) == NULL) {
+      free(s);
+      in->error = 1;
+    }
+  }
+  if (in->error) { FREELIST(list); }
+  return list;
+}
+
+static int _pu_confcache_stat(int rootfd, const char *path, struct stat *st) {
+  if (rootfd != -1) {
+    while (path[0] == '/') { path++; }
+    return fstatat(rootfd, path[0] ? path : ".", st, 0);
+  } else {
+    return stat(path, st);
+  }
+}
+
+static int _pu_confcache_open_root(const char *sysroot) {
+  if (sysroot && sysroot[0]) {
+    return open(sysroot, O_DIRECTORY | O_CLOEXEC);
+  } else {
+    errno = 0;
+    return -1;
+  }
+}
+
+static uint64_t _pu_confcache_hash(uint64_t h, const char *s) {
+  /* FNV-1a, including the terminating NUL */
+  do {
+    h ^= (unsigned char) *s;
+    h *= UINT64_C(0x100000001b3);
+  } while (*s++);
+  return h;
+}
+
+/* Returns NULL if the cache should not be used: root has to opt in with
+ * PACUTILS_CONFIG_CACHE and nobody writes below a base directory owned by
+ * someone else, such as the invoking user's HOME under sudo. */
+char *pu_config_cache_path(const char *file, const char *sysroot) {
+  const char *base = getenv("XDG_CACHE_HOME"), *subdir = "pacutils";
+  uint64_t h = UINT64_C(0xcbf29ce484222325);
+  struct stat st;
+
+  if (geteuid() == 0 && getenv("PACUTILS_CONFIG_CACHE") == NULL) {
+    errno = EPERM;
+    return NULL;
+  }
+  if (base == NULL || base[0] != '/') {
+    base = getenv("HOME");
+    subdir = ".cache/pacutils";
+  }
+  if (base == NULL || base[0] != '/') {
+    errno = ENOENT;
+    return NULL;
+  }
+  if (stat(base, &st) != 0) { return NULL; }
+  if (st.st_uid != geteuid()) {
+    errno = EPERM;
+    return NULL;
+  }
+
+  h = _pu_confcache_hash(h, file);
+  h = _pu_confcache_hash(h, sysroot ? sysroot : "");
+
+  return pu_asprintf("%s/%s/config-%016" PRIx64, base, subdir, h);
+}
+
+static int _pu_confcache_read_deps(struct _pu_confcache_in *in, int rootfd) {
+  uint32_t count = _pu_confcache_get_u32(in);
+  while (count-- > 0 && !in->error) {
+    char *path = _pu_confcache_get_str(in);
+    uint32_t exists = _pu_confcache_get_u32(in);
+    uint64_t dev = _pu_confcache_get_u64(in);
+    uint64_t ino = _pu_confcache_get_u64(in);
+    uint64_t size = _pu_confcache_get_u64(in);
+    uint64_t sec = _pu_confcache_get_u64(in);
+    uint64_t nsec = _pu_confcache_get_u64(in);
+    struct stat st;
+    int fresh;
+
+    if (in->error || path == NULL) {
+      free(path);
+      in->error = 1;
+      return -1;
+    }
+    if (_pu_confcache_stat(rootfd, path, &st) == 0) {
+      fresh = exists
+          && dev == (uint64_t) st.st_dev && ino == (uint64_t) st.st_ino
+          && size == (uint64_t) st.st_size
+          && sec == (uint64_t) st.st_mtim.tv_sec
+          && nsec == (uint64_t) st.st_mtim.tv_nsec;
+    } else {
+      fresh = !exists && (errno == ENOENT || errno == ENOTDIR);
+    }
+    free(path);
+    if (!fresh) { return -1; }
+  }
+  return in->error ? -1 : 0;
+}
+
+static int _pu_confcache_read_config(struct _pu_confcache_in *in,
+    pu_config_t *config) {
+  uint32_t nrepos;
+
+  config->rootdir = _pu_confcache_get_str(in);
+  config->dbpath = _pu_confcache_get_str(in);
+  config->gpgdir = _pu_confcache_get_str(in);
+  config->logfile = _pu_confcache_get_str(in);
+  config->xfercommand = _pu_confcache_get_str(in);
+
+  config->paralleldownloads = _pu_confcache_get_int(in);
+
+  config->checkspace = _pu_confcache_get_int(in);
+  config->color = _pu_confcache_get_int(in);
+  config->ilovecandy = _pu_confcache_get_int(in);
+  config->usesyslog = _pu_confcache_get_int(in);
+  config->verbosepkglists = _pu_confcache_get_int(in);
+  config->disabledownloadtimeout = _pu_confcache_get_int(in);
+
+  config->siglevel = _pu_confcache_get_int(in);
+  config->localfilesiglevel = _pu_confcache_get_int(in);
+  config->remotefilesiglevel = _pu_confcache_get_int(in);
+
+  config->siglevel_mask = _pu_confcache_get_int(in);
+  config->localfilesiglevel_mask = _pu_confcache_get_int(in);
+  config->remotefilesiglevel_mask = _pu_confcache_get_int(in);
+
+  config->architectures = _pu_confcache_get_list(in);
+  config->cachedirs = _pu_confcache_get_list(in);
+  config->holdpkgs = _pu_confcache_get_list(in);
+  config->hookdirs = _pu_confcache_get_list(in);
+  config->ignoregroups = _pu_confcache_get_list(in);
+  config->ignorepkgs = _pu_confcache_get_list(in);
+  config->noextract = _pu_confcache_get_list(in);
+  config->noupgrade = _pu_confcache_get_list(in);
+
+  config->cleanmethod = _pu_confcache_get_int(in);
+
+  nrepos = _pu_confcache_get_u32(in);
+  while (nrepos-- > 0 && !in->error) {
+    pu_repo_t *repo = pu_repo_new();
+    if (repo == NULL || alpm_list_append(&config->repos, repo) == NULL) {
+      pu_repo_free(repo);
+      return -1;
+    }
+    repo->name = _pu_confcache_get_str(in);
+    repo->servers = _pu_confcache_get_list(in);
+    repo->usage = _pu_confcache_get_int(in);
+    repo->siglevel = _pu_confcache_get_int(in);
+    repo->siglevel_mask = _pu_confcache_get_int(in);
+    if (repo->name == NULL) { in->error = 1; }
+  }
+
+  return in->error || in->pos != in->end ? -1 : 0;
+}
+
+pu_config_t *pu_config_cache_read(const char *path,
+    const char *file, const char *sysroot) {
+  struct _pu_confcache_in in;
+  pu_config_t *config = NULL;
+  unsigned char *buf = MAP_FAILED;
+  char *cfile = NULL, *croot = NULL;
+  struct stat st;
+  int fd, rootfd = -1, err;
+
+  if ((fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC)) == -1) {
+    return NULL;
+  }
+  if (fstat(fd, &st) != 0) { goto error; }
+  if (!S_ISREG(st.st_mode) || st.st_uid != geteuid()
+      || (st.st_mode & (S_IWGRP | S_IWOTH))) {
+    errno = EPERM;
+    goto error;
+  }
+  if (st.st_size < 8) { errno = ESTALE; goto error; }
+  buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (buf == MAP_FAILED) { goto error; }
+  if (memcmp(buf, PU_CONFCACHE_MAGIC, 8) != 0) { errno = ESTALE; goto error; }
+
+  in.pos = buf + 8;
+  in.end = buf + st.st_size;
+  in.error = 0;
+
+  cfile = _pu_confcache_get_str(&in);
+  croot = _pu_confcache_get_str(&in);
+  if (in.error || cfile == NULL || strcmp(cfile, file) != 0
+      || strcmp(croot ? croot : "", sysroot ? sysroot : "") != 0) {
+    errno = ESTALE;
+    goto error;
+  }
+
+  if ((rootfd = _pu_confcache_open_root(sysroot)) == -1 && errno) {
+    goto error;
+  }
+  if (_pu_confcache_read_deps(&in, rootfd) != 0) {
+    errno = ESTALE;
+    goto error;
+  }
+
+  if ((config = pu_config_new()) == NULL) { goto error; }
+  if (_pu_confcache_read_config(&in, config) != 0) {
+    errno = in.error ? ESTALE : ENOMEM;
+    goto error;
+  }
+
+  free(cfile);
+  free(croot);
+  munmap(buf, st.st_size);
+  if (rootfd != -1) { close(rootfd); }
+  close(fd);
+  return config;
+
+error:
+  err = errno;
+  pu_config_free(config);
+  free(cfile);
+  free(croot);
+  if (buf != MAP_FAILED) { munmap(buf, st.st_size); }
+  if (rootfd != -1) { close(rootfd); }
+  close(fd);
+  errno = err;
+  return NULL;
+}
+
+static int _pu_confcache_write_deps(struct _pu_confcache_out *out,
+    int rootfd, alpm_list_t *deps) {
+  time_t now = time(NULL);
+
+  _pu_confcache_put_u32(out, alpm_list_count(deps));
+  for (; deps; deps = deps->next) {
+    struct stat st;
+    int exists = _pu_confcache_stat(rootfd, deps->data, &st) == 0;
+
+    if (!exists) {
+      if (errno != ENOENT && errno != ENOTDIR) { return -1; }
+      memset(&st, 0, sizeof(st));
+    } else if (st.st_mtim.tv_sec >= now - 1) {
+      /* a change within the same timestamp granularity would go unnoticed */
+      errno = EAGAIN;
+      return -1;
+    }
+
+    _pu_confcache_put_str(out, deps->data);
+    _pu_confcache_put_u32(out, exists);
+    _pu_confcache_put_u64(out, st.st_dev);
+    _pu_confcache_put_u64(out, st.st_ino);
+    _pu_confcache_put_u64(out, st.st_size);
+    _pu_confcache_put_u64(out, st.st_mtim.tv_sec);
+    _pu_confcache_put_u64(out, st.st_mtim.tv_nsec);
+  }
+  return 0;
+}
+
+static void _pu_confcache_write_config(struct _pu_confcache_out *out,
+    pu_config_t *config) {
+  alpm_list_t *i;
+
+  _pu_confcache_put_str(out, config->rootdir);
+  _pu_confcache_put_str(out, config->dbpath);
+  _pu_confcache_put_str(out, config->gpgdir);
+  _pu_confcache_put_str(out, config->logfile);
+  _pu_confcache_put_str(out, config->xfercommand);
+
+  _pu_confcache_put_int(out, config->paralleldownloads);
+
+  _pu_confcache_put_int(out, config->checkspace);
+  _pu_confcache_put_int(out, config->color);
+  _pu_confcache_put_int(out, config->ilovecandy);
+  _pu_confcache_put_int(out, config->usesyslog);
+  _pu_confcache_put_int(out, config->verbosepkglists);
+  _pu_confcache_put_int(out, config->disabledownloadtimeout);
+
+  _pu_confcache_put_int(out, config->siglevel);
+  _pu_confcache_put_int(out, config->localfilesiglevel);
+  _pu_confcache_put_int(out, config->remotefilesiglevel);
+
+  _pu_confcache_put_int(out, config->siglevel_mask);
+  _pu_confcache_put_int(out, config->localfilesiglevel_mask);
+  _pu_confcache_put_int(out, config->remotefilesiglevel_mask);
+
+  _pu_confcache_put_list(out, config->architectures);
+  _pu_confcache_put_list(out, config->cachedirs);
+  _pu_confcache_put_list(out, config->holdpkgs);
+  _pu_confcache_put_list(out, config->hookdirs);
+  _pu_confcache_put_list(out, config->ignoregroups);
+  _pu_confcache_put_list(out, config->ignorepkgs);
+  _pu_confcache_put_list(out, config->noextract);
+  _pu_confcache_put_list(out, config->noupgrade);
+
+  _pu_confcache_put_int(out, config->cleanmethod);
+
+  _pu_confcache_put_u32(out, alpm_list_count(config->repos));
+  for (i = config->repos; i; i = i->next) {
+    pu_repo_t *repo = i->data;
+    _pu_confcache_put_str(out, repo->name);
+    _pu_confcache_put_list(out, repo->servers);
+    _pu_confcache_put_int(out, repo->usage);
+    _pu_confcache_put_int(out, repo->siglevel);
+    _pu_confcache_put_int(out, repo->siglevel_mask);
+  }
+}
+
+static int _pu_confcache_mkdirs(const char *path) {
+  char *dir = strdup(path), *c;
+  if (dir == NULL) { return -1; }
+  for (c = dir + 1; (c = strchr(c, '/')); c++) {
+    *c = '\0';
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+      free(dir);
+      return -1;
+    }
+    *c = '/';
+  }
+  free(dir);
+  return 0;
+}
+
+int pu_config_cache_write(const char *path, pu_config_t *config,
+    const char *file, const char *sysroot, alpm_list_t *deps) {
+  struct _pu_confcache_out out = { NULL, 0 };
+  char *tmp = NULL;
+  int fd, rootfd, err;
+
+  if ((rootfd = _pu_confcache_open_root(sysroot)) == -1 && errno) {
+    return -1;
+  }
+  if (_pu_confcache_mkdirs(path) != 0) { goto error; }
+  if ((tmp = malloc(strlen(path) + 8)) == NULL) { goto error; }
+  sprintf(tmp, "%s.XXXXXX", path);
+  if ((fd = mkstemp(tmp)) == -1) { free(tmp); tmp = NULL; goto error; }
+  if ((out.stream = fdopen(fd, "w")) == NULL) { close(fd); goto error; }
+
+  _pu_confcache_put(&out, PU_CONFCACHE_MAGIC, 8);
+  _pu_confcache_put_str(&out, file);
+  _pu_confcache_put_str(&out, sysroot);
+  if (_pu_confcache_write_deps(&out, rootfd, deps) != 0) { goto error; }
+  _pu_confcache_write_config(&out, config);
+
+  if (out.error || fflush(out.stream) != 0) { goto error; }
+  if (fclose(out.stream) != 0) { out.stream = NULL; goto error; }
+  out.stream = NULL;
+  if (rename(tmp, path) != 0) { goto error; }
+
+  free(tmp);
+  if (rootfd != -1) { close(rootfd); }
+  return 0;
+
+error:
+  err = errno;
+  if (out.stream) { fclose(out.stream); }
+  if (tmp) { unlink(tmp); free(tmp); }
+  if (rootfd != -1) { close(rootfd); }
+  errno = err;
+  return -1;
+}
+
+/* vim: set ts=2 sw=2 et: */
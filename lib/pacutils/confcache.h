@@ -0,0 +1,53 @@
+/*
+ * Copyright 2026 Andrew Gregory <andrew.gregory.8@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef PACUTILS_CONFCACHE_H
+#define PACUTILS_CONFCACHE_H
+
+#include "config.h"
+
+/* A binary snapshot of a parsed configuration.  The snapshot records the
+ * device, inode, size and mtime of the root config file, every file it
+ * included and every directory an Include glob was expanded in; it is only
+ * used while all of them are unchanged.  The stored configuration is the
+ * reader output before pu_config_resolve(), so command line overrides and
+ * server variable substitution still apply to it. */
+
+/* returns the default cache location for file and sysroot under
+ * $XDG_CACHE_HOME or ~/.cache, or NULL if neither is available */
+char *pu_config_cache_path(const char *file, const char *sysroot);
+
+/* returns NULL with errno ESTALE if the cache is out of date; the cache file
+ * is ignored unless it is owned by the current user and not writable by
+ * anybody else */
+pu_config_t *pu_config_cache_read(const char *path,
+    const char *file, const char *sysroot);
+
+/* deps is the list of files and directories the configuration was read
+ * from, see pu_config_reader_t; fails with EAGAIN if one of them was
+ * modified too recently to be reliably detected when it changes again */
+int pu_config_cache_write(const char *path, pu_config_t *config,
+    const char *file, const char *sysroot, alpm_list_t *deps);
+
+#endif /* PACUTILS_CONFCACHE_H */
+
+/* vim: set ts=2 sw=2 et: */
@@ -30,6 +30,7 @@
 
 #include "config.h"
 #include "config-defaults.h"
+#include "daemon.h"
 #include "util.h"
 
 struct _pu_config_setting {
@@ -342,9 +343,14 @@ static int _pu_subst_server_vars(pu_config_t *config) {
 }
 
 alpm_handle_t *pu_initialize_handle_from_config(pu_config_t *config) {
-  alpm_handle_t *handle = alpm_initialize(config->rootdir, config->dbpath, NULL);
+  alpm_handle_t *handle;
 
-  if (!handle) {
+  /* reuse the handle the daemon has already loaded */
+  if ((handle = _pu_daemon_get_handle(config))) {
+    return handle;
+  }
+
+  if (!(handle = alpm_initialize(config->rootdir, config->dbpath, NULL))) {
     return NULL;
   }
 
@@ -379,8 +385,41 @@ alpm_handle_t *pu_initialize_handle_from_config(pu_config_t *config) {
   return handle;
 }
 
+/* a handle preloaded by the daemon can be released by the process exiting,
+ * freeing it would only copy the shared pages */
+int pu_release_handle(alpm_handle_t *handle) {
+  if (_pu_daemon_is_handle(handle)) {
+    return 0;
+  }
+  return alpm_release(handle);
+}
+
+/* whether the sync databases of a preloaded handle can be used as is */
+static int _pu_preloaded_syncdbs(alpm_handle_t *handle) {
+  const char *dbext = alpm_option_get_dbext(handle), *pre = _pu_daemon_dbext();
+  if (!_pu_daemon_is_handle(handle)) {
+    return 0;
+  } else if (dbext == pre || (dbext && pre && strcmp(dbext, pre) == 0)) {
+    return 1;
+  }
+  /* the caller wants a different database extension, start over and
+   * register the replacements normally */
+  alpm_unregister_all_syncdbs(handle);
+  _pu_daemon_set_dbext(dbext);
+  return 0;
+}
+
 alpm_db_t *pu_register_syncdb(alpm_handle_t *handle, pu_repo_t *repo) {
-  alpm_db_t *db = alpm_register_syncdb(handle, repo->name, repo->siglevel);
+  alpm_db_t *db;
+  if (_pu_preloaded_syncdbs(handle)) {
+    alpm_list_t *i;
+    for (i = alpm_get_syncdbs(handle); i; i = i->next) {
+      if (strcmp(alpm_db_get_name(i->data), repo->name) == 0) {
+        return i->data;
+      }
+    }
+  }
+  db = alpm_register_syncdb(handle, repo->name, repo->siglevel);
   if (db) {
     alpm_db_set_servers(db, alpm_list_strdup(repo->servers));
     alpm_db_set_usage(db, repo->usage);
@@ -390,6 +429,9 @@ alpm_db_t *pu_register_syncdb(alpm_handle_t *handle, pu_repo_t *repo) {
 
 alpm_list_t *pu_register_syncdbs(alpm_handle_t *handle, alpm_list_t *repos) {
   alpm_list_t *r;
+  if (_pu_preloaded_syncdbs(handle)) {
+    return alpm_get_syncdbs(handle);
+  }
   for (r = repos; r; r = r->next) {
     pu_register_syncdb(handle, r->data);
   }
@@ -585,6 +627,54 @@ static int _pu_glob_at(alpm_list_t **dest, const char *pattern, int sysrootfd) {
   return 0;
 }
 
+/* records a file or directory the parsed configuration depends on */
+static int _pu_config_reader_add_dep(pu_config_reader_t *reader,
+    const char *path, size_t len) {
+  char *dup = strndup(path, len);
+  if (dup == NULL || alpm_list_append(&reader->_deps, dup) == NULL) {
+    free(dup);
+    return -1;
+  }
+  return 0;
+}
+
+/* the set of files matched by a glob changes with its directory */
+static int _pu_config_reader_add_glob_dep(pu_config_reader_t *reader,
+    const char *pattern) {
+  const char *wild = strpbrk(pattern, "*?["), *c;
+  int ret = 0;
+
+  if (wild == NULL) { return 0; }
+
+  /* the directory listed for the first wildcard component */
+  for (c = wild; c > pattern && c[-1] != '/'; c--);
+  if (c == pattern) {
+    ret = _pu_config_reader_add_dep(reader, ".", 1);
+  } else {
+    ret = _pu_config_reader_add_dep(reader, pattern,
+        c - 1 == pattern ? 1 : (size_t) (c - 1 - pattern));
+  }
+
+  /* directories matched by later components are listed as well */
+  for (c = strchr(wild, '/'); c && ret == 0; c = strchr(c + 1, '/')) {
+    alpm_list_t *dirs = NULL, *d;
+    char *prefix = strndup(pattern, c - pattern);
+    if (prefix == NULL || _pu_glob_at(&dirs, prefix, reader->_sysroot_fd) != 0) {
+      ret = -1;
+    }
+    for (d = dirs; d && ret == 0; d = d->next) {
+      /* GLOB_NOCHECK hands back the pattern itself if nothing matched */
+      if (strpbrk(d->data, "*?[") == NULL) {
+        ret = _pu_config_reader_add_dep(reader, d->data, strlen(d->data));
+      }
+    }
+    FREELIST(dirs);
+    free(prefix);
+  }
+
+  return ret;
+}
+
 #define SETSTROPT(dest, val) if(!dest) { \
     char *dup = strdup(val); \
     if(dup) { \
@@ -630,7 +720,8 @@ int pu_config_reader_next(pu_config_reader_t *reader) {
         reader->file = _pu_list_shift(&reader->_parent->_includes);
         reader->_includes = NULL;
         reader->_mini = _pu_mini_openat(reader->_sysroot_fd, reader->file);
-        if (reader->_mini == NULL) {
+        if (reader->_mini == NULL || _pu_config_reader_add_dep(reader,
+              reader->file, strlen(reader->file)) != 0) {
           _PU_ERR(reader, PU_CONFIG_READER_STATUS_ERROR);
         }
       } else {
@@ -680,7 +771,8 @@ int pu_config_reader_next(pu_config_reader_t *reader) {
     }
 
     if (s->type == PU_CONFIG_OPTION_INCLUDE) {
-      if (_pu_glob_at(&reader->_includes, mini->value, reader->_sysroot_fd) != 0) {
+      if (_pu_glob_at(&reader->_includes, mini->value, reader->_sysroot_fd) != 0
+          || _pu_config_reader_add_glob_dep(reader, mini->value) != 0) {
         _PU_ERR(reader, PU_CONFIG_READER_STATUS_ERROR);
       } else if (reader->_includes == NULL) {
         return pu_config_reader_next(reader);
@@ -689,7 +781,8 @@ int pu_config_reader_next(pu_config_reader_t *reader) {
         pu_config_reader_t *p = malloc(sizeof(pu_config_reader_t));
         mini_t *newmini = _pu_mini_openat(reader->_sysroot_fd, file);
 
-        if (p == NULL || newmini == NULL) {
+        if (p == NULL || newmini == NULL
+            || _pu_config_reader_add_dep(reader, file, strlen(file)) != 0) {
           free(file);
           free(p);
           mini_free(newmini);
@@ -697,6 +790,7 @@ int pu_config_reader_next(pu_config_reader_t *reader) {
         }
 
         memcpy(p, reader, sizeof(pu_config_reader_t));
+        p->_deps = NULL;
         reader->file = file;
         reader->line = 0;
         reader->_parent = p;
@@ -870,7 +964,8 @@ pu_config_reader_t *pu_config_reader_new_sysroot(pu_config_t *config,
     reader->_sysroot_fd = -1;
   }
 
-  if ((reader->_mini = _pu_mini_openat(reader->_sysroot_fd, file)) == NULL) {
+  if ((reader->_mini = _pu_mini_openat(reader->_sysroot_fd, file)) == NULL
+      || _pu_config_reader_add_dep(reader, file, strlen(file)) != 0) {
     pu_config_reader_free(reader);
     return NULL;
   }
@@ -903,6 +998,7 @@ void pu_config_reader_free(pu_config_reader_t *reader) {
   free(reader->section);
   mini_free(reader->_mini);
   FREELIST(reader->_includes);
+  FREELIST(reader->_deps);
   pu_config_reader_free(reader->_parent);
   free(reader);
 }
@@ -139,6 +139,7 @@ typedef struct pu_config_reader_t {
   struct pu_config_reader_t *_parent;
   alpm_list_t *_includes;
   int _sysroot_fd;
+  alpm_list_t *_deps; /* files and include directories read so far */
 } pu_config_reader_t;
 
 pu_repo_t *pu_repo_new(void);
@@ -153,6 +154,7 @@ int pu_config_resolve_sysroot(pu_config_t *config, const char *sysroot);
 void pu_config_free(pu_config_t *config);
 
 alpm_handle_t *pu_initialize_handle_from_config(pu_config_t *config);
+int pu_release_handle(alpm_handle_t *handle);
 
 pu_config_reader_t *pu_config_reader_new_sysroot(pu_config_t *config,
     const char *file, const char *sysroot);
@@ -0,0 +1,404 @@
+/*
+ * Copyright 2026 Andrew Gregory <andrew.gregory.8@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#define _GNU_SOURCE /* struct ucred */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "daemon.h"
+#include "util.h"
+
+#define PU_DAEMON_MAGIC "PUDAEMN1"
+#define PU_DAEMON_MAXDATA (1 << 20)
+
+struct _pu_daemon_header {
+  char magic[8];
+  uint32_t argc;
+  uint32_t fdmask;
+  uint32_t datalen;
+  uint32_t pad;
+};
+
+static pu_config_t *_pu_daemon_config = NULL;
+static alpm_handle_t *_pu_daemon_handle = NULL;
+static char *_pu_daemon_handle_dbext = NULL;
+static int _pu_daemon_serving = 0;
+
+char *pu_daemon_default_socket(void) {
+  return strdup(LOCALSTATEDIR "/run/pacutilsd.sock");
+}
+
+/* Returns the socket given with --daemon[=<socket>] before any "--", or NULL
+ * if the option was not given or this process is serving a request for the
+ * daemon itself.  The option must be spelled out in full. */
+const char *pu_daemon_option(int argc, char **argv) {
+  static char *def = NULL;
+  int i;
+  if (_pu_daemon_serving) { return NULL; }
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--") == 0) {
+      return NULL;
+    } else if (strncmp(argv[i], "--daemon=", 9) == 0 && argv[i][9]) {
+      return argv[i] + 9;
+    } else if (strcmp(argv[i], "--daemon") == 0) {
+      if (def == NULL) { def = pu_daemon_default_socket(); }
+      return def;
+    }
+  }
+  return NULL;
+}
+
+static int _pu_daemon_write_all(int fd, const char *buf, size_t len) {
+  while (len) {
+    ssize_t w = write(fd, buf, len);
+    if (w < 0 && errno == EINTR) { continue; }
+    if (w <= 0) { return -1; }
+    buf += w;
+    len -= w;
+  }
+  return 0;
+}
+
+static int _pu_daemon_read_all(int fd, char *buf, size_t len) {
+  while (len) {
+    ssize_t r = read(fd, buf, len);
+    if (r < 0 && errno == EINTR) { continue; }
+    if (r == 0) { errno = ECONNRESET; }
+    if (r <= 0) { return -1; }
+    buf += r;
+    len -= r;
+  }
+  return 0;
+}
+
+static int _pu_daemon_addr(const char *path, struct sockaddr_un *addr) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr->sun_path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  strcpy(addr->sun_path, path);
+  return 0;
+}
+
+/* Runs tool through the daemon listening on socket, passing along argv, the
+ * working directory and the standard streams.  Returns the tool's exit
+ * status, or -1 if the request could not be made, in which case nothing has
+ * been run and the caller may run the tool itself.  If the connection is lost
+ * after the request was made 1 is returned. */
+int pu_daemon_run(const char *socket_path, const char *tool,
+    int argc, char **argv) {
+  struct _pu_daemon_header hdr;
+  struct sockaddr_un addr;
+  struct msghdr msg;
+  struct iovec iov;
+  union {
+    char buf[CMSG_SPACE(3 * sizeof(int))];
+    struct cmsghdr align;
+  } cbuf;
+  char cwd[PATH_MAX], *data = NULL, *c;
+  int fds[3], nfds = 0, fd, i, err;
+  size_t datalen;
+  int32_t status;
+
+  if (getcwd(cwd, sizeof(cwd)) == NULL) { return -1; }
+  datalen = strlen(tool) + strlen(cwd) + 2;
+  for (i = 0; i < argc; i++) { datalen += strlen(argv[i]) + 1; }
+  if (datalen > PU_DAEMON_MAXDATA) { errno = E2BIG; return -1; }
+  if ((data = malloc(datalen)) == NULL) { return -1; }
+  c = stpcpy(data, tool) + 1;
+  c = stpcpy(c, cwd) + 1;
+  for (i = 0; i < argc; i++) { c = stpcpy(c, argv[i]) + 1; }
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, PU_DAEMON_MAGIC, 8);
+  hdr.argc = argc;
+  hdr.datalen = datalen;
+  for (i = 0; i < 3; i++) {
+    if (fcntl(i, F_GETFD) != -1) {
+      hdr.fdmask |= 1 << i;
+      fds[nfds++] = i;
+    }
+  }
+
+  if (_pu_daemon_addr(socket_path, &addr) != 0
+      || (fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1) {
+    err = errno;
+    free(data);
+    errno = err;
+    return -1;
+  }
+  if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+    goto error;
+  }
+
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = &hdr;
+  iov.iov_len = sizeof(hdr);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  if (nfds) {
+    struct cmsghdr *cmsg;
+    memset(&cbuf, 0, sizeof(cbuf));
+    msg.msg_control = cbuf.buf;
+    msg.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, nfds * sizeof(int));
+  }
+  if (sendmsg(fd, &msg, MSG_NOSIGNAL) != sizeof(hdr)
+      || _pu_daemon_write_all(fd, data, datalen) != 0) {
+    goto error;
+  }
+  free(data);
+
+  if (_pu_daemon_read_all(fd, (char *) &status, sizeof(status)) != 0) {
+    close(fd);
+    return 1;
+  }
+  close(fd);
+  return status;
+
+error:
+  err = errno;
+  close(fd);
+  free(data);
+  errno = err;
+  return -1;
+}
+
+int pu_daemon_listen(const char *socket_path) {
+  struct sockaddr_un addr;
+  int fd, err;
+
+  if (_pu_daemon_addr(socket_path, &addr) != 0) { return -1; }
+  if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1) {
+    return -1;
+  }
+  unlink(socket_path);
+  if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0
+      || chmod(socket_path, 0666) != 0
+      || listen(fd, SOMAXCONN) != 0) {
+    err = errno;
+    close(fd);
+    errno = err;
+    return -1;
+  }
+  return fd;
+}
+
+/* reads the request sent by pu_daemon_run from conn, which req takes */
+int pu_daemon_request_read(int conn, pu_daemon_request_t *req) {
+  struct _pu_daemon_header hdr;
+  struct ucred cred;
+  socklen_t credlen = sizeof(cred);
+  struct msghdr msg;
+  struct cmsghdr *cmsg;
+  struct iovec iov;
+  union {
+    char buf[CMSG_SPACE(3 * sizeof(int))];
+    struct cmsghdr align;
+  } cbuf;
+  int fds[3], nfds = 0, i, n;
+  ssize_t r;
+  char *c, *end;
+
+  memset(req, 0, sizeof(*req));
+  req->conn = conn;
+  req->fds[0] = req->fds[1] = req->fds[2] = -1;
+
+  if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &credlen) != 0) {
+    return -1;
+  }
+  req->uid = cred.uid;
+  req->gid = cred.gid;
+  req->pid = cred.pid;
+
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = &hdr;
+  iov.iov_len = sizeof(hdr);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = cbuf.buf;
+  msg.msg_controllen = sizeof(cbuf.buf);
+  while ((r = recvmsg(conn, &msg, MSG_CMSG_CLOEXEC)) == -1 && errno == EINTR);
+  if (r == -1) { return -1; }
+
+  for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+      n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      for (i = 0; i < n; i++) {
+        int fd;
+        memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+        if (nfds < 3) { fds[nfds++] = fd; } else { close(fd); }
+      }
+    }
+  }
+  for (i = 0, n = 0; i < 3; i++) {
+    if (hdr.fdmask & (1 << i) && n < nfds) { req->fds[i] = fds[n++]; }
+  }
+  for (; n < nfds; n++) { close(fds[n]); }
+
+  if (r != sizeof(hdr) || memcmp(hdr.magic, PU_DAEMON_MAGIC, 8) != 0
+      || hdr.datalen > PU_DAEMON_MAXDATA || hdr.argc > hdr.datalen) {
+    errno = EPROTO;
+    return -1;
+  }
+
+  if ((req->_data = malloc(hdr.datalen + 1)) == NULL
+      || (req->argv = calloc(hdr.argc + 1, sizeof(char *))) == NULL
+      || _pu_daemon_read_all(conn, req->_data, hdr.datalen) != 0) {
+    return -1;
+  }
+  req->_data[hdr.datalen] = '\0';
+
+  c = req->_data;
+  end = req->_data + hdr.datalen;
+  req->tool = c;
+  c += strlen(c) + 1;
+  if (c >= end) { errno = EPROTO; return -1; }
+  req->cwd = c;
+  c += strlen(c) + 1;
+  for (req->argc = 0; (uint32_t) req->argc < hdr.argc; req->argc++) {
+    if (c >= end) { errno = EPROTO; return -1; }
+    req->argv[req->argc] = c;
+    c += strlen(c) + 1;
+  }
+
+  return 0;
+}
+
+int pu_daemon_reply(pu_daemon_request_t *req, int status) {
+  int32_t s = status;
+  int ret = 0;
+  if (send(req->conn, &s, sizeof(s), MSG_NOSIGNAL) != sizeof(s)) { ret = -1; }
+  return ret;
+}
+
+/* closes the connection and any streams that were passed along */
+void pu_daemon_request_free(pu_daemon_request_t *req) {
+  int i;
+  if (req->conn != -1) { close(req->conn); }
+  for (i = 0; i < 3; i++) {
+    if (req->fds[i] != -1) { close(req->fds[i]); }
+  }
+  free(req->argv);
+  free(req->_data);
+  req->conn = -1;
+  req->argv = NULL;
+  req->_data = NULL;
+}
+
+/* Marks handle, initialized from config with its sync databases registered,
+ * as preloaded: pu_initialize_handle_from_config() returns it for an
+ * identical configuration instead of creating a new handle.  Meant for the
+ * daemon, whose forked children inherit the handle to serve requests. */
+void pu_daemon_set_handle(pu_config_t *config, alpm_handle_t *handle) {
+  _pu_daemon_config = handle ? config : NULL;
+  _pu_daemon_handle = handle;
+  /* a process that has served a handle never forwards its own requests,
+   * even after the handle has been dropped as stale */
+  _pu_daemon_serving |= (handle != NULL);
+  free(_pu_daemon_handle_dbext);
+  _pu_daemon_handle_dbext = NULL;
+  if (handle && alpm_option_get_dbext(handle)) {
+    _pu_daemon_handle_dbext = strdup(alpm_option_get_dbext(handle));
+  }
+}
+
+static int _pu_daemon_streq(const char *s1, const char *s2) {
+  return s1 == s2 || (s1 && s2 && strcmp(s1, s2) == 0);
+}
+
+static int _pu_daemon_listeq(alpm_list_t *l1, alpm_list_t *l2) {
+  for (; l1 && l2; l1 = l1->next, l2 = l2->next) {
+    if (!_pu_daemon_streq(l1->data, l2->data)) { return 0; }
+  }
+  return l1 == l2;
+}
+
+static int _pu_daemon_config_eq(pu_config_t *c1, pu_config_t *c2) {
+  alpm_list_t *r1, *r2;
+  if (!_pu_daemon_streq(c1->rootdir, c2->rootdir)
+      || !_pu_daemon_streq(c1->dbpath, c2->dbpath)
+      || !_pu_daemon_streq(c1->gpgdir, c2->gpgdir)
+      || !_pu_daemon_streq(c1->logfile, c2->logfile)
+      || c1->siglevel != c2->siglevel
+      || c1->localfilesiglevel != c2->localfilesiglevel
+      || c1->remotefilesiglevel != c2->remotefilesiglevel
+      || c1->usesyslog != c2->usesyslog
+      || c1->disabledownloadtimeout != c2->disabledownloadtimeout
+      || c1->paralleldownloads != c2->paralleldownloads
+      || !_pu_daemon_listeq(c1->architectures, c2->architectures)
+      || !_pu_daemon_listeq(c1->cachedirs, c2->cachedirs)
+      || !_pu_daemon_listeq(c1->hookdirs, c2->hookdirs)
+      || !_pu_daemon_listeq(c1->ignoregroups, c2->ignoregroups)
+      || !_pu_daemon_listeq(c1->ignorepkgs, c2->ignorepkgs)
+      || !_pu_daemon_listeq(c1->noextract, c2->noextract)
+      || !_pu_daemon_listeq(c1->noupgrade, c2->noupgrade)) {
+    return 0;
+  }
+  for (r1 = c1->repos, r2 = c2->repos; r1 && r2; r1 = r1->next, r2 = r2->next) {
+    pu_repo_t *repo1 = r1->data, *repo2 = r2->data;
+    if (!_pu_daemon_streq(repo1->name, repo2->name)
+        || repo1->siglevel != repo2->siglevel
+        || repo1->usage != repo2->usage
+        || !_pu_daemon_listeq(repo1->servers, repo2->servers)) {
+      return 0;
+    }
+  }
+  return r1 == r2;
+}
+
+alpm_handle_t *_pu_daemon_get_handle(pu_config_t *config) {
+  if (_pu_daemon_handle && _pu_daemon_config_eq(_pu_daemon_config, config)) {
+    return _pu_daemon_handle;
+  }
+  return NULL;
+}
+
+int _pu_daemon_is_handle(alpm_handle_t *handle) {
+  return handle && handle == _pu_daemon_handle;
+}
+
+const char *_pu_daemon_dbext(void) {
+  return _pu_daemon_handle_dbext;
+}
+
+void _pu_daemon_set_dbext(const char *dbext) {
+  free(_pu_daemon_handle_dbext);
+  _pu_daemon_handle_dbext = dbext ? strdup(dbext) : NULL;
+}
+
+/* vim: set ts=2 sw=2 et: */
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2026 Andrew Gregory <andrew.gregory.8@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef PACUTILS_DAEMON_H
+#define PACUTILS_DAEMON_H
+
+#include <sys/types.h>
+
+#include <alpm.h>
+
+#include "config.h"
+
+/* A request forwarded by a tool running with --daemon: the tool name, the
+ * client's working directory and arguments, and its standard streams, -1
+ * for any stream the client had closed. */
+typedef struct pu_daemon_request_t {
+  int conn;
+  char *tool;
+  char *cwd;
+  int argc;
+  char **argv;
+  int fds[3];
+  uid_t uid;
+  gid_t gid;
+  pid_t pid;
+
+  char *_data;
+} pu_daemon_request_t;
+
+char *pu_daemon_default_socket(void);
+const char *pu_daemon_option(int argc, char **argv);
+int pu_daemon_run(const char *socket, const char *tool, int argc, char **argv);
+
+int pu_daemon_listen(const char *socket);
+int pu_daemon_request_read(int conn, pu_daemon_request_t *req);
+int pu_daemon_reply(pu_daemon_request_t *req, int status);
+void pu_daemon_request_free(pu_daemon_request_t *req);
+
+void pu_daemon_set_handle(pu_config_t *config, alpm_handle_t *handle);
+alpm_handle_t *_pu_daemon_get_handle(pu_config_t *config);
+int _pu_daemon_is_handle(alpm_handle_t *handle);
+const char *_pu_daemon_dbext(void);
+void _pu_daemon_set_dbext(const char *dbext);
+
+#endif /* PACUTILS_DAEMON_H */
+
+/* vim: set ts=2 sw=2 et: */
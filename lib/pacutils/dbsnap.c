@@ -0,0 +1,899 @@
+/*
+ * Copyright 2026 Andrew Gregory <andrew.gregory.8@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dbsnap.h"
+#include "util.h"
+
+#define PU_DBSNAP_MAGIC "PUDBSNP1"
+#define PU_DBSNAP_NULL UINT32_MAX
+
+struct _pu_dbsnap_header {
+  char magic[8];
+  uint32_t npkgs, pad;
+  uint64_t stamp1, stamp2;
+  uint64_t pool, poollen;
+  uint64_t str[PU_DBSNAP_STR_COUNT];
+  uint64_t num[PU_DBSNAP_INT_COUNT];
+  uint64_t lstart[PU_DBSNAP_LIST_COUNT], items[PU_DBSNAP_LIST_COUNT];
+  uint64_t fstart, fcount, fblob, fbloblen, filebytes;
+};
+
+struct _pu_dbsnap_intern {
+  uint32_t off, hash;
+};
+
+struct pu_dbsnap_t {
+  uint32_t npkgs;
+
+  /* builder state */
+  size_t _pkgsize;
+  uint32_t *_str[PU_DBSNAP_STR_COUNT];
+  int64_t *_num[PU_DBSNAP_INT_COUNT];
+  uint32_t *_lstart[PU_DBSNAP_LIST_COUNT];
+  uint32_t *_items[PU_DBSNAP_LIST_COUNT];
+  size_t _nitems[PU_DBSNAP_LIST_COUNT], _itemsize[PU_DBSNAP_LIST_COUNT];
+  uint64_t *_fstart;
+  uint32_t *_fcount;
+  unsigned char *_fblob;
+  size_t _fbloblen, _fblobsize;
+  char *_pool;
+  size_t _poollen, _poolsize;
+  struct _pu_dbsnap_intern *_intern;
+  size_t _internmask, _interncount;
+  char _prev[PATH_MAX];
+  size_t _prevlen;
+
+  /* finalized (mapped) state */
+  const char *pool;
+  const uint32_t *str[PU_DBSNAP_STR_COUNT];
+  const int64_t *num[PU_DBSNAP_INT_COUNT];
+  const uint32_t *lstart[PU_DBSNAP_LIST_COUNT];
+  const uint32_t *items[PU_DBSNAP_LIST_COUNT];
+  const uint64_t *fstart;
+  const uint32_t *fcount;
+  const unsigned char *fblob;
+  uint64_t filebytes;
+  void *_map;
+  size_t _maplen;
+};
+
+static int _pu_dbsnap_grow(void **ptr, size_t *size, size_t need,
+    size_t membsize) {
+  size_t newsize = *size ? *size : 16;
+  void *newptr;
+  if (need <= *size) { return 0; }
+  while (newsize < need) { newsize *= 2; }
+  if ((newptr = realloc(*ptr, newsize * membsize)) == NULL) { return -1; }
+  *ptr = newptr;
+  *size = newsize;
+  return 0;
+}
+
+static uint32_t _pu_dbsnap_hash(const char *s, size_t len) {
+  uint32_t h = 2166136261u;
+  while (len--) {
+    h ^= (unsigned char) *s++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+char *pu_dbsnap_default_path(alpm_handle_t *handle) {
+  return pu_prepend_dir(alpm_option_get_dbpath(handle), "pacutils-dbsnap");
+}
+
+static uint64_t _pu_dbsnap_ns(const struct timespec *ts) {
+  return (uint64_t) ts->tv_sec * 1000000000u + ts->tv_nsec;
+}
+
+static uint64_t _pu_dbsnap_mix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdu;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53u;
+  h ^= h >> 33;
+  return h;
+}
+
+/* Computes the stamps identifying the current state of the local database:
+ * the modification time of the local directory, which changes whenever a
+ * package is added or removed, and an order-independent hash of the name,
+ * size and modification time of every entry's desc and files, which changes
+ * when an entry is rewritten in place. */
+int pu_dbsnap_stamp(const char *dbpath, uint64_t *stamp1, uint64_t *stamp2) {
+  char *localpath = pu_prepend_dir(dbpath, "local");
+  struct dirent *entry;
+  struct stat st;
+  uint64_t sum = 0;
+  DIR *dir;
+
+  if (localpath == NULL) { return -1; }
+  dir = opendir(localpath);
+  free(localpath);
+  if (dir == NULL) { return -1; }
+  if (fstat(dirfd(dir), &st) != 0) {
+    closedir(dir);
+    return -1;
+  }
+  *stamp1 = _pu_dbsnap_ns(&st.st_mtim);
+
+  errno = 0;
+  while ((entry = readdir(dir))) {
+    static const char *files[] = { "desc", "files" };
+    const char *name = entry->d_name;
+    size_t len = strlen(name), i;
+    uint64_t h;
+    char path[PATH_MAX];
+
+    if (name[0] == '.' || len + 8 >= PATH_MAX) { continue; }
+    h = _pu_dbsnap_hash(name, len);
+    for (i = 0; i < 2; i++) {
+      sprintf(path, "%s/%s", name, files[i]);
+      if (fstatat(dirfd(dir), path, &st, 0) == 0) {
+        h = _pu_dbsnap_mix(h ^ _pu_dbsnap_ns(&st.st_mtim));
+        h = _pu_dbsnap_mix(h ^ (uint64_t) st.st_size);
+      } else {
+        h = _pu_dbsnap_mix(h ^ i);
+      }
+    }
+    sum += h;
+    errno = 0;
+  }
+  if (errno != 0) {
+    int err = errno;
+    closedir(dir);
+    errno = err;
+    return -1;
+  }
+  closedir(dir);
+  *stamp2 = sum;
+  return 0;
+}
+
+pu_dbsnap_t *pu_dbsnap_new(void) {
+  return calloc(sizeof(pu_dbsnap_t), 1);
+}
+
+int pu_dbsnap_add_pkg(pu_dbsnap_t *snap) {
+  size_t size = snap->_pkgsize;
+  int i;
+
+  if (snap->_map || snap->npkgs == UINT32_MAX - 1) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (i = 0; i < PU_DBSNAP_STR_COUNT; i++) {
+    size_t s = size;
+    if (_pu_dbsnap_grow((void **) &snap->_str[i], &s, snap->npkgs + 2,
+          sizeof(uint32_t)) != 0) {
+      return -1;
+    }
+    snap->_str[i][snap->npkgs] = PU_DBSNAP_NULL;
+  }
+  for (i = 0; i < PU_DBSNAP_INT_COUNT; i++) {
+    size_t s = size;
+    if (_pu_dbsnap_grow((void **) &snap->_num[i], &s, snap->npkgs + 2,
+          sizeof(int64_t)) != 0) {
+      return -1;
+    }
+    snap->_num[i][snap->npkgs] = 0;
+  }
+  for (i = 0; i < PU_DBSNAP_LIST_COUNT; i++) {
+    size_t s = size;
+    if (_pu_dbsnap_grow((void **) &snap->_lstart[i], &s, snap->npkgs + 2,
+          sizeof(uint32_t)) != 0) {
+      return -1;
+    }
+    snap->_lstart[i][snap->npkgs] = snap->_nitems[i];
+  }
+  {
+    size_t s = size;
+    if (_pu_dbsnap_grow((void **) &snap->_fcount, &s, snap->npkgs + 2,
+          sizeof(uint32_t)) != 0) {
+      return -1;
+    }
+  }
+  if (_pu_dbsnap_grow((void **) &snap->_fstart, &snap->_pkgsize,
+        snap->npkgs + 2, sizeof(uint64_t)) != 0) {
+    return -1;
+  }
+  snap->_fstart[snap->npkgs] = snap->_fbloblen;
+  snap->_fcount[snap->npkgs] = 0;
+  snap->_prevlen = 0;
+
+  return snap->npkgs++;
+}
+
+static int _pu_dbsnap_intern_grow(pu_dbsnap_t *snap) {
+  size_t i, size = snap->_intern ? (snap->_internmask + 1) * 2 : 1024;
+  struct _pu_dbsnap_intern *slots = malloc(size * sizeof(*slots));
+  if (slots == NULL) { return -1; }
+  for (i = 0; i < size; i++) { slots[i].off = PU_DBSNAP_NULL; }
+  for (i = 0; snap->_intern && i <= snap->_internmask; i++) {
+    struct _pu_dbsnap_intern *old = &snap->_intern[i];
+    size_t j = old->hash & (size - 1);
+    if (old->off == PU_DBSNAP_NULL) { continue; }
+    while (slots[j].off != PU_DBSNAP_NULL) { j = (j + 1) & (size - 1); }
+    slots[j] = *old;
+  }
+  free(snap->_intern);
+  snap->_intern = slots;
+  snap->_internmask = size - 1;
+  return 0;
+}
+
+/* returns the pool offset of str, adding it if it is not already present */
+static uint32_t _pu_dbsnap_intern(pu_dbsnap_t *snap, const char *str) {
+  size_t len = strlen(str), i;
+  uint32_t hash = _pu_dbsnap_hash(str, len);
+
+  if ((snap->_intern == NULL || snap->_interncount * 2 >= snap->_internmask)
+      && _pu_dbsnap_intern_grow(snap) != 0) {
+    return PU_DBSNAP_NULL;
+  }
+  for (i = hash & snap->_internmask; snap->_intern[i].off != PU_DBSNAP_NULL;
+      i = (i + 1) & snap->_internmask) {
+    struct _pu_dbsnap_intern *s = &snap->_intern[i];
+    if (s->hash == hash && strcmp(snap->_pool + s->off, str) == 0) {
+      return s->off;
+    }
+  }
+  if (snap->_poollen + len + 1 >= PU_DBSNAP_NULL) {
+    errno = EOVERFLOW;
+    return PU_DBSNAP_NULL;
+  }
+  if (_pu_dbsnap_grow((void **) &snap->_pool, &snap->_poolsize,
+        snap->_poollen + len + 1, 1) != 0) {
+    return PU_DBSNAP_NULL;
+  }
+  memcpy(snap->_pool + snap->_poollen, str, len + 1);
+  snap->_intern[i].off = snap->_poollen;
+  snap->_intern[i].hash = hash;
+  snap->_interncount++;
+  snap->_poollen += len + 1;
+  return snap->_intern[i].off;
+}
+
+int pu_dbsnap_set_str(pu_dbsnap_t *snap, pu_dbsnap_str_t field,
+    const char *str) {
+  uint32_t off = PU_DBSNAP_NULL;
+  if (snap->_map || snap->npkgs == 0 || field >= PU_DBSNAP_STR_COUNT) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (str && (off = _pu_dbsnap_intern(snap, str)) == PU_DBSNAP_NULL) {
+    return -1;
+  }
+  snap->_str[field][snap->npkgs - 1] = off;
+  return 0;
+}
+
+int pu_dbsnap_set_int(pu_dbsnap_t *snap, pu_dbsnap_int_t field, int64_t value) {
+  if (snap->_map || snap->npkgs == 0 || field >= PU_DBSNAP_INT_COUNT) {
+    errno = EINVAL;
+    return -1;
+  }
+  snap->_num[field][snap->npkgs - 1] = value;
+  return 0;
+}
+
+int pu_dbsnap_add_item(pu_dbsnap_t *snap, pu_dbsnap_list_t field,
+    const char *str) {
+  uint32_t off;
+  if (snap->_map || snap->npkgs == 0 || field >= PU_DBSNAP_LIST_COUNT
+      || str == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (snap->_nitems[field] + 1 >= PU_DBSNAP_NULL) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+  if ((off = _pu_dbsnap_intern(snap, str)) == PU_DBSNAP_NULL
+      || _pu_dbsnap_grow((void **) &snap->_items[field],
+        &snap->_itemsize[field], snap->_nitems[field] + 1,
+        sizeof(uint32_t)) != 0) {
+    return -1;
+  }
+  snap->_items[field][snap->_nitems[field]++] = off;
+  return 0;
+}
+
+static unsigned char *_pu_dbsnap_put_varint(unsigned char *c, size_t v) {
+  while (v >= 0x80) {
+    *c++ = (v & 0x7f) | 0x80;
+    v >>= 7;
+  }
+  *c++ = v;
+  return c;
+}
+
+static const unsigned char *_pu_dbsnap_get_varint(const unsigned char *c,
+    const unsigned char *end, size_t *v) {
+  int shift = 0;
+  *v = 0;
+  for (; c < end && shift < 35; c++, shift += 7) {
+    *v |= (size_t) (*c & 0x7f) << shift;
+    if (!(*c & 0x80)) { return c + 1; }
+  }
+  return NULL;
+}
+
+/* Files are front-coded against the previous file of the same package: the
+ * length of the shared prefix and of the remaining suffix, followed by the
+ * suffix itself. */
+int pu_dbsnap_add_file(pu_dbsnap_t *snap, const char *path) {
+  size_t len = strlen(path), shared = 0;
+  unsigned char *c;
+
+  if (snap->_map || snap->npkgs == 0) { errno = EINVAL; return -1; }
+  if (len >= PATH_MAX) { errno = ENAMETOOLONG; return -1; }
+
+  while (shared < len && shared < snap->_prevlen
+      && snap->_prev[shared] == path[shared]) {
+    shared++;
+  }
+  if (_pu_dbsnap_grow((void **) &snap->_fblob, &snap->_fblobsize,
+        snap->_fbloblen + 20 + len - shared, 1) != 0) {
+    return -1;
+  }
+  c = snap->_fblob + snap->_fbloblen;
+  c = _pu_dbsnap_put_varint(c, shared);
+  c = _pu_dbsnap_put_varint(c, len - shared);
+  memcpy(c, path + shared, len - shared);
+  snap->_fbloblen = (c + len - shared) - snap->_fblob;
+  snap->_fcount[snap->npkgs - 1]++;
+  snap->filebytes += len + 1;
+
+  memcpy(snap->_prev + shared, path + shared, len - shared + 1);
+  snap->_prevlen = len;
+  return 0;
+}
+
+static int _pu_dbsnap_add_deps(pu_dbsnap_t *snap, pu_dbsnap_list_t field,
+    alpm_list_t *deps) {
+  for (; deps; deps = deps->next) {
+    char *dep = alpm_dep_compute_string(deps->data);
+    int ret = dep ? pu_dbsnap_add_item(snap, field, dep) : -1;
+    free(dep);
+    if (ret != 0) { return -1; }
+  }
+  return 0;
+}
+
+static int _pu_dbsnap_add_strs(pu_dbsnap_t *snap, pu_dbsnap_list_t field,
+    alpm_list_t *strs) {
+  for (; strs; strs = strs->next) {
+    if (pu_dbsnap_add_item(snap, field, strs->data) != 0) { return -1; }
+  }
+  return 0;
+}
+
+int pu_dbsnap_add_alpm_pkg(pu_dbsnap_t *snap, alpm_pkg_t *pkg) {
+  alpm_filelist_t *files;
+  size_t i;
+
+  if (pu_dbsnap_add_pkg(snap) == -1
+      || pu_dbsnap_set_str(snap, PU_DBSNAP_NAME, alpm_pkg_get_name(pkg))
+      || pu_dbsnap_set_str(snap, PU_DBSNAP_VERSION, alpm_pkg_get_version(pkg))
+      || pu_dbsnap_set_str(snap, PU_DBSNAP_BASE, alpm_pkg_get_base(pkg))
+      || pu_dbsnap_set_str(snap, PU_DBSNAP_DESC, alpm_pkg_get_desc(pkg))
+      || pu_dbsnap_set_str(snap, PU_DBSNAP_URL, alpm_pkg_get_url(pkg))
+      || pu_dbsnap_set_str(snap, PU_DBSNAP_PACKAGER, alpm_pkg_get_packager(pkg))
+      || pu_dbsnap_set_str(snap, PU_DBSNAP_ARCH, alpm_pkg_get_arch(pkg))
+      || pu_dbsnap_set_int(snap, PU_DBSNAP_SIZE, alpm_pkg_get_size(pkg))
+      || pu_dbsnap_set_int(snap, PU_DBSNAP_ISIZE, alpm_pkg_get_isize(pkg))
+      || pu_dbsnap_set_int(snap, PU_DBSNAP_BUILDDATE,
+        alpm_pkg_get_builddate(pkg))
+      || pu_dbsnap_set_int(snap, PU_DBSNAP_INSTALLDATE,
+        alpm_pkg_get_installdate(pkg))
+      || pu_dbsnap_set_int(snap, PU_DBSNAP_REASON, alpm_pkg_get_reason(pkg))
+      || pu_dbsnap_set_int(snap, PU_DBSNAP_VALIDATION,
+        alpm_pkg_get_validation(pkg))
+      || _pu_dbsnap_add_strs(snap, PU_DBSNAP_GROUPS, alpm_pkg_get_groups(pkg))
+      || _pu_dbsnap_add_strs(snap, PU_DBSNAP_LICENSES,
+        alpm_pkg_get_licenses(pkg))
+      || _pu_dbsnap_add_deps(snap, PU_DBSNAP_DEPENDS, alpm_pkg_get_depends(pkg))
+      || _pu_dbsnap_add_deps(snap, PU_DBSNAP_OPTDEPENDS,
+        alpm_pkg_get_optdepends(pkg))
+      || _pu_dbsnap_add_deps(snap, PU_DBSNAP_PROVIDES,
+        alpm_pkg_get_provides(pkg))
+      || _pu_dbsnap_add_deps(snap, PU_DBSNAP_CONFLICTS,
+        alpm_pkg_get_conflicts(pkg))
+      || _pu_dbsnap_add_deps(snap, PU_DBSNAP_REPLACES,
+        alpm_pkg_get_replaces(pkg))) {
+    return -1;
+  }
+
+  files = alpm_pkg_get_files(pkg);
+  for (i = 0; files && i < files->count; i++) {
+    if (pu_dbsnap_add_file(snap, files->files[i].name) != 0) { return -1; }
+  }
+  return 0;
+}
+
+static int _pu_dbsnap_pad(FILE *f, size_t len, uint64_t *off) {
+  static const char zero[8] = { 0 };
+  size_t pad = (8 - (len % 8)) % 8;
+  if (pad && fwrite(zero, pad, 1, f) != 1) { return -1; }
+  *off += len + pad;
+  return 0;
+}
+
+static int _pu_dbsnap_put(FILE *f, const void *data, size_t len,
+    uint64_t *off) {
+  if (len && fwrite(data, len, 1, f) != 1) { return -1; }
+  return _pu_dbsnap_pad(f, len, off);
+}
+
+struct _pu_dbsnap_order {
+  const char *name;
+  uint32_t pkg;
+};
+
+static int _pu_dbsnap_ordercmp(const void *p1, const void *p2) {
+  const struct _pu_dbsnap_order *o1 = p1, *o2 = p2;
+  return strcmp(o1->name, o2->name);
+}
+
+/* writes the builder contents with packages sorted by name */
+static int _pu_dbsnap_write_columns(FILE *stream, pu_dbsnap_t *snap,
+    struct _pu_dbsnap_header *hdr, uint64_t *off) {
+  struct _pu_dbsnap_order *order;
+  uint32_t i, n = snap->npkgs;
+  int f, ret = -1;
+  void *col;
+
+  order = malloc(n * sizeof(*order));
+  col = malloc((n + 1) * sizeof(uint64_t));
+  if (order == NULL || col == NULL) { goto cleanup; }
+
+  for (i = 0; i < n; i++) {
+    uint32_t name = snap->_str[PU_DBSNAP_NAME][i];
+    order[i].name = name == PU_DBSNAP_NULL ? "" : snap->_pool + name;
+    order[i].pkg = i;
+  }
+  qsort(order, n, sizeof(*order), _pu_dbsnap_ordercmp);
+
+  hdr->pool = *off;
+  hdr->poollen = snap->_poollen;
+  if (_pu_dbsnap_put(stream, snap->_pool, snap->_poollen, off) != 0) {
+    goto cleanup;
+  }
+
+  for (f = 0; f < PU_DBSNAP_STR_COUNT; f++) {
+    uint32_t *c = col;
+    for (i = 0; i < n; i++) { c[i] = snap->_str[f][order[i].pkg]; }
+    hdr->str[f] = *off;
+    if (_pu_dbsnap_put(stream, c, n * sizeof(uint32_t), off) != 0) {
+      goto cleanup;
+    }
+  }
+
+  for (f = 0; f < PU_DBSNAP_INT_COUNT; f++) {
+    int64_t *c = col;
+    for (i = 0; i < n; i++) { c[i] = snap->_num[f][order[i].pkg]; }
+    hdr->num[f] = *off;
+    if (_pu_dbsnap_put(stream, c, n * sizeof(int64_t), off) != 0) {
+      goto cleanup;
+    }
+  }
+
+  for (f = 0; f < PU_DBSNAP_LIST_COUNT; f++) {
+    uint32_t *c = col, total = 0;
+    snap->_lstart[f][n] = snap->_nitems[f];
+    for (i = 0; i < n; i++) {
+      uint32_t p = order[i].pkg;
+      c[i] = total;
+      total += snap->_lstart[f][p + 1] - snap->_lstart[f][p];
+    }
+    c[n] = total;
+    hdr->lstart[f] = *off;
+    if (_pu_dbsnap_put(stream, c, (n + 1) * sizeof(uint32_t), off) != 0) {
+      goto cleanup;
+    }
+    hdr->items[f] = *off;
+    for (i = 0; i < n; i++) {
+      uint32_t p = order[i].pkg, start = snap->_lstart[f][p];
+      size_t count = snap->_lstart[f][p + 1] - start;
+      if (count && fwrite(snap->_items[f] + start, count * sizeof(uint32_t),
+            1, stream) != 1) {
+        goto cleanup;
+      }
+    }
+    if (_pu_dbsnap_pad(stream, total * sizeof(uint32_t), off) != 0) {
+      goto cleanup;
+    }
+  }
+
+  {
+    uint64_t *c = col, total = 0;
+    uint32_t *counts = (uint32_t *) order;
+    snap->_fstart[n] = snap->_fbloblen;
+    for (i = 0; i < n; i++) {
+      uint32_t p = order[i].pkg;
+      c[i] = total;
+      total += snap->_fstart[p + 1] - snap->_fstart[p];
+    }
+    c[n] = total;
+    hdr->fstart = *off;
+    if (_pu_dbsnap_put(stream, c, (n + 1) * sizeof(uint64_t), off) != 0) {
+      goto cleanup;
+    }
+    hdr->fblob = *off;
+    hdr->fbloblen = total;
+    for (i = 0; i < n; i++) {
+      uint32_t p = order[i].pkg;
+      size_t len = snap->_fstart[p + 1] - snap->_fstart[p];
+      if (len && fwrite(snap->_fblob + snap->_fstart[p], len, 1, stream) != 1) {
+        goto cleanup;
+      }
+    }
+    if (_pu_dbsnap_pad(stream, total, off) != 0) { goto cleanup; }
+
+    /* the order is no longer needed, reuse it for the counts */
+    for (i = 0; i < n; i++) { counts[i] = snap->_fcount[order[i].pkg]; }
+    hdr->fcount = *off;
+    if (_pu_dbsnap_put(stream, counts, n * sizeof(uint32_t), off) != 0) {
+      goto cleanup;
+    }
+    hdr->filebytes = snap->filebytes;
+  }
+
+  ret = 0;
+
+cleanup:
+  free(order);
+  free(col);
+  return ret;
+}
+
+int pu_dbsnap_write(pu_dbsnap_t *snap, const char *path,
+    uint64_t stamp1, uint64_t stamp2) {
+  struct _pu_dbsnap_header hdr;
+  uint64_t off = 0;
+  char *tmp = NULL;
+  FILE *stream = NULL;
+  int fd;
+
+  if (snap->_map) { errno = EINVAL; return -1; }
+
+  if ((tmp = malloc(strlen(path) + 8)) == NULL) { return -1; }
+  sprintf(tmp, "%s.XXXXXX", path);
+  if ((fd = mkstemp(tmp)) == -1) { free(tmp); return -1; }
+  if (fchmod(fd, 0644) != 0 || (stream = fdopen(fd, "w")) == NULL) {
+    close(fd);
+    goto error;
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, PU_DBSNAP_MAGIC, 8);
+  hdr.npkgs = snap->npkgs;
+  hdr.stamp1 = stamp1;
+  hdr.stamp2 = stamp2;
+
+  /* reserve space for the header, it is rewritten once offsets are known */
+  if (_pu_dbsnap_put(stream, &hdr, sizeof(hdr), &off) != 0
+      || _pu_dbsnap_write_columns(stream, snap, &hdr, &off) != 0) {
+    goto error;
+  }
+
+  if (fseek(stream, 0, SEEK_SET) != 0
+      || fwrite(&hdr, sizeof(hdr), 1, stream) != 1
+      || fflush(stream) != 0 || fsync(fileno(stream)) != 0) {
+    goto error;
+  }
+  if (fclose(stream) != 0) { stream = NULL; goto error; }
+  stream = NULL;
+  if (rename(tmp, path) != 0) { goto error; }
+
+  free(tmp);
+  return 0;
+
+error:
+  {
+    int err = errno;
+    if (stream) { fclose(stream); }
+    unlink(tmp);
+    free(tmp);
+    errno = err;
+  }
+  return -1;
+}
+
+/* makes sure every section lies within the mapped file */
+static int _pu_dbsnap_check(const char *map, size_t len) {
+  const struct _pu_dbsnap_header *hdr = (const struct _pu_dbsnap_header *) map;
+  uint64_t n = hdr->npkgs, i, nfiles = 0;
+  const uint32_t *fcount;
+  int f;
+
+#define CHECK(o, size) \
+  if ((o) % 8 || (o) > len || (size) > len - (o)) { return -1; }
+  CHECK(hdr->pool, hdr->poollen);
+  if (hdr->poollen && map[hdr->pool + hdr->poollen - 1] != '\0') { return -1; }
+  for (f = 0; f < PU_DBSNAP_STR_COUNT; f++) {
+    CHECK(hdr->str[f], n * sizeof(uint32_t));
+  }
+  for (f = 0; f < PU_DBSNAP_INT_COUNT; f++) {
+    CHECK(hdr->num[f], n * sizeof(int64_t));
+  }
+  for (f = 0; f < PU_DBSNAP_LIST_COUNT; f++) {
+    const uint32_t *lstart = (const uint32_t *) (map + hdr->lstart[f]);
+    CHECK(hdr->lstart[f], (n + 1) * sizeof(uint32_t));
+    CHECK(hdr->items[f], (uint64_t) lstart[n] * sizeof(uint32_t));
+  }
+  CHECK(hdr->fstart, (n + 1) * sizeof(uint64_t));
+  CHECK(hdr->fcount, n * sizeof(uint32_t));
+  CHECK(hdr->fblob, hdr->fbloblen);
+  if (((const uint64_t *) (map + hdr->fstart))[n] > hdr->fbloblen) {
+    return -1;
+  }
+  /* every path takes at least its NUL and is shorter than PATH_MAX */
+  fcount = (const uint32_t *) (map + hdr->fcount);
+  for (i = 0; i < n; i++) { nfiles += fcount[i]; }
+  if (hdr->filebytes < nfiles || hdr->filebytes > nfiles * PATH_MAX) {
+    return -1;
+  }
+#undef CHECK
+
+  return 0;
+}
+
+pu_dbsnap_t *pu_dbsnap_open(const char *path, uint64_t stamp1, uint64_t stamp2) {
+  const struct _pu_dbsnap_header *hdr;
+  pu_dbsnap_t *snap;
+  struct stat sbuf;
+  char *map;
+  int fd, f;
+
+  if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1) { return NULL; }
+  if (fstat(fd, &sbuf) != 0) { close(fd); return NULL; }
+  if ((size_t) sbuf.st_size < sizeof(struct _pu_dbsnap_header)) {
+    close(fd);
+    errno = EINVAL;
+    return NULL;
+  }
+  map = mmap(NULL, sbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) { return NULL; }
+
+  hdr = (const struct _pu_dbsnap_header *) map;
+  if (memcmp(hdr->magic, PU_DBSNAP_MAGIC, 8) != 0
+      || _pu_dbsnap_check(map, sbuf.st_size) != 0) {
+    munmap(map, sbuf.st_size);
+    errno = EINVAL;
+    return NULL;
+  }
+  if (hdr->stamp1 != stamp1 || hdr->stamp2 != stamp2) {
+    munmap(map, sbuf.st_size);
+    errno = ESTALE;
+    return NULL;
+  }
+
+  if ((snap = calloc(sizeof(pu_dbsnap_t), 1)) == NULL) {
+    munmap(map, sbuf.st_size);
+    return NULL;
+  }
+  snap->_map = map;
+  snap->_maplen = sbuf.st_size;
+  snap->npkgs = hdr->npkgs;
+  snap->pool = map + hdr->pool;
+  snap->_poollen = hdr->poollen;
+  for (f = 0; f < PU_DBSNAP_STR_COUNT; f++) {
+    snap->str[f] = (const uint32_t *) (map + hdr->str[f]);
+  }
+  for (f = 0; f < PU_DBSNAP_INT_COUNT; f++) {
+    snap->num[f] = (const int64_t *) (map + hdr->num[f]);
+  }
+  for (f = 0; f < PU_DBSNAP_LIST_COUNT; f++) {
+    snap->lstart[f] = (const uint32_t *) (map + hdr->lstart[f]);
+    snap->items[f] = (const uint32_t *) (map + hdr->items[f]);
+  }
+  snap->fstart = (const uint64_t *) (map + hdr->fstart);
+  snap->fcount = (const uint32_t *) (map + hdr->fcount);
+  snap->fblob = (const unsigned char *) (map + hdr->fblob);
+  snap->filebytes = hdr->filebytes;
+
+  return snap;
+}
+
+/* Opens the default snapshot for handle's local database.  If it is missing
+ * or out of date and update is set, it is rebuilt from the database first;
+ * failing to write it is an error.  Nothing is built if the database
+ * directory is not writable. */
+pu_dbsnap_t *pu_dbsnap_load(alpm_handle_t *handle, int update) {
+  pu_dbsnap_t *snap = NULL;
+  uint64_t stamp1, stamp2;
+  alpm_list_t *p;
+  char *path;
+  int err;
+
+  if (pu_dbsnap_stamp(alpm_option_get_dbpath(handle), &stamp1, &stamp2) != 0
+      || (path = pu_dbsnap_default_path(handle)) == NULL) {
+    return NULL;
+  }
+  if ((snap = pu_dbsnap_open(path, stamp1, stamp2)) || !update
+      || (errno != ENOENT && errno != ESTALE && errno != EINVAL)) {
+    goto cleanup;
+  }
+  if (access(alpm_option_get_dbpath(handle), W_OK) != 0) { goto cleanup; }
+
+  if ((snap = pu_dbsnap_new()) == NULL) { goto cleanup; }
+  for (p = alpm_db_get_pkgcache(alpm_get_localdb(handle)); p; p = p->next) {
+    if (pu_dbsnap_add_alpm_pkg(snap, p->data) != 0) { goto error; }
+  }
+  if (pu_dbsnap_write(snap, path, stamp1, stamp2) != 0) { goto error; }
+  pu_dbsnap_free(snap);
+  snap = pu_dbsnap_open(path, stamp1, stamp2);
+  goto cleanup;
+
+error:
+  err = errno;
+  pu_dbsnap_free(snap);
+  snap = NULL;
+  errno = err;
+
+cleanup:
+  err = errno;
+  free(path);
+  errno = err;
+  return snap;
+}
+
+void pu_dbsnap_free(pu_dbsnap_t *snap) {
+  int f;
+  if (snap == NULL) { return; }
+  if (snap->_map) { munmap(snap->_map, snap->_maplen); }
+  for (f = 0; f < PU_DBSNAP_STR_COUNT; f++) { free(snap->_str[f]); }
+  for (f = 0; f < PU_DBSNAP_INT_COUNT; f++) { free(snap->_num[f]); }
+  for (f = 0; f < PU_DBSNAP_LIST_COUNT; f++) {
+    free(snap->_lstart[f]);
+    free(snap->_items[f]);
+  }
+  free(snap->_fstart);
+  free(snap->_fcount);
+  free(snap->_fblob);
+  free(snap->_pool);
+  free(snap->_intern);
+  free(snap);
+}
+
+/* the remaining functions are only valid for an opened snapshot */
+
+uint32_t pu_dbsnap_count(pu_dbsnap_t *snap) {
+  return snap->_map ? snap->npkgs : 0;
+}
+
+static const char *_pu_dbsnap_pool_str(pu_dbsnap_t *snap, uint32_t off) {
+  return off < snap->_poollen ? snap->pool + off : NULL;
+}
+
+/* returns the index of the package called name or UINT32_MAX */
+uint32_t pu_dbsnap_find(pu_dbsnap_t *snap, const char *name) {
+  uint32_t lo = 0, hi = pu_dbsnap_count(snap);
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    const char *s = _pu_dbsnap_pool_str(snap, snap->str[PU_DBSNAP_NAME][mid]);
+    int cmp = strcmp(s ? s : "", name);
+    if (cmp == 0) {
+      return mid;
+    } else if (cmp < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return UINT32_MAX;
+}
+
+const char *pu_dbsnap_str(pu_dbsnap_t *snap, uint32_t pkg,
+    pu_dbsnap_str_t field) {
+  if (pkg >= pu_dbsnap_count(snap) || field >= PU_DBSNAP_STR_COUNT) {
+    return NULL;
+  }
+  return _pu_dbsnap_pool_str(snap, snap->str[field][pkg]);
+}
+
+int64_t pu_dbsnap_int(pu_dbsnap_t *snap, uint32_t pkg, pu_dbsnap_int_t field) {
+  if (pkg >= pu_dbsnap_count(snap) || field >= PU_DBSNAP_INT_COUNT) {
+    return 0;
+  }
+  return snap->num[field][pkg];
+}
+
+uint32_t pu_dbsnap_list_count(pu_dbsnap_t *snap, uint32_t pkg,
+    pu_dbsnap_list_t field) {
+  const uint32_t *lstart;
+  if (pkg >= pu_dbsnap_count(snap) || field >= PU_DBSNAP_LIST_COUNT) {
+    return 0;
+  }
+  lstart = snap->lstart[field];
+  if (lstart[pkg + 1] < lstart[pkg] || lstart[pkg + 1] > lstart[snap->npkgs]) {
+    return 0;
+  }
+  return lstart[pkg + 1] - lstart[pkg];
+}
+
+const char *pu_dbsnap_list_item(pu_dbsnap_t *snap, uint32_t pkg,
+    pu_dbsnap_list_t field, uint32_t i) {
+  if (i >= pu_dbsnap_list_count(snap, pkg, field)) { return NULL; }
+  return _pu_dbsnap_pool_str(snap,
+      snap->items[field][snap->lstart[field][pkg] + i]);
+}
+
+/* total length of every file path, including terminating NULs */
+uint64_t pu_dbsnap_files_size(pu_dbsnap_t *snap) {
+  return snap->_map ? snap->filebytes : 0;
+}
+
+/* prepares iter to decode pkg's files and returns the file count */
+uint32_t pu_dbsnap_files(pu_dbsnap_t *snap, uint32_t pkg,
+    pu_dbsnap_files_t *iter) {
+  iter->count = iter->_left = 0;
+  iter->len = 0;
+  iter->path[0] = '\0';
+  if (pkg >= pu_dbsnap_count(snap)
+      || snap->fstart[pkg + 1] < snap->fstart[pkg]
+      || snap->fstart[pkg + 1] > snap->fstart[snap->npkgs]) {
+    return 0;
+  }
+  iter->_pos = snap->fblob + snap->fstart[pkg];
+  iter->_end = snap->fblob + snap->fstart[pkg + 1];
+  iter->count = iter->_left = snap->fcount[pkg];
+  return iter->count;
+}
+
+/* returns the next path, valid until the following call, or NULL once all
+ * files have been returned or if the data is corrupt */
+const char *pu_dbsnap_files_next(pu_dbsnap_files_t *iter) {
+  size_t shared, len;
+  const unsigned char *c;
+
+  if (iter->_left == 0) { return NULL; }
+  if ((c = _pu_dbsnap_get_varint(iter->_pos, iter->_end, &shared)) == NULL
+      || (c = _pu_dbsnap_get_varint(c, iter->_end, &len)) == NULL
+      || shared > iter->len || len > (size_t) (iter->_end - c)
+      || shared + len >= PATH_MAX) {
+    iter->_left = 0;
+    return NULL;
+  }
+  memcpy(iter->path + shared, c, len);
+  iter->len = shared + len;
+  iter->path[iter->len] = '\0';
+  iter->_pos = c + len;
+  iter->_left--;
+  return iter->path;
+}
+
+/* vim: set ts=2 sw=2 et: */
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2026 Andrew Gregory <andrew.gregory.8@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef PACUTILS_DBSNAP_H
+#define PACUTILS_DBSNAP_H
+
+#include <limits.h>
+#include <stdint.h>
+
+#include <alpm.h>
+
+/* A read-only snapshot of the local database in a single file that can be
+ * mapped directly.  Strings are interned in one pool, scalar fields are
+ * stored in fixed-width columns, list fields as arrays of string offsets and
+ * file lists are front-coded.  Packages are sorted by name.  The snapshot is
+ * tied to the state of the local database directory through two stamps, see
+ * pu_dbsnap_stamp(). */
+typedef struct pu_dbsnap_t pu_dbsnap_t;
+
+typedef enum pu_dbsnap_str_t {
+  PU_DBSNAP_NAME,
+  PU_DBSNAP_VERSION,
+  PU_DBSNAP_BASE,
+  PU_DBSNAP_DESC,
+  PU_DBSNAP_URL,
+  PU_DBSNAP_PACKAGER,
+  PU_DBSNAP_ARCH,
+  PU_DBSNAP_STR_COUNT,
+} pu_dbsnap_str_t;
+
+typedef enum pu_dbsnap_int_t {
+  PU_DBSNAP_SIZE,
+  PU_DBSNAP_ISIZE,
+  PU_DBSNAP_BUILDDATE,
+  PU_DBSNAP_INSTALLDATE,
+  PU_DBSNAP_REASON,
+  PU_DBSNAP_VALIDATION,
+  PU_DBSNAP_INT_COUNT,
+} pu_dbsnap_int_t;
+
+typedef enum pu_dbsnap_list_t {
+  PU_DBSNAP_GROUPS,
+  PU_DBSNAP_LICENSES,
+  PU_DBSNAP_DEPENDS,
+  PU_DBSNAP_OPTDEPENDS,
+  PU_DBSNAP_PROVIDES,
+  PU_DBSNAP_CONFLICTS,
+  PU_DBSNAP_REPLACES,
+  PU_DBSNAP_LIST_COUNT,
+} pu_dbsnap_list_t;
+
+typedef struct pu_dbsnap_files_t {
+  uint32_t count;
+  size_t len;
+  char path[PATH_MAX];
+
+  const unsigned char *_pos, *_end;
+  uint32_t _left;
+} pu_dbsnap_files_t;
+
+char *pu_dbsnap_default_path(alpm_handle_t *handle);
+int pu_dbsnap_stamp(const char *dbpath, uint64_t *stamp1, uint64_t *stamp2);
+
+pu_dbsnap_t *pu_dbsnap_new(void);
+int pu_dbsnap_add_pkg(pu_dbsnap_t *snap);
+int pu_dbsnap_set_str(pu_dbsnap_t *snap, pu_dbsnap_str_t field,
+    const char *str);
+int pu_dbsnap_set_int(pu_dbsnap_t *snap, pu_dbsnap_int_t field, int64_t value);
+int pu_dbsnap_add_item(pu_dbsnap_t *snap, pu_dbsnap_list_t field,
+    const char *str);
+int pu_dbsnap_add_file(pu_dbsnap_t *snap, const char *path);
+int pu_dbsnap_add_alpm_pkg(pu_dbsnap_t *snap, alpm_pkg_t *pkg);
+int pu_dbsnap_write(pu_dbsnap_t *snap, const char *path,
+    uint64_t stamp1, uint64_t stamp2);
+
+pu_dbsnap_t *pu_dbsnap_open(const char *path, uint64_t stamp1, uint64_t stamp2);
+pu_dbsnap_t *pu_dbsnap_load(alpm_handle_t *handle, int update);
+void pu_dbsnap_free(pu_dbsnap_t *snap);
+
+uint32_t pu_dbsnap_count(pu_dbsnap_t *snap);
+uint32_t pu_dbsnap_find(pu_dbsnap_t *snap, const char *name);
+const char *pu_dbsnap_str(pu_dbsnap_t *snap, uint32_t pkg,
+    pu_dbsnap_str_t field);
+int64_t pu_dbsnap_int(pu_dbsnap_t *snap, uint32_t pkg, pu_dbsnap_int_t field);
+uint32_t pu_dbsnap_list_count(pu_dbsnap_t *snap, uint32_t pkg,
+    pu_dbsnap_list_t field);
+const char *pu_dbsnap_list_item(pu_dbsnap_t *snap, uint32_t pkg,
+    pu_dbsnap_list_t field, uint32_t i);
+uint64_t pu_dbsnap_files_size(pu_dbsnap_t *snap);
+uint32_t pu_dbsnap_files(pu_dbsnap_t *snap, uint32_t pkg,
+    pu_dbsnap_files_t *iter);
+const char *pu_dbsnap_files_next(pu_dbsnap_files_t *iter);
+
+#endif /* PACUTILS_DBSNAP_H */
+
+/* vim: set ts=2 sw=2 et: */
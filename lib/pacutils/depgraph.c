@@ -0,0 +1,505 @@
+/*
+ * Copyright 2026 Andrew Gregory <andrew.gregory.8@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "depends.h"
+#include "depgraph.h"
+
+struct _pu_depgraph_name {
+  const char *name;
+  size_t node;
+};
+
+struct pu_depgraph_t {
+  size_t count;
+  alpm_pkg_t **pkgs;
+  unsigned char *explicit;
+
+  /* edges in compressed rows: the dependencies of node i are
+   * deps[dep_off[i]] to deps[dep_off[i + 1] - 1], likewise for rdeps.
+   * There is an edge to every package satisfying a dependency, like
+   * alpm_pkg_compute_requiredby; primary is set for the edge to the package
+   * alpm_find_satisfier would pick. */
+  size_t *dep_off, *deps;
+  unsigned char *primary;
+  size_t *rdep_off, *rdeps;
+
+  /* package names and provisions sorted by name, then node */
+  size_t nnames;
+  struct _pu_depgraph_name *names;
+
+  /* memoized results, -1 if not yet computed */
+  off_t *removable;
+
+  /* scratch space for traversals; a node is marked if mark[node] == gen */
+  uint32_t gen, *mark;
+  size_t *ext, *stack, *reach;
+};
+
+static int _pu_depgraph_name_cmp(const void *p1, const void *p2) {
+  const struct _pu_depgraph_name *n1 = p1, *n2 = p2;
+  int ret = strcmp(n1->name, n2->name);
+  if (ret != 0) { return ret; }
+  return n1->node < n2->node ? -1 : n1->node > n2->node;
+}
+
+/* returns the first entry for name or graph->nnames if there is none */
+static size_t _pu_depgraph_name_find(pu_depgraph_t *graph, const char *name) {
+  size_t lo = 0, hi = graph->nnames;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (strcmp(graph->names[mid].name, name) < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo < graph->nnames && strcmp(graph->names[lo].name, name) == 0) {
+    return lo;
+  }
+  return graph->nnames;
+}
+
+/* mirrors alpm_find_satisfier: a package with a matching name is preferred
+ * over the first package with a matching provision */
+static size_t _pu_depgraph_resolve(pu_depgraph_t *graph, alpm_depend_t *dep) {
+  size_t i, found = graph->count;
+  for (i = _pu_depgraph_name_find(graph, dep->name);
+      i < graph->nnames && strcmp(graph->names[i].name, dep->name) == 0; i++) {
+    alpm_pkg_t *pkg = graph->pkgs[graph->names[i].node];
+    if (strcmp(alpm_pkg_get_name(pkg), dep->name) == 0) {
+      if (pu_pkg_satisfies_dep(pkg, dep)) { return graph->names[i].node; }
+    } else if (found == graph->count && pu_pkg_satisfies_dep(pkg, dep)) {
+      found = graph->names[i].node;
+    }
+  }
+  return found;
+}
+
+static size_t _pu_depgraph_node(pu_depgraph_t *graph, alpm_pkg_t *pkg) {
+  const char *name = alpm_pkg_get_name(pkg);
+  size_t i;
+  for (i = _pu_depgraph_name_find(graph, name);
+      i < graph->nnames && strcmp(graph->names[i].name, name) == 0; i++) {
+    if (graph->pkgs[graph->names[i].node] == pkg) {
+      return graph->names[i].node;
+    }
+  }
+  return graph->count;
+}
+
+static int _pu_depgraph_add_edge(pu_depgraph_t *graph, size_t node,
+    int primary, size_t *len, size_t *cap) {
+  if (*len == *cap) {
+    size_t newcap = *cap ? *cap * 2 : 64;
+    size_t *newdeps = realloc(graph->deps, newcap * sizeof(size_t));
+    unsigned char *newprimary;
+    if (newdeps == NULL) { return -1; }
+    graph->deps = newdeps;
+    if ((newprimary = realloc(graph->primary, newcap)) == NULL) { return -1; }
+    graph->primary = newprimary;
+    *cap = newcap;
+  }
+  graph->deps[*len] = node;
+  graph->primary[(*len)++] = (unsigned char) primary;
+  return 0;
+}
+
+static int _pu_depgraph_add_deps(pu_depgraph_t *graph, alpm_list_t *deps,
+    size_t *len, size_t *cap) {
+  for (; deps; deps = deps->next) {
+    alpm_depend_t *dep = deps->data;
+    size_t first = _pu_depgraph_resolve(graph, dep), start = *len, i, j;
+    if (first == graph->count) { continue; }
+    if (_pu_depgraph_add_edge(graph, first, 1, len, cap) != 0) { return -1; }
+    for (i = _pu_depgraph_name_find(graph, dep->name);
+        i < graph->nnames && strcmp(graph->names[i].name, dep->name) == 0;
+        i++) {
+      size_t node = graph->names[i].node;
+      /* a package may provide the same name more than once */
+      for (j = start; j < *len && graph->deps[j] != node; j++);
+      if (j == *len && pu_pkg_satisfies_dep(graph->pkgs[node], dep)
+          && _pu_depgraph_add_edge(graph, node, 0, len, cap) != 0) {
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+/* builds the graph for pkgs, which must stay valid for the lifetime of the
+ * graph; optional dependencies are included as edges if optdepends is set */
+pu_depgraph_t *pu_depgraph_new(alpm_list_t *pkgs, int optdepends) {
+  pu_depgraph_t *graph = calloc(1, sizeof(pu_depgraph_t));
+  size_t i, j, n = alpm_list_count(pkgs), ndeps = 0, cap = 0;
+  alpm_list_t *p;
+
+  if (graph == NULL) { return NULL; }
+  graph->count = n;
+
+  graph->nnames = n;
+  for (p = pkgs; p; p = p->next) {
+    graph->nnames += alpm_list_count(alpm_pkg_get_provides(p->data));
+  }
+
+  if ((graph->pkgs = malloc(n * sizeof(alpm_pkg_t *) + 1)) == NULL
+      || (graph->explicit = malloc(n + 1)) == NULL
+      || (graph->dep_off = malloc((n + 1) * sizeof(size_t))) == NULL
+      || (graph->rdep_off = calloc(n + 2, sizeof(size_t))) == NULL
+      || (graph->names = malloc(graph->nnames
+              * sizeof(struct _pu_depgraph_name) + 1)) == NULL
+      || (graph->removable = malloc(n * sizeof(off_t) + 1)) == NULL
+      || (graph->mark = calloc(n + 1, sizeof(uint32_t))) == NULL
+      || (graph->ext = malloc(n * sizeof(size_t) + 1)) == NULL
+      || (graph->stack = malloc(n * sizeof(size_t) + 1)) == NULL
+      || (graph->reach = malloc(n * sizeof(size_t) + 1)) == NULL) {
+    pu_depgraph_free(graph);
+    return NULL;
+  }
+
+  for (i = 0, j = 0, p = pkgs; p; p = p->next, i++) {
+    alpm_list_t *pv;
+    graph->pkgs[i] = p->data;
+    graph->explicit[i] =
+      alpm_pkg_get_reason(p->data) == ALPM_PKG_REASON_EXPLICIT;
+    graph->removable[i] = -1;
+    graph->names[j].name = alpm_pkg_get_name(p->data);
+    graph->names[j++].node = i;
+    for (pv = alpm_pkg_get_provides(p->data); pv; pv = pv->next) {
+      alpm_depend_t *provision = pv->data;
+      graph->names[j].name = provision->name;
+      graph->names[j++].node = i;
+    }
+  }
+  qsort(graph->names, graph->nnames, sizeof(struct _pu_depgraph_name),
+      _pu_depgraph_name_cmp);
+
+  for (i = 0; i < n; i++) {
+    graph->dep_off[i] = ndeps;
+    if (_pu_depgraph_add_deps(graph, alpm_pkg_get_depends(graph->pkgs[i]),
+            &ndeps, &cap) != 0
+        || (optdepends && _pu_depgraph_add_deps(graph,
+                alpm_pkg_get_optdepends(graph->pkgs[i]), &ndeps, &cap) != 0)) {
+      pu_depgraph_free(graph);
+      return NULL;
+    }
+  }
+  graph->dep_off[n] = ndeps;
+
+  /* transpose: count the reverse edges of each node into rdep_off[node + 2]
+   * so that the prefix sum leaves rdep_off[node + 1] pointing at the start of
+   * the node's row while it is filled, and at its end afterwards */
+  if ((graph->rdeps = malloc(ndeps * sizeof(size_t) + 1)) == NULL) {
+    pu_depgraph_free(graph);
+    return NULL;
+  }
+  for (i = 0; i < ndeps; i++) {
+    graph->rdep_off[graph->deps[i] + 2]++;
+  }
+  for (i = 2; i < n + 2; i++) {
+    graph->rdep_off[i] += graph->rdep_off[i - 1];
+  }
+  for (i = 0; i < n; i++) {
+    for (j = graph->dep_off[i]; j < graph->dep_off[i + 1]; j++) {
+      graph->rdeps[graph->rdep_off[graph->deps[j] + 1]++] = i;
+    }
+  }
+
+  return graph;
+}
+
+void pu_depgraph_free(pu_depgraph_t *graph) {
+  if (graph) {
+    free(graph->pkgs);
+    free(graph->explicit);
+    free(graph->dep_off);
+    free(graph->deps);
+    free(graph->primary);
+    free(graph->rdep_off);
+    free(graph->rdeps);
+    free(graph->names);
+    free(graph->removable);
+    free(graph->mark);
+    free(graph->ext);
+    free(graph->stack);
+    free(graph->reach);
+    free(graph);
+  }
+}
+
+static void _pu_depgraph_next_gen(pu_depgraph_t *graph) {
+  if (++graph->gen == 0) {
+    memset(graph->mark, 0, graph->count * sizeof(uint32_t));
+    graph->gen = 1;
+  }
+}
+
+static size_t _pu_depgraph_visit(pu_depgraph_t *graph, size_t node,
+    size_t nreach) {
+  if (graph->mark[node] != graph->gen && !graph->explicit[node]) {
+    graph->mark[node] = graph->gen;
+    graph->reach[nreach++] = node;
+  }
+  return nreach;
+}
+
+/* The removable set of a group of packages is the largest set of packages
+ * containing the group and reachable from it through dependencies that were
+ * not installed explicitly and are only required by packages within the set.
+ * Dependencies are followed to the package alpm_find_satisfier picks, but a
+ * package counts as required by every package with a dependency it
+ * satisfies.  The set is found by collecting everything reachable and then
+ * evicting packages required from outside until nothing changes, so the
+ * result does not depend on the order in which dependencies are listed.
+ * A package outside of the graph may be given instead of roots, its
+ * dependencies are resolved against the graph. */
+static off_t _pu_depgraph_removable(pu_depgraph_t *graph, size_t *roots,
+    size_t nroots, alpm_pkg_t *external) {
+  size_t i, j, nreach = 0, nstack = 0;
+  uint32_t gen;
+  off_t size = 0;
+
+  _pu_depgraph_next_gen(graph);
+  gen = graph->gen;
+
+  for (i = 0; i < nroots; i++) {
+    if (graph->mark[roots[i]] != gen) {
+      graph->mark[roots[i]] = gen;
+      graph->ext[roots[i]] = SIZE_MAX;
+      graph->reach[nreach++] = roots[i];
+    }
+  }
+  nroots = nreach;
+  if (external) {
+    alpm_list_t *d;
+    size = alpm_pkg_get_isize(external);
+    for (d = alpm_pkg_get_depends(external); d; d = d->next) {
+      size_t node = _pu_depgraph_resolve(graph, d->data);
+      if (node < graph->count) {
+        nreach = _pu_depgraph_visit(graph, node, nreach);
+      }
+    }
+  }
+  for (i = 0; i < nreach; i++) {
+    size_t node = graph->reach[i];
+    for (j = graph->dep_off[node]; j < graph->dep_off[node + 1]; j++) {
+      if (graph->primary[j]) {
+        nreach = _pu_depgraph_visit(graph, graph->deps[j], nreach);
+      }
+    }
+  }
+
+  for (i = nroots; i < nreach; i++) {
+    size_t node = graph->reach[i];
+    graph->ext[node] = 0;
+    for (j = graph->rdep_off[node]; j < graph->rdep_off[node + 1]; j++) {
+      if (graph->mark[graph->rdeps[j]] != gen) { graph->ext[node]++; }
+    }
+    if (graph->ext[node]) { graph->stack[nstack++] = node; }
+  }
+
+  while (nstack) {
+    size_t node = graph->stack[--nstack];
+    graph->mark[node] = 0;
+    for (j = graph->dep_off[node]; j < graph->dep_off[node + 1]; j++) {
+      size_t dep = graph->deps[j];
+      if (graph->mark[dep] == gen && graph->ext[dep] != SIZE_MAX
+          && graph->ext[dep]++ == 0) {
+        graph->stack[nstack++] = dep;
+      }
+    }
+  }
+
+  for (i = 0; i < nreach; i++) {
+    if (graph->mark[graph->reach[i]] == gen) {
+      size += alpm_pkg_get_isize(graph->pkgs[graph->reach[i]]);
+    }
+  }
+  return size;
+}
+
+/* Returns the installed size of pkg plus that of every dependency which
+ * would become unneeded if pkg were removed.  Results for packages in the
+ * graph are cached.  pkg does not need to be part of the graph, in which
+ * case its dependencies are resolved against it.  Not thread-safe. */
+off_t pu_depgraph_removable_size(pu_depgraph_t *graph, alpm_pkg_t *pkg) {
+  size_t node = _pu_depgraph_node(graph, pkg);
+  if (node == graph->count) {
+    return _pu_depgraph_removable(graph, NULL, 0, pkg);
+  }
+  if (graph->removable[node] < 0) {
+    graph->removable[node] = _pu_depgraph_removable(graph, &node, 1, NULL);
+  }
+  return graph->removable[node];
+}
+
+/* Like pu_depgraph_removable_size, for removing all of pkgs at once.
+ * Packages which are not part of the graph are ignored. */
+off_t pu_depgraph_pkglist_removable_size(pu_depgraph_t *graph,
+    alpm_list_t *pkgs) {
+  size_t nroots = 0, *roots = malloc(alpm_list_count(pkgs) * sizeof(size_t) + 1);
+  off_t size;
+  if (roots == NULL) { return -1; }
+  for (; pkgs; pkgs = pkgs->next) {
+    size_t node = _pu_depgraph_node(graph, pkgs->data);
+    if (node < graph->count) { roots[nroots++] = node; }
+  }
+  size = _pu_depgraph_removable(graph, roots, nroots, NULL);
+  free(roots);
+  return size;
+}
+
+/* appends the packages no other package in the graph depends on to ret */
+int pu_depgraph_leaves(pu_depgraph_t *graph, alpm_list_t **ret) {
+  size_t i;
+  for (i = 0; i < graph->count; i++) {
+    if (graph->rdep_off[i] == graph->rdep_off[i + 1]
+        && alpm_list_append(ret, graph->pkgs[i]) == NULL) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/* Tarjan's algorithm, iterative to handle arbitrarily long dependency
+ * chains; assigns each node the index of its strongly connected component
+ * in comp and returns the number of components. */
+static size_t _pu_depgraph_scc(pu_depgraph_t *graph, size_t *comp,
+    size_t *index, size_t *low, size_t *edge) {
+  size_t *calls = graph->reach, ncalls = 0;
+  size_t *stack = graph->stack, nstack = 0;
+  size_t root, next = 1, ncomps = 0;
+
+  memset(index, 0, graph->count * sizeof(size_t));
+
+  for (root = 0; root < graph->count; root++) {
+    if (index[root]) { continue; }
+    calls[ncalls++] = root;
+    index[root] = low[root] = next++;
+    edge[root] = graph->dep_off[root];
+    stack[nstack++] = root;
+    comp[root] = SIZE_MAX;
+
+    while (ncalls) {
+      size_t node = calls[ncalls - 1];
+      if (edge[node] < graph->dep_off[node + 1]) {
+        size_t dep = graph->deps[edge[node]++];
+        if (index[dep] == 0) {
+          calls[ncalls++] = dep;
+          index[dep] = low[dep] = next++;
+          edge[dep] = graph->dep_off[dep];
+          stack[nstack++] = dep;
+          comp[dep] = SIZE_MAX;
+        } else if (comp[dep] == SIZE_MAX && index[dep] < low[node]) {
+          /* still on the stack */
+          low[node] = index[dep];
+        }
+        continue;
+      }
+
+      ncalls--;
+      if (ncalls && low[node] < low[calls[ncalls - 1]]) {
+        low[calls[ncalls - 1]] = low[node];
+      }
+      if (low[node] == index[node]) {
+        size_t member;
+        do {
+          member = stack[--nstack];
+          comp[member] = ncomps;
+        } while (member != node);
+        ncomps++;
+      }
+    }
+  }
+
+  return ncomps;
+}
+
+/* Appends a list of packages to ret for each dependency cycle which no
+ * package outside of the cycle depends on.  Such cycles, and anything only
+ * they depend on, are not reachable from any leaf package.  Linear in the
+ * number of packages plus dependencies. */
+int pu_depgraph_orphan_cycles(pu_depgraph_t *graph, alpm_list_t **ret) {
+  size_t n = graph->count, ncomps = 0, i, j;
+  size_t *comp = malloc(n * sizeof(size_t) + 1);
+  size_t *index = malloc(n * sizeof(size_t) + 1);
+  size_t *low = malloc(n * sizeof(size_t) + 1);
+  size_t *edge = malloc(n * sizeof(size_t) + 1);
+  alpm_list_t **members = NULL;
+  unsigned char *flags = NULL;
+  int err = -1;
+  enum { COMP_CYCLE = 1, COMP_NEEDED = 2 };
+
+  if (comp == NULL || index == NULL || low == NULL || edge == NULL) {
+    goto cleanup;
+  }
+
+  ncomps = _pu_depgraph_scc(graph, comp, index, low, edge);
+  if ((flags = calloc(ncomps + 1, 1)) == NULL
+      || (members = calloc(ncomps + 1, sizeof(alpm_list_t *))) == NULL) {
+    goto cleanup;
+  }
+
+  for (i = 0; i < n; i++) {
+    for (j = graph->dep_off[i]; j < graph->dep_off[i + 1]; j++) {
+      size_t dep = graph->deps[j];
+      if (comp[dep] != comp[i]) {
+        flags[comp[dep]] |= COMP_NEEDED;
+      } else {
+        /* covers self-dependencies as well as larger components */
+        flags[comp[dep]] |= COMP_CYCLE;
+      }
+    }
+  }
+
+  for (i = 0; i < n; i++) {
+    if (flags[comp[i]] == COMP_CYCLE
+        && alpm_list_append(&members[comp[i]], graph->pkgs[i]) == NULL) {
+      goto cleanup;
+    }
+  }
+  for (i = 0; i < ncomps; i++) {
+    if (members[i]) {
+      if (alpm_list_append(ret, members[i]) == NULL) { goto cleanup; }
+      members[i] = NULL;
+    }
+  }
+  err = 0;
+
+cleanup:
+  if (members) {
+    for (i = 0; i < ncomps; i++) { alpm_list_free(members[i]); }
+  }
+  free(members);
+  free(flags);
+  free(comp);
+  free(index);
+  free(low);
+  free(edge);
+  return err;
+}
+
+/* vim: set ts=2 sw=2 et: */
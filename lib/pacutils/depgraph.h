@@ -0,0 +1,48 @@
+/*
+ * Copyright 2026 Andrew Gregory <andrew.gregory.8@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef PACUTILS_DEPGRAPH_H
+#define PACUTILS_DEPGRAPH_H
+
+#include <alpm.h>
+
+/* A dependency graph over a fixed set of packages (usually the local
+ * database).  Each dependency is resolved once, to every package satisfying
+ * it, so later queries never have to search the package list or compute
+ * reverse dependencies.  Removable sizes follow the package
+ * alpm_find_satisfier would pick, leaves and cycles consider all of them,
+ * matching alpm_pkg_compute_requiredby. */
+typedef struct pu_depgraph_t pu_depgraph_t;
+
+pu_depgraph_t *pu_depgraph_new(alpm_list_t *pkgs, int optdepends);
+void pu_depgraph_free(pu_depgraph_t *graph);
+
+off_t pu_depgraph_removable_size(pu_depgraph_t *graph, alpm_pkg_t *pkg);
+off_t pu_depgraph_pkglist_removable_size(pu_depgraph_t *graph,
+    alpm_list_t *pkgs);
+
+int pu_depgraph_leaves(pu_depgraph_t *graph, alpm_list_t **ret);
+int pu_depgraph_orphan_cycles(pu_depgraph_t *graph, alpm_list_t **ret);
+
+#endif /* PACUTILS_DEPGRAPH_H */
+
+/* vim: set ts=2 sw=2 et: */
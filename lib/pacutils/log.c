@@ -23,7 +23,9 @@
 #define _XOPEN_SOURCE 700 /* strptime/strndup */
 
 #include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
@@ -151,6 +153,7 @@ pu_log_reader_t *pu_log_reader_open_stream(FILE *stream) {
 void pu_log_reader_free(pu_log_reader_t *p) {
   if (p == NULL) { return; }
   if (p->_close_stream) { fclose(p->stream); }
+  free(p->_msg);
   free(p);
 }
 
@@ -193,65 +196,98 @@ char *_pu_log_parse_timestamp(const char *buf, pu_log_timestamp_t *ts) {
   return NULL;
 }
 
-pu_log_entry_t *pu_log_reader_next(pu_log_reader_t *reader) {
-  char *p, *c;
-  pu_log_entry_t *entry = calloc(sizeof(pu_log_entry_t), 1);
+static int _pu_log_reader_msg_append(pu_log_reader_t *reader, const char *str) {
+  size_t len = strlen(str);
+  if (reader->_msgsize - reader->_msglen <= len) {
+    size_t size = reader->_msgsize ? reader->_msgsize : 256;
+    char *msg;
+    while (size - reader->_msglen <= len) {
+      if (size > SIZE_MAX / 2) { errno = ENOMEM; return -1; }
+      size *= 2;
+    }
+    if ((msg = realloc(reader->_msg, size)) == NULL) { return -1; }
+    reader->_msg = msg;
+    reader->_msgsize = size;
+  }
+  memcpy(reader->_msg + reader->_msglen, str, len + 1);
+  reader->_msglen += len;
+  return 0;
+}
 
-  if (entry == NULL) { errno = ENOMEM; return NULL; }
+/* Returns the next entry, or NULL at the end of the stream or on error.
+ * Entries read by a reader bound to an arena are freed along with the arena
+ * and must not be passed to pu_log_entry_free(). */
+pu_log_entry_t *pu_log_reader_next(pu_log_reader_t *reader) {
+  pu_arena_t *arena = reader->arena;
+  pu_log_timestamp_t ts;
+  pu_log_entry_t *entry;
+  char *p, *c, *caller = NULL;
+  size_t callerlen = 0;
 
+  memset(&ts, 0, sizeof(ts));
   if (reader->_next) {
-    memcpy(&entry->timestamp, &reader->_next_ts, sizeof(pu_log_timestamp_t));
+    memcpy(&ts, &reader->_next_ts, sizeof(pu_log_timestamp_t));
     p = reader->_next;
   } else if (fgets(reader->_buf, 256, reader->stream) == NULL) {
-    free(entry);
     reader->eof = feof(reader->stream);
     return NULL;
-  } else if (!(p = _pu_log_parse_timestamp(reader->_buf, &entry->timestamp))) {
-    free(entry);
+  } else if (!(p = _pu_log_parse_timestamp(reader->_buf, &ts))) {
     errno = EINVAL;
     return NULL;
   }
 
+  entry = arena ? pu_arena_calloc(arena, 1, sizeof(pu_log_entry_t))
+    : calloc(sizeof(pu_log_entry_t), 1);
+  if (entry == NULL) { errno = ENOMEM; reader->_next = NULL; return NULL; }
+  entry->timestamp = ts;
+
   if (p[0] == ' ' && p[1] == '[' && (c = strstr(p + 2, "] "))) {
-    entry->caller = strndup(p + 2, c - (p + 2));
-    p += strlen(entry->caller) + 4;
+    caller = p + 2;
+    callerlen = c - caller;
+    entry->caller = arena ? pu_arena_strndup(arena, caller, callerlen)
+      : strndup(caller, callerlen);
+    if (entry->caller == NULL) { goto error; }
+    p += callerlen + 4;
   } else {
     /* old style entries without caller information */
     p += 1;
   }
 
-  entry->message = strdup(p);
+  reader->_msglen = 0;
+  if (_pu_log_reader_msg_append(reader, p) != 0) { goto error; }
 
   while ((reader->_next = fgets(reader->_buf, 256, reader->stream)) != NULL) {
     if ((p = _pu_log_parse_timestamp(reader->_buf, &reader->_next_ts)) == NULL) {
-      size_t oldlen = strlen(entry->message);
-      size_t newlen = oldlen + strlen(reader->_buf) + 1;
-      char *newmessage = realloc(entry->message, newlen);
-      if (oldlen > newlen || newmessage == NULL) {
-        free(entry);
-        reader->_next = NULL;
-        errno = ENOMEM;
-        return NULL;
-      }
-      entry->message = newmessage;
-      strcpy(entry->message + oldlen, reader->_buf);
+      if (_pu_log_reader_msg_append(reader, reader->_buf) != 0) { goto error; }
     } else {
       reader->_next = p;
       break;
     }
   }
 
+  entry->message = arena
+    ? pu_arena_strndup(arena, reader->_msg, reader->_msglen)
+    : strndup(reader->_msg, reader->_msglen);
+  if (entry->message == NULL) { goto error; }
+
   return entry;
+
+error:
+  if (!arena) { pu_log_entry_free(entry); }
+  reader->_next = NULL;
+  errno = ENOMEM;
+  return NULL;
 }
 
 alpm_list_t *pu_log_parse_file(FILE *stream) {
   pu_log_reader_t *reader = pu_log_reader_open_stream(stream);
   pu_log_entry_t *entry;
   alpm_list_t *entries = NULL;
+  if (reader == NULL) { return NULL; }
   while ((entry = pu_log_reader_next(reader))) {
     entries = alpm_list_add(entries, entry);
   }
-  free(reader);
+  pu_log_reader_free(reader);
   return entries;
 }
 
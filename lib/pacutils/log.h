@@ -28,6 +28,8 @@
 
 #include <alpm_list.h>
 
+#include "arena.h"
+
 typedef enum {
   PU_LOG_OPERATION_INSTALL,
   PU_LOG_OPERATION_REINSTALL,
@@ -71,11 +73,14 @@ typedef struct {
 typedef struct {
   FILE *stream;
   int eof;
+  pu_arena_t *arena; /* if set, entries are allocated from it */
 
   char _buf[256];    /* read buffer */
   char *_next;       /* next line indicator */
   int _close_stream; /* close stream on free */
   pu_log_timestamp_t _next_ts;
+  char *_msg;        /* message being assembled */
+  size_t _msglen, _msgsize;
 } pu_log_reader_t;
 
 pu_log_transaction_status_t pu_log_transaction_parse(const char *message);
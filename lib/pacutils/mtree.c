@@ -59,6 +59,7 @@ pu_mtree_t *pu_mtree_new(void) {
 void pu_mtree_free(pu_mtree_t *mtree) {
   if (mtree) {
     free(mtree->path);
+    free(mtree->link);
     free(mtree);
   }
 }
@@ -139,9 +140,12 @@ pu_mtree_reader_t *pu_mtree_reader_open_package( alpm_handle_t *h,
   }
 }
 
-static char *_pu_mtree_path(const char *mpath, const char *end) {
-  char oct[4], *path = malloc(end - mpath), *c = path;
-  if (mpath[0] == '.' && mpath[1] == '/') { mpath += 2; }
+static char *_pu_mtree_unescape(pu_arena_t *arena, const char *mpath,
+    const char *end) {
+  size_t len = end - mpath + 1;
+  char oct[4], *path, *c;
+  path = c = arena ? pu_arena_alloc(arena, len) : malloc(len);
+  if (path == NULL) { return NULL; }
   oct[3] = '\0';
   while (mpath < end) {
     if (*mpath == '\\' && mpath + 3 < end) {
@@ -157,7 +161,17 @@ static char *_pu_mtree_path(const char *mpath, const char *end) {
   return path;
 }
 
+static char *_pu_mtree_path(pu_arena_t *arena, const char *mpath,
+    const char *end) {
+  if (mpath[0] == '.' && mpath[1] == '/') { mpath += 2; }
+  return _pu_mtree_unescape(arena, mpath, end);
+}
+
+/* Reads the next entry into dest, or into a newly allocated entry if dest
+ * is NULL.  Entries and strings read by a reader bound to an arena are
+ * freed along with the arena and must not be passed to pu_mtree_free(). */
 pu_mtree_t *pu_mtree_reader_next(pu_mtree_reader_t *reader, pu_mtree_t *dest) {
+  pu_arena_t *arena = reader->arena;
   ssize_t len;
   char *saveptr, *c;
   pu_mtree_t *entry = dest;
@@ -177,9 +191,14 @@ pu_mtree_t *pu_mtree_reader_next(pu_mtree_reader_t *reader, pu_mtree_t *dest) {
   } else {
     char *sep = c, *path;
     while (*sep && !isspace(*sep)) { sep++; }
-    if ((path = _pu_mtree_path(c, sep)) == NULL) { return NULL; }
-    if (entry) {
+    if ((path = _pu_mtree_path(arena, c, sep)) == NULL) { return NULL; }
+    if (arena) {
+      if (!entry && !(entry = pu_arena_alloc(arena, sizeof(pu_mtree_t)))) {
+        return NULL;
+      }
+    } else if (entry) {
       free(entry->path);
+      free(entry->link);
     } else if ((entry = malloc(sizeof(pu_mtree_t))) == NULL) {
       free(path);
       return NULL;
@@ -207,6 +226,17 @@ pu_mtree_t *pu_mtree_reader_next(pu_mtree_reader_t *reader, pu_mtree_t *dest) {
       strcpy(entry->md5digest, val);
     } else if (strcmp(field, "sha256digest") == 0) {
       strcpy(entry->sha256digest, val);
+    } else if (strcmp(field, "time") == 0) {
+      entry->mtime = strtoll(val, NULL, 10);
+    } else if (strcmp(field, "link") == 0) {
+      if (entry != &reader->defaults) {
+        if (!arena) { free(entry->link); }
+        entry->link = _pu_mtree_unescape(arena, val, val + strlen(val));
+        if (entry->link == NULL) {
+          if (entry != dest && !arena) { pu_mtree_free(entry); }
+          return NULL;
+        }
+      }
     } else {
       /* ignore unknown fields */
     }
@@ -22,6 +22,8 @@
 
 #include <alpm.h>
 
+#include "arena.h"
+
 #ifndef PACUTILS_MTREE_H
 #define PACUTILS_MTREE_H
 
@@ -34,12 +36,15 @@ typedef struct pu_mtree_t {
   off_t size;
   char md5digest[33];
   char sha256digest[65];
+  time_t mtime;
+  char *link; /* symlink target, never inherited from /set */
 } pu_mtree_t;
 
 typedef struct {
   FILE *stream;
   int eof;
   pu_mtree_t defaults;
+  pu_arena_t *arena; /* if set, entries and paths are allocated from it */
 
   char *_buf;        /* line buffer */
   size_t _buflen;    /* line buffer length */
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2026 Andrew Gregory <andrew.gregory.8@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "parallel.h"
+
+struct _pu_parallel_ctx {
+  size_t count;
+  size_t next;
+  pu_parallel_fn_t *fn;
+  void *ctx;
+};
+
+/* returns the number of workers to use for a requested job count, a
+ * non-positive request uses one worker per online CPU */
+int pu_parallel_jobs(int jobs) {
+  if (jobs <= 0) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = ncpu > 0 ? (int) ncpu : 1;
+  }
+  return jobs;
+}
+
+static void *_pu_parallel_worker(void *arg) {
+  struct _pu_parallel_ctx *p = arg;
+  size_t i;
+  while ((i = __atomic_fetch_add(&p->next, 1, __ATOMIC_RELAXED)) < p->count) {
+    p->fn(p->ctx, i);
+  }
+  return NULL;
+}
+
+/* Calls fn for every index in [0, count) using up to jobs threads, including
+ * the calling thread.  Indices are handed out dynamically so uneven work is
+ * balanced across workers.  Returns once every call has completed. */
+int pu_parallel_for(size_t count, int jobs, pu_parallel_fn_t *fn, void *ctx) {
+  struct _pu_parallel_ctx p = { count, 0, fn, ctx };
+  pthread_t *threads = NULL;
+  size_t nthreads = 0, i;
+
+  jobs = pu_parallel_jobs(jobs);
+  if ((size_t) jobs > count) { jobs = count; }
+  if (jobs > 1 && (threads = calloc(jobs - 1, sizeof(pthread_t)))) {
+    for (; nthreads < (size_t) jobs - 1; nthreads++) {
+      if (pthread_create(&threads[nthreads], NULL, _pu_parallel_worker, &p)) {
+        /* carry on with the threads we have */
+        break;
+      }
+    }
+  }
+
+  _pu_parallel_worker(&p);
+
+  for (i = 0; i < nthreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+
+  return 0;
+}
+
+static void _pu_pkg_load_one(alpm_handle_t *handle, pu_pkg_load_t *l,
+    int full) {
+  l->pkg = NULL;
+  l->error = ALPM_ERR_OK;
+  if (alpm_pkg_load(handle, l->path, full, l->level, &l->pkg) != 0) {
+    l->error = alpm_errno(handle);
+    l->pkg = NULL;
+  }
+}
+
+/* asks the kernel to start reading a package file in the background */
+static void _pu_pkg_load_readahead(const char *path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) { return; }
+  posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+  close(fd);
+}
+
+/* Loads count package files with handle so that they may be added to its
+ * transactions.  A handle may only be used by one thread at a time, so the
+ * packages are loaded one after another; for full loads the next file is
+ * read ahead while the current one is decompressed.  Returns the number of
+ * packages that failed to load. */
+size_t pu_pkg_load_many(alpm_handle_t *handle, pu_pkg_load_t *loads,
+    size_t count, int full) {
+  size_t i, failed = 0;
+
+  for (i = 0; i < count; i++) {
+    if (full && i + 1 < count) { _pu_pkg_load_readahead(loads[i + 1].path); }
+    _pu_pkg_load_one(handle, &loads[i], full);
+    if (loads[i].pkg == NULL) { failed++; }
+  }
+
+  return failed;
+}
+
+struct _pu_pkg_load_ctx {
+  alpm_handle_t *handle;
+  alpm_handle_t **handles;
+  pu_pkg_load_t *loads;
+  size_t count, next;
+  int full;
+  pthread_mutex_t lock;
+};
+
+static void _pu_pkg_load_worker(void *ctx, size_t w) {
+  struct _pu_pkg_load_ctx *c = ctx;
+  alpm_handle_t *handle = alpm_initialize(alpm_option_get_root(c->handle),
+      alpm_option_get_dbpath(c->handle), NULL);
+  const char *gpgdir = alpm_option_get_gpgdir(c->handle);
+  size_t i;
+
+  if (handle && gpgdir && alpm_option_set_gpgdir(handle, gpgdir) != 0) {
+    alpm_release(handle);
+    handle = NULL;
+  }
+  c->handles[w] = handle;
+  while ((i = __atomic_fetch_add(&c->next, 1, __ATOMIC_RELAXED)) < c->count) {
+    if (handle) {
+      _pu_pkg_load_one(handle, &c->loads[i], c->full);
+    } else {
+      /* no handle of our own, share the caller's */
+      pthread_mutex_lock(&c->lock);
+      _pu_pkg_load_one(c->handle, &c->loads[i], c->full);
+      pthread_mutex_unlock(&c->lock);
+    }
+  }
+}
+
+/* Loads count package files using up to jobs threads (see pu_parallel_jobs).
+ * Each worker loads with a handle of its own, created from handle's root and
+ * database path and GnuPG directory, so the packages must not be added to a
+ * transaction.  The worker
+ * handles are appended to handles and must be released with
+ * pu_pkg_load_release once the packages have been freed.  No callbacks are
+ * called.  Returns the number of packages that failed to load. */
+size_t pu_pkg_load_many_detached(alpm_handle_t *handle, pu_pkg_load_t *loads,
+    size_t count, int full, int jobs, alpm_list_t **handles) {
+  struct _pu_pkg_load_ctx c = {
+    .handle = handle, .loads = loads, .count = count, .full = full,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+  };
+  size_t i, nworkers, failed = 0;
+
+  if (count == 0) { return 0; }
+
+  nworkers = pu_parallel_jobs(jobs);
+  if (nworkers > count) { nworkers = count; }
+  if ((c.handles = calloc(nworkers, sizeof(alpm_handle_t *))) == NULL) {
+    return pu_pkg_load_many(handle, loads, count, full);
+  }
+
+  pu_parallel_for(nworkers, nworkers, _pu_pkg_load_worker, &c);
+
+  for (i = 0; i < nworkers; i++) {
+    /* a handle has to outlive its packages, leak it if it cannot be returned */
+    if (c.handles[i]) { alpm_list_append(handles, c.handles[i]); }
+  }
+  for (i = 0; i < count; i++) {
+    if (loads[i].pkg == NULL) { failed++; }
+  }
+
+  free(c.handles);
+  pthread_mutex_destroy(&c.lock);
+
+  return failed;
+}
+
+void pu_pkg_load_release(alpm_list_t *handles) {
+  alpm_list_t *i;
+  for (i = handles; i; i = i->next) { alpm_release(i->data); }
+  alpm_list_free(handles);
+}
+
+/* vim: set ts=2 sw=2 et: */
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2026 Andrew Gregory <andrew.gregory.8@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef PACUTILS_PARALLEL_H
+#define PACUTILS_PARALLEL_H
+
+#include <stddef.h>
+
+#include <alpm.h>
+
+typedef void (pu_parallel_fn_t)(void *ctx, size_t i);
+
+int pu_parallel_jobs(int jobs);
+int pu_parallel_for(size_t count, int jobs, pu_parallel_fn_t *fn, void *ctx);
+
+typedef struct pu_pkg_load_t {
+  const char *path;
+  alpm_siglevel_t level;
+  alpm_pkg_t *pkg;
+  alpm_errno_t error;
+} pu_pkg_load_t;
+
+size_t pu_pkg_load_many(alpm_handle_t *handle, pu_pkg_load_t *loads,
+    size_t count, int full);
+size_t pu_pkg_load_many_detached(alpm_handle_t *handle, pu_pkg_load_t *loads,
+    size_t count, int full, int jobs, alpm_list_t **handles);
+void pu_pkg_load_release(alpm_list_t *handles);
+
+#endif /* PACUTILS_PARALLEL_H */
+
+/* vim: set ts=2 sw=2 et: */
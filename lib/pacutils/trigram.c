@@ -0,0 +1,701 @@
+/*
+ * Copyright 2026 Andrew Gregory <andrew.gregory.8@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#define _GNU_SOURCE /* strndup */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trigram.h"
+
+#define PU_TRIGRAM_MAGIC "PUTRGM1\n"
+
+struct _pu_trigram_posting {
+  uint32_t key;
+  uint32_t count;
+  uint32_t size;
+  uint32_t *docs;
+};
+
+struct _pu_trigram_field {
+  /* builder state */
+  struct _pu_trigram_posting *slots;
+  size_t nslots, nkeys;
+  char *pool;
+  size_t poollen, poolsize;
+
+  /* finalized (mapped) state */
+  uint32_t mkeys;
+  const uint32_t *keys;
+  const uint32_t *kstart;
+  const uint32_t *postings;
+  const uint64_t *stroffs;
+  const uint32_t *strcounts;
+  const char *strpool;
+};
+
+struct _pu_trigram_header {
+  char magic[8];
+  uint32_t nfields, ndocs;
+  uint64_t stamp1, stamp2;
+  uint64_t nameoffs, namepool;
+  struct {
+    uint64_t keys, kstart, postings, stroffs, strcounts, strpool;
+    uint32_t nkeys, pad;
+  } fields[PU_TRIGRAM_MAX_FIELDS];
+};
+
+struct pu_trigram_index_t {
+  unsigned int nfields;
+  uint32_t ndocs;
+  struct _pu_trigram_field fields[PU_TRIGRAM_MAX_FIELDS];
+
+  /* builder state */
+  size_t docsize;
+  uint64_t *_nameoffs;
+  uint64_t *_stroffs[PU_TRIGRAM_MAX_FIELDS];
+  uint32_t *_strcounts[PU_TRIGRAM_MAX_FIELDS];
+  char *_names;
+  size_t _nameslen, _namessize;
+
+  /* finalized (mapped) state */
+  const uint64_t *nameoffs;
+  const char *names;
+  void *_map;
+  size_t _maplen;
+};
+
+static uint32_t _pu_trigram_key(const unsigned char *s) {
+  uint32_t key = 0;
+  int i;
+  for (i = 0; i < 3; i++) {
+    unsigned char c = s[i];
+    if (c >= 'A' && c <= 'Z') { c += 'a' - 'A'; }
+    key = (key << 8) | c;
+  }
+  return key;
+}
+
+static int _pu_trigram_ascii(const unsigned char *s) {
+  return s[0] < 0x80 && s[1] < 0x80 && s[2] < 0x80;
+}
+
+static int _pu_grow(void **ptr, size_t *size, size_t need, size_t membsize) {
+  size_t newsize = *size ? *size : 16;
+  void *newptr;
+  if (need <= *size) { return 0; }
+  while (newsize < need) { newsize *= 2; }
+  if ((newptr = realloc(*ptr, newsize * membsize)) == NULL) { return -1; }
+  *ptr = newptr;
+  *size = newsize;
+  return 0;
+}
+
+static struct _pu_trigram_posting *_pu_trigram_slot(
+    struct _pu_trigram_posting *slots, size_t nslots, uint32_t key) {
+  uint32_t h = key * 2654435761u;
+  size_t i = (h ^ (h >> 15)) & (nslots - 1);
+  while (slots[i].docs && slots[i].key != key) { i = (i + 1) & (nslots - 1); }
+  return &slots[i];
+}
+
+static int _pu_trigram_rehash(struct _pu_trigram_field *f) {
+  size_t i, nslots = f->nslots ? f->nslots * 2 : 1024;
+  struct _pu_trigram_posting *slots = calloc(nslots, sizeof(*slots));
+  if (slots == NULL) { return -1; }
+  for (i = 0; i < f->nslots; i++) {
+    if (f->slots[i].docs) {
+      *_pu_trigram_slot(slots, nslots, f->slots[i].key) = f->slots[i];
+    }
+  }
+  free(f->slots);
+  f->slots = slots;
+  f->nslots = nslots;
+  return 0;
+}
+
+static int _pu_trigram_insert(struct _pu_trigram_field *f, uint32_t key,
+    uint32_t doc) {
+  struct _pu_trigram_posting *p;
+  if ((f->nkeys + 1) * 2 > f->nslots && _pu_trigram_rehash(f) != 0) {
+    return -1;
+  }
+  p = _pu_trigram_slot(f->slots, f->nslots, key);
+  if (p->docs == NULL) {
+    size_t size = 0;
+    if (_pu_grow((void **) &p->docs, &size, 1, sizeof(uint32_t)) != 0) {
+      return -1;
+    }
+    p->key = key;
+    p->size = size;
+    f->nkeys++;
+  } else if (p->docs[p->count - 1] == doc) {
+    return 0;
+  } else {
+    size_t size = p->size;
+    if (_pu_grow((void **) &p->docs, &size, p->count + 1, sizeof(uint32_t))) {
+      return -1;
+    }
+    p->size = size;
+  }
+  p->docs[p->count++] = doc;
+  return 0;
+}
+
+pu_trigram_index_t *pu_trigram_index_new(unsigned int nfields) {
+  pu_trigram_index_t *idx;
+  if (nfields == 0 || nfields > PU_TRIGRAM_MAX_FIELDS) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if ((idx = calloc(sizeof(pu_trigram_index_t), 1)) == NULL) { return NULL; }
+  idx->nfields = nfields;
+  return idx;
+}
+
+int pu_trigram_index_add_doc(pu_trigram_index_t *idx, const char *name) {
+  size_t len = strlen(name) + 1, docsize = idx->docsize;
+  unsigned int i;
+
+  if (idx->_map || idx->ndocs == UINT32_MAX) { errno = EINVAL; return -1; }
+
+  if (_pu_grow((void **) &idx->_names, &idx->_namessize,
+        idx->_nameslen + len, 1) != 0) {
+    return -1;
+  }
+  for (i = 0; i < idx->nfields; i++) {
+    size_t s = docsize;
+    if (_pu_grow((void **) &idx->_stroffs[i], &s, idx->ndocs + 2,
+          sizeof(uint64_t)) != 0) {
+      return -1;
+    }
+    s = docsize;
+    if (_pu_grow((void **) &idx->_strcounts[i], &s, idx->ndocs + 2,
+          sizeof(uint32_t)) != 0) {
+      return -1;
+    }
+    idx->_stroffs[i][idx->ndocs] = idx->fields[i].poollen;
+    idx->_strcounts[i][idx->ndocs] = 0;
+  }
+  if (_pu_grow((void **) &idx->_nameoffs, &idx->docsize, idx->ndocs + 2,
+        sizeof(uint64_t)) != 0) {
+    return -1;
+  }
+
+  memcpy(idx->_names + idx->_nameslen, name, len);
+  idx->_nameoffs[idx->ndocs] = idx->_nameslen;
+  idx->_nameslen += len;
+
+  return idx->ndocs++;
+}
+
+int pu_trigram_index_add_str(pu_trigram_index_t *idx, unsigned int field,
+    const char *str) {
+  const unsigned char *c = (const unsigned char *) str;
+  struct _pu_trigram_field *f;
+  size_t len;
+  uint32_t doc;
+
+  if (field >= idx->nfields || idx->_map || idx->ndocs == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  f = &idx->fields[field];
+  if (str == NULL) { return 0; }
+
+  doc = idx->ndocs - 1;
+  len = strlen(str) + 1;
+  if (_pu_grow((void **) &f->pool, &f->poolsize, f->poollen + len, 1) != 0) {
+    return -1;
+  }
+  memcpy(f->pool + f->poollen, str, len);
+  f->poollen += len;
+  idx->_strcounts[field][doc]++;
+
+  for (; c[0] && c[1] && c[2]; c++) {
+    if (_pu_trigram_insert(f, _pu_trigram_key(c), doc) != 0) { return -1; }
+  }
+
+  return 0;
+}
+
+static int _pu_trigram_keycmp(const void *k1, const void *k2) {
+  uint32_t a = *(const uint32_t *) k1, b = *(const uint32_t *) k2;
+  return a < b ? -1 : a > b;
+}
+
+static int _pu_trigram_pad(FILE *f, size_t len, uint64_t *off) {
+  static const char zero[8] = { 0 };
+  size_t pad = (8 - (len % 8)) % 8;
+  if (pad && fwrite(zero, pad, 1, f) != 1) { return -1; }
+  *off += len + pad;
+  return 0;
+}
+
+static int _pu_trigram_put(FILE *f, const void *data, size_t len,
+    uint64_t *off) {
+  if (len && fwrite(data, len, 1, f) != 1) { return -1; }
+  return _pu_trigram_pad(f, len, off);
+}
+
+static int _pu_trigram_write_field(FILE *stream, pu_trigram_index_t *idx,
+    unsigned int field, struct _pu_trigram_header *hdr, uint64_t *off) {
+  struct _pu_trigram_field *f = &idx->fields[field];
+  uint32_t *keys, *kstart, total = 0;
+  size_t i, k = 0;
+  int ret = -1;
+
+  keys = malloc((f->nkeys + 1) * sizeof(uint32_t));
+  kstart = malloc((f->nkeys + 1) * sizeof(uint32_t));
+  if (keys == NULL || kstart == NULL) { goto cleanup; }
+
+  for (i = 0; i < f->nslots; i++) {
+    if (f->slots[i].docs) { keys[k++] = f->slots[i].key; }
+  }
+  qsort(keys, k, sizeof(uint32_t), _pu_trigram_keycmp);
+  for (i = 0; i < k; i++) {
+    kstart[i] = total;
+    total += _pu_trigram_slot(f->slots, f->nslots, keys[i])->count;
+  }
+  kstart[k] = total;
+
+  hdr->fields[field].nkeys = k;
+  hdr->fields[field].keys = *off;
+  if (_pu_trigram_put(stream, keys, k * sizeof(uint32_t), off) != 0) {
+    goto cleanup;
+  }
+  hdr->fields[field].kstart = *off;
+  if (_pu_trigram_put(stream, kstart, (k + 1) * sizeof(uint32_t), off) != 0) {
+    goto cleanup;
+  }
+  hdr->fields[field].postings = *off;
+  for (i = 0; i < k; i++) {
+    struct _pu_trigram_posting *p = _pu_trigram_slot(f->slots, f->nslots, keys[i]);
+    if (p->count && fwrite(p->docs, p->count * sizeof(uint32_t), 1, stream) != 1) {
+      goto cleanup;
+    }
+  }
+  if (_pu_trigram_pad(stream, total * sizeof(uint32_t), off) != 0) {
+    goto cleanup;
+  }
+
+  idx->_stroffs[field][idx->ndocs] = f->poollen;
+  hdr->fields[field].stroffs = *off;
+  if (_pu_trigram_put(stream, idx->_stroffs[field],
+        (idx->ndocs + 1) * sizeof(uint64_t), off) != 0) {
+    goto cleanup;
+  }
+  hdr->fields[field].strcounts = *off;
+  if (_pu_trigram_put(stream, idx->_strcounts[field],
+        idx->ndocs * sizeof(uint32_t), off) != 0) {
+    goto cleanup;
+  }
+  hdr->fields[field].strpool = *off;
+  if (_pu_trigram_put(stream, f->pool, f->poollen, off) != 0) {
+    goto cleanup;
+  }
+
+  ret = 0;
+
+cleanup:
+  free(keys);
+  free(kstart);
+  return ret;
+}
+
+int pu_trigram_index_write(pu_trigram_index_t *idx, const char *path,
+    uint64_t stamp1, uint64_t stamp2) {
+  struct _pu_trigram_header hdr;
+  uint64_t off = 0;
+  char *tmp = NULL;
+  FILE *stream = NULL;
+  unsigned int i;
+  int fd;
+
+  if (idx->_map || idx->ndocs == 0) { errno = EINVAL; return -1; }
+
+  if ((tmp = malloc(strlen(path) + 8)) == NULL) { return -1; }
+  sprintf(tmp, "%s.XXXXXX", path);
+  if ((fd = mkstemp(tmp)) == -1) { free(tmp); return -1; }
+  if ((stream = fdopen(fd, "w")) == NULL) { close(fd); goto error; }
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, PU_TRIGRAM_MAGIC, 8);
+  hdr.nfields = idx->nfields;
+  hdr.ndocs = idx->ndocs;
+  hdr.stamp1 = stamp1;
+  hdr.stamp2 = stamp2;
+
+  /* reserve space for the header, it is rewritten once offsets are known */
+  if (_pu_trigram_put(stream, &hdr, sizeof(hdr), &off) != 0) { goto error; }
+
+  hdr.nameoffs = off;
+  if (_pu_trigram_put(stream, idx->_nameoffs,
+        idx->ndocs * sizeof(uint64_t), &off) != 0) {
+    goto error;
+  }
+  hdr.namepool = off;
+  if (_pu_trigram_put(stream, idx->_names, idx->_nameslen, &off) != 0) {
+    goto error;
+  }
+  for (i = 0; i < idx->nfields; i++) {
+    if (_pu_trigram_write_field(stream, idx, i, &hdr, &off) != 0) {
+      goto error;
+    }
+  }
+
+  if (fseek(stream, 0, SEEK_SET) != 0
+      || fwrite(&hdr, sizeof(hdr), 1, stream) != 1
+      || fflush(stream) != 0 || fsync(fileno(stream)) != 0) {
+    goto error;
+  }
+  if (fclose(stream) != 0) { stream = NULL; goto error; }
+  stream = NULL;
+  if (rename(tmp, path) != 0) { goto error; }
+
+  free(tmp);
+  return 0;
+
+error:
+  if (stream) { fclose(stream); }
+  unlink(tmp);
+  free(tmp);
+  return -1;
+}
+
+/* sections are written back to back, so the name pool runs up to the first
+ * field's keys; everything else carries its own length */
+static int _pu_trigram_check(const char *map, size_t len) {
+  const struct _pu_trigram_header *hdr = (const struct _pu_trigram_header *) map;
+  uint64_t n = hdr->ndocs, namelen, d;
+  unsigned int i;
+
+#define CHECK(o, size) \
+  if ((o) % 8 || (o) > len || (size) > len - (o)) { return -1; }
+  if (hdr->nfields == 0 || hdr->nfields > PU_TRIGRAM_MAX_FIELDS) { return -1; }
+  CHECK(hdr->nameoffs, n * sizeof(uint64_t));
+  if (hdr->fields[0].keys < hdr->namepool) { return -1; }
+  namelen = hdr->fields[0].keys - hdr->namepool;
+  CHECK(hdr->namepool, namelen);
+  if (n && (namelen == 0 || map[hdr->namepool + namelen - 1] != '\0')) {
+    return -1;
+  }
+  for (d = 0; d < n; d++) {
+    if (((const uint64_t *) (map + hdr->nameoffs))[d] >= namelen) { return -1; }
+  }
+
+  for (i = 0; i < hdr->nfields; i++) {
+    const uint32_t *kstart = (const uint32_t *) (map + hdr->fields[i].kstart);
+    const uint32_t *postings = (const uint32_t *) (map + hdr->fields[i].postings);
+    const uint64_t *stroffs = (const uint64_t *) (map + hdr->fields[i].stroffs);
+    uint64_t nkeys = hdr->fields[i].nkeys, k, p;
+
+    CHECK(hdr->fields[i].keys, nkeys * sizeof(uint32_t));
+    CHECK(hdr->fields[i].kstart, (nkeys + 1) * sizeof(uint32_t));
+    CHECK(hdr->fields[i].postings, (uint64_t) kstart[nkeys] * sizeof(uint32_t));
+    for (k = 0; k < nkeys; k++) {
+      if (kstart[k] > kstart[k + 1]) { return -1; }
+    }
+    for (p = 0; p < kstart[nkeys]; p++) {
+      if (postings[p] >= n) { return -1; }
+    }
+
+    CHECK(hdr->fields[i].stroffs, (n + 1) * sizeof(uint64_t));
+    CHECK(hdr->fields[i].strcounts, n * sizeof(uint32_t));
+    CHECK(hdr->fields[i].strpool, stroffs[n]);
+    for (d = 0; d < n; d++) {
+      /* each document's strings must end inside its own range */
+      if (stroffs[d] > stroffs[d + 1]) { return -1; }
+      if (stroffs[d] < stroffs[d + 1]
+          && map[hdr->fields[i].strpool + stroffs[d + 1] - 1] != '\0') {
+        return -1;
+      }
+    }
+  }
+#undef CHECK
+
+  return 0;
+}
+
+pu_trigram_index_t *pu_trigram_index_open(const char *path,
+    uint64_t stamp1, uint64_t stamp2) {
+  const struct _pu_trigram_header *hdr;
+  pu_trigram_index_t *idx;
+  struct stat sbuf;
+  unsigned int i;
+  char *map;
+  int fd;
+
+  if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1) { return NULL; }
+  if (fstat(fd, &sbuf) != 0) { close(fd); return NULL; }
+  if ((size_t) sbuf.st_size < sizeof(struct _pu_trigram_header)) {
+    close(fd);
+    errno = EINVAL;
+    return NULL;
+  }
+  map = mmap(NULL, sbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) { return NULL; }
+
+  hdr = (const struct _pu_trigram_header *) map;
+  if (memcmp(hdr->magic, PU_TRIGRAM_MAGIC, 8) != 0
+      || _pu_trigram_check(map, sbuf.st_size) != 0) {
+    munmap(map, sbuf.st_size);
+    errno = EINVAL;
+    return NULL;
+  }
+  if (hdr->stamp1 != stamp1 || hdr->stamp2 != stamp2) {
+    munmap(map, sbuf.st_size);
+    errno = ESTALE;
+    return NULL;
+  }
+
+  if ((idx = calloc(sizeof(pu_trigram_index_t), 1)) == NULL) {
+    munmap(map, sbuf.st_size);
+    return NULL;
+  }
+  idx->_map = map;
+  idx->_maplen = sbuf.st_size;
+  idx->nfields = hdr->nfields;
+  idx->ndocs = hdr->ndocs;
+  idx->nameoffs = (const uint64_t *) (map + hdr->nameoffs);
+  idx->names = map + hdr->namepool;
+  for (i = 0; i < idx->nfields; i++) {
+    struct _pu_trigram_field *f = &idx->fields[i];
+    f->mkeys = hdr->fields[i].nkeys;
+    f->keys = (const uint32_t *) (map + hdr->fields[i].keys);
+    f->kstart = (const uint32_t *) (map + hdr->fields[i].kstart);
+    f->postings = (const uint32_t *) (map + hdr->fields[i].postings);
+    f->stroffs = (const uint64_t *) (map + hdr->fields[i].stroffs);
+    f->strcounts = (const uint32_t *) (map + hdr->fields[i].strcounts);
+    f->strpool = map + hdr->fields[i].strpool;
+  }
+
+  return idx;
+}
+
+void pu_trigram_index_free(pu_trigram_index_t *idx) {
+  unsigned int i;
+  if (idx == NULL) { return; }
+  if (idx->_map) { munmap(idx->_map, idx->_maplen); }
+  for (i = 0; i < idx->nfields; i++) {
+    struct _pu_trigram_field *f = &idx->fields[i];
+    size_t j;
+    for (j = 0; j < f->nslots; j++) { free(f->slots[j].docs); }
+    free(f->slots);
+    free(f->pool);
+    free(idx->_stroffs[i]);
+    free(idx->_strcounts[i]);
+  }
+  free(idx->_nameoffs);
+  free(idx->_names);
+  free(idx);
+}
+
+uint32_t pu_trigram_index_count(pu_trigram_index_t *idx) {
+  return idx->ndocs;
+}
+
+const char *pu_trigram_index_doc_name(pu_trigram_index_t *idx, uint32_t doc) {
+  if (doc >= idx->ndocs) { return NULL; }
+  if (idx->_map) {
+    return idx->names + idx->nameoffs[doc];
+  } else {
+    return idx->_names + idx->_nameoffs[doc];
+  }
+}
+
+uint32_t pu_trigram_index_doc_strs(pu_trigram_index_t *idx,
+    unsigned int field, uint32_t doc, const char **first) {
+  struct _pu_trigram_field *f;
+  if (field >= idx->nfields || doc >= idx->ndocs) { return 0; }
+  f = &idx->fields[field];
+  if (idx->_map) {
+    /* do not let a bad count walk past the end of the document's strings */
+    const char *s = f->strpool + f->stroffs[doc];
+    const char *end = f->strpool + f->stroffs[doc + 1];
+    uint32_t count = 0;
+    *first = s;
+    while (count < f->strcounts[doc] && s < end) {
+      s = (const char *) memchr(s, '\0', end - s) + 1;
+      count++;
+    }
+    return count;
+  } else {
+    *first = f->pool + idx->_stroffs[field][doc];
+    return idx->_strcounts[field][doc];
+  }
+}
+
+int pu_trigram_index_filter(pu_trigram_index_t *idx, unsigned int field,
+    const char *literal, unsigned char *candidates) {
+  const unsigned char *c = (const unsigned char *) literal;
+  struct _pu_trigram_field *f;
+
+  if (field >= idx->nfields || idx->_map == NULL) { errno = EINVAL; return -1; }
+  f = &idx->fields[field];
+
+  for (; c[0] && c[1] && c[2]; c++) {
+    uint32_t key, *k, d = 0, p;
+
+    /* case-folding is only reliable for ASCII, skip anything else */
+    if (!_pu_trigram_ascii(c)) { continue; }
+
+    key = _pu_trigram_key(c);
+    k = bsearch(&key, f->keys, f->mkeys, sizeof(uint32_t), _pu_trigram_keycmp);
+    if (k == NULL) {
+      memset(candidates, 0, idx->ndocs);
+      return 0;
+    }
+    for (p = f->kstart[k - f->keys]; p < f->kstart[k - f->keys + 1]; p++) {
+      while (d < f->postings[p]) { candidates[d++] = 0; }
+      d++;
+    }
+    while (d < idx->ndocs) { candidates[d++] = 0; }
+  }
+
+  return 0;
+}
+
+static const char *_pu_regex_skip_bracket(const char *c) {
+  /* c points at the opening '[' */
+  c++;
+  if (*c == '^') { c++; }
+  if (*c == ']') { c++; }
+  while (*c && *c != ']') {
+    if (c[0] == '[' && (c[1] == ':' || c[1] == '.' || c[1] == '=')) {
+      char delim = c[1];
+      for (c += 2; *c && !(c[0] == delim && c[1] == ']'); c++);
+      if (*c) { c++; }
+    }
+    if (*c) { c++; }
+  }
+  return c;
+}
+
+static const char *_pu_regex_skip_group(const char *c) {
+  /* c points at the opening '(' */
+  int depth = 0;
+  for (; *c; c++) {
+    if (*c == '\\' && c[1]) {
+      c++;
+    } else if (*c == '[') {
+      if (!*(c = _pu_regex_skip_bracket(c))) { break; }
+    } else if (*c == '(') {
+      depth++;
+    } else if (*c == ')' && --depth == 0) {
+      break;
+    }
+  }
+  return c;
+}
+
+/* Returns the literal strings that every match of the extended regular
+ * expression must contain.  The analysis is deliberately conservative: any
+ * top-level alternation yields no literals at all and the contents of groups,
+ * bracket expressions and quantified atoms are ignored. */
+alpm_list_t *pu_trigram_regex_literals(const char *regex) {
+  alpm_list_t *literals = NULL;
+  const char *c;
+  size_t len = 0;
+  char *run;
+
+  if ((run = malloc(strlen(regex) + 1)) == NULL) { return NULL; }
+
+#define FLUSH() do { \
+    if (len >= 3) { \
+      char *lit = strndup(run, len); \
+      if (lit == NULL || alpm_list_append(&literals, lit) == NULL) { \
+        free(lit); \
+        goto error; \
+      } \
+    } \
+    len = 0; \
+  } while (0)
+
+  for (c = regex; *c; c++) {
+    switch (*c) {
+      case '\\':
+        if (c[1] && (unsigned char) c[1] < 0x80
+            && strchr("^.[]$()|*+?{}\\/-", c[1])) {
+          run[len++] = *(++c);
+        } else {
+          FLUSH();
+          if (c[1]) { c++; }
+        }
+        break;
+      case '|':
+        goto error;
+      case '[':
+        FLUSH();
+        if (!*(c = _pu_regex_skip_bracket(c))) { c--; }
+        break;
+      case '(':
+        FLUSH();
+        if (!*(c = _pu_regex_skip_group(c))) { c--; }
+        break;
+      case '*':
+      case '?':
+      case '{':
+        if (len) { len--; }
+        FLUSH();
+        if (*c == '{') {
+          while (c[1] && *c != '}') { c++; }
+        }
+        break;
+      case '+':
+      case '.':
+      case '^':
+      case '$':
+      case ')':
+        FLUSH();
+        break;
+      default:
+        if ((unsigned char) *c >= 0x80) {
+          FLUSH();
+        } else {
+          run[len++] = *c;
+        }
+        break;
+    }
+  }
+  FLUSH();
+
+#undef FLUSH
+
+  free(run);
+  return literals;
+
+error:
+  free(run);
+  FREELIST(literals);
+  return NULL;
+}
+
+/* vim: set ts=2 sw=2 et: */
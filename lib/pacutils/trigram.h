@@ -0,0 +1,59 @@
+/*
+ * Copyright 2026 Andrew Gregory <andrew.gregory.8@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef PACUTILS_TRIGRAM_H
+#define PACUTILS_TRIGRAM_H
+
+#include <stdint.h>
+
+#include <alpm_list.h>
+
+#define PU_TRIGRAM_MAX_FIELDS 8
+
+/* A trigram index maps each document (package) to one or more lists of
+ * strings per field.  Trigrams are case-folded (ASCII only) so the index can
+ * be used to narrow case-insensitive substring and regex searches; candidates
+ * must still be verified against the stored strings. */
+typedef struct pu_trigram_index_t pu_trigram_index_t;
+
+pu_trigram_index_t *pu_trigram_index_new(unsigned int nfields);
+int pu_trigram_index_add_doc(pu_trigram_index_t *idx, const char *name);
+int pu_trigram_index_add_str(pu_trigram_index_t *idx, unsigned int field,
+    const char *str);
+int pu_trigram_index_write(pu_trigram_index_t *idx, const char *path,
+    uint64_t stamp1, uint64_t stamp2);
+pu_trigram_index_t *pu_trigram_index_open(const char *path,
+    uint64_t stamp1, uint64_t stamp2);
+void pu_trigram_index_free(pu_trigram_index_t *idx);
+
+uint32_t pu_trigram_index_count(pu_trigram_index_t *idx);
+const char *pu_trigram_index_doc_name(pu_trigram_index_t *idx, uint32_t doc);
+uint32_t pu_trigram_index_doc_strs(pu_trigram_index_t *idx,
+    unsigned int field, uint32_t doc, const char **first);
+
+int pu_trigram_index_filter(pu_trigram_index_t *idx, unsigned int field,
+    const char *literal, unsigned char *candidates);
+alpm_list_t *pu_trigram_regex_literals(const char *regex);
+
+#endif /* PACUTILS_TRIGRAM_H */
+
+/* vim: set ts=2 sw=2 et: */
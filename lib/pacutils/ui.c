@@ -582,10 +582,22 @@ void pu_ui_display_transaction(alpm_handle_t *handle) {
 
 pu_config_t *pu_ui_config_parse_sysroot(pu_config_t *dest,
     const char *file, const char *root) {
-  pu_config_t *config = pu_config_new();
-  pu_config_reader_t *reader = pu_config_reader_new_sysroot(config, file, root);
+  char *cache_path = file[0] == '/' ? pu_config_cache_path(file, root) : NULL;
+  pu_config_t *config = NULL;
+  pu_config_reader_t *reader = NULL;
+  alpm_list_t *deps;
+  int clean = 1;
+
+  if (cache_path && (config = pu_config_cache_read(cache_path, file, root))) {
+    free(cache_path);
+    goto merge;
+  }
+
+  config = pu_config_new();
+  reader = pu_config_reader_new_sysroot(config, file, root);
 
   if (config == NULL || reader == NULL) {
+    free(cache_path);
     pu_ui_error("reading '%s' failed (%s)", file, strerror(errno));
     pu_config_free(config);
     pu_config_reader_free(reader);
@@ -597,10 +609,12 @@ pu_config_t *pu_ui_config_parse_sysroot(pu_config_t *dest,
       case PU_CONFIG_READER_STATUS_INVALID_VALUE:
         pu_ui_error("config %s line %d: invalid value '%s' for '%s'",
             reader->file, reader->line, reader->value, reader->key);
+        clean = 0;
         break;
       case PU_CONFIG_READER_STATUS_UNKNOWN_OPTION:
         pu_ui_warn("config %s line %d: unknown option '%s'",
             reader->file, reader->line, reader->key);
+        clean = 0;
         break;
       case PU_CONFIG_READER_STATUS_OK:
         /* todo debugging */
@@ -614,12 +628,24 @@ pu_config_t *pu_ui_config_parse_sysroot(pu_config_t *dest,
     if (!reader->eof) {
       pu_ui_error("reading '%s' failed (%s)", reader->file, strerror(errno));
     }
+    free(cache_path);
     pu_config_reader_free(reader);
     pu_config_free(config);
     return NULL;
   }
+  deps = reader->_deps;
+  reader->_deps = NULL;
   pu_config_reader_free(reader);
 
+  /* only cache configs without diagnostics so they are never hidden, the
+   * cache is an optimization and any failure to write it is ignored */
+  if (cache_path && clean) {
+    pu_config_cache_write(cache_path, config, file, root, deps);
+  }
+  FREELIST(deps);
+  free(cache_path);
+
+merge:
   if (dest) {
     pu_config_merge(dest, config);
     config = NULL;
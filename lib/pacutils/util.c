@@ -40,6 +40,31 @@ char *pu_basename(char *path) {
   return c;
 }
 
+/* Splits a package file name of the form name-pkgver-pkgrel-arch.ext,
+ * optionally followed by .sig, without copying.  The fields point into
+ * filename and are not NUL-terminated.  Returns -1 if filename does not
+ * contain the three separating dashes. */
+int pu_pkgfile_parse(const char *filename, pu_pkgfile_t *pkgfile) {
+  const char *end = filename + strlen(filename), *c, *dash[3];
+  int ndash = 0;
+
+  for (c = end; c > filename && ndash < 3; c--) {
+    if (c[-1] == '-') { dash[ndash++] = c - 1; }
+  }
+  if (ndash < 3 || dash[2] == filename) {
+    return -1;
+  }
+
+  pkgfile->name = filename;
+  pkgfile->namelen = dash[2] - filename;
+  pkgfile->version = dash[2] + 1;
+  pkgfile->versionlen = dash[0] - pkgfile->version;
+  pkgfile->arch = dash[0] + 1;
+  pkgfile->archlen = strcspn(pkgfile->arch, ".");
+  pkgfile->sig = end - filename >= 4 && strcmp(end - 4, ".sig") == 0;
+  return 0;
+}
+
 char *pu_hr_size(off_t bytes, char *dest) {
   static char *suff[] = {"B", "K", "M", "G", "T", "P", "E", NULL};
   float hrsize;
@@ -212,4 +237,341 @@ FILE *pu_fopenat(int dirfd, const char *path, const char *mode) {
   return stream;
 }
 
+/* table sizes are powers of two kept at most 3/4 full */
+static size_t _pu_table_size(size_t hint) {
+  size_t size = 16;
+  while (size < SIZE_MAX / 4 && size / 4 * 3 <= hint) { size <<= 1; }
+  return size;
+}
+
+static size_t _pu_ptr_hash(const void *ptr) {
+  uint64_t h = (uintptr_t) ptr;
+  h ^= h >> 33;
+  h *= UINT64_C(0xff51afd7ed558ccd);
+  h ^= h >> 33;
+  return (size_t) h;
+}
+
+static size_t _pu_str_hash(const char *str) {
+  uint64_t h = UINT64_C(0xcbf29ce484222325);
+  while (*str) {
+    h ^= (unsigned char) *(str++);
+    h *= UINT64_C(0x100000001b3);
+  }
+  return (size_t) (h ^ (h >> 32));
+}
+
+pu_ptrset_t *pu_ptrset_new(size_t hint) {
+  pu_ptrset_t *set = calloc(1, sizeof(pu_ptrset_t));
+  if (set == NULL) { return NULL; }
+  set->_size = _pu_table_size(hint);
+  if ((set->_slots = calloc(set->_size, sizeof(void *))) == NULL) {
+    free(set);
+    return NULL;
+  }
+  return set;
+}
+
+static int _pu_ptrset_grow(pu_ptrset_t *set) {
+  size_t i, size = set->_size * 2;
+  const void **slots = calloc(size, sizeof(void *));
+  if (slots == NULL) { return -1; }
+  for (i = 0; i < set->_size; i++) {
+    if (set->_slots[i]) {
+      size_t j = _pu_ptr_hash(set->_slots[i]) & (size - 1);
+      while (slots[j]) { j = (j + 1) & (size - 1); }
+      slots[j] = set->_slots[i];
+    }
+  }
+  free(set->_slots);
+  set->_slots = slots;
+  set->_size = size;
+  return 0;
+}
+
+/* returns 1 if ptr was added, 0 if it was already present */
+int pu_ptrset_add(pu_ptrset_t *set, const void *ptr) {
+  size_t i;
+  if (ptr == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (set->count >= set->_size / 4 * 3 && _pu_ptrset_grow(set) != 0) {
+    return -1;
+  }
+  for (i = _pu_ptr_hash(ptr) & (set->_size - 1); set->_slots[i];
+      i = (i + 1) & (set->_size - 1)) {
+    if (set->_slots[i] == ptr) { return 0; }
+  }
+  set->_slots[i] = ptr;
+  set->count++;
+  return 1;
+}
+
+int pu_ptrset_contains(const pu_ptrset_t *set, const void *ptr) {
+  size_t i;
+  if (ptr == NULL) { return 0; }
+  for (i = _pu_ptr_hash(ptr) & (set->_size - 1); set->_slots[i];
+      i = (i + 1) & (set->_size - 1)) {
+    if (set->_slots[i] == ptr) { return 1; }
+  }
+  return 0;
+}
+
+pu_ptrset_t *pu_ptrset_from_list(alpm_list_t *list) {
+  pu_ptrset_t *set = pu_ptrset_new(alpm_list_count(list));
+  if (set == NULL) { return NULL; }
+  for (; list; list = list->next) {
+    if (list->data && pu_ptrset_add(set, list->data) == -1) {
+      pu_ptrset_free(set);
+      return NULL;
+    }
+  }
+  return set;
+}
+
+/* the order of the returned list is unspecified */
+alpm_list_t *pu_ptrset_to_list(const pu_ptrset_t *set) {
+  alpm_list_t *list = NULL;
+  size_t i;
+  for (i = 0; i < set->_size; i++) {
+    if (set->_slots[i] && !alpm_list_append(&list, (void *) set->_slots[i])) {
+      alpm_list_free(list);
+      return NULL;
+    }
+  }
+  return list;
+}
+
+void pu_ptrset_free(pu_ptrset_t *set) {
+  if (set == NULL) { return; }
+  free(set->_slots);
+  free(set);
+}
+
+struct _pu_strmap_entry {
+  const char *key;
+  size_t hash;
+  void *value;
+};
+
+/* keys are packed into shared chunks rather than allocated one by one */
+struct _pu_strmap_chunk {
+  struct _pu_strmap_chunk *next;
+  size_t used, size;
+  char data[];
+};
+
+pu_strmap_t *pu_strmap_new(size_t hint) {
+  pu_strmap_t *map = calloc(1, sizeof(pu_strmap_t));
+  if (map == NULL) { return NULL; }
+  map->_size = _pu_table_size(hint);
+  if ((map->_entries = calloc(map->_size, sizeof(struct _pu_strmap_entry))) == NULL) {
+    free(map);
+    return NULL;
+  }
+  return map;
+}
+
+static const char *_pu_strmap_store(pu_strmap_t *map, const char *key) {
+  struct _pu_strmap_chunk *c = map->_chunks;
+  size_t len = strlen(key) + 1;
+  char *dest;
+  if (c == NULL || c->size - c->used < len) {
+    size_t size = len > 4096 ? len : 4096;
+    if ((c = malloc(sizeof(struct _pu_strmap_chunk) + size)) == NULL) {
+      return NULL;
+    }
+    c->used = 0;
+    c->size = size;
+    c->next = map->_chunks;
+    map->_chunks = c;
+  }
+  dest = c->data + c->used;
+  memcpy(dest, key, len);
+  c->used += len;
+  return dest;
+}
+
+static int _pu_strmap_grow(pu_strmap_t *map) {
+  size_t i, size = map->_size * 2;
+  struct _pu_strmap_entry *entries = calloc(size, sizeof(struct _pu_strmap_entry));
+  if (entries == NULL) { return -1; }
+  for (i = 0; i < map->_size; i++) {
+    if (map->_entries[i].key) {
+      size_t j = map->_entries[i].hash & (size - 1);
+      while (entries[j].key) { j = (j + 1) & (size - 1); }
+      entries[j] = map->_entries[i];
+    }
+  }
+  free(map->_entries);
+  map->_entries = entries;
+  map->_size = size;
+  return 0;
+}
+
+static struct _pu_strmap_entry *_pu_strmap_find(const pu_strmap_t *map,
+    const char *key, size_t hash) {
+  size_t i;
+  for (i = hash & (map->_size - 1); map->_entries[i].key;
+      i = (i + 1) & (map->_size - 1)) {
+    struct _pu_strmap_entry *e = &map->_entries[i];
+    if (e->hash == hash && strcmp(e->key, key) == 0) { return e; }
+  }
+  return &map->_entries[i];
+}
+
+static struct _pu_strmap_entry *_pu_strmap_insert(pu_strmap_t *map,
+    const char *key) {
+  size_t hash = _pu_str_hash(key);
+  struct _pu_strmap_entry *e;
+  if (map->count >= map->_size / 4 * 3 && _pu_strmap_grow(map) != 0) {
+    return NULL;
+  }
+  if ((e = _pu_strmap_find(map, key, hash))->key == NULL) {
+    if ((e->key = _pu_strmap_store(map, key)) == NULL) { return NULL; }
+    e->hash = hash;
+    e->value = NULL;
+    map->count++;
+  }
+  return e;
+}
+
+/* Returns the address of the value stored for key, adding key with a NULL
+ * value if it is not already present.  The address is only valid until the
+ * next key is added. */
+void **pu_strmap_slot(pu_strmap_t *map, const char *key) {
+  struct _pu_strmap_entry *e = _pu_strmap_insert(map, key);
+  return e ? &e->value : NULL;
+}
+
+/* Returns the map's copy of key, adding it if necessary. */
+const char *pu_strmap_intern(pu_strmap_t *map, const char *key) {
+  struct _pu_strmap_entry *e = _pu_strmap_insert(map, key);
+  return e ? e->key : NULL;
+}
+
+int pu_strmap_set(pu_strmap_t *map, const char *key, void *value) {
+  void **slot = pu_strmap_slot(map, key);
+  if (slot == NULL) { return -1; }
+  *slot = value;
+  return 0;
+}
+
+void *pu_strmap_get(const pu_strmap_t *map, const char *key) {
+  return _pu_strmap_find(map, key, _pu_str_hash(key))->value;
+}
+
+int pu_strmap_contains(const pu_strmap_t *map, const char *key) {
+  return _pu_strmap_find(map, key, _pu_str_hash(key))->key != NULL;
+}
+
+/* builds a map of the given strings, all with NULL values */
+pu_strmap_t *pu_strmap_from_list(alpm_list_t *strings) {
+  pu_strmap_t *map = pu_strmap_new(alpm_list_count(strings));
+  if (map == NULL) { return NULL; }
+  for (; strings; strings = strings->next) {
+    if (pu_strmap_intern(map, strings->data) == NULL) {
+      pu_strmap_free(map, NULL);
+      return NULL;
+    }
+  }
+  return map;
+}
+
+/* the returned list holds the map's copies of the keys, in unspecified
+ * order */
+alpm_list_t *pu_strmap_keys(const pu_strmap_t *map) {
+  alpm_list_t *list = NULL;
+  size_t i;
+  for (i = 0; i < map->_size; i++) {
+    const char *key = map->_entries[i].key;
+    if (key && !alpm_list_append(&list, (void *) key)) {
+      alpm_list_free(list);
+      return NULL;
+    }
+  }
+  return list;
+}
+
+void pu_strmap_free(pu_strmap_t *map, alpm_list_fn_free valfree) {
+  struct _pu_strmap_chunk *c, *next;
+  size_t i;
+  if (map == NULL) { return; }
+  if (valfree) {
+    for (i = 0; i < map->_size; i++) {
+      if (map->_entries[i].key) { valfree(map->_entries[i].value); }
+    }
+  }
+  for (c = map->_chunks; c; c = next) {
+    next = c->next;
+    free(c);
+  }
+  free(map->_entries);
+  free(map);
+}
+
+pu_vec_t *pu_vec_new(size_t hint) {
+  pu_vec_t *vec = calloc(1, sizeof(pu_vec_t));
+  if (vec == NULL) { return NULL; }
+  vec->_size = hint ? hint : 16;
+  if ((vec->items = malloc(vec->_size * sizeof(void *))) == NULL) {
+    free(vec);
+    return NULL;
+  }
+  return vec;
+}
+
+int pu_vec_push(pu_vec_t *vec, void *item) {
+  if (vec->count == vec->_size) {
+    size_t size = vec->_size * 2;
+    void **items;
+    if (size < vec->_size || size > SIZE_MAX / sizeof(void *)) {
+      errno = ENOMEM;
+      return -1;
+    }
+    if ((items = realloc(vec->items, size * sizeof(void *))) == NULL) {
+      return -1;
+    }
+    vec->items = items;
+    vec->_size = size;
+  }
+  vec->items[vec->count++] = item;
+  return 0;
+}
+
+pu_vec_t *pu_vec_from_list(alpm_list_t *list) {
+  pu_vec_t *vec = pu_vec_new(alpm_list_count(list));
+  if (vec == NULL) { return NULL; }
+  for (; list; list = list->next) {
+    if (pu_vec_push(vec, list->data) != 0) {
+      pu_vec_free(vec, NULL);
+      return NULL;
+    }
+  }
+  return vec;
+}
+
+alpm_list_t *pu_vec_to_list(const pu_vec_t *vec) {
+  alpm_list_t *list = NULL;
+  size_t i;
+  for (i = 0; i < vec->count; i++) {
+    if (!alpm_list_append(&list, vec->items[i])) {
+      alpm_list_free(list);
+      return NULL;
+    }
+  }
+  return list;
+}
+
+void pu_vec_free(pu_vec_t *vec, alpm_list_fn_free itemfree) {
+  size_t i;
+  if (vec == NULL) { return; }
+  if (itemfree) {
+    for (i = 0; i < vec->count; i++) { itemfree(vec->items[i]); }
+  }
+  free(vec->items);
+  free(vec);
+}
+
 /* vim: set ts=2 sw=2 et: */
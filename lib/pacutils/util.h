@@ -29,6 +29,14 @@
 #include <alpm_list.h>
 
 char *pu_basename(char *path);
+
+typedef struct pu_pkgfile_t {
+  const char *name, *version, *arch;
+  size_t namelen, versionlen, archlen;
+  int sig;
+} pu_pkgfile_t;
+
+int pu_pkgfile_parse(const char *filename, pu_pkgfile_t *pkgfile);
 char *pu_hr_size(off_t bytes, char *dest);
 struct tm *pu_parse_datetime(const char *string, struct tm *stm);
 
@@ -43,6 +51,55 @@ int pu_prepend_dir_list(const char *dir, alpm_list_t *paths);
 
 FILE *pu_fopenat(int dirfd, const char *path, const char *mode);
 
+/* Open-addressing set of non-NULL pointers. */
+typedef struct pu_ptrset_t {
+  size_t count;
+
+  const void **_slots;
+  size_t _size;
+} pu_ptrset_t;
+
+pu_ptrset_t *pu_ptrset_new(size_t hint);
+int pu_ptrset_add(pu_ptrset_t *set, const void *ptr);
+int pu_ptrset_contains(const pu_ptrset_t *set, const void *ptr);
+pu_ptrset_t *pu_ptrset_from_list(alpm_list_t *list);
+alpm_list_t *pu_ptrset_to_list(const pu_ptrset_t *set);
+void pu_ptrset_free(pu_ptrset_t *set);
+
+/* String-keyed map.  Keys are copied into storage owned by the map and keep
+ * their address for its lifetime. */
+typedef struct pu_strmap_t {
+  size_t count;
+
+  struct _pu_strmap_entry *_entries;
+  size_t _size;
+  struct _pu_strmap_chunk *_chunks;
+} pu_strmap_t;
+
+pu_strmap_t *pu_strmap_new(size_t hint);
+void **pu_strmap_slot(pu_strmap_t *map, const char *key);
+const char *pu_strmap_intern(pu_strmap_t *map, const char *key);
+int pu_strmap_set(pu_strmap_t *map, const char *key, void *value);
+void *pu_strmap_get(const pu_strmap_t *map, const char *key);
+int pu_strmap_contains(const pu_strmap_t *map, const char *key);
+pu_strmap_t *pu_strmap_from_list(alpm_list_t *strings);
+alpm_list_t *pu_strmap_keys(const pu_strmap_t *map);
+void pu_strmap_free(pu_strmap_t *map, alpm_list_fn_free valfree);
+
+/* Growable array of pointers. */
+typedef struct pu_vec_t {
+  void **items;
+  size_t count;
+
+  size_t _size;
+} pu_vec_t;
+
+pu_vec_t *pu_vec_new(size_t hint);
+int pu_vec_push(pu_vec_t *vec, void *item);
+pu_vec_t *pu_vec_from_list(alpm_list_t *list);
+alpm_list_t *pu_vec_to_list(const pu_vec_t *vec);
+void pu_vec_free(pu_vec_t *vec, alpm_list_fn_free itemfree);
+
 #endif /* PACUTILS_UTIL_H */
 
 /* vim: set ts=2 sw=2 et: */
@@ -0,0 +1,340 @@
+/*
+ * Copyright 2026 Andrew Gregory <andrew.gregory.8@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "parallel.h"
+#include "walk.h"
+
+/* a directory waiting to be read, path has no trailing slash */
+struct _pu_walk_dir {
+  int flags;
+  size_t len;
+  char path[];
+};
+
+/* each worker pushes and pops directories at the tail of its own queue,
+ * idle workers steal from the head of the others' */
+struct _pu_walk_queue {
+  pthread_mutex_t lock;
+  struct _pu_walk_dir **items;
+  size_t head, tail, size;
+};
+
+struct _pu_walk {
+  pu_walk_fn_t *fn;
+  void *ctx;
+  struct _pu_walk_queue *queues;
+  size_t nqueues;
+  size_t pending;
+  size_t next_worker;
+  int error;
+
+  /* idle workers sleep on wake until work is pushed or the walk ends;
+   * gen is bumped for each such event so a wakeup cannot be missed */
+  pthread_mutex_t idle_lock;
+  pthread_cond_t wake;
+  unsigned long gen;
+  size_t idle;
+};
+
+static void _pu_walk_wake(struct _pu_walk *w, int all) {
+  __atomic_add_fetch(&w->gen, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&w->idle, __ATOMIC_SEQ_CST) > 0) {
+    pthread_mutex_lock(&w->idle_lock);
+    if (all) {
+      pthread_cond_broadcast(&w->wake);
+    } else {
+      pthread_cond_signal(&w->wake);
+    }
+    pthread_mutex_unlock(&w->idle_lock);
+  }
+}
+
+static void _pu_walk_sleep(struct _pu_walk *w, unsigned long gen) {
+  pthread_mutex_lock(&w->idle_lock);
+  __atomic_add_fetch(&w->idle, 1, __ATOMIC_SEQ_CST);
+  while (__atomic_load_n(&w->gen, __ATOMIC_SEQ_CST) == gen
+      && __atomic_load_n(&w->pending, __ATOMIC_SEQ_CST) > 0) {
+    pthread_cond_wait(&w->wake, &w->idle_lock);
+  }
+  __atomic_sub_fetch(&w->idle, 1, __ATOMIC_SEQ_CST);
+  pthread_mutex_unlock(&w->idle_lock);
+}
+
+static int _pu_walk_push(struct _pu_walk *w, struct _pu_walk_queue *q,
+    const char *path, size_t len, int flags) {
+  struct _pu_walk_dir *d = malloc(sizeof(struct _pu_walk_dir) + len + 1);
+  if (d == NULL) { return -1; }
+  d->flags = flags;
+  d->len = len;
+  memcpy(d->path, path, len);
+  d->path[len] = '\0';
+
+  pthread_mutex_lock(&q->lock);
+  if (q->tail == q->size) {
+    if (q->head > 0) {
+      memmove(q->items, q->items + q->head,
+          (q->tail - q->head) * sizeof(struct _pu_walk_dir *));
+      q->tail -= q->head;
+      q->head = 0;
+    } else {
+      size_t newsize = q->size ? q->size * 2 : 64;
+      struct _pu_walk_dir **newitems
+        = realloc(q->items, newsize * sizeof(struct _pu_walk_dir *));
+      if (newitems == NULL) {
+        pthread_mutex_unlock(&q->lock);
+        free(d);
+        return -1;
+      }
+      q->items = newitems;
+      q->size = newsize;
+    }
+  }
+  /* count the directory before it becomes visible so the walk cannot be
+   * considered finished while it is queued */
+  __atomic_add_fetch(&w->pending, 1, __ATOMIC_SEQ_CST);
+  q->items[q->tail++] = d;
+  pthread_mutex_unlock(&q->lock);
+  _pu_walk_wake(w, 0);
+  return 0;
+}
+
+static struct _pu_walk_dir *_pu_walk_pop(struct _pu_walk_queue *q,
+    int steal) {
+  struct _pu_walk_dir *d = NULL;
+  pthread_mutex_lock(&q->lock);
+  if (q->head < q->tail) {
+    d = steal ? q->items[q->head++] : q->items[--q->tail];
+    if (q->head == q->tail) { q->head = q->tail = 0; }
+  }
+  pthread_mutex_unlock(&q->lock);
+  return d;
+}
+
+static int _pu_walk_dtype(int fd, const char *name, unsigned char dtype,
+    enum pu_walk_type *type) {
+  struct stat st;
+  if (dtype != DT_UNKNOWN) {
+    *type = dtype == DT_DIR ? PU_WALK_DIR : PU_WALK_FILE;
+    return 0;
+  }
+  if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) { return -1; }
+  *type = S_ISDIR(st.st_mode) ? PU_WALK_DIR : PU_WALK_FILE;
+  return 0;
+}
+
+static void _pu_walk_entry(struct _pu_walk *w, struct _pu_walk_queue *q,
+    struct _pu_walk_dir *dir, int fd, const char *name, unsigned char dtype,
+    char *path) {
+  size_t namelen = strlen(name);
+  pu_walk_entry_t entry;
+
+  if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+    return;
+  }
+
+  entry.flags = dir->flags;
+  entry.error = 0;
+  entry.type = PU_WALK_FILE;
+  entry.path = path;
+  entry.pathlen = dir->len + 1 + namelen;
+  entry.name = path + dir->len + 1;
+  if (entry.pathlen + 1 >= PATH_MAX) {
+    /* report the truncated path */
+    entry.pathlen = dir->len;
+    entry.name = "";
+    entry.error = ENAMETOOLONG;
+    path[dir->len] = '\0';
+    w->fn(w->ctx, &entry);
+    path[dir->len] = '/';
+    return;
+  }
+  memcpy(path + dir->len + 1, name, namelen + 1);
+
+  if (_pu_walk_dtype(fd, name, dtype, &entry.type) != 0) {
+    entry.error = errno;
+    w->fn(w->ctx, &entry);
+    return;
+  }
+
+  if (w->fn(w->ctx, &entry) && entry.type == PU_WALK_DIR) {
+    if (_pu_walk_push(w, q, path, entry.pathlen, entry.flags) != 0) {
+      __atomic_store_n(&w->error, errno, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+#ifdef __linux__
+struct _pu_dirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+#endif
+
+static int _pu_walk_read(struct _pu_walk *w, struct _pu_walk_queue *q,
+    struct _pu_walk_dir *dir, int fd, char *path) {
+#ifdef __linux__
+  /* getdents64 reads entries in bulk, without DIR's extra buffering */
+  uint64_t buf[4096];
+  long n;
+  while ((n = syscall(SYS_getdents64, fd, buf, sizeof(buf))) > 0) {
+    long off;
+    for (off = 0; off < n; ) {
+      struct _pu_dirent64 *de = (struct _pu_dirent64 *) ((char *) buf + off);
+      _pu_walk_entry(w, q, dir, fd, de->d_name, de->d_type, path);
+      off += de->d_reclen;
+    }
+  }
+  close(fd);
+  return n < 0 ? -1 : 0;
+#else
+  struct dirent *de;
+  DIR *d = fdopendir(fd);
+  if (d == NULL) {
+    close(fd);
+    return -1;
+  }
+  errno = 0;
+  while ((de = readdir(d))) {
+    _pu_walk_entry(w, q, dir, fd, de->d_name, de->d_type, path);
+    errno = 0;
+  }
+  closedir(d);
+  return errno ? -1 : 0;
+#endif
+}
+
+static void _pu_walk_dir(struct _pu_walk *w, struct _pu_walk_queue *q,
+    struct _pu_walk_dir *dir, char *path) {
+  int fd = open(dir->len ? dir->path : "/", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+  memcpy(path, dir->path, dir->len);
+  path[dir->len] = '/';
+
+  if (fd < 0 || _pu_walk_read(w, q, dir, fd, path) != 0) {
+    pu_walk_entry_t entry = {
+      .path = path,
+      .pathlen = dir->len,
+      .name = strrchr(dir->path, '/') ? strrchr(dir->path, '/') + 1 : dir->path,
+      .type = PU_WALK_DIR,
+      .error = errno,
+      .flags = dir->flags,
+    };
+    memcpy(path, dir->path, dir->len + 1);
+    w->fn(w->ctx, &entry);
+  }
+}
+
+static void _pu_walk_worker(void *arg, size_t i) {
+  struct _pu_walk *w = arg;
+  struct _pu_walk_queue *q = &w->queues[i];
+  char *path = malloc(PATH_MAX + 1);
+
+  if (path == NULL) {
+    __atomic_store_n(&w->error, errno, __ATOMIC_RELAXED);
+    return;
+  }
+
+  while (__atomic_load_n(&w->pending, __ATOMIC_SEQ_CST) > 0) {
+    unsigned long gen = __atomic_load_n(&w->gen, __ATOMIC_SEQ_CST);
+    struct _pu_walk_dir *dir = _pu_walk_pop(q, 0);
+    size_t j;
+    for (j = 1; dir == NULL && j < w->nqueues; j++) {
+      dir = _pu_walk_pop(&w->queues[(i + j) % w->nqueues], 1);
+    }
+    if (dir == NULL) {
+      _pu_walk_sleep(w, gen);
+      continue;
+    }
+    _pu_walk_dir(w, q, dir, path);
+    free(dir);
+    if (__atomic_sub_fetch(&w->pending, 1, __ATOMIC_SEQ_CST) == 0) {
+      _pu_walk_wake(w, 1);
+    }
+  }
+
+  free(path);
+}
+
+/* Walks the directory tree below dir using up to jobs threads (see
+ * pu_parallel_jobs), calling fn for every entry.  Entries are not visited
+ * in any particular order.  flags is passed to fn for the top-level entries.
+ * Symbolic links are not followed.  Returns -1 and sets errno if the walk
+ * could not be completed due to memory exhaustion. */
+int pu_walk(const char *dir, int flags, int jobs, pu_walk_fn_t *fn, void *ctx) {
+  struct _pu_walk w = { .fn = fn, .ctx = ctx };
+  size_t i, len = strlen(dir);
+  int ret = 0;
+
+  while (len > 0 && dir[len - 1] == '/') { len--; }
+
+  w.nqueues = pu_parallel_jobs(jobs);
+  if ((w.queues = calloc(w.nqueues, sizeof(struct _pu_walk_queue))) == NULL) {
+    return -1;
+  }
+  for (i = 0; i < w.nqueues; i++) {
+    pthread_mutex_init(&w.queues[i].lock, NULL);
+  }
+  pthread_mutex_init(&w.idle_lock, NULL);
+  pthread_cond_init(&w.wake, NULL);
+
+  if (_pu_walk_push(&w, &w.queues[0], dir, len, flags) == 0) {
+    pu_parallel_for(w.nqueues, w.nqueues, _pu_walk_worker, &w);
+  } else {
+    w.error = errno;
+  }
+
+  for (i = 0; i < w.nqueues; i++) {
+    struct _pu_walk_dir *d;
+    while ((d = _pu_walk_pop(&w.queues[i], 0))) { free(d); }
+    free(w.queues[i].items);
+    pthread_mutex_destroy(&w.queues[i].lock);
+  }
+  free(w.queues);
+  pthread_cond_destroy(&w.wake);
+  pthread_mutex_destroy(&w.idle_lock);
+
+  if (w.error) {
+    errno = w.error;
+    ret = -1;
+  }
+  return ret;
+}
+
+/* vim: set ts=2 sw=2 et: */
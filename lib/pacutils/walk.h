@@ -0,0 +1,56 @@
+/*
+ * Copyright 2026 Andrew Gregory <andrew.gregory.8@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef PACUTILS_WALK_H
+#define PACUTILS_WALK_H
+
+#include <stddef.h>
+
+enum pu_walk_type {
+  PU_WALK_FILE,
+  PU_WALK_DIR,
+};
+
+typedef struct pu_walk_entry_t {
+  /* full path without a trailing slash; the buffer has room for one more
+   * character so callbacks may temporarily append a '/' to directories */
+  char *path;
+  size_t pathlen;
+  const char *name;
+  enum pu_walk_type type;
+  /* errno if the entry could not be read (type is PU_WALK_DIR if the entry
+   * is a directory that could not be opened), otherwise 0 */
+  int error;
+  /* inherited from the parent directory, changes made by the callback are
+   * inherited by the entry's own children */
+  int flags;
+} pu_walk_entry_t;
+
+/* return non-zero to descend into a directory, the return value is ignored
+ * for other entries; callbacks are run concurrently from multiple threads */
+typedef int (pu_walk_fn_t)(void *ctx, pu_walk_entry_t *entry);
+
+int pu_walk(const char *dir, int flags, int jobs, pu_walk_fn_t *fn, void *ctx);
+
+#endif /* PACUTILS_WALK_H */
+
+/* vim: set ts=2 sw=2 et: */
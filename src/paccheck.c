@@ -71,7 +71,9 @@ enum check_types {
 pu_config_t *config = NULL;
 alpm_handle_t *handle = NULL;
 alpm_db_t *localdb = NULL;
-alpm_list_t *pkgcache = NULL, *packages = NULL;
+alpm_list_t *pkgcache = NULL;
+pu_vec_t *packages = NULL;
+pu_ptrset_t *selected = NULL;
 const char *sysroot = NULL;
 int checks = 0, recursive = 0, list_broken = 0, quiet = 0;
 int include_db_files = 0, require_mtree = 0;
@@ -729,12 +731,17 @@ static int check_sha256sum(alpm_pkg_t *pkg) {
   return ret;
 }
 
-alpm_list_t *list_add_unique(alpm_list_t *list, void *data) {
-  if (alpm_list_find_ptr(list, data)) {
-    return list;
-  } else {
-    return alpm_list_add(list, data);
+/* returns 1 if pkg was newly added, 0 if it was already selected */
+int select_pkg(alpm_pkg_t *pkg) {
+  int ret = pu_ptrset_add(selected, pkg);
+  if (ret == 1 && pu_vec_push(packages, pkg) != 0) {
+    ret = -1;
+  }
+  if (ret == -1) {
+    fprintf(stderr, "error: could not select package '%s' (%s)\n",
+        alpm_pkg_get_name(pkg), strerror(errno));
   }
+  return ret;
 }
 
 alpm_pkg_t *load_pkg(const char *pkgname) {
@@ -745,8 +752,8 @@ alpm_pkg_t *load_pkg(const char *pkgname) {
   alpm_pkg_t *p = alpm_db_get_pkg(localdb, pkgname);
   if (p == NULL) {
     fprintf(stderr, "error: could not find package '%s'\n", pkgname);
-  } else {
-    packages = list_add_unique(packages, p);
+  } else if (select_pkg(p) == -1) {
+    return NULL;
   }
   return p;
 }
@@ -756,8 +763,7 @@ void add_deps(alpm_pkg_t *pkg) {
   for (i = alpm_pkg_get_depends(pkg); i; i = alpm_list_next(i)) {
     char *depstring = alpm_dep_compute_string(i->data);
     alpm_pkg_t *p = alpm_find_satisfier(pkgcache, depstring);
-    if (p && !alpm_list_find_ptr(packages, p)) {
-      packages = alpm_list_add(packages, p);
+    if (p && select_pkg(p) == 1) {
       add_deps(p);
     }
     free(depstring);
@@ -766,8 +772,7 @@ void add_deps(alpm_pkg_t *pkg) {
     for (i = alpm_pkg_get_optdepends(pkg); i; i = alpm_list_next(i)) {
       char *depstring = alpm_dep_compute_string(i->data);
       alpm_pkg_t *p = alpm_find_satisfier(pkgcache, depstring);
-      if (p && !alpm_list_find_ptr(packages, p)) {
-        packages = alpm_list_add(packages, p);
+      if (p && select_pkg(p) == 1) {
         add_deps(p);
       }
       free(depstring);
@@ -776,7 +781,7 @@ void add_deps(alpm_pkg_t *pkg) {
 }
 
 int main(int argc, char **argv) {
-  alpm_list_t *i;
+  size_t k;
   int ret = 0;
 
   if (!(config = parse_opts(argc, argv))) {
@@ -797,6 +802,12 @@ int main(int argc, char **argv) {
   localdb = alpm_get_localdb(handle);
   pkgcache = alpm_db_get_pkgcache(localdb);
 
+  if (!(packages = pu_vec_new(0)) || !(selected = pu_ptrset_new(0))) {
+    perror("malloc");
+    ret = 1;
+    goto cleanup;
+  }
+
   for (; optind < argc; ++optind) {
     if (load_pkg(argv[optind]) == NULL) { ret = 1; }
   }
@@ -814,33 +825,39 @@ int main(int argc, char **argv) {
 
   if (ret) { goto cleanup; }
 
-  if (packages == NULL) {
-    packages = alpm_list_copy(pkgcache);
+  if (packages->count == 0) {
+    pu_vec_free(packages, NULL);
+    if (!(packages = pu_vec_from_list(pkgcache))) {
+      perror("malloc");
+      ret = 1;
+      goto cleanup;
+    }
     recursive = 0;
   } else if (recursive) {
-    /* load [opt-]depends */
-    alpm_list_t *i, *originals = alpm_list_copy(packages);
-    for (i = originals; i; i = alpm_list_next(i)) {
-      add_deps(i->data);
+    /* load [opt-]depends, only for the packages requested */
+    size_t requested = packages->count;
+    for (k = 0; k < requested; k++) {
+      add_deps(packages->items[k]);
     }
-    alpm_list_free(originals);
   }
 
-  for (i = packages; i; i = alpm_list_next(i)) {
+  for (k = 0; k < packages->count; k++) {
+    alpm_pkg_t *pkg = packages->items[k];
     int pkgerr = 0;
 #define RUNCHECK(t, b) if((checks & t) && b != 0) { pkgerr = ret = 1; }
-    RUNCHECK(CHECK_DEPENDS, check_depends(i->data));
-    RUNCHECK(CHECK_OPT_DEPENDS, check_opt_depends(i->data));
-    RUNCHECK(CHECK_FILES, check_files(i->data));
-    RUNCHECK(CHECK_FILE_PROPERTIES, check_file_properties(i->data));
-    RUNCHECK(CHECK_MD5SUM, check_md5sum(i->data));
-    RUNCHECK(CHECK_SHA256SUM, check_sha256sum(i->data));
+    RUNCHECK(CHECK_DEPENDS, check_depends(pkg));
+    RUNCHECK(CHECK_OPT_DEPENDS, check_opt_depends(pkg));
+    RUNCHECK(CHECK_FILES, check_files(pkg));
+    RUNCHECK(CHECK_FILE_PROPERTIES, check_file_properties(pkg));
+    RUNCHECK(CHECK_MD5SUM, check_md5sum(pkg));
+    RUNCHECK(CHECK_SHA256SUM, check_sha256sum(pkg));
 #undef RUNCHECK
-    if (pkgerr && list_broken) { printf("%s\n", alpm_pkg_get_name(i->data)); }
+    if (pkgerr && list_broken) { printf("%s\n", alpm_pkg_get_name(pkg)); }
   }
 
 cleanup:
-  alpm_list_free(packages);
+  pu_vec_free(packages, NULL);
+  pu_ptrset_free(selected);
   alpm_release(handle);
   pu_config_free(config);
 
@@ -32,14 +32,16 @@
 
 const char *myname = "pacfile", *myver = BUILDVER;
 
-int checkfs = 0;
+int checkfs = 0, isep = '\n';
 alpm_list_t *pkgnames = NULL;
 const char *sysroot = NULL;
 
 enum longopt_flags {
   FLAG_CONFIG = 1000,
+  FLAG_DAEMON,
   FLAG_DBPATH,
   FLAG_HELP,
+  FLAG_NULL,
   FLAG_PACKAGE,
   FLAG_ROOT,
   FLAG_SYSROOT,
@@ -54,6 +56,7 @@ void usage(int ret) {
   hputs("        pacfile (--help|--version)");
   hputs("options:");
   hputs("   --config=<path>    set an alternate configuration file");
+  hputs("   --daemon[=<sock>]  query a running pacutilsd instead");
   hputs("   --dbpath=<path>    set an alternate database location");
   hputs("   --root=<path>      set an alternate installation root");
   hputs("   --sysroot=<path>   set an alternate system root");
@@ -61,6 +64,7 @@ void usage(int ret) {
   hputs("   --version          display version information");
   hputs("   --package=<pkg>    limit information to specified package(s)");
   hputs("   --check            compare database values to filesystem");
+  hputs("   --null[=sep]       parse stdin as <sep> separated values (default NUL)");
 #undef hputs
   exit(ret);
 }
@@ -73,6 +77,7 @@ pu_config_t *parse_opts(int argc, char **argv) {
   char *short_opts = "";
   struct option long_opts[] = {
     { "config", required_argument, NULL, FLAG_CONFIG       },
+    { "daemon", optional_argument, NULL, FLAG_DAEMON       },
     { "dbpath", required_argument, NULL, FLAG_DBPATH       },
     { "help", no_argument, NULL, FLAG_HELP         },
     { "root", required_argument, NULL, FLAG_ROOT         },
@@ -81,6 +86,7 @@ pu_config_t *parse_opts(int argc, char **argv) {
     { "no-check", no_argument, &checkfs, 0                 },
     { "check", no_argument, &checkfs, 1                 },
     { "package", required_argument, NULL, FLAG_PACKAGE      },
+    { "null", optional_argument, NULL, FLAG_NULL         },
     { 0, 0, 0, 0 },
   };
 
@@ -97,6 +103,9 @@ pu_config_t *parse_opts(int argc, char **argv) {
       case FLAG_CONFIG:
         config_file = optarg;
         break;
+      case FLAG_DAEMON:
+        /* handled before parsing */
+        break;
       case FLAG_DBPATH:
         free(config->dbpath);
         config->dbpath = strdup(optarg);
@@ -115,6 +124,9 @@ pu_config_t *parse_opts(int argc, char **argv) {
         pu_print_version(myname, myver);
         exit(0);
         break;
+      case FLAG_NULL:
+        isep = optarg ? optarg[0] : '\0';
+        break;
       case FLAG_PACKAGE:
         pkgnames = alpm_list_add(pkgnames, strdup(optarg));
         break;
@@ -153,9 +165,21 @@ const char *mode_str(mode_t mode) {
   }
 }
 
-mode_t cmp_mode(struct archive_entry *entry, struct stat *st) {
+/* mtree data only stores the permission bits */
+mode_t mtree_mode(pu_mtree_t *m) {
+  mode_t type = strcmp(m->type, "dir") == 0 ? S_IFDIR
+      : strcmp(m->type, "link") == 0 ? S_IFLNK
+      : strcmp(m->type, "block") == 0 ? S_IFBLK
+      : strcmp(m->type, "char") == 0 ? S_IFCHR
+      : strcmp(m->type, "fifo") == 0 ? S_IFIFO
+      : strcmp(m->type, "socket") == 0 ? S_IFSOCK
+      : S_IFREG;
+  return type | (m->mode & 07777);
+}
+
+mode_t cmp_mode(pu_mtree_t *m, struct stat *st) {
   mode_t mask = 07777;
-  mode_t pmode = archive_entry_mode(entry);
+  mode_t pmode = mtree_mode(m);
   mode_t perm = pmode & mask;
   const char *type = mode_str(pmode);
 
@@ -178,11 +202,11 @@ mode_t cmp_mode(struct archive_entry *entry, struct stat *st) {
   return pmode;
 }
 
-void cmp_mtime(struct archive_entry *entry, struct stat *st) {
+void cmp_mtime(pu_mtree_t *m, struct stat *st) {
   struct tm ltime;
   char time_buf[26];
 
-  time_t t = archive_entry_mtime(entry);
+  time_t t = m->mtime;
   strftime(time_buf, 26, "%F %T", localtime_r(&t, &ltime));
   printf("mtime:  %s", time_buf);
 
@@ -194,15 +218,14 @@ void cmp_mtime(struct archive_entry *entry, struct stat *st) {
   putchar('\n');
 }
 
-void cmp_target(struct archive_entry *entry, struct stat *st,
-    const char *path) {
-  const char *ptarget = archive_entry_symlink(entry);
+void cmp_target(pu_mtree_t *m, struct stat *st, const char *path) {
+  const char *ptarget = m->link ? m->link : "";
   printf("target: %s", ptarget);
 
   if (st) {
     char ftarget[PATH_MAX];
-    ssize_t len = readlink(path, ftarget, PATH_MAX);
-    ftarget[len] = '\0';
+    ssize_t len = readlink(path, ftarget, PATH_MAX - 1);
+    ftarget[len < 0 ? 0 : len] = '\0';
     if (strcmp(ptarget, ftarget) != 0) {
       printf(" (%s on filesystem)", ftarget);
     }
@@ -211,8 +234,8 @@ void cmp_target(struct archive_entry *entry, struct stat *st,
   putchar('\n');
 }
 
-void cmp_uid(struct archive_entry *entry, struct stat *st) {
-  uid_t puid = archive_entry_uid(entry);
+void cmp_uid(pu_mtree_t *m, struct stat *st) {
+  uid_t puid = m->uid;
   struct passwd *pw = getpwuid(puid);
 
   printf("owner:  %d/%s", puid, pw ? pw->pw_name : "unknown user");
@@ -226,8 +249,8 @@ void cmp_uid(struct archive_entry *entry, struct stat *st) {
   putchar('\n');
 }
 
-void cmp_gid(struct archive_entry *entry, struct stat *st) {
-  gid_t pgid = archive_entry_gid(entry);
+void cmp_gid(pu_mtree_t *m, struct stat *st) {
+  gid_t pgid = m->gid;
   struct group *gr = getgrgid(pgid);
 
   printf("group:  %d/%s", pgid, gr ? gr->gr_name : "unknown group");
@@ -241,124 +264,267 @@ void cmp_gid(struct archive_entry *entry, struct stat *st) {
   putchar('\n');
 }
 
-void cmp_size(struct archive_entry *entry, struct stat *st) {
-  int64_t psize = archive_entry_size(entry);
+void cmp_size(pu_mtree_t *m, struct stat *st) {
   char hr_size[20];
 
-  printf("size:   %s", pu_hr_size(psize, hr_size));
+  printf("size:   %s", pu_hr_size(m->size, hr_size));
 
-  if (st && psize != st->st_size) {
+  if (st && m->size != st->st_size) {
     printf(" (%s on filesystem)", pu_hr_size(st->st_size, hr_size));
   }
 
   putchar('\n');
 }
 
-void cmp_sha256sum(struct stat *st,
-    alpm_handle_t *handle, alpm_pkg_t *pkg, const char *path) {
+/* One owner of one requested path.  Everything needed for the output is
+ * gathered up front so that each package's mtree is only read once and the
+ * filesystem checks can run in parallel; printing then follows input
+ * order. */
+struct file_match {
+  size_t query, pkgidx;
+  alpm_pkg_t *pkg;
+  alpm_file_t *file;
+  alpm_backup_t *backup;
+  char *full_path;
+  pu_mtree_t *mtree;
+  int mtree_missing;
+
+  /* --check */
+  struct stat st;
+  int st_err, sha256_err, md5_err;
+  char *sha256, *md5, *backup_md5;
+};
+
+struct file_batch {
+  struct file_match *matches;
+  size_t count, alloc;
+};
+
+static struct file_match *batch_add(struct file_batch *batch) {
+  if (batch->count == batch->alloc) {
+    size_t alloc = batch->alloc ? batch->alloc * 2 : 64;
+    struct file_match *m = realloc(batch->matches, alloc * sizeof(*m));
+    if (m == NULL) {
+      return NULL;
+    }
+    batch->matches = m;
+    batch->alloc = alloc;
+  }
+  memset(&batch->matches[batch->count], 0, sizeof(struct file_match));
+  return &batch->matches[batch->count++];
+}
+
+static void batch_free(struct file_batch *batch) {
+  size_t i;
+  for (i = 0; i < batch->count; i++) {
+    struct file_match *m = &batch->matches[i];
+    pu_mtree_free(m->mtree);
+    free(m->full_path);
+    free(m->sha256);
+    free(m->md5);
+    free(m->backup_md5);
+  }
+  free(batch->matches);
+}
+
+/* matches grouped by package, in file list order within each package */
+static int match_cmp(const void *p1, const void *p2) {
+  const struct file_match *m1 = *(struct file_match **) p1;
+  const struct file_match *m2 = *(struct file_match **) p2;
+  if (m1->pkgidx != m2->pkgidx) {
+    return m1->pkgidx < m2->pkgidx ? -1 : 1;
+  } else if (m1->file != m2->file) {
+    return m1->file < m2->file ? -1 : 1;
+  }
+  return 0;
+}
+
+static pu_mtree_t *mtree_dup(pu_mtree_t *m) {
+  pu_mtree_t *dup = pu_mtree_new();
+  if (dup == NULL) {
+    return NULL;
+  }
+  memcpy(dup, m, sizeof(pu_mtree_t));
+  dup->path = strdup(m->path);
+  dup->link = m->link ? strdup(m->link) : NULL;
+  if (dup->path == NULL || (m->link && dup->link == NULL)) {
+    pu_mtree_free(dup);
+    return NULL;
+  }
+  return dup;
+}
+
+/* reads the mtree for the count matches starting at group, which all
+ * belong to the same package */
+static void load_mtree(alpm_handle_t *handle, struct file_match **group,
+    size_t count) {
+  alpm_pkg_t *pkg = group[0]->pkg;
+  alpm_filelist_t *files = alpm_pkg_get_files(pkg);
   pu_mtree_reader_t *reader;
-  pu_mtree_t *m;
+  pu_mtree_t entry, *m;
+  pu_arena_t *arena;
 
   if ((reader = pu_mtree_reader_open_package(handle, pkg)) == NULL) {
     pu_ui_warn("%s: mtree data not available", alpm_pkg_get_name(pkg));
     return;
   }
-
-  while ((m = pu_mtree_reader_next(reader, NULL))) {
-    char *sha = NULL;
-    if (strcmp(m->path, path) != 0) { pu_mtree_free(m); continue; }
-
-    if (checkfs && S_ISREG(st->st_mode)) {
-      char rpath[PATH_MAX];
-      snprintf(rpath, PATH_MAX, "%s%s", alpm_option_get_root(handle), path);
-      if ((sha = alpm_compute_sha256sum(rpath)) == NULL) {
-        pu_ui_warn("%s: '%s' read error (%s)",
-            alpm_pkg_get_name(pkg), rpath, strerror(errno));
+  /* wanted entries are copied out, the arena is recycled for each line */
+  if ((arena = pu_arena_new(0)) == NULL) {
+    pu_ui_warn("%s: error reading mtree data (%s)",
+        alpm_pkg_get_name(pkg), strerror(errno));
+    pu_mtree_reader_free(reader);
+    return;
+  }
+  reader->arena = arena;
+  for (; (m = pu_mtree_reader_next(reader, &entry)); pu_arena_reset(arena)) {
+    alpm_file_t *file = pu_filelist_contains_path(files, m->path);
+    size_t lo = 0, hi = count;
+    if (file == NULL) {
+      continue;
+    }
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (group[mid]->file < file) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
       }
     }
-
-    printf("sha256: %s", m->sha256digest);
-
-    if (sha) {
-      if (strcmp(sha, m->sha256digest) != 0) {
-        printf(" (%s on filesystem)", sha);
+    /* the same path may have been requested more than once */
+    for (; lo < count && group[lo]->file == file; lo++) {
+      if (group[lo]->mtree == NULL) {
+        group[lo]->mtree = mtree_dup(m);
       }
-      free(sha);
     }
-    putchar('\n');
-
-    pu_mtree_reader_free(reader);
-    pu_mtree_free(m);
-
-    return;
   }
-
   if (!reader->eof) {
     pu_ui_warn("%s: error reading mtree data (%s)",
         alpm_pkg_get_name(pkg), strerror(errno));
   } else {
-    pu_ui_warn("%s: error '%s' not found in mtree data",
-        alpm_pkg_get_name(pkg), path);
+    size_t i;
+    for (i = 0; i < count; i++) {
+      group[i]->mtree_missing = group[i]->mtree == NULL;
+    }
   }
   pu_mtree_reader_free(reader);
+  pu_arena_free(arena);
 }
 
-void cmp_md5sum(struct stat *st,
-    alpm_handle_t *handle, alpm_pkg_t *pkg, const char *path) {
-  pu_mtree_reader_t *reader;
-  pu_mtree_t *m;
+static void check_match(void *ctx, size_t i) {
+  struct file_match *m = &((struct file_batch *) ctx)->matches[i];
 
-  if ((reader = pu_mtree_reader_open_package(handle, pkg)) == NULL) {
-    pu_ui_warn("%s: mtree data not available", alpm_pkg_get_name(pkg));
-    return;
+  if (lstat(m->full_path, &m->st) != 0) {
+    m->st_err = errno;
+  }
+  if (m->backup && (m->backup_md5 = alpm_compute_md5sum(m->full_path)) == NULL) {
+    m->md5_err = errno;
+  }
+  if (m->mtree && strcmp(m->mtree->type, "file") == 0 && !m->st_err
+      && S_ISREG(m->st.st_mode)) {
+    if ((m->sha256 = alpm_compute_sha256sum(m->full_path)) == NULL) {
+      m->sha256_err = errno;
+    }
+    if ((m->md5 = alpm_compute_md5sum(m->full_path)) == NULL) {
+      m->md5_err = errno;
+    }
+  }
+}
+
+/* prints a digest recorded in the mtree along with the filesystem value */
+static void print_digest(const char *label, const char *digest,
+    const char *fsdigest, int err, struct file_match *m) {
+  if (checkfs && !fsdigest && err && m->mtree) {
+    pu_ui_warn("%s: '%s' read error (%s)",
+        alpm_pkg_get_name(m->pkg), m->full_path, strerror(err));
   }
+  printf("%s %s", label, digest);
+  if (fsdigest && strcmp(fsdigest, digest) != 0) {
+    printf(" (%s on filesystem)", fsdigest);
+  }
+  putchar('\n');
+}
 
-  while ((m = pu_mtree_reader_next(reader, NULL))) {
-    char *md5 = NULL;
-    if (strcmp(m->path, path) != 0) { pu_mtree_free(m); continue; }
+int print_match(struct file_match *m) {
+  int ret = 0;
 
-    if (checkfs && S_ISREG(st->st_mode)) {
-      char rpath[PATH_MAX];
-      snprintf(rpath, PATH_MAX, "%s%s", alpm_option_get_root(handle), path);
-      if ((md5 = alpm_compute_md5sum(rpath)) == NULL) {
-        pu_ui_warn("%s: '%s' read error (%s)",
-            alpm_pkg_get_name(pkg), rpath, strerror(errno));
-      }
-    }
+  printf("file:   %s\n", m->file->name);
+  printf("owner:  %s\n", alpm_pkg_get_name(m->pkg));
 
-    printf("md5sum: %s", m->md5digest);
+  /* backup file status */
+  if (m->backup) {
+    fputs("backup: yes\n", stdout);
+    fprintf(stdout, "md5sum: %s", m->backup->hash);
 
-    if (md5) {
-      if (strcmp(md5, m->md5digest) != 0) {
-        printf(" (%s on filesystem)", md5);
+    if (checkfs) {
+      if (!m->backup_md5) {
+        fprintf(stderr, "warning: could not calculate md5sum for '%s'\n",
+            m->full_path);
+        ret = 1;
+      } else if (strcmp(m->backup_md5, m->backup->hash) != 0) {
+        fprintf(stdout, " (%s on filesystem)", m->backup_md5);
       }
-      free(md5);
     }
+
     putchar('\n');
+  } else {
+    fputs("backup: no\n", stdout);
+  }
 
-    pu_mtree_reader_free(reader);
-    pu_mtree_free(m);
+  /* MTREE info */
+  if (m->mtree) {
+    struct stat *st = NULL;
 
-    return;
-  }
+    if (checkfs) {
+      if (m->st_err) {
+        fprintf(stderr, "warning: could not stat '%s' (%s)\n",
+            m->full_path, strerror(m->st_err));
+        ret = 1;
+      } else {
+        st = &m->st;
+      }
+    }
 
-  if (!reader->eof) {
-    pu_ui_warn("%s: error reading mtree data (%s)",
-        alpm_pkg_get_name(pkg), strerror(errno));
-  } else {
+    if (S_ISLNK(cmp_mode(m->mtree, st))) {
+      cmp_target(m->mtree, st, m->full_path);
+    }
+    cmp_mtime(m->mtree, st);
+    cmp_uid(m->mtree, st);
+    cmp_gid(m->mtree, st);
+
+    if (strcmp(m->mtree->type, "file") == 0) {
+      cmp_size(m->mtree, st);
+      print_digest("sha256:", m->mtree->sha256digest, m->sha256,
+          m->sha256_err, m);
+      print_digest("md5sum:", m->mtree->md5digest, m->md5, m->md5_err, m);
+    }
+  } else if (m->mtree_missing) {
     pu_ui_warn("%s: error '%s' not found in mtree data",
-        alpm_pkg_get_name(pkg), path);
+        alpm_pkg_get_name(m->pkg), m->file->name);
   }
-  pu_mtree_reader_free(reader);
+
+  return ret;
 }
 
 int main(int argc, char **argv) {
   pu_config_t *config = NULL;
   alpm_handle_t *handle = NULL;
-  alpm_list_t *pkgs = NULL;
+  alpm_list_t *pkgs = NULL, *files = NULL, *f;
+  struct file_batch batch = { .matches = NULL };
+  struct file_match **order = NULL;
+  size_t i, nfiles = 0;
   int ret = 0;
   size_t rootlen;
-  const char *root;
+  const char *root, *daemon_sock;
+
+  /* forward the whole invocation to a running pacutilsd if requested */
+  if ((daemon_sock = pu_daemon_option(argc, argv))) {
+    if ((ret = pu_daemon_run(daemon_sock, myname, argc, argv)) != -1) {
+      return ret;
+    }
+    fprintf(stderr, "warning: unable to contact pacutilsd at '%s' (%s)\n",
+        daemon_sock, strerror(errno));
+    ret = 0;
+  }
 
   if (!(config = parse_opts(argc, argv))) {
     goto cleanup;
@@ -390,11 +556,25 @@ int main(int argc, char **argv) {
     pkgs = alpm_list_copy(alpm_db_get_pkgcache(alpm_get_localdb(handle)));
   }
 
-  while (optind < argc) {
-    const char *relfname, *filename = argv[optind];
+  for (; optind < argc; optind++) {
+    files = alpm_list_add(files, strdup(argv[optind]));
+  }
+  if (!isatty(fileno(stdin)) && errno != EBADF) {
+    char *buf = NULL;
+    size_t len = 0;
+    ssize_t read;
+    while ((read = getdelim(&buf, &len, isep, stdin)) != -1) {
+      if (buf[read - 1] == isep) { buf[read - 1] = '\0'; }
+      files = alpm_list_add(files, strdup(buf));
+    }
+    free(buf);
+  }
 
-    int found = 0;
+  /* find every owner of every path */
+  for (f = files; f; f = f->next, nfiles++) {
+    const char *relfname, *filename = f->data;
     alpm_list_t *p;
+    size_t pkgidx = 0;
 
     if (strncmp(filename, root, rootlen) == 0) {
       relfname = filename + rootlen;
@@ -402,103 +582,85 @@ int main(int argc, char **argv) {
       relfname = filename;
     }
 
-    for (p = pkgs; p; p = alpm_list_next(p)) {
+    for (p = pkgs; p; p = alpm_list_next(p), pkgidx++) {
       alpm_file_t *pfile = pu_filelist_contains_path(
               alpm_pkg_get_files(p->data), relfname);
-      if (pfile) {
-        alpm_list_t *b;
-        char full_path[PATH_MAX];
-        snprintf(full_path, PATH_MAX, "%s%s", root, pfile->name);
-
-        if (found++) { putchar('\n'); }
-
-        printf("file:   %s\n", pfile->name);
-        printf("owner:  %s\n", alpm_pkg_get_name(p->data));
-
-        /* backup file status */
-        for (b = alpm_pkg_get_backup(p->data); b; b = b->next) {
-          alpm_backup_t *bak = b->data;
-          if (pu_pathcmp(relfname, bak->name) == 0) {
-            fputs("backup: yes\n", stdout);
-            fprintf(stdout, "md5sum: %s", bak->hash);
-
-            if (checkfs) {
-              char *md5sum = alpm_compute_md5sum(full_path);
-              if (!md5sum) {
-                fprintf(stderr, "warning: could not calculate md5sum for '%s'\n",
-                    full_path);
-                ret = 1;
-              } else {
-                if (strcmp(md5sum, bak->hash) != 0) {
-                  fprintf(stdout, " (%s on filesystem)", md5sum);
-                }
-                free(md5sum);
-              }
-            }
-
-            putchar('\n');
-            break;
-          }
-        }
-        if (!b) {
-          fputs("backup: no\n", stdout);
+      struct file_match *m;
+      alpm_list_t *b;
+      if (!pfile) {
+        continue;
+      }
+      if ((m = batch_add(&batch)) == NULL) {
+        fprintf(stderr, "error: %s\n", strerror(errno));
+        ret = 1;
+        goto cleanup;
+      }
+      m->query = nfiles;
+      m->pkgidx = pkgidx;
+      m->pkg = p->data;
+      m->file = pfile;
+      if ((m->full_path = pu_asprintf("%s%s", root, pfile->name)) == NULL) {
+        fprintf(stderr, "error: %s\n", strerror(errno));
+        ret = 1;
+        goto cleanup;
+      }
+      for (b = alpm_pkg_get_backup(p->data); b; b = b->next) {
+        alpm_backup_t *bak = b->data;
+        if (pu_pathcmp(relfname, bak->name) == 0) {
+          m->backup = bak;
+          break;
         }
+      }
+    }
+  }
 
-        /* MTREE info */
-        struct archive *mtree = alpm_pkg_mtree_open(p->data);
-        if (mtree) {
-
-          struct archive_entry *entry;
-          while (alpm_pkg_mtree_next(p->data, mtree, &entry) == ARCHIVE_OK) {
-            struct stat sbuf, *st = NULL;
-
-            const char *ppath = archive_entry_pathname(entry);
-            if (strncmp("./", ppath, 2) == 0) { ppath += 2; }
-
-            if (pu_pathcmp(relfname, ppath) != 0) { continue; }
-
-            if (checkfs) {
-              if (lstat(full_path, &sbuf) != 0) {
-                fprintf(stderr, "warning: could not stat '%s' (%s)\n",
-                    full_path, strerror(errno));
-                ret = 1;
-              } else {
-                st = &sbuf;
-              }
-            }
-
-            if (S_ISLNK(cmp_mode(entry, st))) {
-              cmp_target(entry, st, full_path);
-            }
-            cmp_mtime(entry, st);
-            cmp_uid(entry, st);
-            cmp_gid(entry, st);
-
-            if (archive_entry_filetype(entry) == AE_IFREG) {
-              cmp_size(entry, st);
-              cmp_sha256sum(st, handle, p->data, ppath);
-              cmp_md5sum(st, handle, p->data, ppath);
-            }
-
-            break;
-          }
-          alpm_pkg_mtree_close(p->data, mtree);
-        }
+  /* read each owning package's mtree once for all of its paths */
+  if (batch.count && (order = malloc(batch.count * sizeof(*order))) == NULL) {
+    fprintf(stderr, "error: %s\n", strerror(errno));
+    ret = 1;
+    goto cleanup;
+  }
+  for (i = 0; i < batch.count; i++) {
+    order[i] = &batch.matches[i];
+  }
+  qsort(order, batch.count, sizeof(*order), match_cmp);
+  for (i = 0; i < batch.count; ) {
+    size_t end = i + 1;
+    while (end < batch.count && order[end]->pkgidx == order[i]->pkgidx) {
+      end++;
+    }
+    load_mtree(handle, order + i, end - i);
+    i = end;
+  }
+
+  if (checkfs) {
+    pu_parallel_for(batch.count, 0, check_match, &batch);
+  }
+
+  /* matches were added in input order */
+  for (f = files, i = 0, nfiles = 0; f; f = f->next, nfiles++) {
+    int found = 0;
+    for (; i < batch.count && batch.matches[i].query == nfiles; i++) {
+      if (found++) { putchar('\n'); }
+      if (print_match(&batch.matches[i]) != 0) {
+        ret = 1;
       }
     }
 
     if (!found) {
-      printf("no package owns '%s'\n", filename);
+      printf("no package owns '%s'\n", (char *) f->data);
     }
 
-    ++optind;
-    if (optind < argc) {
+    if (f->next) {
       fputs("\n", stdout);
     }
   }
 
 cleanup:
-  alpm_release(handle);
+  batch_free(&batch);
+  free(order);
+  FREELIST(files);
+  pu_release_handle(handle);
   pu_config_free(config);
   alpm_list_free(pkgs);
   FREELIST(pkgnames);
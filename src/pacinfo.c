@@ -34,11 +34,28 @@ const char *myname = "pacinfo", *myver = BUILDVER;
 enum format {
   FORMAT_SHORT = 1,
   FORMAT_LONG = 2,
+  FORMAT_TEMPLATE = 3,
 };
 
+/* --format templates are compiled into a list of ops so that only the
+ * fields actually referenced are looked up */
+struct format_op {
+  char field; /* a template field character, or 0 for literal text */
+  char *text;
+  size_t len;
+};
+
+struct format_op *template = NULL;
+size_t template_len = 0;
+
 pu_config_t *config = NULL;
 alpm_handle_t *handle = NULL;
 alpm_list_t *allpkgs = NULL;
+pu_depgraph_t *depgraph = NULL;
+
+/* every local and sync package by name, for batch lookups; each list keeps
+ * the local db first, then sync dbs in order */
+pu_strmap_t *pkgindex = NULL;
 
 int format = FORMAT_LONG, verbosity = 1, removable_size = 0, raw = 0;
 int isep = '\n';
@@ -50,6 +67,8 @@ enum longopt_flags {
   FLAG_DBEXT,
   FLAG_DBPATH,
   FLAG_DEBUG,
+  FLAG_FORMAT,
+  FLAG_DAEMON,
   FLAG_HELP,
   FLAG_NOTIMEOUT,
   FLAG_NULL,
@@ -137,57 +156,84 @@ void printo(const char *field, off_t size) {
   printf(field, hrsize);
 }
 
-off_t _pkg_removable_size(alpm_pkg_t *pkg, alpm_list_t *pkgs,
-    alpm_list_t **seen) {
-  const char *pkgname = alpm_pkg_get_name(pkg);
-  if (alpm_list_find_ptr(*seen, pkgname))
-  { return 0; }
-
-  off_t size = alpm_pkg_get_isize(pkg);
-  *seen = alpm_list_add(*seen, (void *) pkgname);
-
-  alpm_list_t *d, *deps = alpm_pkg_get_depends(pkg);
-  for (d = deps; d; d = d->next) {
-    char *depstring = alpm_dep_compute_string(d->data);
-    alpm_pkg_t *p = alpm_find_satisfier(pkgs, depstring);
-    free(depstring);
+static const char template_fields[] = "nvdrabupfskIBDLGPROCENYFgmhw";
 
-    if (!p) {
-      continue;
-    }
-
-    if (alpm_pkg_get_reason(p) == ALPM_PKG_REASON_EXPLICIT) {
-      continue;
+static int template_add(char field, const char *text, size_t len) {
+  struct format_op *ops = realloc(template,
+      (template_len + 1) * sizeof(struct format_op));
+  if (ops == NULL) {
+    return -1;
+  }
+  template = ops;
+  template[template_len].field = field;
+  template[template_len].text = NULL;
+  template[template_len].len = len;
+  if (text) {
+    /* literal text may contain NUL separators */
+    if ((template[template_len].text = malloc(len)) == NULL) {
+      return -1;
     }
+    memcpy(template[template_len].text, text, len);
+  }
+  template_len++;
+  return 0;
+}
 
-    if (alpm_list_find_ptr(*seen, p)) {
-      continue;
-    }
+void template_free(void) {
+  size_t i;
+  for (i = 0; i < template_len; i++) {
+    free(template[i].text);
+  }
+  free(template);
+}
 
-    alpm_list_t *rb = alpm_pkg_compute_requiredby(p);
+int template_compile(const char *fmt) {
+  char *buf = malloc(strlen(fmt) + 1);
+  size_t len = 0;
+  const char *c;
 
-    if (rb) {
-      alpm_list_t *diff = alpm_list_diff(rb, *seen,
-              (alpm_list_fn_cmp) strcmp);
-      if (diff) {
-        alpm_list_free(diff);
-        FREELIST(rb);
-        continue;
+  if (buf == NULL) {
+    perror("malloc");
+    return -1;
+  }
+  for (c = fmt; *c; c++) {
+    if (*c == '\\' && c[1]) {
+      switch (*++c) {
+        case 'n': buf[len++] = '\n'; break;
+        case 't': buf[len++] = '\t'; break;
+        case '0': buf[len++] = '\0'; break;
+        default: buf[len++] = *c; break;
+      }
+    } else if (*c == '%' && c[1] == '%') {
+      buf[len++] = *++c;
+    } else if (*c == '%') {
+      if (c[1] == '\0') {
+        fprintf(stderr, "error: format ends with '%%'\n");
+        free(buf);
+        return -1;
+      } else if (!strchr(template_fields, c[1])) {
+        fprintf(stderr, "error: unknown format field '%%%c'\n", c[1]);
+        free(buf);
+        return -1;
       }
-      FREELIST(rb);
+      if ((len && template_add(0, buf, len) != 0)
+          || template_add(*++c, NULL, 0) != 0) {
+        perror("malloc");
+        free(buf);
+        return -1;
+      }
+      len = 0;
+    } else {
+      buf[len++] = *c;
     }
-
-    size += _pkg_removable_size(p, pkgs, seen);
   }
-
-  return size;
-}
-
-off_t pkg_removable_size(alpm_handle_t *handle, alpm_pkg_t *pkg) {
-  alpm_db_t *localdb = alpm_get_localdb(handle);
-  alpm_list_t *seen = NULL, *installed = alpm_db_get_pkgcache(localdb);
-  alpm_list_free(seen);
-  return _pkg_removable_size(pkg, installed, &seen);
+  if (len && template_add(0, buf, len) != 0) {
+    perror("malloc");
+    free(buf);
+    return -1;
+  }
+  free(buf);
+  return 0;
 }
 
 void usage(int ret) {
@@ -200,10 +246,12 @@ void usage(int ret) {
   hputs("options:");
   hputs("   --cachedir=<path>  set an alternate cache location");
   hputs("   --config=<path>    set an alternate configuration file");
+  hputs("   --daemon[=<sock>]  query a running pacutilsd instead");
   hputs("   --dbext=<ext>      set an alternate sync database extension");
   hputs("   --dbpath=<path>    set an alternate database location");
   hputs("   --no-timeout       disable low speed timeouts for downloads");
   hputs("   --debug            enable extra debugging messages");
+  hputs("   --format=<fmt>     display package information using template <fmt>");
   hputs("   --null[=sep]       parse stdin as <sep> separated values (default NUL)");
   hputs("   --short            display brief package information");
   hputs("   --raw              display raw numeric values");
@@ -228,9 +276,11 @@ pu_config_t *parse_opts(int argc, char **argv) {
     { "help", no_argument, NULL, FLAG_HELP         },
     { "version", no_argument, NULL, FLAG_VERSION      },
 
+    { "daemon", optional_argument, NULL, FLAG_DAEMON       },
     { "dbext", required_argument, NULL, FLAG_DBEXT        },
     { "dbpath", required_argument, NULL, FLAG_DBPATH       },
     { "debug", no_argument, NULL, FLAG_DEBUG        },
+    { "format", required_argument, NULL, FLAG_FORMAT       },
     { "root", required_argument, NULL, FLAG_ROOT         },
     { "sysroot", required_argument, NULL, FLAG_SYSROOT      },
     { "null", optional_argument, NULL, FLAG_NULL         },
@@ -268,6 +318,9 @@ pu_config_t *parse_opts(int argc, char **argv) {
         exit(0);
         break;
 
+      case FLAG_DAEMON:
+        /* handled before parsing */
+        break;
       case FLAG_DBEXT:
         dbext = optarg;
         break;
@@ -279,6 +332,16 @@ pu_config_t *parse_opts(int argc, char **argv) {
         log_level |= ALPM_LOG_DEBUG;
         log_level |= ALPM_LOG_FUNCTION;
         break;
+      case FLAG_FORMAT:
+        template_free();
+        template = NULL;
+        template_len = 0;
+        if (template_compile(optarg) != 0) {
+          pu_config_free(config);
+          return NULL;
+        }
+        format = FORMAT_TEMPLATE;
+        break;
       case FLAG_REMOVABLE:
         removable_size = 1;
         break;
@@ -315,6 +378,50 @@ pu_config_t *parse_opts(int argc, char **argv) {
   return config;
 }
 
+/* the reverse dependency searches need every package, which is only
+ * collected the first time one is requested */
+alpm_list_t *get_allpkgs(void) {
+  if (allpkgs == NULL) {
+    allpkgs = alpm_list_copy(alpm_db_get_pkgcache(alpm_get_localdb(handle)));
+    for (alpm_list_t *i = alpm_get_syncdbs(handle); i; i = i->next) {
+      allpkgs = alpm_list_join(allpkgs,
+              alpm_list_copy(alpm_db_get_pkgcache(i->data)));
+    }
+  }
+  return allpkgs;
+}
+
+int pkg_index_build(void) {
+  alpm_list_t *dbs = alpm_list_add(NULL, alpm_get_localdb(handle)), *d, *p;
+  size_t count = 0;
+
+  dbs = alpm_list_join(dbs, alpm_list_copy(alpm_get_syncdbs(handle)));
+  for (d = dbs; d; d = d->next) {
+    count += alpm_list_count(alpm_db_get_pkgcache(d->data));
+  }
+  if ((pkgindex = pu_strmap_new(count)) == NULL) {
+    alpm_list_free(dbs);
+    return -1;
+  }
+  for (d = dbs; d; d = d->next) {
+    for (p = alpm_db_get_pkgcache(d->data); p; p = p->next) {
+      void **slot = pu_strmap_slot(pkgindex, alpm_pkg_get_name(p->data));
+      alpm_list_t *pkgs = slot ? *slot : NULL;
+      if (slot == NULL || !alpm_list_append(&pkgs, p->data)) {
+        alpm_list_free(dbs);
+        return -1;
+      }
+      *slot = pkgs;
+    }
+  }
+  alpm_list_free(dbs);
+  return 0;
+}
+
+alpm_list_t *pkg_index_find(const char *name) {
+  return alpm_list_copy(pu_strmap_get(pkgindex, name));
+}
+
 void print_pkg_info(alpm_pkg_t *pkg) {
   alpm_db_t *db = alpm_pkg_get_db(pkg);
   alpm_db_t *localdb = alpm_get_localdb(handle);
@@ -369,22 +476,22 @@ void print_pkg_info(alpm_pkg_t *pkg) {
       printd("Replaces:       %s\n", alpm_pkg_get_replaces(pkg));
 
       if (verbosity >= 2) {
-        pu_pkg_find_requiredby(pkg, allpkgs, &i);
+        pu_pkg_find_requiredby(pkg, get_allpkgs(), &i);
         printr("Required By:    %s\n", pkg, i, 0);
         alpm_list_free(i);
         i = NULL;
 
-        pu_pkg_find_optionalfor(pkg, allpkgs, &i);
+        pu_pkg_find_optionalfor(pkg, get_allpkgs(), &i);
         printr("Optional For:   %s\n", pkg, i, 1);
         alpm_list_free(i);
         i = NULL;
 
-        pu_pkg_find_makedepfor(pkg, allpkgs, &i);
+        pu_pkg_find_makedepfor(pkg, get_allpkgs(), &i);
         printr("MakeDep For:    %s\n", pkg, i, 2);
         alpm_list_free(i);
         i = NULL;
 
-        pu_pkg_find_checkdepfor(pkg, allpkgs, &i);
+        pu_pkg_find_checkdepfor(pkg, get_allpkgs(), &i);
         printr("CheckDep For:   %s\n", pkg, i, 3);
         alpm_list_free(i);
         i = NULL;
@@ -394,7 +501,7 @@ void print_pkg_info(alpm_pkg_t *pkg) {
       printo("Download Size:  %s\n", alpm_pkg_download_size(pkg));
       printo("Installed Size: %s\n",
           removable_size
-          ? pkg_removable_size(handle, pkg)
+          ? pu_depgraph_removable_size(depgraph, pkg)
           : alpm_pkg_get_isize(pkg));
       prints("Packager:       %s\n", alpm_pkg_get_packager(pkg));
       printt("Build Date:     %s\n", alpm_pkg_get_builddate(pkg));
@@ -431,6 +538,98 @@ void print_pkg_info(alpm_pkg_t *pkg) {
   putchar('\n');
 }
 
+/* list fields are printed space-separated */
+void print_template_list(alpm_list_t *values, int deps) {
+  for (; values; values = values->next) {
+    if (deps) {
+      char *s = alpm_dep_compute_string(values->data);
+      fputs(s, stdout);
+      free(s);
+    } else {
+      fputs(values->data, stdout);
+    }
+    if (values->next) {
+      putchar(' ');
+    }
+  }
+}
+
+void print_template_pkgs(alpm_list_t *pkgs) {
+  alpm_list_t *p;
+  for (p = pkgs; p; p = p->next) {
+    pu_fprint_pkgspec(stdout, p->data);
+    if (p->next) {
+      putchar(' ');
+    }
+  }
+  alpm_list_free(pkgs);
+}
+
+void print_pkg_template(alpm_pkg_t *pkg) {
+  size_t i;
+  for (i = 0; i < template_len; i++) {
+    struct format_op *op = &template[i];
+    alpm_list_t *pkgs = NULL;
+    switch (op->field) {
+      case 0: fwrite(op->text, 1, op->len, stdout); break;
+      case 'n': prints("%s", alpm_pkg_get_name(pkg)); break;
+      case 'v': prints("%s", alpm_pkg_get_version(pkg)); break;
+      case 'd': prints("%s", alpm_pkg_get_desc(pkg)); break;
+      case 'r': prints("%s", alpm_db_get_name(alpm_pkg_get_db(pkg))); break;
+      case 'a': prints("%s", alpm_pkg_get_arch(pkg)); break;
+      case 'b': prints("%s", alpm_pkg_get_base(pkg)); break;
+      case 'u': prints("%s", alpm_pkg_get_url(pkg)); break;
+      case 'p': prints("%s", alpm_pkg_get_packager(pkg)); break;
+      case 'f': prints("%s", alpm_pkg_get_filename(pkg)); break;
+      case 's': printo("%s", alpm_pkg_get_size(pkg)); break;
+      case 'k': printo("%s", alpm_pkg_download_size(pkg)); break;
+      case 'I':
+        printo("%s", removable_size
+            ? pu_depgraph_removable_size(depgraph, pkg)
+            : alpm_pkg_get_isize(pkg));
+        break;
+      case 'B': printt("%s", alpm_pkg_get_builddate(pkg)); break;
+      case 'D': printt("%s", alpm_pkg_get_installdate(pkg)); break;
+      case 'L': print_template_list(alpm_pkg_get_licenses(pkg), 0); break;
+      case 'G': print_template_list(alpm_pkg_get_groups(pkg), 0); break;
+      case 'P': print_template_list(alpm_pkg_get_provides(pkg), 1); break;
+      case 'R': print_template_list(alpm_pkg_get_depends(pkg), 1); break;
+      case 'O': print_template_list(alpm_pkg_get_optdepends(pkg), 1); break;
+      case 'C': print_template_list(alpm_pkg_get_conflicts(pkg), 1); break;
+      case 'E': print_template_list(alpm_pkg_get_replaces(pkg), 1); break;
+      case 'N':
+        pu_pkg_find_requiredby(pkg, get_allpkgs(), &pkgs);
+        print_template_pkgs(pkgs);
+        break;
+      case 'Y':
+        pu_pkg_find_optionalfor(pkg, get_allpkgs(), &pkgs);
+        print_template_pkgs(pkgs);
+        break;
+      case 'F':
+        {
+          alpm_filelist_t *files = alpm_pkg_get_files(pkg);
+          size_t f;
+          for (f = 0; files && f < files->count; f++) {
+            fputs(files->files[f].name, stdout);
+            if (f + 1 < files->count) {
+              putchar(' ');
+            }
+          }
+        }
+        break;
+      case 'g': prints("%s", alpm_pkg_get_base64_sig(pkg)); break;
+      case 'm': prints("%s", alpm_pkg_get_md5sum(pkg)); break;
+      case 'h': prints("%s", alpm_pkg_get_sha256sum(pkg)); break;
+      case 'w':
+        if (alpm_pkg_get_origin(pkg) == ALPM_PKG_FROM_LOCALDB) {
+          fputs(alpm_pkg_get_reason(pkg) == ALPM_PKG_REASON_EXPLICIT
+              ? "Explicit" : "Dependency", stdout);
+        }
+        break;
+    }
+  }
+}
+
 alpm_list_t *find_pkg(const char *pkgspec) {
   alpm_list_t *i, *pkgs = NULL;
   alpm_pkg_t *pkg = pu_find_pkgspec(handle, pkgspec);
@@ -439,6 +638,10 @@ alpm_list_t *find_pkg(const char *pkgspec) {
     return alpm_list_add(NULL, pkg);
   }
 
+  if (pkgindex) {
+    return pkg_index_find(pkgspec);
+  }
+
   if ((pkg = alpm_db_get_pkg(alpm_get_localdb(handle), pkgspec))) {
     pkgs = alpm_list_add(pkgs, pkg);
   }
@@ -459,7 +662,11 @@ int print_pkgspec_info(const char *pkgspec) {
     return -1;
   }
   for (i = pkgs; i; i = alpm_list_next(i)) {
-    print_pkg_info(i->data);
+    if (format == FORMAT_TEMPLATE) {
+      print_pkg_template(i->data);
+    } else {
+      print_pkg_info(i->data);
+    }
   }
   alpm_list_free(pkgs);
   return 0;
@@ -473,12 +680,28 @@ void cb_log(void *ctx, alpm_loglevel_t level, const char *fmt, va_list args) {
 }
 
 int main(int argc, char **argv) {
+  const char *daemon_sock;
   int ret = 0;
 
+  /* forward the whole invocation to a running pacutilsd if requested */
+  if ((daemon_sock = pu_daemon_option(argc, argv))) {
+    if ((ret = pu_daemon_run(daemon_sock, myname, argc, argv)) != -1) {
+      return ret;
+    }
+    fprintf(stderr, "warning: unable to contact pacutilsd at '%s' (%s)\n",
+        daemon_sock, strerror(errno));
+    ret = 0;
+  }
+
   if (!(config = parse_opts(argc, argv))) {
     goto cleanup;
   }
 
+  /* output is mostly large batches of small writes */
+  if (!isatty(fileno(stdout))) {
+    setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+  }
+
   if (!(handle = pu_initialize_handle_from_config(config))) {
     fprintf(stderr, "error: failed to initialize alpm.\n");
     ret = 1;
@@ -496,10 +719,12 @@ int main(int argc, char **argv) {
   alpm_option_set_logcb(handle, cb_log, NULL);
 
   pu_register_syncdbs(handle, config->repos);
-  allpkgs = alpm_list_copy(alpm_db_get_pkgcache(alpm_get_localdb(handle)));
-  for (alpm_list_t *i = alpm_get_syncdbs(handle); i; i = i->next) {
-    allpkgs = alpm_list_join(allpkgs,
-            alpm_list_copy(alpm_db_get_pkgcache(i->data)));
+  if (removable_size && !(depgraph = pu_depgraph_new(
+              alpm_db_get_pkgcache(alpm_get_localdb(handle)), 0))) {
+    fprintf(stderr, "error: unable to build dependency graph (%s)\n",
+        strerror(errno));
+    ret = 1;
+    goto cleanup;
   }
 
   for (argv += optind; *argv; ++argv) {
@@ -510,6 +735,13 @@ int main(int argc, char **argv) {
     char *buf = NULL;
     size_t len = 0;
     ssize_t read;
+    /* resolve batches with a single index lookup instead of one per db */
+    if (pkg_index_build() != 0) {
+      fprintf(stderr, "error: unable to index packages (%s)\n",
+          strerror(errno));
+      ret = 1;
+      goto cleanup;
+    }
     while ((read = getdelim(&buf, &len, isep, stdin)) != -1) {
       if (buf[read - 1] == isep) { buf[read - 1] = '\0'; }
       if (print_pkgspec_info(buf) != 0) { ret = 1; }
@@ -518,8 +750,11 @@ int main(int argc, char **argv) {
   }
 
 cleanup:
+  template_free();
+  pu_strmap_free(pkgindex, (alpm_list_fn_free) alpm_list_free);
+  pu_depgraph_free(depgraph);
   alpm_list_free(allpkgs);
-  alpm_release(handle);
+  pu_release_handle(handle);
   pu_config_free(config);
 
   return ret;
@@ -23,7 +23,6 @@
 #include <getopt.h>
 #include <errno.h>
 #include <string.h>
-#include <strings.h>
 
 #include <pacutils.h>
 
@@ -34,13 +33,12 @@
 const char *myname = "pacini", *myver = BUILDVER;
 
 mini_t *ini = NULL;
-alpm_list_t *directives = NULL;
+const char *const *directives = NULL;
 char sep = '\n', *section_name = NULL, *input_file = NULL;
 int section_list = 0, verbose = 0;
 
 void cleanup(void) {
   free(section_name);
-  alpm_list_free(directives);
 }
 
 void usage(int ret) {
@@ -100,23 +98,12 @@ void parse_opts(int argc, char **argv) {
   }
 }
 
-alpm_list_t *find_str(alpm_list_t *haystack, const char *needle) {
-  for (; haystack; haystack = alpm_list_next(haystack)) {
-    if (strcasecmp(haystack->data, needle) == 0) {
-      return haystack;
-    }
-  }
-  return NULL;
-}
-
 void print_section(mini_t *ini) {
-  if (directives) { return; }
   printf("[%s]", ini->section);
   fputc(sep, stdout);
 }
 
 void print_option(mini_t *ini) {
-  if (directives && !find_str(directives, ini->key)) { return; }
   if (verbose || !ini->value) { fputs(ini->key, stdout); }
   if (ini->value) {
     if (verbose) { fputs(" = ", stdout); }
@@ -135,18 +122,20 @@ void list_sections(void) {
 }
 
 void show_section(void) {
-  int in_section = (section_name[0] == '\0');
-  while (mini_next(ini)) {
-    if (!ini->key) {
-      const char *section = ini->section ? ini->section : "";
-      in_section = (strcmp(section, section_name) == 0);
-    } else if (in_section) {
-      print_option(ini);
-    }
+  /* an empty name selects options outside of any section */
+  const char *section = section_name[0] ? section_name : NULL;
+  while (mini_next_key(ini, section, directives, MINI_ICASE)) {
+    print_option(ini);
   }
 }
 
 void show_directives(void) {
+  if (directives) {
+    while (mini_next_key(ini, NULL, directives, MINI_ANY_SECTION | MINI_ICASE)) {
+      print_option(ini);
+    }
+    return;
+  }
   while (mini_next(ini)) {
     if (!ini->key) { print_section(ini); }
     else          { print_option(ini); }
@@ -172,11 +161,13 @@ int main(int argc, char **argv) {
     goto cleanup;
   }
 
-  for (; optind < argc; optind++) {
-    directives = alpm_list_add(directives, argv[optind]);
+  /* argv is NULL-terminated, so the remaining arguments can be matched
+   * against directly */
+  if (optind < argc) {
+    directives = (const char *const *) argv + optind;
   }
 
-  if (alpm_list_count(directives) != 1) {
+  if (argc - optind != 1) {
     verbose = 1;
   }
 
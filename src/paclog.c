@@ -314,10 +314,23 @@ void print_entry(FILE *stream, pu_log_entry_t *entry) {
 
 int main(int argc, char **argv) {
   alpm_list_t *i, *entries = NULL;
+  pu_strmap_t *pkgset = NULL, *callerset = NULL;
+  pu_log_reader_t *reader;
+  pu_log_entry_t *entry;
+  pu_arena_t *arena = NULL;
   FILE *f;
   int ret = 0;
 
   parse_opts(argc, argv);
+
+  /* filters are checked against every entry, look them up by hash */
+  if ((pkgs && !(pkgset = pu_strmap_from_list(pkgs)))
+      || (caller && !(callerset = pu_strmap_from_list(caller)))) {
+    perror("malloc");
+    ret = 1;
+    goto cleanup;
+  }
+
   if (color == 1 && !isatty(fileno(stdout))) {
     color = 0;
   }
@@ -333,7 +346,19 @@ int main(int argc, char **argv) {
     goto cleanup;
   }
 
-  entries = pu_log_parse_file(f);
+  /* entries live until exit, allocate them in bulk */
+  if ((arena = pu_arena_new(0)) == NULL
+      || (reader = pu_log_reader_open_stream(f)) == NULL) {
+    perror("malloc");
+    fclose(f);
+    ret = 1;
+    goto cleanup;
+  }
+  reader->arena = arena;
+  while ((entry = pu_log_reader_next(reader))) {
+    entries = alpm_list_add(entries, entry);
+  }
+  pu_log_reader_free(reader);
   fclose(f);
 
   if (!entries) {
@@ -343,13 +368,19 @@ int main(int argc, char **argv) {
   }
 
   if (list_installed) {
-    alpm_list_t *seen = NULL;
+    pu_strmap_t *seen = pu_strmap_new(0);
+
+    if (seen == NULL) {
+      perror("malloc");
+      ret = 1;
+      goto cleanup;
+    }
 
     for (i = alpm_list_last(entries); i; i = alpm_list_previous(i)) {
       pu_log_entry_t *e = i->data;
       pu_log_action_t *a = pu_log_action_parse(e->message);
 
-      if (a && !alpm_list_find_str(seen, a->target)) {
+      if (a && !pu_strmap_contains(seen, a->target)) {
         switch (a->operation) {
           case PU_LOG_OPERATION_INSTALL:
           case PU_LOG_OPERATION_REINSTALL:
@@ -358,13 +389,13 @@ int main(int argc, char **argv) {
             printf("%s %s\n", a->target, a->new_version);
           /* fall through */
           case PU_LOG_OPERATION_REMOVE:
-            seen = alpm_list_add(seen, strdup(a->target));
+            pu_strmap_intern(seen, a->target);
             break;
         }
       }
       pu_log_action_free(a);
     }
-    FREELIST(seen);
+    pu_strmap_free(seen, NULL);
   } else if (!after && !before && !pkgs && !caller && !actions && !warnings
       && !commandline && !grep) {
     for (i = entries; i; i = i->next) {
@@ -387,7 +418,7 @@ int main(int argc, char **argv) {
 
       if (caller) {
         const char *c = e->caller ? e->caller : "";
-        if (alpm_list_find_str(caller, c)) {
+        if (pu_strmap_contains(callerset, c)) {
           print_entry(stdout, e);
           continue;
         }
@@ -455,7 +486,7 @@ int main(int argc, char **argv) {
 
       if (pkgs) {
         pu_log_action_t *a = pu_log_action_parse(e->message);
-        int found = (a && alpm_list_find_str(pkgs, a->target));
+        int found = (a && pu_strmap_contains(pkgset, a->target));
         pu_log_action_free(a);
         if (found) {
           print_entry(stdout, e);
@@ -466,11 +497,13 @@ int main(int argc, char **argv) {
   }
 
 cleanup:
+  pu_strmap_free(pkgset, NULL);
+  pu_strmap_free(callerset, NULL);
   FREELIST(pkgs);
   FREELIST(actions);
   FREELIST(caller);
-  alpm_list_free_inner(entries, (alpm_list_fn_free) pu_log_entry_free);
   alpm_list_free(entries);
+  pu_arena_free(arena);
   alpm_list_free_inner(grep, (alpm_list_fn_free) regfree);
   FREELIST(grep);
   free(logfile);
@@ -214,132 +214,276 @@ void free_pkg(alpm_pkg_t *p) {
   alpm_pkg_free(p);
 }
 
-alpm_list_t *load_cache_pkgs(alpm_handle_t *handle) {
-  alpm_list_t *i, *cache_pkgs = NULL;
-  puts("Loading cache packages...");
+/* Cache files indexed by the name and version parsed from their file names,
+ * so that only the candidates for each target need to be loaded.  Entries
+ * with the same name and version are chained together, the architecture is
+ * checked against each one. */
+struct cache_file {
+  char *path;
+  pu_pkgfile_t pf;
+  uint32_t hash;
+  size_t seq; /* position in the cache directories */
+  struct cache_file *next;
+};
+
+struct cache_index {
+  struct cache_file **buckets;
+  size_t mask, count;
+};
+
+static uint32_t cache_hash(const char *name, size_t namelen,
+    const char *ver, size_t verlen) {
+  uint32_t h = 2166136261u;
+  while (namelen--) {
+    h ^= (unsigned char) *name++;
+    h *= 16777619u;
+  }
+  h ^= '-';
+  h *= 16777619u;
+  while (verlen--) {
+    h ^= (unsigned char) *ver++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+void cache_index_free(struct cache_index *idx) {
+  size_t i;
+  for (i = 0; idx->buckets && i <= idx->mask; i++) {
+    struct cache_file *f = idx->buckets[i], *next;
+    for (; f; f = next) {
+      next = f->next;
+      free(f->path);
+      free(f);
+    }
+  }
+  free(idx->buckets);
+}
+
+static int cache_index_grow(struct cache_index *idx) {
+  size_t i, size = idx->buckets ? (idx->mask + 1) * 2 : 1024;
+  struct cache_file **buckets = calloc(size, sizeof(struct cache_file *));
+  if (buckets == NULL) { return -1; }
+  for (i = 0; idx->buckets && i <= idx->mask; i++) {
+    struct cache_file *f = idx->buckets[i], *next;
+    for (; f; f = next) {
+      next = f->next;
+      f->next = buckets[f->hash & (size - 1)];
+      buckets[f->hash & (size - 1)] = f;
+    }
+  }
+  free(idx->buckets);
+  idx->buckets = buckets;
+  idx->mask = size - 1;
+  return 0;
+}
+
+static int cache_index_add(struct cache_index *idx, const char *dir,
+    const char *name) {
+  struct cache_file *f;
+  size_t dirlen = strlen(dir);
+
+  if ((idx->buckets == NULL || idx->count > idx->mask)
+      && cache_index_grow(idx) != 0) {
+    return -1;
+  }
+  if ((f = calloc(1, sizeof(struct cache_file))) == NULL) { return -1; }
+  if ((f->path = pu_asprintf("%s%s%s", dir,
+            dirlen && dir[dirlen - 1] == '/' ? "" : "/", name)) == NULL) {
+    free(f);
+    return -1;
+  }
+  pu_pkgfile_parse(f->path + strlen(f->path) - strlen(name), &f->pf);
+  f->hash = cache_hash(f->pf.name, f->pf.namelen,
+      f->pf.version, f->pf.versionlen);
+  f->seq = idx->count;
+  f->next = idx->buckets[f->hash & idx->mask];
+  idx->buckets[f->hash & idx->mask] = f;
+  idx->count++;
+  return 0;
+}
+
+/* reads the file names in each cache directory without opening them */
+int load_cache_index(alpm_handle_t *handle, struct cache_index *idx) {
+  alpm_list_t *i;
+  puts("Indexing cache packages...");
   for (i = alpm_option_get_cachedirs(handle); i; i = i->next) {
     const char *path = i->data;
-    DIR *dir = opendir(path);
     struct dirent *entry;
-    if (!dir) {
-      pu_ui_warn("could not open cache dir '%s' (%s)", path, strerror(errno));
+    DIR *dir;
+    if ((dir = opendir(path)) == NULL) {
+      pu_ui_warn("could not read cache dir '%s' (%s)", path, strerror(errno));
       continue;
     }
-    errno = 0;
     while ((entry = readdir(dir))) {
-      size_t path_len;
-      char *filename, *name = entry->d_name;
-      alpm_pkg_t *pkg = NULL;
-
-      if (strcmp(".", name) == 0 || strcmp("..", name) == 0) {
+      pu_pkgfile_t pf;
+      if (entry->d_type != DT_REG && entry->d_type != DT_LNK
+          && entry->d_type != DT_UNKNOWN) {
         continue;
       }
-      if (strlen(name) >= 4 && strcmp(name + strlen(name) - 4, ".sig") == 0) {
+      if (pu_pkgfile_parse(entry->d_name, &pf) != 0 || pf.sig) {
         continue;
       }
-
-      path_len = strlen(path) + strlen(name);
-      filename = malloc(path_len + 1);
-      sprintf(filename, "%s%s", path, entry->d_name);
-      if (alpm_pkg_load(handle, filename, 1, 0, &pkg) == 0) {
-        alpm_list_append(&cache_pkgs, pkg);
-      } else {
-        pu_ui_warn("could not load package '%s' (%s)",
-            filename, alpm_strerror(alpm_errno(handle)));
+      if (cache_index_add(idx, path, entry->d_name) != 0) {
+        pu_ui_error("%s", strerror(errno));
+        closedir(dir);
+        return -1;
       }
-      free(filename);
-    }
-    if (errno != 0) {
-      pu_ui_warn("could not read cache dir '%s' (%s)", path, strerror(errno));
     }
     closedir(dir);
   }
-  return cache_pkgs;
+  return 0;
+}
+
+static int pkgfile_field_eq(const char *field, size_t len, const char *str) {
+  return str && strncmp(field, str, len) == 0 && str[len] == '\0';
+}
+
+/* architecture rules shared by file names and loaded packages */
+int cache_arch_ok(alpm_pkg_t *pkg, const char *arch, size_t archlen) {
+  alpm_list_t *allowed_arch = alpm_option_get_architectures(handle), *i;
+  const char *want = alpm_pkg_get_arch(pkg);
+  if (want) {
+    /* architecture must match */
+    return arch != NULL && strlen(want) == archlen
+      && strncmp(want, arch, archlen) == 0;
+  } else if (arch == NULL || allowed_arch == NULL
+      || (archlen == 3 && strncmp(arch, "any", 3) == 0)) {
+    return 1;
+  }
+  /* needle has no architecture, package must be installable */
+  for (i = allowed_arch; i; i = i->next) {
+    if (strlen(i->data) == archlen && strncmp(i->data, arch, archlen) == 0) {
+      return 1;
+    }
+  }
+  return 0;
 }
 
-alpm_list_t *find_cached_pkg(alpm_pkg_t *pkg, alpm_list_t *cache_pkgs) {
+static int cache_file_cmp(const void *p1, const void *p2) {
+  const struct cache_file *f1 = p1, *f2 = p2;
+  return f1->seq < f2->seq ? -1 : f1->seq > f2->seq;
+}
+
+/* files whose name, version and architecture could match pkg, in cache
+ * directory order */
+alpm_list_t *find_cache_candidates(struct cache_index *idx, alpm_pkg_t *pkg) {
   const char *name = alpm_pkg_get_name(pkg), *ver = alpm_pkg_get_version(pkg);
-  alpm_list_t *i, *found = NULL;
-  alpm_list_t *allowed_arch = alpm_option_get_architectures(handle);
-  for (i = cache_pkgs; i; i = i->next) {
-    if (strcmp(name, alpm_pkg_get_name(i->data)) != 0
-        || strcmp(ver, alpm_pkg_get_version(i->data)) != 0) {
-      /* name/version don't match */
-      continue;
-    } else if (alpm_pkg_get_arch(pkg)
-        && strcmp(alpm_pkg_get_arch(pkg), alpm_pkg_get_arch(i->data)) != 0) {
-      /* architecture doesn't match */
-      continue;
-    } else if (alpm_pkg_get_arch(pkg) == NULL
-        && alpm_pkg_get_arch(i->data) != NULL
-        && allowed_arch
-        && !alpm_list_find_str(allowed_arch, alpm_pkg_get_arch(i->data))
-        && strcmp(alpm_pkg_get_arch(i->data), "any") != 0) {
-      /* needle has no architecture and package is not installable */
-      continue;
-    } else if (alpm_list_append(&found, i) == NULL) {
-      /* package matched but we ran out of memory */
+  uint32_t hash = cache_hash(name, strlen(name), ver, strlen(ver));
+  struct cache_file *f;
+  alpm_list_t *found = NULL;
+  for (f = idx->buckets ? idx->buckets[hash & idx->mask] : NULL; f; f = f->next) {
+    if (f->hash == hash
+        && pkgfile_field_eq(f->pf.name, f->pf.namelen, name)
+        && pkgfile_field_eq(f->pf.version, f->pf.versionlen, ver)
+        && cache_arch_ok(pkg, f->pf.arch, f->pf.archlen)
+        && alpm_list_append(&found, f) == NULL) {
       pu_ui_error("%s", strerror(errno));
       alpm_list_free(found);
       return NULL;
     }
   }
-  switch (alpm_list_count(found)) {
-    case 0:
-      pu_ui_warn("unable to locate cached package for '%s-%s'", name, ver);
-      return NULL;
-    case 1:
-      i = found->data;
-      alpm_list_free(found);
-      return i;
-    default:
-      pu_ui_warn("multiple packages found for '%s-%s'", name, ver);
-      for (i = found; i; i = i->next) {
-        alpm_list_t *j = i->data;
-        fprintf(stderr, "  %s\n", alpm_pkg_get_filename(j->data));
-      }
-      alpm_list_free(found);
-      return NULL;
-  }
+  return alpm_list_msort(found, alpm_list_count(found), cache_file_cmp);
 }
 
-void _pu_list_append_item(alpm_list_t **list, alpm_list_t *item) {
-  item->next = NULL;
-
-  /* Special case: the input list is empty */
-  if (*list == NULL) {
-    *list = item;
-    item->prev = item;
-  } else {
-    alpm_list_t *lp = alpm_list_last(*list);
-    lp->next = item;
-    item->prev = lp;
-    (*list)->prev = item;
-  }
+/* checks a loaded candidate's metadata; the file name may not be accurate */
+int cached_pkg_matches(alpm_pkg_t *pkg, alpm_pkg_t *cpkg) {
+  const char *arch = alpm_pkg_get_arch(cpkg);
+  return strcmp(alpm_pkg_get_name(pkg), alpm_pkg_get_name(cpkg)) == 0
+    && strcmp(alpm_pkg_get_version(pkg), alpm_pkg_get_version(cpkg)) == 0
+    && cache_arch_ok(pkg, arch, arch ? strlen(arch) : 0);
 }
 
 alpm_list_t *find_cached_pkgs(alpm_handle_t *handle, alpm_list_t *pkgnames) {
-  alpm_list_t *i, *packages = NULL, *cache_files = load_cache_pkgs(handle);
+  struct cache_index idx = { .buckets = NULL };
+  alpm_list_t *i, *packages = NULL, **candidates;
+  pu_pkg_load_t *loads = NULL;
+  size_t n, t, npkgs = alpm_list_count(pkgnames), count = 0;
   int error = 0;
 
-  if (cache_files == NULL) {
+  if (load_cache_index(handle, &idx) != 0) {
+    cache_index_free(&idx);
+    return NULL;
+  } else if (idx.count == 0) {
     pu_ui_error("no cached packages found");
+    cache_index_free(&idx);
     return NULL;
   }
 
-  for (i = pkgnames; i; i = i->next) {
-    alpm_list_t *match = find_cached_pkg(i->data, cache_files);
-    if (match == NULL) {
+  if ((candidates = calloc(npkgs, sizeof(alpm_list_t *))) == NULL) {
+    pu_ui_error("%s", strerror(errno));
+    cache_index_free(&idx);
+    return NULL;
+  }
+
+  for (i = pkgnames, t = 0; i; i = i->next, t++) {
+    candidates[t] = find_cache_candidates(&idx, i->data);
+    count += alpm_list_count(candidates[t]);
+  }
+
+  /* only the candidates are loaded */
+  if (count && (loads = calloc(count, sizeof(pu_pkg_load_t))) == NULL) {
+    pu_ui_error("%s", strerror(errno));
+    error = 1;
+    goto cleanup;
+  }
+  for (t = 0, n = 0; t < npkgs; t++) {
+    for (i = candidates[t]; i; i = i->next) {
+      struct cache_file *f = i->data;
+      loads[n++].path = f->path;
+    }
+  }
+  pu_pkg_load_many(handle, loads, count, 1);
+
+  for (i = pkgnames, t = 0, n = 0; i; i = i->next, t++) {
+    const char *name = alpm_pkg_get_name(i->data);
+    const char *ver = alpm_pkg_get_version(i->data);
+    size_t first = n, c, nfound = 0;
+    alpm_pkg_t *match = NULL;
+
+    for (c = alpm_list_count(candidates[t]); c; c--, n++) {
+      if (loads[n].pkg == NULL) {
+        pu_ui_warn("could not load package '%s' (%s)",
+            loads[n].path, alpm_strerror(loads[n].error));
+      } else if (cached_pkg_matches(i->data, loads[n].pkg)) {
+        match = loads[n].pkg;
+        nfound++;
+      }
+    }
+
+    if (nfound == 0) {
+      pu_ui_warn("unable to locate cached package for '%s-%s'", name, ver);
+      error = 1;
+    } else if (nfound > 1) {
+      pu_ui_warn("multiple packages found for '%s-%s'", name, ver);
+      for (c = first; c < n; c++) {
+        if (loads[c].pkg && cached_pkg_matches(i->data, loads[c].pkg)) {
+          fprintf(stderr, "  %s\n", loads[c].path);
+        }
+      }
+      error = 1;
+    } else if (alpm_list_append(&packages, match) == NULL) {
+      pu_ui_error("%s", strerror(errno));
       error = 1;
-      continue;
     } else {
-      cache_files = alpm_list_remove_item(cache_files, match);
-      _pu_list_append_item(&packages, match);
+      /* keep the matching package */
+      for (c = first; c < n; c++) {
+        if (loads[c].pkg == match) { loads[c].pkg = NULL; }
+      }
     }
   }
 
-  alpm_list_free_inner(cache_files, (alpm_list_fn_free) free_pkg);
-  alpm_list_free(cache_files);
+cleanup:
+  for (n = 0; loads && n < count; n++) {
+    if (loads[n].pkg) { alpm_pkg_free(loads[n].pkg); }
+  }
+  free(loads);
+  for (t = 0; t < npkgs; t++) {
+    alpm_list_free(candidates[t]);
+  }
+  free(candidates);
+  cache_index_free(&idx);
+
   if (!error) {
     return packages;
   } else {
@@ -24,7 +24,7 @@
 #include <errno.h>
 #include <getopt.h>
 #include <grp.h>
-#include <libgen.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <pwd.h>
 #include <stdio.h>
@@ -41,6 +41,7 @@ enum longopt_flags {
   FLAG_CONFIG = 1000,
   FLAG_DBPATH,
   FLAG_HELP,
+  FLAG_JOBS,
   FLAG_PACKAGE,
   FLAG_ROOT,
   FLAG_SYSROOT,
@@ -51,7 +52,7 @@ pu_config_t *config = NULL;
 alpm_handle_t *handle = NULL;
 alpm_list_t *packages = NULL;
 int _fix_gid = 0, _fix_mode = 0, _fix_mtime = 0, _fix_uid = 0;
-int verbose = 1;
+int verbose = 1, jobs = 1;
 const char *sysroot = NULL;
 
 #define ASSERT(x) \
@@ -69,6 +70,7 @@ void usage(int ret) {
   hputs("   --root=<path>      set an alternate installation root");
   hputs("   --sysroot=<path>   set an alternate system root");
   hputs("   --quiet            do not display progress information");
+  hputs("   --jobs=<n>         repair files using <n> threads (0 for one per CPU)");
   hputs("   --help             display this help information");
   hputs("   --version          display version information");
   hputs("");
@@ -94,6 +96,7 @@ pu_config_t *parse_opts(int argc, char **argv) {
     { "sysroot", required_argument, NULL, FLAG_SYSROOT      },
 
     { "quiet", no_argument, &verbose, 0                 },
+    { "jobs", required_argument, NULL, FLAG_JOBS         },
 
     { "help", no_argument, NULL, FLAG_HELP         },
     { "version", no_argument, NULL, FLAG_VERSION      },
@@ -145,6 +148,18 @@ pu_config_t *parse_opts(int argc, char **argv) {
       case FLAG_PACKAGE:
         ASSERT(alpm_list_append(&packages, optarg));
         break;
+      case FLAG_JOBS:
+        {
+          char *end;
+          long n = strtol(optarg, &end, 10);
+          if (*optarg == '\0' || *end != '\0' || n < INT_MIN || n > INT_MAX) {
+            pu_ui_error("invalid job count '%s'", optarg);
+            pu_config_free(config);
+            return NULL;
+          }
+          jobs = n;
+        }
+        break;
 
       case '?':
       default:
@@ -175,171 +190,342 @@ int _fchmodat(int fd, const char *path, mode_t mode, int flag) {
   return ret;
 }
 
-int fix_mode(const char *path, struct archive_entry *entry) {
-  mode_t m = archive_entry_perm(entry);
-  if (_fchmodat(AT_FDCWD, path, m, AT_SYMLINK_NOFOLLOW) != 0) {
-    pu_ui_warn("%s: unable to set permissions (%s)", path, strerror(errno));
-    return 1;
-  } else if (verbose) {
-    printf("%s: set permissions to %o\n", path, m);
-  }
-  return 0;
-}
+enum fix_field {
+  FIX_UID,
+  FIX_GID,
+  FIX_MODE,
+  FIX_MTIME,
+  FIX_COUNT,
+};
 
-int fix_mtime(const char *path, struct archive_entry *entry) {
-  time_t t = archive_entry_mtime(entry);
-  struct timespec times[2] = { { 0, UTIME_OMIT }, { t, 0 } };
+/* A resolved input path.  Fixes are applied relative to a descriptor for
+ * the containing directory, results are stored so that they can be reported
+ * in input order regardless of --jobs. */
+struct target {
+  const char *input;
+  char *path;
+  size_t dirlen; /* length of the containing directory, 0 for the root */
+  pu_mtree_t *mtree;
+  int err[FIX_COUNT];
+};
 
-  if (utimensat(AT_FDCWD, path, times, AT_SYMLINK_NOFOLLOW) != 0) {
-    pu_ui_warn("%s: unable to set modification time (%s)",
-        path, strerror(errno));
-    return 1;
-  } else if (verbose) {
-    printf("%s: set modification time to %zu\n", path, t);
+/* one package owning a target */
+struct owner {
+  size_t target, pkgidx;
+  alpm_pkg_t *pkg;
+  alpm_file_t *file;
+};
+
+struct repair {
+  struct target *targets;
+  size_t ntargets;
+  struct owner *owners;
+  size_t nowners;
+  struct target **bydir; /* targets with mtree data, grouped by directory */
+  size_t nbydir;
+  size_t *groups; /* start of each directory group in bydir */
+  size_t ngroups;
+};
+
+int fix_enabled(enum fix_field f) {
+  switch (f) {
+    case FIX_UID: return _fix_uid;
+    case FIX_GID: return _fix_gid;
+    case FIX_MODE: return _fix_mode;
+    case FIX_MTIME: return _fix_mtime;
+    default: return 0;
   }
+}
 
-  return 0;
+int fix_mode(int dirfd, const char *name, pu_mtree_t *m) {
+  return _fchmodat(dirfd, name, m->mode & 07777, AT_SYMLINK_NOFOLLOW);
 }
 
-int fix_uid(const char *path, struct archive_entry *entry) {
-  uid_t u = archive_entry_uid(entry);
-  if (fchownat(AT_FDCWD, path, u, -1, AT_SYMLINK_NOFOLLOW) != 0) {
-    pu_ui_warn("%s: unable to set uid (%s)", path, strerror(errno));
-    return 1;
-  } else if (verbose) {
-    printf("%s: set uid to %u\n", path, u);
-  }
+int fix_mtime(int dirfd, const char *name, pu_mtree_t *m) {
+  struct timespec times[2] = { { 0, UTIME_OMIT }, { m->mtime, 0 } };
+  return utimensat(dirfd, name, times, AT_SYMLINK_NOFOLLOW);
+}
 
-  return 0;
+int fix_uid(int dirfd, const char *name, pu_mtree_t *m) {
+  return fchownat(dirfd, name, m->uid, -1, AT_SYMLINK_NOFOLLOW);
 }
 
-int fix_gid(const char *path, struct archive_entry *entry) {
-  gid_t g = archive_entry_gid(entry);
-  if (fchownat(AT_FDCWD, path, -1, g, AT_SYMLINK_NOFOLLOW) != 0) {
-    pu_ui_warn("%s: unable to set gid (%s)", path, strerror(errno));
-    return 1;
-  } else if (verbose) {
-    printf("%s: set gid to %u\n", path, g);
-  }
+int fix_gid(int dirfd, const char *name, pu_mtree_t *m) {
+  return fchownat(dirfd, name, -1, m->gid, AT_SYMLINK_NOFOLLOW);
+}
 
-  return 0;
+int report_fix(struct target *t, enum fix_field f) {
+  const char *path = t->path;
+  pu_mtree_t *m = t->mtree;
+  int err = t->err[f];
+
+  switch (f) {
+    case FIX_UID:
+      if (err) {
+        pu_ui_warn("%s: unable to set uid (%s)", path, strerror(err));
+      } else if (verbose) {
+        printf("%s: set uid to %u\n", path, m->uid);
+      }
+      break;
+    case FIX_GID:
+      if (err) {
+        pu_ui_warn("%s: unable to set gid (%s)", path, strerror(err));
+      } else if (verbose) {
+        printf("%s: set gid to %u\n", path, m->gid);
+      }
+      break;
+    case FIX_MODE:
+      if (err) {
+        pu_ui_warn("%s: unable to set permissions (%s)", path, strerror(err));
+      } else if (verbose) {
+        printf("%s: set permissions to %o\n", path, m->mode & 07777);
+      }
+      break;
+    case FIX_MTIME:
+      if (err) {
+        pu_ui_warn("%s: unable to set modification time (%s)",
+            path, strerror(err));
+      } else if (verbose) {
+        printf("%s: set modification time to %jd\n", path, (intmax_t) m->mtime);
+      }
+      break;
+    default:
+      break;
+  }
+  return err ? 1 : 0;
 }
 
-char *lrealpath(const char *path, char *resolved_path) {
-  /* copy path because dirname and basename do funky things */
-  char *p = strdup(path);
-  char *p2 = strdup(path);
-  const char *bname = basename(p2), *dname = dirname(p);
-  int alloc_path = (resolved_path == NULL);
+/* resolves everything but the final component of path so that symlinks
+ * themselves can be repaired; resolved must hold PATH_MAX bytes */
+char *lrealpath(const char *path, char *resolved) {
+  char buf[PATH_MAX];
+  const char *dname, *bname;
+  size_t len = strlen(path), rlen, blen;
+  char *slash;
+
+  if (len == 0 || len >= PATH_MAX) {
+    errno = len ? ENAMETOOLONG : ENOENT;
+    return NULL;
+  }
+  memcpy(buf, path, len + 1);
+  while (len > 1 && buf[len - 1] == '/') { buf[--len] = '\0'; }
+
+  if ((slash = strrchr(buf, '/')) == NULL) {
+    dname = ".";
+    bname = buf;
+  } else if (slash == buf) {
+    dname = "/";
+    bname = buf + 1;
+  } else {
+    *slash = '\0';
+    dname = buf;
+    bname = slash + 1;
+  }
 
   /* handle a few special cases of bname
    * that require resolving the entire path */
-  if (strcmp(bname, "..") == 0
-      || strcmp(bname, ".") == 0
-      || strcmp(bname, "/") == 0) {
-    dname = path;
-    bname = NULL;
+  if (strcmp(bname, "..") == 0 || strcmp(bname, ".") == 0 || *bname == '\0') {
+    return realpath(path, resolved);
   }
 
-  if ((resolved_path = realpath(dname, resolved_path)) == NULL) {
-    free(p);
-    free(p2);
+  if (realpath(dname, resolved) == NULL) {
     return NULL;
   }
 
-  /* add bname back if we have a valid one */
-  if (bname) {
-    size_t rlen = strlen(resolved_path), blen = strlen(bname);
-    if (alloc_path) {
-      if (rlen + blen + 2 <= rlen) {
-        errno = ENAMETOOLONG;
-        free(p);
-        free(p2);
-        return NULL;
-      } else {
-        char *newp = realloc(resolved_path, rlen + blen + 2);
-        if (newp == NULL) {
-          errno = ENOMEM;
-          free(p);
-          free(p2);
-          return NULL;
-        }
-        resolved_path = newp;
-      }
-    } else {
-      /* error out if resolved_path is too long to append bname */
-      if ((rlen + blen + 2) >= PATH_MAX) {
-        errno = ENAMETOOLONG;
-        free(p);
-        free(p2);
-        return NULL;
-      }
-    }
-    if (resolved_path[rlen - 1] != '/') { strcpy(resolved_path + rlen++, "/"); }
-    strcpy(resolved_path + rlen, bname);
+  /* add bname back */
+  rlen = strlen(resolved);
+  blen = strlen(bname);
+  if (rlen + blen + 2 >= PATH_MAX) {
+    errno = ENAMETOOLONG;
+    return NULL;
   }
+  if (resolved[rlen - 1] != '/') { resolved[rlen++] = '/'; }
+  memcpy(resolved + rlen, bname, blen + 1);
 
-  free(p);
-  free(p2);
-  return resolved_path;
+  return resolved;
 }
 
-int fix_file(const char *file) {
-  alpm_list_t *i;
-  char *rpath = lrealpath(file, NULL);
+/* resolves file and finds its owners, returns 1 on error */
+int resolve_file(struct repair *r, const char *file) {
+  struct target *t = &r->targets[r->ntargets];
   const char *root = alpm_option_get_root(handle);
-  size_t rootlen = strlen(root);
+  size_t rootlen = strlen(root), pkgidx = 0;
+  char rpath[PATH_MAX], *c;
+  alpm_list_t *i;
+  int found = 0;
 
-  if (rpath == NULL) {
+  if (lrealpath(file, rpath) == NULL) {
     pu_ui_error("%s: unable to resolve path (%s)", file, strerror(errno));
     return 1;
   }
 
   if (strncmp(rpath, root, rootlen) != 0) {
-    pu_ui_error("%s: file not owned");
-    free(rpath);
+    pu_ui_error("%s: file not owned", file);
     return 1;
   }
 
   if (access(rpath, W_OK)) {
     pu_ui_error("%s: %s", rpath, strerror(errno));
-    free(rpath);
     return 1;
   }
 
-  for (i = packages; i; i = alpm_list_next(i)) {
-    alpm_filelist_t *filelist = alpm_pkg_get_files(i->data);
-    if (pu_filelist_contains_path(filelist, rpath + rootlen)) {
-      struct archive *mtree = alpm_pkg_mtree_open(i->data);
-      if (mtree) {
-        struct archive_entry *entry;
-        while (alpm_pkg_mtree_next(i->data, mtree, &entry) == ARCHIVE_OK) {
-          int ret = 0;
-          const char *ppath = archive_entry_pathname(entry);
-          if (strncmp("./", ppath, 2) == 0) { ppath += 2; }
+  for (i = packages; i; i = alpm_list_next(i), pkgidx++) {
+    alpm_file_t *pfile = pu_filelist_contains_path(
+            alpm_pkg_get_files(i->data), rpath + rootlen);
+    if (pfile) {
+      struct owner *o;
+      ASSERT(o = realloc(r->owners, (r->nowners + 1) * sizeof(*o)));
+      r->owners = o;
+      o += r->nowners++;
+      o->target = r->ntargets;
+      o->pkgidx = pkgidx;
+      o->pkg = i->data;
+      o->file = pfile;
+      found = 1;
+    }
+  }
+  if (!found) {
+    pu_ui_error("%s: could not find package", file);
+    return 1;
+  }
+
+  memset(t, 0, sizeof(*t));
+  t->input = file;
+  ASSERT(t->path = strdup(rpath));
+  c = strrchr(t->path, '/');
+  t->dirlen = c - t->path;
+  r->ntargets++;
+  return 0;
+}
+
+/* owners grouped by package, in file list order within each package */
+static int owner_cmp(const void *p1, const void *p2) {
+  const struct owner *o1 = p1, *o2 = p2;
+  if (o1->pkgidx != o2->pkgidx) {
+    return o1->pkgidx < o2->pkgidx ? -1 : 1;
+  } else if (o1->file != o2->file) {
+    return o1->file < o2->file ? -1 : 1;
+  }
+  return o1->target < o2->target ? -1 : o1->target > o2->target;
+}
 
-          if (pu_pathcmp(rpath + rootlen, ppath) != 0) { continue; }
+static pu_mtree_t *mtree_dup(pu_mtree_t *m) {
+  pu_mtree_t *dup = pu_mtree_new();
+  if (dup == NULL) {
+    return NULL;
+  }
+  memcpy(dup, m, sizeof(pu_mtree_t));
+  dup->path = strdup(m->path);
+  dup->link = m->link ? strdup(m->link) : NULL;
+  if (dup->path == NULL || (m->link && dup->link == NULL)) {
+    pu_mtree_free(dup);
+    return NULL;
+  }
+  return dup;
+}
 
-          if (_fix_uid && fix_uid(rpath, entry) != 0) { ret = 1; }
-          if (_fix_gid && fix_gid(rpath, entry) != 0) { ret = 1; }
-          if (_fix_mode && fix_mode(rpath, entry) != 0) { ret = 1; }
-          if (_fix_mtime && fix_mtime(rpath, entry) != 0) { ret = 1; }
+/* reads one package's mtree for the count owners starting at group; a
+ * target takes its properties from the first package that has them */
+void load_mtree(struct repair *r, struct owner *group, size_t count) {
+  alpm_filelist_t *files = alpm_pkg_get_files(group->pkg);
+  pu_mtree_reader_t *reader;
+  pu_mtree_t entry, *m;
+  pu_arena_t *arena;
 
-          alpm_pkg_mtree_close(i->data, mtree);
-          free(rpath);
-          return ret;
-        }
-        alpm_pkg_mtree_close(i->data, mtree);
+  if ((reader = pu_mtree_reader_open_package(handle, group->pkg)) == NULL) {
+    return;
+  }
+  /* wanted entries are copied out, the arena is recycled for each line */
+  ASSERT(arena = pu_arena_new(0));
+  reader->arena = arena;
+  for (; (m = pu_mtree_reader_next(reader, &entry)); pu_arena_reset(arena)) {
+    alpm_file_t *file = pu_filelist_contains_path(files, m->path);
+    size_t lo = 0, hi = count;
+    if (file == NULL) {
+      continue;
+    }
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (group[mid].file < file) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    for (; lo < count && group[lo].file == file; lo++) {
+      struct target *t = &r->targets[group[lo].target];
+      if (t->mtree == NULL) {
+        ASSERT(t->mtree = mtree_dup(m));
       }
     }
   }
+  if (!reader->eof) {
+    pu_ui_warn("%s: error reading mtree data (%s)",
+        alpm_pkg_get_name(group->pkg), strerror(errno));
+  }
+  pu_mtree_reader_free(reader);
+  pu_arena_free(arena);
+}
 
-  pu_ui_error("%s: could not find package", file);
-  free(rpath);
-  return 1;
+static int target_dir_cmp(const void *p1, const void *p2) {
+  const struct target *t1 = *(struct target **) p1;
+  const struct target *t2 = *(struct target **) p2;
+  size_t len = t1->dirlen < t2->dirlen ? t1->dirlen : t2->dirlen;
+  int ret = memcmp(t1->path, t2->path, len);
+  if (ret == 0 && t1->dirlen != t2->dirlen) {
+    ret = t1->dirlen < t2->dirlen ? -1 : 1;
+  }
+  return ret ? ret : (t1 < t2 ? -1 : t1 > t2);
+}
+
+/* applies the requested fixes to every target in one directory */
+void repair_dir(void *ctx, size_t g) {
+  struct repair *r = ctx;
+  size_t i = r->groups[g], end = g + 1 < r->ngroups ? r->groups[g + 1] : r->nbydir;
+  struct target *first = r->bydir[i];
+  char dir[PATH_MAX];
+  int dirfd;
+
+  if (first->dirlen == 0) {
+    strcpy(dir, "/");
+  } else {
+    memcpy(dir, first->path, first->dirlen);
+    dir[first->dirlen] = '\0';
+  }
+
+  if ((dirfd = open(dir, O_RDONLY | O_DIRECTORY)) == -1) {
+    int err = errno;
+    for (; i < end; i++) {
+      struct target *t = r->bydir[i];
+      for (int f = 0; f < FIX_COUNT; f++) { t->err[f] = err; }
+    }
+    return;
+  }
+
+  for (; i < end; i++) {
+    struct target *t = r->bydir[i];
+    const char *name = t->path + t->dirlen + 1;
+    if (_fix_uid && fix_uid(dirfd, name, t->mtree) != 0) {
+      t->err[FIX_UID] = errno;
+    }
+    if (_fix_gid && fix_gid(dirfd, name, t->mtree) != 0) {
+      t->err[FIX_GID] = errno;
+    }
+    if (_fix_mode && fix_mode(dirfd, name, t->mtree) != 0) {
+      t->err[FIX_MODE] = errno;
+    }
+    if (_fix_mtime && fix_mtime(dirfd, name, t->mtree) != 0) {
+      t->err[FIX_MTIME] = errno;
+    }
+  }
+
+  close(dirfd);
 }
 
 int main(int argc, char **argv) {
+  struct repair r = { .targets = NULL };
+  alpm_list_t *inputs = NULL, *in;
+  size_t i, ninputs;
   int ret = 0;
 
   if (!(config = parse_opts(argc, argv))) {
@@ -378,7 +564,7 @@ int main(int argc, char **argv) {
   }
 
   while (optind < argc) {
-    if (fix_file(argv[optind++]) != 0 ) { ret = 1; }
+    ASSERT(alpm_list_append_strdup(&inputs, argv[optind++]));
   }
   if (!isatty(fileno(stdin)) && errno != EBADF) {
     char *buf = NULL;
@@ -386,7 +572,7 @@ int main(int argc, char **argv) {
     ssize_t len;
     while ((len = getline(&buf, &blen, stdin)) != -1) {
       if (buf[len - 1] == '\n') { buf[len - 1] = '\0'; }
-      if (fix_file(buf) != 0) { ret = 1; }
+      ASSERT(alpm_list_append_strdup(&inputs, buf));
     }
     if (!feof(stdin)) {
       pu_ui_error("unable to read from stdin (%s)", strerror(errno));
@@ -395,7 +581,68 @@ int main(int argc, char **argv) {
     free(buf);
   }
 
+  /* resolve every path and find its owners */
+  ninputs = alpm_list_count(inputs);
+  if (ninputs) {
+    ASSERT(r.targets = calloc(ninputs, sizeof(struct target)));
+  }
+  for (in = inputs; in; in = in->next) {
+    if (resolve_file(&r, in->data) != 0) { ret = 1; }
+  }
+
+  /* read each owning package's mtree once */
+  qsort(r.owners, r.nowners, sizeof(struct owner), owner_cmp);
+  for (i = 0; i < r.nowners; ) {
+    size_t end = i + 1;
+    while (end < r.nowners && r.owners[end].pkgidx == r.owners[i].pkgidx) {
+      end++;
+    }
+    load_mtree(&r, r.owners + i, end - i);
+    i = end;
+  }
+
+  /* group targets by directory so each is only opened once */
+  if (r.ntargets) {
+    ASSERT(r.bydir = malloc(r.ntargets * sizeof(struct target *)));
+    ASSERT(r.groups = malloc(r.ntargets * sizeof(size_t)));
+  }
+  for (i = 0; i < r.ntargets; i++) {
+    if (r.targets[i].mtree) {
+      r.bydir[r.nbydir++] = &r.targets[i];
+    }
+  }
+  qsort(r.bydir, r.nbydir, sizeof(struct target *), target_dir_cmp);
+  for (i = 0; i < r.nbydir; i++) {
+    if (i == 0 || r.bydir[i]->dirlen != r.bydir[i - 1]->dirlen
+        || memcmp(r.bydir[i]->path, r.bydir[i - 1]->path,
+            r.bydir[i]->dirlen) != 0) {
+      r.groups[r.ngroups++] = i;
+    }
+  }
+  pu_parallel_for(r.ngroups, jobs, repair_dir, &r);
+
+  for (i = 0; i < r.ntargets; i++) {
+    struct target *t = &r.targets[i];
+    if (t->mtree == NULL) {
+      pu_ui_error("%s: could not find package", t->input);
+      ret = 1;
+      continue;
+    }
+    for (int f = 0; f < FIX_COUNT; f++) {
+      if (fix_enabled(f) && report_fix(t, f) != 0) { ret = 1; }
+    }
+  }
+
 cleanup:
+  for (i = 0; i < r.ntargets; i++) {
+    free(r.targets[i].path);
+    pu_mtree_free(r.targets[i].mtree);
+  }
+  free(r.targets);
+  free(r.owners);
+  free(r.bydir);
+  free(r.groups);
+  FREELIST(inputs);
   alpm_list_free(packages);
   alpm_release(handle);
   pu_config_free(config);
@@ -30,6 +30,9 @@
 #include <math.h>
 #include <fnmatch.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include <time.h>
 
 #include <pacutils.h>
 
@@ -41,27 +44,69 @@ const char *myname = "pacreport", *myver = BUILDVER;
 
 pu_config_t *config = NULL;
 alpm_handle_t *handle;
+pu_depgraph_t *depgraph = NULL;
 alpm_list_t *groups = NULL, *ignore = NULL, *pkg_ignore = NULL;
 int missing_files = 0, backup_files = 0, orphan_files = 0, optional_deps = 0;
+int cache_keep = -1;
+int incremental = 0, timings = 0;
+uint32_t ignore_hash = 2166136261u; /* FNV-1a of the compiled ignore rules */
 char *dbext = NULL;
 const char *sysroot = NULL;
 
 enum longopt_flags {
   FLAG_BACKUPS = 1000,
   FLAG_CACHEDIR,
+  FLAG_CACHE_KEEP,
   FLAG_CONFIG,
   FLAG_DBEXT,
   FLAG_DBPATH,
+  FLAG_FORMAT,
   FLAG_GROUP,
   FLAG_HELP,
+  FLAG_INCREMENTAL,
   FLAG_MISSING_FILES,
   FLAG_OPTIONAL_DEPS,
   FLAG_ORPHANS,
   FLAG_ROOT,
+  FLAG_SECTIONS,
   FLAG_SYSROOT,
+  FLAG_TIMINGS,
   FLAG_VERSION,
 };
 
+enum section_flags {
+  SECTION_UNOWNED = 1,
+  SECTION_BACKUPS = 2,
+  SECTION_UNNEEDED = 4,
+  SECTION_FOREIGN = 8,
+  SECTION_GROUPS = 16,
+  SECTION_MISSING = 32,
+  SECTION_CACHE = 64,
+};
+
+struct section_name {
+  const char *name;
+  int flag;
+} section_names[] = {
+  { "unowned-files", SECTION_UNOWNED  },
+  { "backups",       SECTION_BACKUPS  },
+  { "unneeded",      SECTION_UNNEEDED },
+  { "foreign",       SECTION_FOREIGN  },
+  { "groups",        SECTION_GROUPS   },
+  { "missing-files", SECTION_MISSING  },
+  { "cache",         SECTION_CACHE    },
+  { NULL, 0 },
+};
+
+int sections = SECTION_UNNEEDED | SECTION_FOREIGN | SECTION_CACHE;
+
+enum output_format {
+  FORMAT_TEXT,
+  FORMAT_JSON,
+};
+
+enum output_format format = FORMAT_TEXT;
+
 struct pkg_ignore_t {
   char *pkgname;
   char *ignore;
@@ -101,84 +146,99 @@ struct pkg_file_t *pkg_file_new(alpm_pkg_t *pkg, alpm_file_t *file) {
   return mf;
 }
 
-/**
- * @brief Calculates the total size of all unneeded dependencies of a package.
- *
- * @param handle
- * @param pkg
- * @param depchain list of already processed packages
- *
- * @return size in bytes
- */
-off_t get_pkg_chain_size(alpm_handle_t *handle, alpm_pkg_t *pkg) {
-  alpm_db_t *localdb = alpm_get_localdb(handle);
-  alpm_list_t *localpkgs = alpm_db_get_pkgcache(localdb);
-  alpm_list_t *depchain = alpm_list_add(NULL, pkg);
-  off_t size = 0;
-  alpm_list_t *d;
-
+/* Each section is printed as soon as it is complete; with --format=json
+ * that is one object per line holding the section's lists. */
+struct section_state {
+  const char *name;
+  struct timespec start;
+  size_t items;
+  int first; /* no list item printed yet */
+} section;
+
+void section_begin(const char *name) {
+  section.name = name;
+  section.items = 0;
+  clock_gettime(CLOCK_MONOTONIC, &section.start);
+  if (format == FORMAT_JSON) {
+    printf("{\"section\":\"%s\"", name);
+  }
+}
 
-  for (d = depchain; d; d = d->next) {
-    alpm_pkg_t *p = d->data;
-    alpm_list_t *dep, *deps = alpm_list_copy(alpm_pkg_get_depends(p));
-    alpm_list_t *r, *rb;
+void section_end(void) {
+  struct timespec end;
+  if (format == FORMAT_JSON) {
+    puts("}");
+  }
+  fflush(stdout);
+  if (timings) {
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fprintf(stderr, "%s: %.3fs, %zu items\n", section.name,
+        (end.tv_sec - section.start.tv_sec)
+        + (end.tv_nsec - section.start.tv_nsec) / 1e9, section.items);
+  }
+}
 
-    if (optional_deps) {
-      deps = alpm_list_join(deps, alpm_list_copy(alpm_pkg_get_optdepends(p)));
+/* control characters are escaped, anything else is passed through as-is */
+void json_string(const char *str) {
+  putchar('"');
+  for (; *str; str++) {
+    unsigned char c = *str;
+    if (c == '"' || c == '\\') {
+      putchar('\\');
+      putchar(c);
+    } else if (c < 0x20) {
+      printf("\\u%04x", c);
+    } else {
+      putchar(c);
     }
+  }
+  putchar('"');
+}
 
-    size += alpm_pkg_get_isize(p);
+/* starts a list within the current section or object, key may be NULL for a
+ * list nested directly in another */
+void json_list_begin(const char *key) {
+  if (key) {
+    printf(",\"%s\":", key);
+  }
+  putchar('[');
+  section.first = 1;
+}
 
-    for (dep = deps; dep; dep = dep->next) {
-      char *depstring = alpm_dep_compute_string(dep->data);
-      alpm_pkg_t *satisfier = alpm_find_satisfier(localpkgs, depstring);
-      free(depstring);
+void json_list_item(void) {
+  if (!section.first) {
+    putchar(',');
+  }
+  section.first = 0;
+}
 
-      /* move on if the dependency was installed explicitly or already
-       * processed */
-      if (!satisfier
-          || alpm_pkg_get_reason(satisfier) == ALPM_PKG_REASON_EXPLICIT
-          || alpm_list_find_ptr(depchain, satisfier)) {
-        continue;
-      }
+void print_pkg_json(alpm_pkg_t *pkg) {
+  alpm_list_t *group, *optional_for;
+  int is_optional = 0;
 
-      /* check if the dependency is required outside the chain */
-      int required = 0;
-      rb = alpm_pkg_compute_requiredby(satisfier);
-      for (r = rb; r; r = r->next) {
-        alpm_pkg_t *p = alpm_db_get_pkg(localdb, r->data);
-        if (!alpm_list_find_ptr(depchain, p)) {
-          required = 1;
-          break;
-        }
-      }
-      FREELIST(rb);
-
-      /* check if the dependency is optionally required outside the chain */
-      if (!required && optional_deps) {
-        rb = alpm_pkg_compute_optionalfor(satisfier);
-        for (r = rb; r; r = r->next) {
-          alpm_pkg_t *p = alpm_db_get_pkg(localdb, r->data);
-          if (!alpm_list_find_ptr(depchain, p)) {
-            required = 1;
-            break;
-          }
-        }
-        FREELIST(rb);
-      }
+  if ((optional_for = alpm_pkg_compute_optionalfor(pkg))) {
+    is_optional = 1;
+    FREELIST(optional_for);
+  }
 
-      if (!required) {
-        depchain = alpm_list_add(depchain, satisfier);
-      }
+  json_list_item();
+  fputs("{\"name\":", stdout);
+  json_string(alpm_pkg_get_name(pkg));
+  printf(",\"removable_size\":%jd,\"optional\":%s,\"description\":",
+      (intmax_t) pu_depgraph_removable_size(depgraph, pkg),
+      is_optional ? "true" : "false");
+  json_string(alpm_pkg_get_desc(pkg) ? alpm_pkg_get_desc(pkg) : "");
+  fputs(",\"groups\":[", stdout);
+  for (group = alpm_pkg_get_groups(pkg); group; group = group->next) {
+    json_string(group->data);
+    if (group->next) {
+      putchar(',');
     }
   }
-
-  alpm_list_free(depchain);
-  return size;
+  fputs("]}", stdout);
 }
 
-void print_pkg_info(alpm_handle_t *handle, alpm_pkg_t *pkg,
-    size_t pkgname_len) {
+void print_pkg_info(alpm_pkg_t *pkg, size_t pkgname_len) {
   char size[20];
   alpm_list_t *group, *optional_for;
   int is_optional = 0;
@@ -191,7 +251,7 @@ void print_pkg_info(alpm_handle_t *handle, alpm_pkg_t *pkg,
   printf(" %c%-*s	%8s - %s",
       is_optional ? '*' : ' ',
       (int) pkgname_len, alpm_pkg_get_name(pkg),
-      pu_hr_size( get_pkg_chain_size(handle, pkg), size),
+      pu_hr_size(pu_depgraph_removable_size(depgraph, pkg), size),
       alpm_pkg_get_desc(pkg));
 
   if (alpm_pkg_get_groups(pkg)) {
@@ -208,9 +268,22 @@ void print_pkg_info(alpm_handle_t *handle, alpm_pkg_t *pkg,
   putchar('\n');
 }
 
-void print_pkglist(alpm_handle_t *handle, alpm_list_t *pkgs) {
+/* heading is only printed as text, key only used for json */
+void print_pkglist(const char *heading, const char *key, alpm_list_t *pkgs) {
   size_t pkgname_len = 0;
   alpm_list_t *p;
+  section.items += alpm_list_count(pkgs);
+  if (format == FORMAT_JSON) {
+    json_list_begin(key);
+    for (p = pkgs; p; p = p->next) {
+      print_pkg_json(p->data);
+    }
+    putchar(']');
+    return;
+  }
+  if (heading) {
+    puts(heading);
+  }
   for (p = pkgs; p; p = p->next) {
     size_t len = strlen(alpm_pkg_get_name(p->data));
     if (len > pkgname_len) {
@@ -218,65 +291,75 @@ void print_pkglist(alpm_handle_t *handle, alpm_list_t *pkgs) {
     }
   }
   for (p = pkgs; p; p = p->next) {
-    print_pkg_info(handle, p->data, pkgname_len);
+    print_pkg_info(p->data, pkgname_len);
   }
 }
 
-int _pu_pkg_depends_on(alpm_pkg_t *pkg, alpm_pkg_t *dpkg) {
-  return pu_pkg_depends_on(pkg, dpkg)
-      || (optional_deps && pu_pkg_optdepends_on(pkg, dpkg));
+static int pkg_cmp_name(const void *p1, const void *p2) {
+  return strcmp(alpm_pkg_get_name((alpm_pkg_t *) p1),
+      alpm_pkg_get_name((alpm_pkg_t *) p2));
 }
 
-void print_unneeded_packages(alpm_handle_t *handle) {
-  alpm_db_t *localdb = alpm_get_localdb(handle);
-  alpm_list_t *leaves_e = NULL, *leaves_d = NULL;
-  alpm_list_t *connected = NULL, *disconnected = NULL;
-  alpm_list_t *p, *pkgs = alpm_db_get_pkgcache(localdb);
+static int pkglist_cmp_name(const void *l1, const void *l2) {
+  return pkg_cmp_name(((alpm_list_t *) l1)->data, ((alpm_list_t *) l2)->data);
+}
 
-  for (p = pkgs; p; p = p->next) {
-    alpm_list_t *rb = alpm_pkg_compute_requiredby(p->data);
-    if (rb == NULL && optional_deps) {
-      rb = alpm_pkg_compute_optionalfor(p->data);
-    }
-    if (rb == NULL) {
-      if (alpm_pkg_get_reason(p->data) == ALPM_PKG_REASON_EXPLICIT) {
-        leaves_e = alpm_list_add(leaves_e, p->data);
-      } else {
-        leaves_d = alpm_list_add(leaves_d, p->data);
-      }
-    }
-    FREELIST(rb);
-  }
-
-  connected = alpm_list_join(alpm_list_copy(leaves_e), alpm_list_copy(leaves_d));
-  disconnected = alpm_list_copy(pkgs);
-  for (p = connected; p; p = p->next) {
-    alpm_list_t *l, *next = NULL;
-    for (l = disconnected; l; l = next) {
-      next = l->next;
-      if (p->data == l->data) {
-        disconnected = alpm_list_remove_item(disconnected, l);
-        free(l);
-      } else if (_pu_pkg_depends_on(p->data, l->data)) {
-        connected = alpm_list_add(connected, l->data);
-        disconnected = alpm_list_remove_item(disconnected, l);
-        free(l);
-      }
+void print_unneeded_packages(void) {
+  alpm_list_t *leaves = NULL, *leaves_e = NULL, *leaves_d = NULL;
+  alpm_list_t *cycles = NULL, *p;
+
+  if (pu_depgraph_leaves(depgraph, &leaves) != 0
+      || pu_depgraph_orphan_cycles(depgraph, &cycles) != 0) {
+    pu_ui_error("unable to search for unneeded packages (%s)\n",
+        strerror(errno));
+  }
+
+  for (p = leaves; p; p = p->next) {
+    if (alpm_pkg_get_reason(p->data) == ALPM_PKG_REASON_EXPLICIT) {
+      leaves_e = alpm_list_add(leaves_e, p->data);
+    } else {
+      leaves_d = alpm_list_add(leaves_d, p->data);
     }
   }
+  alpm_list_free(leaves);
 
-  printf("Unneeded Packages Installed Explicitly:\n");
-  print_pkglist(handle, leaves_e);
+  print_pkglist("Unneeded Packages Installed Explicitly:", "explicit",
+      leaves_e);
   alpm_list_free(leaves_e);
 
-  printf("Unneeded Packages Installed As Dependencies:\n");
-  print_pkglist(handle, leaves_d);
+  print_pkglist("Unneeded Packages Installed As Dependencies:", "dependencies",
+      leaves_d);
   alpm_list_free(leaves_d);
 
-  printf("Unneeded Packages In A Dependency Cycle:\n");
-  print_pkglist(handle, disconnected);
-  alpm_list_free(disconnected);
-  alpm_list_free(connected);
+  /* members of a cycle require each other, so each cycle is listed as a
+   * group along with the size of removing all of it at once */
+  if (format == FORMAT_JSON) {
+    fputs(",\"cycles\":[", stdout);
+  } else {
+    puts("Unneeded Packages In A Dependency Cycle:");
+  }
+  for (p = cycles; p; p = p->next) {
+    p->data = alpm_list_msort(p->data, alpm_list_count(p->data), pkg_cmp_name);
+  }
+  cycles = alpm_list_msort(cycles, alpm_list_count(cycles), pkglist_cmp_name);
+  for (p = cycles; p; p = p->next) {
+    off_t size = pu_depgraph_pkglist_removable_size(depgraph, p->data);
+    if (format == FORMAT_JSON) {
+      printf("{\"removable_size\":%jd,\"packages\":", (intmax_t) size);
+      print_pkglist(NULL, NULL, p->data);
+      fputs(p->next ? "}," : "}", stdout);
+    } else {
+      char hrsize[20];
+      printf("  %zu packages, %s total:\n", alpm_list_count(p->data),
+          pu_hr_size(size, hrsize));
+      print_pkglist(NULL, NULL, p->data);
+    }
+    alpm_list_free(p->data);
+  }
+  if (format == FORMAT_JSON) {
+    putchar(']');
+  }
+  alpm_list_free(cycles);
 }
 
 int pkg_is_foreign(alpm_handle_t *handle, alpm_pkg_t *pkg) {
@@ -299,8 +382,7 @@ void print_foreign(alpm_handle_t *handle) {
       matches = alpm_list_add(matches, p->data);
     }
   }
-  printf("Installed Packages Not In A Repository:\n");
-  print_pkglist(handle, matches);
+  print_pkglist("Installed Packages Not In A Repository:", "packages", matches);
   alpm_list_free(matches);
 }
 
@@ -309,6 +391,12 @@ void print_group_missing(alpm_handle_t *handle, alpm_list_t *groups) {
   alpm_list_t *localpkgs = alpm_db_get_pkgcache(localdb);
   alpm_list_t *matches = NULL;
   alpm_list_t *i;
+  pu_ptrset_t *seen = pu_ptrset_new(0);
+
+  if (seen == NULL) {
+    pu_ui_error("%s\n", strerror(errno));
+    return;
+  }
 
   for (i = groups; i; i = i->next) {
     const char *group = i->data;
@@ -316,7 +404,7 @@ void print_group_missing(alpm_handle_t *handle, alpm_list_t *groups) {
     pkgs = alpm_find_group_pkgs(alpm_get_syncdbs(handle), group);
     for (p = pkgs; p; p = p->next) {
       const char *pkgname = alpm_pkg_get_name(p->data);
-      if (!alpm_list_find_ptr(matches, p->data)
+      if (pu_ptrset_add(seen, p->data) == 1
           && !alpm_find_satisfier(localpkgs, pkgname)) {
         matches = alpm_list_add(matches, p->data);
       }
@@ -324,15 +412,33 @@ void print_group_missing(alpm_handle_t *handle, alpm_list_t *groups) {
     alpm_list_free(pkgs);
   }
 
-  puts("Missing Group Packages:");
-  print_pkglist(handle, matches);
+  print_pkglist("Missing Group Packages:", "packages", matches);
   alpm_list_free(matches);
+  pu_ptrset_free(seen);
 }
 
 void print_filelist(alpm_handle_t *handle, alpm_list_t *files) {
   size_t pkgname_len = 0;
   alpm_list_t *f;
   const char *root = alpm_option_get_root(handle);
+  section.items += alpm_list_count(files);
+  if (format == FORMAT_JSON) {
+    json_list_begin("files");
+    for (f = files; f; f = f->next) {
+      struct pkg_file_t *mf = f->data;
+      char *path = pu_prepend_dir(root, mf->file->name);
+      json_list_item();
+      fputs("{\"package\":", stdout);
+      json_string(alpm_pkg_get_name(mf->pkg));
+      fputs(",\"path\":", stdout);
+      json_string(path ? path : mf->file->name);
+      putchar('}');
+      free(path);
+    }
+    putchar(']');
+    return;
+  }
+  puts("Missing Package Files:");
   for (f = files; f; f = f->next) {
     struct pkg_file_t *mf = f->data;
     size_t len = strlen(alpm_pkg_get_name(mf->pkg));
@@ -367,76 +473,204 @@ void print_missing_files(alpm_handle_t *handle) {
       }
     }
   }
-  puts("Missing Package Files:");
   print_filelist(handle, matches);
   FREELIST(matches);
 }
 
-int is_cache_file_installed(alpm_handle_t *handle, const char *path) {
-  char *pkgver, *pkgname = strdup(path);
-  int ret = 0;
+struct cache_file {
+  char *name;
+  off_t size;
+  pu_pkgfile_t pf;
+  int parsed;
+};
 
-  if (!(pkgver = strrchr(pkgname, '-'))) {
-    goto cleanup;
+struct cache_scan {
+  pthread_mutex_t lock;
+  struct cache_file *files;
+  size_t count, alloc;
+  int error;
+};
+
+struct cache_stats {
+  off_t bytes, uninstalled, reclaimable, keep_reclaimable;
+  size_t files, pkgs;
+};
+
+/* called concurrently from pu_walk so that the stat calls are spread
+ * across threads; everything else is done afterwards */
+int _scan_cache(void *arg, pu_walk_entry_t *entry) {
+  struct cache_scan *scan = arg;
+  struct cache_file *file;
+  struct stat buf;
+
+  if (entry->error) {
+    if (entry->type == PU_WALK_DIR) {
+      pu_ui_warn("unable to open cachedir '%s' (%s)\n",
+          entry->path, strerror(entry->error));
+    } else {
+      pu_ui_warn("unable to stat '%s' (%s)\n",
+          entry->name, strerror(entry->error));
+    }
+    return 0;
+  }
+  if (entry->type == PU_WALK_DIR) {
+    return 1;
+  }
+  if (fstatat(AT_FDCWD, entry->path, &buf, AT_SYMLINK_NOFOLLOW) != 0) {
+    pu_ui_warn("unable to stat '%s' (%s)\n", entry->name, strerror(errno));
+    return 0;
   }
-  *pkgver = '\0';
-  for (pkgver--; *pkgver != '-' && pkgver > pkgname; pkgver--);
-  for (pkgver--; *pkgver != '-' && pkgver > pkgname; pkgver--);
 
-  if (pkgver > pkgname) {
-    *pkgver = '\0';
-    pkgver++;
-    alpm_pkg_t *lp = alpm_db_get_pkg(alpm_get_localdb(handle), pkgname);
-    if (lp && alpm_pkg_vercmp(alpm_pkg_get_version(lp), pkgver) == 0) {
-      ret = 1;
+  pthread_mutex_lock(&scan->lock);
+  if (scan->count == scan->alloc) {
+    size_t alloc = scan->alloc ? scan->alloc * 2 : 256;
+    struct cache_file *files = realloc(scan->files, alloc * sizeof(*files));
+    if (files == NULL) {
+      scan->error = errno;
+      pthread_mutex_unlock(&scan->lock);
+      return 0;
     }
+    scan->files = files;
+    scan->alloc = alloc;
+  }
+  file = &scan->files[scan->count];
+  if ((file->name = strdup(entry->name)) == NULL) {
+    scan->error = errno;
+  } else {
+    file->size = buf.st_size;
+    scan->count++;
   }
+  pthread_mutex_unlock(&scan->lock);
 
-cleanup:
-  free(pkgname);
-  return ret;
+  return 0;
 }
 
-off_t get_cache_size(alpm_handle_t *handle, int fd, const char *path,
-    off_t *uninstalled) {
-  off_t bytes = 0;
-  struct dirent *de;
-  int dirfd;
-  DIR *d;
+/* copies a parsed field into buf for the alpm functions that need NUL
+ * terminated strings; returns NULL if it does not fit */
+static const char *pkgfile_field(char *buf, size_t size, const char *s,
+    size_t len) {
+  if (len >= size) { return NULL; }
+  memcpy(buf, s, len);
+  buf[len] = '\0';
+  return buf;
+}
 
-  if ((dirfd = openat(fd, path, O_RDONLY | O_DIRECTORY)) < 0) {
-    pu_ui_warn("unable to open cachedir '%s' (%s)\n", path, strerror(errno));
+/* package files grouped by name, newest version first */
+static int cache_file_cmp(const void *p1, const void *p2) {
+  const struct cache_file *f1 = p1, *f2 = p2;
+  size_t len = f1->pf.namelen < f2->pf.namelen ? f1->pf.namelen : f2->pf.namelen;
+  const char *s1, *s2;
+  char v1[256], v2[256];
+  int ret;
+
+  if (f1->parsed != f2->parsed) {
+    return f1->parsed ? -1 : 1;
+  } else if (!f1->parsed) {
     return 0;
+  } else if ((ret = memcmp(f1->pf.name, f2->pf.name, len)) != 0) {
+    return ret;
+  } else if (f1->pf.namelen != f2->pf.namelen) {
+    return f1->pf.namelen < f2->pf.namelen ? -1 : 1;
+  }
+  /* versions too long to copy sort last, by their raw bytes */
+  s1 = pkgfile_field(v1, sizeof(v1), f1->pf.version, f1->pf.versionlen);
+  s2 = pkgfile_field(v2, sizeof(v2), f2->pf.version, f2->pf.versionlen);
+  if (s1 && s2) {
+    return alpm_pkg_vercmp(v2, v1);
+  } else if (s1 || s2) {
+    return s1 ? -1 : 1;
   }
-  if ((d = fdopendir(dirfd)) == NULL) {
-    pu_ui_warn("unable to open cachedir '%s' (%s)\n", path, strerror(errno));
-    close(dirfd);
+  len = f1->pf.versionlen < f2->pf.versionlen
+    ? f1->pf.versionlen : f2->pf.versionlen;
+  if ((ret = memcmp(f1->pf.version, f2->pf.version, len)) != 0) {
+    return ret;
+  }
+  return f1->pf.versionlen < f2->pf.versionlen ? -1
+    : f1->pf.versionlen > f2->pf.versionlen;
+}
+
+/* checks if the version in a package file is in db */
+static int pkgfile_in_db(alpm_db_t *db, struct cache_file *file) {
+  char name[256], version[256];
+  alpm_pkg_t *pkg;
+  if (!pkgfile_field(name, sizeof(name), file->pf.name, file->pf.namelen)
+      || !pkgfile_field(version, sizeof(version),
+          file->pf.version, file->pf.versionlen)) {
     return 0;
   }
+  pkg = alpm_db_get_pkg(db, name);
+  return pkg && alpm_pkg_vercmp(alpm_pkg_get_version(pkg), version) == 0;
+}
 
-  for (de = readdir(d); de; de = readdir(d)) {
-    struct stat buf;
-    if (de->d_name[0] == '.'
-        && (de->d_name[1] == '\0' || strcmp("..", de->d_name) == 0)) {
-      continue;
-    }
-    if (fstatat(dirfd, de->d_name, &buf, AT_SYMLINK_NOFOLLOW) != 0) {
-      pu_ui_warn("unable to stat '%s' (%s)\n", de->d_name, strerror(errno));
-      continue;
-    }
+void get_cache_stats(alpm_handle_t *handle, const char *path,
+    struct cache_stats *stats) {
+  struct cache_scan scan = { .files = NULL };
+  alpm_db_t *localdb = alpm_get_localdb(handle);
+  size_t i, versions = 0;
 
-    if (S_ISDIR(buf.st_mode)) {
-      bytes += get_cache_size(handle, dirfd, de->d_name, uninstalled);
-    } else {
-      bytes += buf.st_size;
-      if (uninstalled && !is_cache_file_installed(handle, de->d_name)) {
-        *uninstalled += buf.st_size;
+  memset(stats, 0, sizeof(*stats));
+  pthread_mutex_init(&scan.lock, NULL);
+  if (pu_walk(path, 0, 0, _scan_cache, &scan) != 0 && !scan.error) {
+    scan.error = errno;
+  }
+  pthread_mutex_destroy(&scan.lock);
+  if (scan.error) {
+    pu_ui_warn("unable to read cachedir '%s' (%s)\n", path,
+        strerror(scan.error));
+  }
+
+  for (i = 0; i < scan.count; i++) {
+    struct cache_file *file = &scan.files[i];
+    file->parsed = pu_pkgfile_parse(file->name, &file->pf) == 0;
+  }
+  qsort(scan.files, scan.count, sizeof(struct cache_file), cache_file_cmp);
+
+  for (i = 0; i < scan.count; i++) {
+    struct cache_file *file = &scan.files[i], *prev = i ? file - 1 : NULL;
+    int installed = 0, kept = 0;
+
+    stats->files++;
+    stats->bytes += file->size;
+
+    if (file->parsed) {
+      if (prev && prev->parsed && prev->pf.namelen == file->pf.namelen
+          && memcmp(prev->pf.name, file->pf.name, file->pf.namelen) == 0) {
+        if (prev->pf.versionlen != file->pf.versionlen
+            || memcmp(prev->pf.version, file->pf.version,
+                file->pf.versionlen) != 0) {
+          versions++;
+        }
+      } else {
+        stats->pkgs++;
+        versions = 0;
       }
+
+      installed = pkgfile_in_db(localdb, file);
+      if (config->cleanmethod & PU_CONFIG_CLEANMETHOD_KEEP_INSTALLED) {
+        kept = installed;
+      }
+      if (!kept && config->cleanmethod & PU_CONFIG_CLEANMETHOD_KEEP_CURRENT) {
+        alpm_list_t *s;
+        for (s = alpm_get_syncdbs(handle); s && !kept; s = s->next) {
+          kept = pkgfile_in_db(s->data, file);
+        }
+      }
+      if (!kept) {
+        stats->reclaimable += file->size;
+      }
+      if (cache_keep >= 0 && versions >= (size_t) cache_keep) {
+        stats->keep_reclaimable += file->size;
+      }
+    }
+    if (!installed) {
+      stats->uninstalled += file->size;
     }
   }
 
-  closedir(d);
-  return bytes;
+  for (i = 0; i < scan.count; i++) {
+    free(scan.files[i].name);
+  }
+  free(scan.files);
 }
 
 void print_cache_sizes(alpm_handle_t *handle) {
@@ -450,51 +684,142 @@ void print_cache_sizes(alpm_handle_t *handle) {
     }
   }
 
-  puts("Package Cache Size:");
+  if (format == FORMAT_JSON) {
+    json_list_begin("cachedirs");
+  } else {
+    puts("Package Cache Size:");
+  }
   for (c = cache_dirs; c; c = c->next) {
-    off_t uninstalled = 0;
-    char size[10], usize[10];
-    pu_hr_size(get_cache_size(handle, AT_FDCWD, c->data, &uninstalled), size);
-    pu_hr_size(uninstalled, usize);
+    struct cache_stats stats;
+    char size[10], usize[10], rsize[10];
+    get_cache_stats(handle, c->data, &stats);
+    section.items++;
+    if (format == FORMAT_JSON) {
+      json_list_item();
+      fputs("{\"path\":", stdout);
+      json_string(c->data);
+      printf(",\"size\":%jd,\"not_installed\":%jd,\"files\":%zu"
+          ",\"packages\":%zu,\"reclaimable\":%jd",
+          (intmax_t) stats.bytes, (intmax_t) stats.uninstalled, stats.files,
+          stats.pkgs, (intmax_t) stats.reclaimable);
+      if (cache_keep >= 0) {
+        printf(",\"keep_versions\":%d,\"keep_reclaimable\":%jd",
+            cache_keep, (intmax_t) stats.keep_reclaimable);
+      }
+      putchar('}');
+      continue;
+    }
+    pu_hr_size(stats.bytes, size);
+    pu_hr_size(stats.uninstalled, usize);
+    pu_hr_size(stats.reclaimable, rsize);
     printf("  %*s %s (%s not installed)\n",
         (int) pathlen, (char *) c->data, size, usize);
+    printf("  %*s %zu files from %zu packages, %s reclaimable",
+        (int) pathlen, "", stats.files, stats.pkgs, rsize);
+    if (cache_keep >= 0) {
+      pu_hr_size(stats.keep_reclaimable, rsize);
+      printf(", %s keeping %d versions", rsize, cache_keep);
+    }
+    putchar('\n');
+  }
+  if (format == FORMAT_JSON) {
+    putchar(']');
   }
 }
 
-int should_ignore_file(alpm_handle_t *handle, const char *path) {
-  const char *root = alpm_option_get_root(handle);
-  size_t rootlen = strlen(root);
-  alpm_db_t *ldb = alpm_get_localdb(handle);
-  alpm_list_t *p;
+/* Ignore rules compiled into a tree of absolute path components.  Rules
+ * without glob characters mark their node as ignored, globs are attached to
+ * the node for their fixed leading directory and are only tried for paths
+ * below it. */
+struct ignore_node {
+  char *name;
+  int literal;
+  alpm_list_t *globs;
+  alpm_list_t *children;
+};
 
-  for (p = ignore; p; p = p->next) {
-    if (fnmatch(p->data, path + rootlen, 0) == 0) {
-      return 1;
-    }
+enum ignore_match {
+  IGNORE_NO,
+  IGNORE_YES,
+  IGNORE_NONE_BELOW, /* no rule can match the path or anything below it */
+};
+
+struct ignore_node *ignore_tree = NULL;
+size_t ignore_rootlen = 0;
+
+void ignore_node_free(struct ignore_node *node) {
+  if (node) {
+    alpm_list_free_inner(node->children, (alpm_list_fn_free) ignore_node_free);
+    alpm_list_free(node->children);
+    alpm_list_free(node->globs);
+    free(node->name);
+    free(node);
   }
-  for (p = pkg_ignore; p; p = p->next) {
-    struct pkg_ignore_t *pi = p->data;
-    alpm_pkg_t *pkg = alpm_db_get_pkg(ldb, pi->pkgname);
-    if (pkg && fnmatch(pi->ignore, path + rootlen, 0) == 0) {
-      return 1;
+}
+
+static struct ignore_node *ignore_child(struct ignore_node *node,
+    const char *name, size_t len, int create) {
+  struct ignore_node *child;
+  alpm_list_t *c;
+  for (c = node->children; c; c = c->next) {
+    child = c->data;
+    if (strncmp(child->name, name, len) == 0 && child->name[len] == '\0') {
+      return child;
     }
   }
-  return 0;
+  if (!create) {
+    return NULL;
+  }
+  if ((child = calloc(1, sizeof(struct ignore_node))) == NULL
+      || (child->name = strndup(name, len)) == NULL
+      || alpm_list_append(&node->children, child) == NULL) {
+    ignore_node_free(child);
+    return NULL;
+  }
+  return child;
 }
 
-int file_is_unowned(alpm_handle_t *handle, const char *path) {
-  alpm_db_t *ldb = alpm_get_localdb(handle);
-  alpm_list_t *p, *pkgs = alpm_db_get_pkgcache(ldb);
-  for (p = pkgs; p; p = p->next) {
-    if (alpm_filelist_contains(alpm_pkg_get_files(p->data), path + 1)) {
-      return 0;
-    }
+/* prefix + pattern is an absolute path; pattern is what globs are matched
+ * against and must remain valid for the lifetime of the tree */
+static int ignore_add(const char *prefix, const char *pattern) {
+  size_t glob = strlen(prefix) + strcspn(pattern, "*?[\\");
+  char *path = pu_asprintf("%s%s", prefix, pattern);
+  char *c, *end;
+  struct ignore_node *node = ignore_tree;
+
+  if (path == NULL) {
+    return -1;
   }
-  return 1;
+  /* snapshots are only valid for the rules they were taken with */
+  for (c = path; *c; c++) {
+    ignore_hash = (ignore_hash ^ (unsigned char) *c) * 16777619u;
+  }
+  ignore_hash = (ignore_hash ^ '\n') * 16777619u;
+  if (path[glob] != '\0') {
+    /* only the fixed leading directories go in the tree */
+    while (glob > 0 && path[glob] != '/') { glob--; }
+  }
+  path[glob] = '\0';
+
+  for (c = path + 1; node && c <= path + glob && *path; c = end + 1) {
+    end = c + strcspn(c, "/");
+    node = ignore_child(node, c, end - c, 1);
+  }
+  free(path);
+
+  if (node == NULL) {
+    return -1;
+  } else if (pattern[strcspn(pattern, "*?[\\")] == '\0') {
+    node->literal = 1;
+  } else if (alpm_list_append(&node->globs, (void *) pattern) == NULL) {
+    return -1;
+  }
+  return 0;
 }
 
-void _scan_filesystem(alpm_handle_t *handle, const char *dir, int backups,
-    int orphans, alpm_list_t **backups_found, alpm_list_t **orphans_found) {
+/* compile the built-in skip list, IgnoreUnowned, and the PkgIgnoreUnowned
+ * rules for installed packages */
+int ignore_tree_build(alpm_handle_t *handle) {
   static char *skip[] = {
     "/etc/ssl/certs",
     "/dev",
@@ -513,68 +838,894 @@ void _scan_filesystem(alpm_handle_t *handle, const char *dir, int backups,
     "/var/tmp",
     NULL
   };
+  const char *root = alpm_option_get_root(handle);
+  alpm_db_t *ldb = alpm_get_localdb(handle);
+  alpm_list_t *p;
+  char **s;
 
-  char path[PATH_MAX];
-  char *filename = path + strlen(dir);
-  strcpy(path, dir);
+  ignore_rootlen = strlen(root);
+  if ((ignore_tree = calloc(1, sizeof(struct ignore_node))) == NULL) {
+    return -1;
+  }
+  for (s = skip; *s; s++) {
+    if (ignore_add("", *s) != 0) { return -1; }
+  }
+  for (p = ignore; p; p = p->next) {
+    if (ignore_add(root, p->data) != 0) { return -1; }
+  }
+  for (p = pkg_ignore; p; p = p->next) {
+    struct pkg_ignore_t *pi = p->data;
+    if (alpm_db_get_pkg(ldb, pi->pkgname) && ignore_add(root, pi->ignore) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
 
-  DIR *dirp = opendir(dir);
-  if (!dirp) {
-    fprintf(stderr, "Error opening '%s' (%s).\n", dir, strerror(errno));
-    return;
+/* path is absolute without a trailing slash */
+enum ignore_match should_ignore_file(const char *path) {
+  struct ignore_node *node = ignore_tree;
+  const char *c = path + 1;
+  int globs = 0;
+
+  for (;;) {
+    alpm_list_t *g;
+    size_t len;
+    if (*c == '\0') {
+      if (node->literal) {
+        return IGNORE_YES;
+      }
+      return globs || node->globs || node->children ? IGNORE_NO : IGNORE_NONE_BELOW;
+    }
+    for (g = node->globs; g; g = g->next) {
+      globs = 1;
+      if (fnmatch(g->data, path + ignore_rootlen, 0) == 0) {
+        return IGNORE_YES;
+      }
+    }
+    len = strcspn(c, "/");
+    if ((node = ignore_child(node, c, len, 0)) == NULL) {
+      return globs ? IGNORE_NO : IGNORE_NONE_BELOW;
+    }
+    c += len;
+    if (*c == '/') { c++; }
   }
+}
 
-  struct dirent *entry;
-  while ((entry = readdir(dirp))) {
-    struct stat buf;
-    char **s;
-    int need_skip = 0;
+enum owned_flags {
+  OWNED_PATH = 1,     /* listed in a package's file list */
+  OWNED_ANCESTOR = 2, /* a directory containing an owned path */
+};
 
-    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0 ) {
-      continue;
+/* Open-addressing hash set of every path in the local database, along with
+ * the directories leading to them.  Keys point into the package file lists,
+ * ancestors being prefixes of them, so nothing is copied. */
+struct owned_slot {
+  const char *path;
+  size_t len;
+  uint32_t hash;
+  int flags;
+  uint64_t names; /* directories: digest of their owned entries' names */
+};
+
+struct owned_slot *owned = NULL;
+char *owned_pool = NULL; /* paths decoded from the database snapshot */
+size_t owned_mask = 0, owned_count = 0;
+uint64_t owned_root_names = 0;
+
+static uint32_t owned_hash(const char *path, size_t len) {
+  uint32_t h = 2166136261u;
+  while (len--) {
+    h ^= (unsigned char) *path++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static struct owned_slot *owned_find(const char *path, size_t len,
+    uint32_t hash) {
+  size_t i = hash & owned_mask;
+  while (owned[i].path && (owned[i].hash != hash || owned[i].len != len
+        || memcmp(owned[i].path, path, len) != 0)) {
+    i = (i + 1) & owned_mask;
+  }
+  return &owned[i];
+}
+
+/* returns the slot's previous flags */
+static int owned_add(const char *path, size_t len, int flags) {
+  uint32_t hash = owned_hash(path, len);
+  struct owned_slot *slot = owned_find(path, len, hash);
+  int old = slot->flags;
+  if (slot->path == NULL) {
+    slot->path = path;
+    slot->len = len;
+    slot->hash = hash;
+    owned_count++;
+  }
+  slot->flags |= flags;
+  return old;
+}
+
+static int owned_grow(void) {
+  struct owned_slot *old = owned;
+  size_t i, oldsize = owned_mask + 1;
+  if ((owned = calloc(oldsize * 2, sizeof(struct owned_slot))) == NULL) {
+    owned = old;
+    return -1;
+  }
+  owned_mask = oldsize * 2 - 1;
+  for (i = 0; i < oldsize; i++) {
+    if (old[i].path) {
+      *owned_find(old[i].path, old[i].len, old[i].hash) = old[i];
     }
+  }
+  free(old);
+  return 0;
+}
 
-    strcpy(filename, entry->d_name);
+static int owned_set_alloc(size_t nfiles) {
+  size_t size = 64;
+  /* ancestors are nearly always listed themselves */
+  while (size < nfiles * 2 + 64) { size *= 2; }
+  if ((owned = calloc(size, sizeof(struct owned_slot))) == NULL) {
+    return -1;
+  }
+  owned_mask = size - 1;
+  return 0;
+}
 
-    for (s = skip; *s && !need_skip; s++) {
-      if (strcmp(path, *s) == 0) {
-        need_skip = 1;
+static int owned_add_file(const char *name) {
+  size_t len = strlen(name);
+  if (owned_count * 2 >= owned_mask && owned_grow() != 0) {
+    return -1;
+  }
+  owned_add(name, len, OWNED_PATH);
+  /* mark parent directories until one is already marked */
+  while (len > 1) {
+    for (len--; len > 0 && name[len - 1] != '/'; len--);
+    if (len == 0 || owned_add(name, len, OWNED_ANCESTOR) & OWNED_ANCESTOR) {
+      break;
+    }
+  }
+  return 0;
+}
+
+/* the database snapshot saves parsing every package's file list, the paths
+ * are decoded into a single pool for the keys to point into */
+static int owned_set_build_dbsnap(pu_dbsnap_t *snap) {
+  uint32_t pkg, npkgs = pu_dbsnap_count(snap);
+  pu_dbsnap_files_t files;
+  size_t nfiles = 0, left = pu_dbsnap_files_size(snap);
+  char *pool;
+
+  for (pkg = 0; pkg < npkgs; pkg++) {
+    nfiles += pu_dbsnap_files(snap, pkg, &files);
+  }
+  if ((owned_pool = pool = malloc(left + 1)) == NULL
+      || owned_set_alloc(nfiles) != 0) {
+    return -1;
+  }
+
+  for (pkg = 0; pkg < npkgs; pkg++) {
+    const char *path;
+    pu_dbsnap_files(snap, pkg, &files);
+    while ((path = pu_dbsnap_files_next(&files))) {
+      /* the size comes from the snapshot header, do not trust it */
+      if (files.len + 1 > left) {
+        errno = EINVAL;
+        return -1;
       }
+      memcpy(pool, path, files.len + 1);
+      if (owned_add_file(pool) != 0) { return -1; }
+      pool += files.len + 1;
+      left -= files.len + 1;
     }
-    if (need_skip || should_ignore_file(handle, path)) {
-      continue;
+  }
+
+  return 0;
+}
+
+int owned_set_build(alpm_handle_t *handle) {
+  alpm_list_t *p, *pkgs;
+  size_t nfiles = 0;
+  pu_dbsnap_t *snap;
+
+  if ((snap = pu_dbsnap_load(handle, 1)) != NULL) {
+    int ret = owned_set_build_dbsnap(snap);
+    pu_dbsnap_free(snap);
+    return ret;
+  }
+
+  pkgs = alpm_db_get_pkgcache(alpm_get_localdb(handle));
+  for (p = pkgs; p; p = p->next) {
+    nfiles += alpm_pkg_get_files(p->data)->count;
+  }
+  if (owned_set_alloc(nfiles) != 0) {
+    return -1;
+  }
+
+  for (p = pkgs; p; p = p->next) {
+    alpm_filelist_t *files = alpm_pkg_get_files(p->data);
+    size_t i;
+    for (i = 0; i < files->count; ++i) {
+      if (owned_add_file(files->files[i].name) != 0) {
+        return -1;
+      }
     }
+  }
 
-    if (lstat(path, &buf) != 0) {
-      fprintf(stderr, "Error reading '%s' (%s).\n", path, strerror(errno));
-      continue;
+  return 0;
+}
+
+/* path is absolute, directories have a trailing slash */
+int file_owned_flags(const char *path) {
+  size_t len = strlen(path + 1);
+  struct owned_slot *slot = owned_find(path + 1, len, owned_hash(path + 1, len));
+  return slot->flags;
+}
+
+static uint64_t owned_name_hash(const char *name, size_t len) {
+  uint64_t h = UINT64_C(14695981039346656037);
+  while (len--) {
+    h ^= (unsigned char) *name++;
+    h *= UINT64_C(1099511628211);
+  }
+  /* spread the bits, the digests are combined with xor */
+  h ^= h >> 33;
+  h *= UINT64_C(0xff51afd7ed558ccd);
+  return h ^ (h >> 33);
+}
+
+/* Gives every directory an order-independent digest of the names of the
+ * owned paths directly inside it, so --incremental can tell when files in
+ * an otherwise unmodified directory stopped or started being owned, e.g.
+ * after pacman --dbonly or a package removal that left files behind.
+ * Every parent is in the set as an ancestor of its entries. */
+void owned_set_digest(void) {
+  size_t i;
+  for (i = 0; i <= owned_mask; i++) {
+    const char *path = owned[i].path;
+    size_t len = owned[i].len, plen;
+    uint64_t h;
+
+    if (path == NULL || !(owned[i].flags & OWNED_PATH)) { continue; }
+    if (path[len - 1] == '/') { len--; }
+    for (plen = len; plen > 0 && path[plen - 1] != '/'; plen--);
+    h = owned_name_hash(path + plen, len - plen);
+    if (plen == 0) {
+      owned_root_names ^= h;
+    } else {
+      owned_find(path, plen, owned_hash(path, plen))->names ^= h;
     }
+  }
+}
 
-    if (S_ISDIR(buf.st_mode)) {
-      strcat(filename, "/");
-      if (orphans && file_is_unowned(handle, path)) {
-        *orphans_found = alpm_list_add(*orphans_found, strdup(path));
-        if (backups) {
-          _scan_filesystem(handle, path, backups, 0, backups_found, orphans_found);
-        }
+/* path is absolute, without a trailing slash except for the root */
+uint64_t dir_owned_names(const char *path, size_t len) {
+  char key[PATH_MAX + 1];
+  if (len <= 1) {
+    return owned_root_names;
+  } else if (len >= sizeof(key)) {
+    return 0;
+  }
+  memcpy(key, path + 1, len - 1);
+  key[len - 1] = '/';
+  return owned_find(key, len, owned_hash(key, len))->names;
+}
+
+int file_is_unowned(const char *path) {
+  return !(file_owned_flags(path) & OWNED_PATH);
+}
+
+/* --incremental keeps a snapshot of every directory listed while looking
+ * for unowned files: its mtime, ctime and ownership, along with the unowned
+ * entries found in it.  Directories which have not changed since are not
+ * listed again, their entries are checked against the current database
+ * instead.  A directory is also listed again if the ownership of one of its
+ * subdirectories changed, as that decides whether it is reported and
+ * descended into. */
+#define SNAPSHOT_HEADER "PUREPORTSNAPSHOT 2"
+
+enum snap_state {
+  SNAP_SAME,
+  SNAP_CHANGED,
+  SNAP_GONE,
+};
+
+struct snap_dir {
+  char *path; /* without trailing slash, except for the root */
+  size_t len;
+  struct timespec mtime, ctime;
+  int flags;
+  uint64_t names; /* see owned_set_digest */
+  size_t parent, child, sibling;
+  alpm_list_t *unowned;
+
+  /* current state, filled in by snapshot_check */
+  enum snap_state state;
+  struct timespec cur_mtime, cur_ctime;
+  int cur_flags;
+  uint64_t cur_names;
+};
+
+struct snapshot {
+  struct snap_dir *dirs;
+  size_t count, alloc;
+  size_t *index, mask; /* open addressing, values are dir indexes + 1 */
+  uint32_t rules;
+  alpm_list_t *unowned;
+};
+
+void snapshot_free(struct snapshot *snap) {
+  size_t i;
+  for (i = 0; i < snap->count; i++) {
+    free(snap->dirs[i].path);
+    alpm_list_free(snap->dirs[i].unowned);
+  }
+  free(snap->dirs);
+  free(snap->index);
+  FREELIST(snap->unowned);
+}
+
+size_t snapshot_find(struct snapshot *snap, const char *path, size_t len) {
+  size_t i;
+  if (snap->index == NULL) {
+    return SIZE_MAX;
+  }
+  for (i = owned_hash(path, len) & snap->mask; snap->index[i];
+      i = (i + 1) & snap->mask) {
+    struct snap_dir *dir = &snap->dirs[snap->index[i] - 1];
+    if (dir->len == len && memcmp(dir->path, path, len) == 0) {
+      return snap->index[i] - 1;
+    }
+  }
+  return SIZE_MAX;
+}
+
+static int snapshot_reindex(struct snapshot *snap, size_t size) {
+  size_t i, *index = calloc(size, sizeof(size_t));
+  if (index == NULL) {
+    return -1;
+  }
+  free(snap->index);
+  snap->index = index;
+  snap->mask = size - 1;
+  for (i = 0; i < snap->count; i++) {
+    size_t slot = owned_hash(snap->dirs[i].path, snap->dirs[i].len) & snap->mask;
+    while (index[slot]) { slot = (slot + 1) & snap->mask; }
+    index[slot] = i + 1;
+  }
+  return 0;
+}
+
+/* returns the index of the new directory or SIZE_MAX on error */
+size_t snapshot_add(struct snapshot *snap, const char *path, size_t len) {
+  struct snap_dir *dir;
+  if (snap->count == snap->alloc) {
+    size_t alloc = snap->alloc ? snap->alloc * 2 : 1024;
+    struct snap_dir *dirs = realloc(snap->dirs, alloc * sizeof(*dirs));
+    if (dirs == NULL) {
+      return SIZE_MAX;
+    }
+    snap->dirs = dirs;
+    snap->alloc = alloc;
+  }
+  dir = &snap->dirs[snap->count];
+  memset(dir, 0, sizeof(*dir));
+  if ((dir->path = strndup(path, len)) == NULL) {
+    return SIZE_MAX;
+  }
+  dir->len = len;
+  dir->parent = dir->child = dir->sibling = SIZE_MAX;
+  snap->count++;
+  if ((snap->count * 2 > snap->mask + 1 || snap->index == NULL)
+      && snapshot_reindex(snap, snap->index ? (snap->mask + 1) * 2 : 2048) != 0) {
+    return SIZE_MAX;
+  } else {
+    size_t slot = owned_hash(path, len) & snap->mask;
+    while (snap->index[slot]) { slot = (slot + 1) & snap->mask; }
+    snap->index[slot] = snap->count;
+  }
+  return snap->count - 1;
+}
+
+/* length of the parent directory of path, 0 for the root */
+static size_t snapshot_parent_len(const char *path, size_t len) {
+  if (len <= 1) {
+    return 0;
+  }
+  while (len > 0 && path[len - 1] != '/') { len--; }
+  return len > 1 ? len - 1 : 1;
+}
+
+/* the name of the last component of path, with any trailing slash */
+static const char *snapshot_name(const char *path, size_t len) {
+  const char *name = path + snapshot_parent_len(path, len);
+  return *name == '/' && len > 1 ? name + 1 : name;
+}
+
+static void snapshot_write_name(FILE *stream, const char *name) {
+  if (*name == ' ' || *name == '\t') {
+    fputc('\\', stream);
+  }
+  for (; *name; name++) {
+    if (*name == '\\') {
+      fputs("\\\\", stream);
+    } else if (*name == '\n') {
+      fputs("\\n", stream);
+    } else {
+      fputc(*name, stream);
+    }
+  }
+  fputc('\n', stream);
+}
+
+static void snapshot_unescape(char *name) {
+  char *out = name;
+  for (; *name; name++) {
+    if (*name == '\\' && name[1]) {
+      name++;
+      *out++ = *name == 'n' ? '\n' : *name;
+    } else {
+      *out++ = *name;
+    }
+  }
+  *out = '\0';
+}
+
+static char *snapshot_join(struct snap_dir *dir, const char *name) {
+  return pu_asprintf("%s%s%s", dir->path, dir->len == 1 ? "" : "/", name);
+}
+
+/* reads the snapshot at path into snap, a missing snapshot is empty */
+int snapshot_read(const char *path, struct snapshot *snap) {
+  FILE *stream = fopen(path, "r");
+  char *buf = NULL;
+  size_t buflen = 0;
+  ssize_t len;
+  int ret = -1;
+
+  if (stream == NULL) {
+    return errno == ENOENT ? 0 : -1;
+  }
+  if ((len = getline(&buf, &buflen, stream)) == -1
+      || sscanf(buf, SNAPSHOT_HEADER " %" SCNx32, &snap->rules) != 1) {
+    errno = EINVAL;
+    goto cleanup;
+  }
+
+  errno = 0;
+  while ((len = getline(&buf, &buflen, stream)) != -1) {
+    long long parent;
+    intmax_t msec, csec;
+    long mnsec, cnsec;
+    uint64_t names;
+    int flags, off = 0;
+    char *name, *full;
+    size_t i;
+
+    if (buf[len - 1] == '\n') { buf[--len] = '\0'; }
+
+    if (sscanf(buf, "D %lld %jd %ld %jd %ld %d %" SCNx64 " %n", &parent,
+            &msec, &mnsec, &csec, &cnsec, &flags, &names, &off) == 7 && off) {
+      struct snap_dir *dir;
+      name = buf + off;
+      snapshot_unescape(name);
+      if (parent < 0) {
+        full = strdup(name);
+      } else if ((size_t) parent < snap->count) {
+        full = snapshot_join(&snap->dirs[parent], name);
       } else {
-        _scan_filesystem(handle, path, backups, orphans, backups_found, orphans_found);
+        errno = EINVAL;
+        goto cleanup;
+      }
+      if (full == NULL || (i = snapshot_add(snap, full, strlen(full))) == SIZE_MAX) {
+        free(full);
+        goto cleanup;
+      }
+      free(full);
+      dir = &snap->dirs[i];
+      dir->mtime.tv_sec = msec;
+      dir->mtime.tv_nsec = mnsec;
+      dir->ctime.tv_sec = csec;
+      dir->ctime.tv_nsec = cnsec;
+      dir->flags = flags;
+      dir->names = names;
+      if (parent >= 0) {
+        dir->parent = parent;
+        dir->sibling = snap->dirs[parent].child;
+        snap->dirs[parent].child = i;
+      }
+    } else if (sscanf(buf, "U %lld %n", &parent, &off) == 1 && off
+        && parent >= 0 && (size_t) parent < snap->count) {
+      name = buf + off;
+      snapshot_unescape(name);
+      if ((full = snapshot_join(&snap->dirs[parent], name)) == NULL
+          || alpm_list_append(&snap->unowned, full) == NULL
+          || alpm_list_append(&snap->dirs[parent].unowned, full) == NULL) {
+        goto cleanup;
       }
     } else {
-      if (orphans && file_is_unowned(handle, path)) {
-        *orphans_found = alpm_list_add(*orphans_found, strdup(path));
+      errno = EINVAL;
+      goto cleanup;
+    }
+  }
+  if (errno == 0 && !ferror(stream)) {
+    ret = 0;
+  }
+  snap->unowned = alpm_list_msort(snap->unowned,
+      alpm_list_count(snap->unowned), (alpm_list_fn_cmp) strcmp);
+
+cleanup:
+  free(buf);
+  fclose(stream);
+  return ret;
+}
+
+static int snap_dir_cmp(const void *p1, const void *p2) {
+  return strcmp(((struct snap_dir *) p1)->path, ((struct snap_dir *) p2)->path);
+}
+
+/* unowned is the sorted list of results; sorting the directories puts every
+ * parent before its children */
+int snapshot_write(const char *path, struct snapshot *snap,
+    alpm_list_t *unowned) {
+  char *tmp = pu_asprintf("%s.XXXXXX", path);
+  FILE *stream = NULL;
+  alpm_list_t *u;
+  size_t i;
+  int fd;
+
+  if (tmp == NULL) {
+    return -1;
+  }
+  if (snap->count) {
+    qsort(snap->dirs, snap->count, sizeof(struct snap_dir), snap_dir_cmp);
+    if (snapshot_reindex(snap, snap->mask + 1) != 0) {
+      goto error;
+    }
+  }
+  if ((fd = mkstemp(tmp)) == -1) {
+    goto error;
+  }
+  if (fchmod(fd, 0644) != 0 || (stream = fdopen(fd, "w")) == NULL) {
+    close(fd);
+    goto error;
+  }
+
+  fprintf(stream, SNAPSHOT_HEADER " %" PRIx32 "\n", ignore_hash);
+  for (i = 0; i < snap->count; i++) {
+    struct snap_dir *dir = &snap->dirs[i];
+    size_t parent = dir->len > 1 ? snapshot_find(snap, dir->path,
+        snapshot_parent_len(dir->path, dir->len)) : SIZE_MAX;
+    fprintf(stream, "D %lld %jd %ld %jd %ld %d %" PRIx64 " ",
+        parent != SIZE_MAX ? (long long) parent : -1LL,
+        (intmax_t) dir->mtime.tv_sec, (long) dir->mtime.tv_nsec,
+        (intmax_t) dir->ctime.tv_sec, (long) dir->ctime.tv_nsec, dir->flags,
+        dir->names);
+    /* the top directory is stored by its full path */
+    snapshot_write_name(stream, parent != SIZE_MAX
+        ? snapshot_name(dir->path, dir->len) : dir->path);
+  }
+  for (u = unowned; u; u = u->next) {
+    const char *upath = u->data;
+    size_t len = strlen(upath), parent;
+    if (upath[len - 1] == '/') { len--; }
+    parent = snapshot_find(snap, upath, snapshot_parent_len(upath, len));
+    if (parent != SIZE_MAX) {
+      fprintf(stream, "U %zu ", parent);
+      snapshot_write_name(stream, snapshot_name(upath, len));
+    }
+  }
+
+  if (fflush(stream) != 0 || ferror(stream) || fsync(fileno(stream)) != 0) {
+    goto error;
+  }
+  if (fclose(stream) != 0) { stream = NULL; goto error; }
+  stream = NULL;
+  if (rename(tmp, path) != 0) { goto error; }
+
+  free(tmp);
+  return 0;
+
+error:
+  {
+    int err = errno;
+    if (stream) { fclose(stream); }
+    unlink(tmp);
+    free(tmp);
+    errno = err;
+  }
+  return -1;
+}
+
+enum scan_flags {
+  SCAN_BACKUPS = 1,
+  SCAN_ORPHANS = 2,
+  SCAN_NOIGNORE = 4, /* no ignore rules apply below this directory */
+};
+
+struct scan_ctx {
+  pthread_mutex_t lock;
+  alpm_list_t *backups_found, *orphans_found;
+
+  /* --incremental: the snapshot being recorded, the one read from the
+   * previous run, and the same if its directories can be reused */
+  struct snapshot *snap, *old, *prev;
+  size_t *queue, nqueue, queuealloc;
+  int incomplete;
+};
+
+/* queues a directory from the previous snapshot to be processed once the
+ * current walk is done; must be called with the lock held while walking */
+static void scan_queue_push(struct scan_ctx *ctx, size_t dir) {
+  if (ctx->nqueue == ctx->queuealloc) {
+    size_t alloc = ctx->queuealloc ? ctx->queuealloc * 2 : 256;
+    size_t *queue = realloc(ctx->queue, alloc * sizeof(size_t));
+    if (queue == NULL) {
+      pu_ui_error("unable to queue '%s' (%s)\n",
+          ctx->prev->dirs[dir].path, strerror(errno));
+      ctx->incomplete = 1;
+      return;
+    }
+    ctx->queue = queue;
+    ctx->queuealloc = alloc;
+  }
+  ctx->queue[ctx->nqueue++] = dir;
+}
+
+static void scan_snapshot_record(struct scan_ctx *ctx, const char *path,
+    size_t len, const struct timespec *mtime, const struct timespec *ctime,
+    int flags) {
+  uint64_t names = dir_owned_names(path, len);
+  size_t i;
+  pthread_mutex_lock(&ctx->lock);
+  if ((i = snapshot_add(ctx->snap, path, len)) == SIZE_MAX) {
+    ctx->incomplete = 1;
+  } else {
+    ctx->snap->dirs[i].mtime = *mtime;
+    ctx->snap->dirs[i].ctime = *ctime;
+    ctx->snap->dirs[i].flags = flags;
+    ctx->snap->dirs[i].names = names;
+  }
+  pthread_mutex_unlock(&ctx->lock);
+}
+
+/* records a directory the scan is about to list; directories that are in
+ * the previous snapshot are queued instead, to be listed again only if they
+ * changed.  Returns whether the walk should descend into the directory. */
+static int scan_snapshot_dir(struct scan_ctx *ctx, const char *path,
+    size_t len, int flags) {
+  size_t prev = ctx->prev ? snapshot_find(ctx->prev, path, len) : SIZE_MAX;
+  struct stat st;
+
+  if (prev != SIZE_MAX && ctx->prev->dirs[prev].state != SNAP_GONE) {
+    pthread_mutex_lock(&ctx->lock);
+    scan_queue_push(ctx, prev);
+    pthread_mutex_unlock(&ctx->lock);
+    return 0;
+  }
+
+  if (lstat(len ? path : "/", &st) != 0) {
+    pthread_mutex_lock(&ctx->lock);
+    ctx->incomplete = 1;
+    pthread_mutex_unlock(&ctx->lock);
+    return 1;
+  }
+  scan_snapshot_record(ctx, path, len, &st.st_mtim, &st.st_ctim, flags);
+  return 1;
+}
+
+static void scan_found(struct scan_ctx *ctx, alpm_list_t **list, const char *path) {
+  pthread_mutex_lock(&ctx->lock);
+  alpm_list_append_strdup(list, path);
+  pthread_mutex_unlock(&ctx->lock);
+}
+
+/* called concurrently from pu_walk; entry->flags holds the scan_flags still
+ * applicable below the current directory */
+int _scan_filesystem(void *arg, pu_walk_entry_t *entry) {
+  struct scan_ctx *ctx = arg;
+  char *path = entry->path;
+
+  if (!(entry->flags & SCAN_NOIGNORE)) {
+    switch (should_ignore_file(path)) {
+      case IGNORE_YES:
+        return 0;
+      case IGNORE_NONE_BELOW:
+        entry->flags |= SCAN_NOIGNORE;
+        break;
+      case IGNORE_NO:
+        break;
+    }
+  }
+
+  if (entry->error) {
+    fprintf(stderr, "Error %s '%s' (%s).\n",
+        entry->type == PU_WALK_DIR ? "opening" : "reading",
+        path, strerror(entry->error));
+    return 0;
+  }
+
+  if (entry->type == PU_WALK_DIR) {
+    int flags = 0, descend = 1;
+    path[entry->pathlen] = '/';
+    path[entry->pathlen + 1] = '\0';
+    if ((entry->flags & SCAN_ORPHANS)
+        && !((flags = file_owned_flags(path)) & OWNED_PATH)) {
+      scan_found(ctx, &ctx->orphans_found, path);
+      /* an unowned directory with nothing owned below it is reported as a
+       * whole without descending into it */
+      if (!(flags & OWNED_ANCESTOR)) {
+        entry->flags &= ~SCAN_ORPHANS;
+        descend = entry->flags & SCAN_BACKUPS;
       }
+    }
+    path[entry->pathlen] = '\0';
+    if (descend && ctx->snap && (entry->flags & SCAN_ORPHANS)) {
+      descend = scan_snapshot_dir(ctx, path, entry->pathlen, flags);
+    }
+    return descend;
+  }
 
-      if (backups) {
-        if (strstr(filename, ".pacnew")
-            || strstr(filename, ".pacsave")
-            || strstr(filename, ".pacorig")) {
-          *backups_found = alpm_list_add(*backups_found, strdup(path));
-        }
+  if ((entry->flags & SCAN_ORPHANS) && file_is_unowned(path)) {
+    scan_found(ctx, &ctx->orphans_found, path);
+  }
+
+  if (entry->flags & SCAN_BACKUPS) {
+    if (strstr(entry->name, ".pacnew")
+        || strstr(entry->name, ".pacsave")
+        || strstr(entry->name, ".pacorig")) {
+      scan_found(ctx, &ctx->backups_found, path);
+    }
+  }
+
+  return 0;
+}
+
+static void snapshot_check(void *arg, size_t i) {
+  struct snap_dir *dir = &((struct snapshot *) arg)->dirs[i];
+  char path[PATH_MAX + 1];
+  struct stat st;
+
+  if (dir->len + 2 > sizeof(path) || lstat(dir->path, &st) != 0
+      || !S_ISDIR(st.st_mode)
+      || (dir->len > 1 && should_ignore_file(dir->path) == IGNORE_YES)) {
+    dir->state = SNAP_GONE;
+    return;
+  }
+
+  memcpy(path, dir->path, dir->len + 1);
+  if (dir->len > 1) {
+    path[dir->len] = '/';
+    path[dir->len + 1] = '\0';
+  }
+  dir->cur_flags = file_owned_flags(path);
+  dir->cur_names = dir_owned_names(dir->path, dir->len);
+  dir->cur_mtime = st.st_mtim;
+  dir->cur_ctime = st.st_ctim;
+  /* entries that changed ownership are only found by listing it again */
+  if (dir->names == dir->cur_names
+      && dir->mtime.tv_sec == st.st_mtim.tv_sec
+      && dir->mtime.tv_nsec == st.st_mtim.tv_nsec
+      && dir->ctime.tv_sec == st.st_ctim.tv_sec
+      && dir->ctime.tv_nsec == st.st_ctim.tv_nsec) {
+    dir->state = SNAP_SAME;
+  } else {
+    dir->state = SNAP_CHANGED;
+  }
+}
+
+/* records and walks a directory that is not in the previous snapshot */
+static void scan_walk_new(struct scan_ctx *ctx, const char *path, int jobs) {
+  size_t len = strlen(path);
+  char dir[PATH_MAX + 1];
+  int flags = 0;
+
+  if (len + 2 <= sizeof(dir)) {
+    memcpy(dir, path, len + 1);
+    if (len > 1) {
+      dir[len] = '/';
+      dir[len + 1] = '\0';
+    }
+    flags = file_owned_flags(dir);
+  }
+  scan_snapshot_dir(ctx, path, len, flags);
+  if (pu_walk(path, SCAN_ORPHANS, jobs, _scan_filesystem, ctx) != 0) {
+    fprintf(stderr, "Error scanning '%s' (%s).\n", path, strerror(errno));
+    ctx->incomplete = 1;
+  }
+}
+
+/* an unowned entry of an unchanged directory from the previous snapshot */
+static void scan_snapshot_entry(struct scan_ctx *ctx, const char *path) {
+  size_t len = strlen(path);
+  char entry[PATH_MAX];
+  int flags;
+
+  if (len >= sizeof(entry)) {
+    return;
+  }
+  memcpy(entry, path, len + 1);
+  if (entry[len - 1] == '/') {
+    entry[--len] = '\0';
+  }
+  if (should_ignore_file(entry) == IGNORE_YES) {
+    return;
+  }
+
+  if (!((flags = file_owned_flags(path)) & OWNED_PATH)) {
+    scan_found(ctx, &ctx->orphans_found, path);
+  }
+  /* a directory reported as a whole before may need to be descended into
+   * now that something below it is owned */
+  if (path[len] == '/' && (flags & (OWNED_PATH | OWNED_ANCESTOR))
+      && snapshot_find(ctx->prev, entry, len) == SIZE_MAX) {
+    scan_walk_new(ctx, entry, 0);
+  }
+}
+
+static void scan_snapshot_process(struct scan_ctx *ctx, size_t i) {
+  struct snap_dir *dir = &ctx->prev->dirs[i];
+  alpm_list_t *u;
+  size_t c;
+
+  scan_snapshot_record(ctx, dir->path, dir->len,
+      &dir->cur_mtime, &dir->cur_ctime, dir->cur_flags);
+
+  if (dir->state == SNAP_CHANGED) {
+    if (pu_walk(dir->path, SCAN_ORPHANS, 1, _scan_filesystem, ctx) != 0) {
+      fprintf(stderr, "Error scanning '%s' (%s).\n", dir->path, strerror(errno));
+      ctx->incomplete = 1;
+    }
+    return;
+  }
+
+  for (u = dir->unowned; u; u = u->next) {
+    scan_snapshot_entry(ctx, u->data);
+  }
+  for (c = dir->child; c != SIZE_MAX; c = ctx->prev->dirs[c].sibling) {
+    if (ctx->prev->dirs[c].state != SNAP_GONE) {
+      scan_queue_push(ctx, c);
+    }
+  }
+}
+
+/* Finds unowned files below base, listing only directories that changed
+ * since the previous snapshot.  Returns -1 if the previous snapshot could
+ * not be used at all. */
+int scan_unowned_incremental(struct scan_ctx *ctx, const char *base) {
+  struct snapshot *prev = ctx->old;
+  size_t i, root;
+
+  if (prev->rules != ignore_hash) {
+    /* entries ignored before were never recorded */
+    prev = NULL;
+  } else {
+    pu_parallel_for(prev->count, 0, snapshot_check, prev);
+    for (i = 0; i < prev->count; i++) {
+      struct snap_dir *dir = &prev->dirs[i];
+      if (dir->parent != SIZE_MAX
+          && (dir->state == SNAP_GONE || dir->cur_flags != dir->flags)
+          && prev->dirs[dir->parent].state == SNAP_SAME) {
+        prev->dirs[dir->parent].state = SNAP_CHANGED;
       }
     }
   }
-  closedir(dirp);
+  ctx->prev = prev;
+
+  root = prev ? snapshot_find(prev, base, strlen(base)) : SIZE_MAX;
+  if (root == SIZE_MAX || prev->dirs[root].state == SNAP_GONE) {
+    scan_walk_new(ctx, base, 0);
+  } else {
+    scan_queue_push(ctx, root);
+  }
+  while (ctx->nqueue) {
+    scan_snapshot_process(ctx, ctx->queue[--ctx->nqueue]);
+  }
+
+  return prev ? 0 : -1;
 }
 
 void find_backups(alpm_handle_t *handle, alpm_list_t **backups) {
@@ -599,46 +1750,156 @@ void find_backups(alpm_handle_t *handle, alpm_list_t **backups) {
   }
 }
 
-void scan_filesystem(alpm_handle_t *handle, int backups, int orphans) {
-  char *base_dir = "/etc/";
-  alpm_list_t *orphans_found = NULL, *backups_found = NULL;
-  if (backups > 1 || orphans) {
-    base_dir = "/";
-  } else {
-    find_backups(handle, &backups_found);
+void print_pathlist(const char *heading, const char *key, alpm_list_t *paths) {
+  alpm_list_t *i;
+  section.items += alpm_list_count(paths);
+  if (format == FORMAT_JSON) {
+    json_list_begin(key);
+    for (i = paths; i; i = i->next) {
+      json_list_item();
+      json_string(i->data);
+    }
+    putchar(']');
+    return;
   }
-  _scan_filesystem(handle, base_dir, backups, orphans, &backups_found,
-      &orphans_found);
+  puts(heading);
+  if (!paths) {
+    puts("  None");
+  }
+  for (i = paths; i; i = i->next) {
+    printf("  %s\n", (char *) i->data);
+  }
+}
 
-  if (orphans) {
+/* prints the changes in unowned files since the previous snapshot */
+void print_unowned_diff(alpm_list_t *old, alpm_list_t *cur) {
+  alpm_list_t *added = NULL, *removed = NULL, *a, *r;
+  while (old || cur) {
+    int cmp = !old ? 1 : !cur ? -1 : strcmp(old->data, cur->data);
+    if (cmp < 0) {
+      removed = alpm_list_add(removed, old->data);
+      old = old->next;
+    } else if (cmp > 0) {
+      added = alpm_list_add(added, cur->data);
+      cur = cur->next;
+    } else {
+      old = old->next;
+      cur = cur->next;
+    }
+  }
+
+  if (format == FORMAT_JSON) {
+    print_pathlist(NULL, "added", added);
+    print_pathlist(NULL, "removed", removed);
+  } else {
     puts("Unowned Files:");
-    if (!orphans_found) {
+    if (!added && !removed) {
       puts("  None");
-    } else {
-      alpm_list_t *i;
-      orphans_found = alpm_list_msort(orphans_found,
-              alpm_list_count(orphans_found), (alpm_list_fn_cmp) strcmp);
-      for (i = orphans_found; i; i = i->next) {
-        printf("  %s\n", (char *) i->data);
+    }
+    for (a = added, r = removed; a || r; ) {
+      if (!r || (a && strcmp(a->data, r->data) < 0)) {
+        printf("  + %s\n", (char *) a->data);
+        a = a->next;
+      } else {
+        printf("  - %s\n", (char *) r->data);
+        r = r->next;
       }
-      FREELIST(orphans_found);
     }
+    section.items += alpm_list_count(added) + alpm_list_count(removed);
   }
+  alpm_list_free(added);
+  alpm_list_free(removed);
+}
 
-  if (backups) {
-    puts("Pacman Backup Files:");
-    if (!backups_found) {
-      puts("  None");
+void scan_filesystem(alpm_handle_t *handle, int backups, int orphans) {
+  char *base_dir = "/etc/", *snap_path = NULL;
+  struct snapshot old = { .dirs = NULL }, snap = { .dirs = NULL };
+  struct scan_ctx ctx = { .orphans_found = NULL, .backups_found = NULL };
+  alpm_list_t *orphans_found, *backups_found;
+  int flags = (backups ? SCAN_BACKUPS : 0) | (orphans ? SCAN_ORPHANS : 0);
+  int have_snapshot = 0;
+
+  /* the walk is shared, so its time counts against the first section */
+  section_begin(orphans ? "unowned-files" : "backups");
+
+  if (ignore_tree_build(handle) != 0) {
+    pu_ui_error("unable to compile ignore rules (%s)\n", strerror(errno));
+    section_end();
+    return;
+  }
+
+  pthread_mutex_init(&ctx.lock, NULL);
+
+  if (orphans && incremental) {
+    /* unowned files are found from the snapshot; backups get their own
+     * walk below */
+    if ((snap_path = pu_prepend_dir(alpm_option_get_dbpath(handle),
+                "pacutils-unowned")) == NULL) {
+      pu_ui_error("%s\n", strerror(errno));
+      pthread_mutex_destroy(&ctx.lock);
+      section_end();
+      return;
+    }
+    if (snapshot_read(snap_path, &old) != 0) {
+      pu_ui_warn("unable to read snapshot '%s' (%s)\n",
+          snap_path, strerror(errno));
+      snapshot_free(&old);
+      memset(&old, 0, sizeof(old));
+    }
+    have_snapshot = old.count > 0;
+    ctx.old = &old;
+    ctx.snap = &snap;
+    scan_unowned_incremental(&ctx, "/");
+    ctx.snap = NULL;
+    flags &= ~SCAN_ORPHANS;
+  }
+
+  if (flags) {
+    if (backups > 1 || (flags & SCAN_ORPHANS)) {
+      base_dir = "/";
     } else {
-      alpm_list_t *i;
-      backups_found = alpm_list_msort(backups_found,
-              alpm_list_count(backups_found), (alpm_list_fn_cmp) strcmp);
-      for (i = backups_found; i; i = i->next) {
-        printf("  %s\n", (char *) i->data);
-      }
-      FREELIST(backups_found);
+      find_backups(handle, &ctx.backups_found);
+    }
+    if (pu_walk(base_dir, flags, 0, _scan_filesystem, &ctx) != 0) {
+      fprintf(stderr, "Error scanning '%s' (%s).\n", base_dir, strerror(errno));
     }
   }
+  pthread_mutex_destroy(&ctx.lock);
+  orphans_found = ctx.orphans_found;
+  backups_found = ctx.backups_found;
+
+  if (orphans) {
+    orphans_found = alpm_list_msort(orphans_found,
+        alpm_list_count(orphans_found), (alpm_list_fn_cmp) strcmp);
+    if (snap_path && !ctx.incomplete
+        && snapshot_write(snap_path, &snap, orphans_found) != 0) {
+      pu_ui_warn("unable to write snapshot '%s' (%s)\n",
+          snap_path, strerror(errno));
+    }
+
+    if (have_snapshot) {
+      print_unowned_diff(old.unowned, orphans_found);
+    } else {
+      print_pathlist("Unowned Files:", "files", orphans_found);
+    }
+    FREELIST(orphans_found);
+    section_end();
+  }
+  snapshot_free(&old);
+  snapshot_free(&snap);
+  free(ctx.queue);
+  free(snap_path);
+
+  if (backups) {
+    if (orphans) {
+      section_begin("backups");
+    }
+    backups_found = alpm_list_msort(backups_found,
+        alpm_list_count(backups_found), (alpm_list_fn_cmp) strcmp);
+    print_pathlist("Pacman Backup Files:", "files", backups_found);
+    FREELIST(backups_found);
+    section_end();
+  }
 }
 
 void usage(int ret) {
@@ -658,15 +1919,42 @@ void usage(int ret) {
   hputs("");
   hputs("   --backups          list .pac{save,orig,new} files");
   hputs("                      (pass twice for extended search outside /etc)");
+  hputs("   --cache-keep=<n>   estimate space reclaimed keeping <n> versions");
+  hputs("   --format=<fmt>     output format (text, json)");
   hputs("   --group=<GROUP>    list missing group packages");
   hputs("   --missing-files    list missing package files");
+  hputs("   --sections=<list>  comma-separated list of sections to print");
+  hputs("   --timings          print the time taken by each section");
   hputs("   --unowned-files    list unowned files");
+  hputs("   --incremental      only list changes in unowned files since the");
+  hputs("                      previous --incremental run");
   hputs("   --help             display this help information");
   hputs("   --version          display version information");
 #undef hputs
   exit(ret);
 }
 
+int parse_sections(const char *list) {
+  sections = 0;
+  while (*list) {
+    size_t len = strcspn(list, ",");
+    struct section_name *s;
+    for (s = section_names; s->name; s++) {
+      if (strncmp(s->name, list, len) == 0 && s->name[len] == '\0') {
+        sections |= s->flag;
+        break;
+      }
+    }
+    if (s->name == NULL) {
+      fprintf(stderr, "error: unknown section '%.*s'\n", (int) len, list);
+      return -1;
+    }
+    list += len;
+    if (*list == ',') { list++; }
+  }
+  return 0;
+}
+
 pu_config_t *parse_opts(int argc, char **argv) {
   char *config_file = PACMANCONF;
   int c;
@@ -682,10 +1970,15 @@ pu_config_t *parse_opts(int argc, char **argv) {
     { "sysroot", required_argument, NULL, FLAG_SYSROOT       },
 
     {"backups", no_argument, NULL, FLAG_BACKUPS       },
+    {"cache-keep", required_argument, NULL, FLAG_CACHE_KEEP    },
+    {"format", required_argument, NULL, FLAG_FORMAT        },
     {"group", required_argument, NULL, FLAG_GROUP         },
+    {"incremental", no_argument, NULL, FLAG_INCREMENTAL   },
     {"missing-files", no_argument, NULL, FLAG_MISSING_FILES },
     {"unowned-files", no_argument, NULL, FLAG_ORPHANS       },
     {"optional-deps", no_argument, NULL, FLAG_OPTIONAL_DEPS },
+    {"sections", required_argument, NULL, FLAG_SECTIONS      },
+    {"timings", no_argument, NULL, FLAG_TIMINGS       },
 
     {"help", no_argument, NULL, FLAG_HELP          },
     {"version", no_argument, NULL, FLAG_VERSION       },
@@ -717,6 +2010,17 @@ pu_config_t *parse_opts(int argc, char **argv) {
       case FLAG_GROUP:
         groups = alpm_list_add(groups, strdup(optarg));
         break;
+      case FLAG_CACHE_KEEP:
+        {
+          char *end;
+          long keep = strtol(optarg, &end, 10);
+          if (*optarg == '\0' || *end != '\0' || keep < 0 || keep > INT_MAX) {
+            fprintf(stderr, "error: invalid cache-keep count '%s'\n", optarg);
+            return NULL;
+          }
+          cache_keep = keep;
+        }
+        break;
       case FLAG_CACHEDIR:
         FREELIST(config->cachedirs);
         config->cachedirs = alpm_list_add(NULL, strdup(optarg));
@@ -728,6 +2032,27 @@ pu_config_t *parse_opts(int argc, char **argv) {
         free(config->dbpath);
         config->dbpath = strdup(optarg);
         break;
+      case FLAG_FORMAT:
+        if (strcmp(optarg, "text") == 0) {
+          format = FORMAT_TEXT;
+        } else if (strcmp(optarg, "json") == 0) {
+          format = FORMAT_JSON;
+        } else {
+          fprintf(stderr, "error: unknown format '%s'\n", optarg);
+          return NULL;
+        }
+        break;
+      case FLAG_SECTIONS:
+        if (parse_sections(optarg) != 0) {
+          return NULL;
+        }
+        break;
+      case FLAG_TIMINGS:
+        timings = 1;
+        break;
+      case FLAG_INCREMENTAL:
+        incremental = 1;
+        break;
       case FLAG_MISSING_FILES:
         ++missing_files;
         break;
@@ -751,6 +2076,14 @@ pu_config_t *parse_opts(int argc, char **argv) {
     }
   }
 
+  /* the options for optional sections imply the section and vice versa */
+  if (backup_files) { sections |= SECTION_BACKUPS; }
+  if (orphan_files) { sections |= SECTION_UNOWNED; }
+  if (missing_files) { sections |= SECTION_MISSING; }
+  if (groups) { sections |= SECTION_GROUPS; }
+  if ((sections & SECTION_BACKUPS) && !backup_files) { backup_files = 1; }
+  if ((sections & SECTION_UNOWNED) && !orphan_files) { orphan_files = 1; }
+
   if (!pu_ui_config_load_sysroot(config, config_file, sysroot)) {
     fprintf(stderr, "error: could not parse '%s'\n", config_file);
     return NULL;
@@ -803,6 +2136,7 @@ int main(int argc, char **argv) {
   int ret = 0;
 
   if (!(config = parse_opts(argc, argv))) {
+    ret = 1;
     goto cleanup;
   }
 
@@ -824,22 +2158,59 @@ int main(int argc, char **argv) {
     goto cleanup;
   }
 
+  if (orphan_files && owned_set_build(handle) != 0) {
+    pu_ui_error("unable to index package files (%s)\n", strerror(errno));
+    ret = 1;
+    goto cleanup;
+  }
+  if (orphan_files && incremental) {
+    owned_set_digest();
+  }
+
+  /* package lists include removable sizes */
+  if ((sections & (SECTION_UNNEEDED | SECTION_FOREIGN | SECTION_GROUPS))
+      && !(depgraph = pu_depgraph_new(
+              alpm_db_get_pkgcache(alpm_get_localdb(handle)), optional_deps))) {
+    pu_ui_error("unable to build dependency graph (%s)\n", strerror(errno));
+    ret = 1;
+    goto cleanup;
+  }
+
   if (backup_files || orphan_files) {
     scan_filesystem(handle, backup_files, orphan_files);
   }
 
-  print_unneeded_packages(handle);
-  print_foreign(handle);
-  if (groups) {
+  if (sections & SECTION_UNNEEDED) {
+    section_begin("unneeded");
+    print_unneeded_packages();
+    section_end();
+  }
+  if (sections & SECTION_FOREIGN) {
+    section_begin("foreign");
+    print_foreign(handle);
+    section_end();
+  }
+  if (sections & SECTION_GROUPS) {
+    section_begin("groups");
     print_group_missing(handle, groups);
+    section_end();
   }
-
-  if (missing_files) {
+  if (sections & SECTION_MISSING) {
+    section_begin("missing-files");
     print_missing_files(handle);
+    section_end();
+  }
+  if (sections & SECTION_CACHE) {
+    section_begin("cache");
+    print_cache_sizes(handle);
+    section_end();
   }
-  print_cache_sizes(handle);
 
 cleanup:
+  free(owned);
+  free(owned_pool);
+  pu_depgraph_free(depgraph);
+  ignore_node_free(ignore_tree);
   FREELIST(groups);
   FREELIST(ignore);
   alpm_list_free_inner(pkg_ignore, (alpm_list_fn_free) pkg_ignore_free);
@@ -28,6 +28,7 @@
 #include <getopt.h>
 #include <regex.h>
 #include <math.h>
+#include <sys/stat.h>
 
 #include <pacutils.h>
 
@@ -40,10 +41,17 @@ alpm_handle_t *handle = NULL;
 alpm_loglevel_t log_level = ALPM_LOG_ERROR | ALPM_LOG_WARNING;
 
 int srch_cache = 0, srch_local = 0, srch_sync = 0;
-int invert = 0, re = 0, exact = 0, any = 0, exists = 0;
-int osep = '\n', isep = '\n';
+int invert = 0, re = 0, exact = 0, any = 0, exists = 0, build_index = 0;
+int osep = '\n', isep = '\n', quiet = 0, reverse = 0, count = 0;
+size_t found = 0, limit = 0, match_count = 0;
+intmax_t match_sum = 0;
+struct field *sort_field = NULL, *sum_field = NULL;
+struct sort_item *sorted = NULL;
+size_t sorted_count = 0, sorted_size = 0;
 const char *dbext = NULL, *sysroot = NULL;
 alpm_list_t *search_dbs = NULL;
+/* handles the cached packages were loaded with, they outlive the haystack */
+alpm_list_t *load_handles = NULL;
 alpm_list_t *repo = NULL, *name = NULL, *description = NULL, *packager = NULL;
 alpm_list_t *base = NULL, *arch = NULL, *url = NULL;
 alpm_list_t *group = NULL, *license = NULL;
@@ -52,6 +60,8 @@ alpm_list_t *requiredby = NULL;
 alpm_list_t *provides = NULL, *depends = NULL, *optdepends = NULL,
              *conflicts = NULL, *replaces = NULL;
 alpm_list_t *satisfies = NULL;
+alpm_list_t *queries = NULL;
+struct query *query = NULL;
 alpm_list_t *isize = NULL, *size = NULL, *dsize = NULL;
 alpm_list_t *builddate = NULL, *installdate = NULL;
 
@@ -63,10 +73,12 @@ typedef alpm_list_t *(deplist_accessor) (alpm_pkg_t *pkg);
 
 enum longopt_flags {
   FLAG_CONFIG = 1000,
+  FLAG_DAEMON,
   FLAG_DBEXT,
   FLAG_DBPATH,
   FLAG_DEBUG,
   FLAG_HELP,
+  FLAG_LIMIT,
   FLAG_NULL,
   FLAG_ROOT,
   FLAG_SYSROOT,
@@ -85,10 +97,13 @@ enum longopt_flags {
   FLAG_ISIZE,
   FLAG_DSIZE,
   FLAG_SIZE,
+  FLAG_SORT,
+  FLAG_SUM,
   FLAG_LICENSE,
   FLAG_OWNSFILE,
   FLAG_PACKAGER,
   FLAG_PROVIDES,
+  FLAG_QUERY,
   FLAG_DEPENDS,
   FLAG_OPTDEPENDS,
   FLAG_CONFLICTS,
@@ -117,9 +132,14 @@ struct date_cmp {
   enum cmp cmp;
 };
 
+void query_free(struct query *q);
+
 void cleanup(int ret) {
+  query_free(query);
+  free(sorted);
   alpm_list_free(search_dbs);
-  alpm_release(handle);
+  pu_release_handle(handle);
+  pu_pkg_load_release(load_handles);
   pu_config_free(config);
 
   FREELIST(repo);
@@ -136,6 +156,7 @@ void cleanup(int ret) {
 
   FREELIST(provides);
   FREELIST(satisfies);
+  FREELIST(queries);
   FREELIST(url);
   FREELIST(depends);
   FREELIST(optdepends);
@@ -315,10 +336,6 @@ const char *get_dbname(alpm_pkg_t *pkg) {
   return alpm_db_get_name(alpm_pkg_get_db(pkg));
 }
 
-int ptr_cmp(const void *p1, const void *p2) {
-  return p1 < p2 ? -1 : p1 > p2;
-}
-
 /* regcmp wrapper with error handling */
 void _regcomp(regex_t *preg, const char *regex, int cflags) {
   int err;
@@ -330,46 +347,76 @@ void _regcomp(regex_t *preg, const char *regex, int cflags) {
   }
 }
 
-alpm_list_t *filter_filelist(alpm_list_t **pkgs, const char *str,
-    const char *root, const size_t rootlen) {
-  alpm_list_t *p, *matches = NULL;
-  if (re) {
+/* compiled regexes are cached for the lifetime of the program */
+regex_t *get_regex(const char *str) {
+  static alpm_list_t *cache = NULL;
+  struct compiled_regex {
+    const char *str;
     regex_t preg;
-    _regcomp(&preg, str, REG_EXTENDED | REG_ICASE | REG_NOSUB);
-    for (p = *pkgs; p; p = p->next) {
-      alpm_filelist_t *files = alpm_pkg_get_files(p->data);
-      size_t i;
-      for (i = 0; i < files->count; ++i) {
-        if (regexec(&preg, files->files[i].name, 0, NULL, 0) == 0) {
-          matches = alpm_list_add(matches, p->data);
-          break;
-        }
-      }
-    }
-    regfree(&preg);
+  } *cr;
+  alpm_list_t *i;
+  for (i = cache; i; i = i->next) {
+    cr = i->data;
+    if (cr->str == str) { return &cr->preg; }
+  }
+  if ((cr = malloc(sizeof(struct compiled_regex))) == NULL
+      || alpm_list_append(&cache, cr) == NULL) {
+    perror("malloc");
+    cleanup(1);
+  }
+  cr->str = str;
+  _regcomp(&cr->preg, str, REG_EXTENDED | REG_ICASE | REG_NOSUB);
+  return &cr->preg;
+}
+
+int match_str(const char *s, const char *str) {
+  if (re) {
+    return regexec(get_regex(str), s, 0, NULL, 0) == 0;
   } else if (exact) {
-    if (strncmp(str, root, rootlen) == 0) { str += rootlen; }
-    for (p = *pkgs; p; p = p->next) {
-      if (alpm_filelist_contains(alpm_pkg_get_files(p->data), str)) {
-        matches = alpm_list_add(matches, p->data);
-      }
-    }
+    return strcasecmp(s, str) == 0;
   } else {
-    for (p = *pkgs; p; p = p->next) {
-      alpm_filelist_t *files = alpm_pkg_get_files(p->data);
-      size_t i;
-      for (i = 0; i < files->count; ++i) {
-        if (strcasestr(files->files[i].name, str)) {
-          matches = alpm_list_add(matches, p->data);
-          break;
-        }
-      }
-    }
+    return strcasestr(s, str) != NULL;
   }
-  for (p = matches; p; p = p->next) {
-    *pkgs = alpm_list_remove(*pkgs, p->data, ptr_cmp, NULL);
+}
+
+enum match_mode {
+  MATCH_SUBSTR,
+  MATCH_EXACT,
+  MATCH_REGEX,
+};
+
+/* exact file paths may be given with the root, the file lists are relative */
+const char *strip_root_mode(const char *path, enum match_mode mode) {
+  const char *root = alpm_option_get_root(handle);
+  size_t rootlen = strlen(root);
+  if (mode == MATCH_EXACT && strncmp(path, root, rootlen) == 0) {
+    return path + rootlen;
   }
-  return matches;
+  return path;
+}
+
+const char *strip_root(const char *path) {
+  return strip_root_mode(path, exact && !re ? MATCH_EXACT : MATCH_SUBSTR);
+}
+
+/* file paths are compared case-sensitively with --exact */
+int match_file(const char *file, const char *str) {
+  if (exact && !re) {
+    return strcmp(file, strip_root(str)) == 0;
+  } else {
+    return match_str(file, str);
+  }
+}
+
+int depmatch(alpm_depend_t *d, alpm_depend_t *needle, int exact_version) {
+  if (needle->name_hash != d->name_hash || strcmp(needle->name, d->name) != 0) {
+    return 0;
+  }
+
+  if (!exact_version && !needle->version) { return 1; }
+
+  return needle->mod == d->mod
+    && alpm_pkg_vercmp(needle->version, d->version) == 0;
 }
 
 int match_date(struct date_cmp *date, alpm_time_t time) {
@@ -410,210 +457,947 @@ int match_size(struct size_cmp *size, off_t bytes) {
   }
 }
 
-alpm_list_t *filter_date(alpm_list_t **pkgs, struct date_cmp *date,
-    date_accessor *func) {
-  alpm_list_t *p, *matches = NULL;
-  for (p = *pkgs; p; p = p->next) {
-    alpm_time_t time = func(p->data);
-    if (match_date(date, time)) {
-      matches = alpm_list_add(matches, p->data);
+enum field_type {
+  FIELD_STR,
+  FIELD_STRLIST,
+  FIELD_FILES,
+  FIELD_DEPLIST,
+  FIELD_SATISFIES,
+  FIELD_SIZE,
+  FIELD_DATE,
+};
+
+/* searchable package fields, in roughly increasing order of the cost of
+ * matching them; field options are checked in this order */
+struct field {
+  const char *name, *alias;
+  enum field_type type;
+  alpm_list_t **values;
+  str_accessor *str;
+  strlist_accessor *strlist;
+  deplist_accessor *deplist;
+  size_accessor *size;
+  date_accessor *date;
+} fields[] = {
+  { "repo", NULL, FIELD_STR, &repo, .str = get_dbname },
+  { "name", NULL, FIELD_STR, &name, .str = alpm_pkg_get_name },
+  { "base", NULL, FIELD_STR, &base, .str = alpm_pkg_get_base },
+  { "architecture", "arch", FIELD_STR, &arch, .str = alpm_pkg_get_arch },
+  { "description", "desc", FIELD_STR, &description, .str = alpm_pkg_get_desc },
+  { "packager", NULL, FIELD_STR, &packager, .str = alpm_pkg_get_packager },
+  { "url", NULL, FIELD_STR, &url, .str = alpm_pkg_get_url },
+  { "group", NULL, FIELD_STRLIST, &group, .strlist = alpm_pkg_get_groups },
+  { "license", NULL, FIELD_STRLIST, &license, .strlist = alpm_pkg_get_licenses },
+  { "installed-size", "isize", FIELD_SIZE, &isize, .size = alpm_pkg_get_isize },
+  { "size", NULL, FIELD_SIZE, &size, .size = alpm_pkg_get_size },
+  { "download-size", "dsize", FIELD_SIZE, &dsize, .size = alpm_pkg_download_size },
+  { "build-date", NULL, FIELD_DATE, &builddate, .date = alpm_pkg_get_builddate },
+  { "install-date", NULL, FIELD_DATE, &installdate, .date = alpm_pkg_get_installdate },
+  { "provides", NULL, FIELD_DEPLIST, &provides, .deplist = alpm_pkg_get_provides },
+  { "depends", NULL, FIELD_DEPLIST, &depends, .deplist = alpm_pkg_get_depends },
+  { "optdepends", NULL, FIELD_DEPLIST, &optdepends, .deplist = alpm_pkg_get_optdepends },
+  { "conflicts", NULL, FIELD_DEPLIST, &conflicts, .deplist = alpm_pkg_get_conflicts },
+  { "replaces", NULL, FIELD_DEPLIST, &replaces, .deplist = alpm_pkg_get_replaces },
+  { "satisfies", NULL, FIELD_SATISFIES, &satisfies, .str = NULL },
+  { "owns-file", NULL, FIELD_FILES, &ownsfile, .str = NULL },
+  { .name = NULL },
+};
+
+struct field *field_find(const char *name, size_t len) {
+  struct field *f;
+  for (f = fields; f->name; f++) {
+    if ((strlen(f->name) == len && strncmp(name, f->name, len) == 0)
+        || (f->alias && strlen(f->alias) == len
+          && strncmp(name, f->alias, len) == 0)) {
+      return f;
     }
   }
-  for (p = matches; p; p = p->next) {
-    *pkgs = alpm_list_remove(*pkgs, p->data, ptr_cmp, NULL);
+  return NULL;
+}
+
+/* numeric value of a size or date field for sorting and summing */
+intmax_t field_value(struct field *f, alpm_pkg_t *pkg) {
+  return f->type == FIELD_SIZE ? (intmax_t) f->size(pkg) : (intmax_t) f->date(pkg);
+}
+
+enum query_type {
+  QUERY_TRUE,
+  QUERY_TERM,
+  QUERY_NOT,
+  QUERY_AND,
+  QUERY_OR,
+};
+
+/* compiled search criteria; terms hold everything needed to test a package
+ * (compiled regex, parsed dependency, comparison) so evaluation does no
+ * parsing or allocation */
+struct query {
+  enum query_type type;
+  struct query *lhs, *rhs;
+  struct field *field;
+  enum match_mode mode;
+  char *str;
+  regex_t preg;
+  alpm_depend_t *dep;
+  struct size_cmp size;
+  struct date_cmp date;
+};
+
+void query_free(struct query *q) {
+  if (q == NULL) { return; }
+  query_free(q->lhs);
+  query_free(q->rhs);
+  if (q->type == QUERY_TERM && q->mode == MATCH_REGEX) { regfree(&q->preg); }
+  alpm_dep_free(q->dep);
+  free(q->str);
+  free(q);
+}
+
+struct query *query_new(enum query_type type, struct query *lhs,
+    struct query *rhs) {
+  struct query *q = calloc(sizeof(struct query), 1);
+  if (q == NULL) {
+    perror("malloc");
+    cleanup(1);
   }
-  return matches;
+  q->type = type;
+  q->lhs = lhs;
+  q->rhs = rhs;
+  return q;
 }
 
-alpm_list_t *filter_size(alpm_list_t **pkgs, struct size_cmp *size,
-    size_accessor *func) {
-  alpm_list_t *p, *matches = NULL;
-  for (p = *pkgs; p; p = p->next) {
-    off_t bytes = func(p->data);
-    if (match_size(size, bytes)) {
-      matches = alpm_list_add(matches, p->data);
-    }
+/* joins two queries, either of which may be NULL */
+struct query *query_join(enum query_type type, struct query *lhs,
+    struct query *rhs) {
+  if (lhs == NULL) { return rhs; }
+  if (rhs == NULL) { return lhs; }
+  return query_new(type, lhs, rhs);
+}
+
+/* str is the term's value as given by the user; size and date values
+ * include their comparison operator */
+struct query *query_term(struct field *field, enum match_mode mode,
+    const char *str) {
+  struct query *q = query_new(QUERY_TERM, NULL, NULL);
+  q->field = field;
+  q->mode = mode;
+
+  switch (field->type) {
+    case FIELD_SIZE:
+      {
+        struct size_cmp *s = parse_size(str);
+        if (s == NULL) {
+          fprintf(stderr, "error: invalid size comparison '%s'\n", str);
+          cleanup(1);
+        }
+        q->size = *s;
+        free(s);
+      }
+      return q;
+    case FIELD_DATE:
+      {
+        struct date_cmp *d = parse_date(str);
+        if (d == NULL) {
+          fprintf(stderr, "error: invalid date '%s'\n", str);
+          cleanup(1);
+        }
+        q->date = *d;
+        free(d);
+      }
+      return q;
+    case FIELD_FILES:
+      str = strip_root_mode(str, mode);
+      break;
+    case FIELD_DEPLIST:
+      if ((q->dep = alpm_dep_from_string(str)) == NULL) {
+        fprintf(stderr, "error: invalid dependency '%s'\n", str);
+        cleanup(1);
+      }
+      break;
+    default:
+      break;
+  }
+
+  if ((q->str = strdup(str)) == NULL) {
+    perror("malloc");
+    cleanup(1);
   }
-  for (p = matches; p; p = p->next) {
-    *pkgs = alpm_list_remove(*pkgs, p->data, ptr_cmp, NULL);
+  if (mode == MATCH_REGEX) {
+    _regcomp(&q->preg, str, REG_EXTENDED | REG_ICASE | REG_NOSUB);
   }
-  return matches;
+  return q;
 }
 
-alpm_list_t *filter_str(alpm_list_t **pkgs, const char *str,
-    str_accessor *func) {
-  alpm_list_t *p, *matches = NULL;
-  if (re) {
-    regex_t preg;
-    _regcomp(&preg, str, REG_EXTENDED | REG_ICASE | REG_NOSUB);
-    for (p = *pkgs; p; p = p->next) {
-      const char *s = func(p->data);
-      if (s && regexec(&preg, s, 0, NULL, 0) == 0) {
-        matches = alpm_list_add(matches, p->data);
+/* combines the individual field options, returns NULL if there are none */
+struct query *query_from_opts(void) {
+  enum match_mode mode = re ? MATCH_REGEX : exact ? MATCH_EXACT : MATCH_SUBSTR;
+  struct query *q = NULL;
+  struct field *f;
+
+  for (f = fields; f->name; f++) {
+    struct query *fq = NULL;
+    alpm_list_t *i;
+    for (i = *f->values; i; i = i->next) {
+      struct query *t;
+      if (f->type == FIELD_SIZE || f->type == FIELD_DATE) {
+        t = query_new(QUERY_TERM, NULL, NULL);
+        t->field = f;
+        if (f->type == FIELD_SIZE) {
+          t->size = *(struct size_cmp *) i->data;
+        } else {
+          t->date = *(struct date_cmp *) i->data;
+        }
+      } else if (f->type == FIELD_DEPLIST || f->type == FIELD_SATISFIES) {
+        /* dependencies are never matched as regular expressions */
+        t = query_term(f, exact ? MATCH_EXACT : MATCH_SUBSTR, i->data);
+      } else {
+        t = query_term(f, mode, i->data);
       }
+      fq = query_join(QUERY_OR, fq, t);
     }
-    regfree(&preg);
-  } else if (exact) {
-    for (p = *pkgs; p; p = p->next) {
-      const char *s = func(p->data);
-      if (s && strcasecmp(s, str) == 0) {
-        matches = alpm_list_add(matches, p->data);
+    q = query_join(any ? QUERY_OR : QUERY_AND, q, fq);
+  }
+
+  return q;
+}
+
+int query_uses_field(struct query *q, enum field_type type) {
+  if (q == NULL) { return 0; }
+  if (q->type == QUERY_TERM) { return q->field->type == type; }
+  return query_uses_field(q->lhs, type) || query_uses_field(q->rhs, type);
+}
+
+int term_match_str(struct query *q, const char *s) {
+  if (s == NULL) { return 0; }
+  switch (q->mode) {
+    case MATCH_REGEX:
+      return regexec(&q->preg, s, 0, NULL, 0) == 0;
+    case MATCH_EXACT:
+      return strcasecmp(s, q->str) == 0;
+    default:
+      return strcasestr(s, q->str) != NULL;
+  }
+}
+
+/* exact matches against string lists are case-sensitive */
+int term_match_strlist(struct query *q, alpm_list_t *strs) {
+  if (q->mode == MATCH_EXACT) {
+    return alpm_list_find_str(strs, q->str) != NULL;
+  }
+  for (; strs; strs = strs->next) {
+    if (term_match_str(q, strs->data)) { return 1; }
+  }
+  return 0;
+}
+
+int term_match(struct query *q, alpm_pkg_t *pkg) {
+  struct field *f = q->field;
+  alpm_list_t *i;
+
+  switch (f->type) {
+    case FIELD_STR:
+      return term_match_str(q, f->str(pkg));
+    case FIELD_STRLIST:
+      return term_match_strlist(q, f->strlist(pkg));
+    case FIELD_FILES:
+      {
+        alpm_filelist_t *files = alpm_pkg_get_files(pkg);
+        size_t n;
+        if (q->mode == MATCH_EXACT) {
+          return alpm_filelist_contains(files, q->str) != NULL;
+        }
+        for (n = 0; files && n < files->count; ++n) {
+          if (term_match_str(q, files->files[n].name)) { return 1; }
+        }
+      }
+      return 0;
+    case FIELD_DEPLIST:
+      for (i = f->deplist(pkg); i; i = i->next) {
+        if (depmatch(i->data, q->dep, q->mode == MATCH_EXACT)) { return 1; }
+      }
+      return 0;
+    case FIELD_SATISFIES:
+      {
+        alpm_list_t l = { .data = pkg, .prev = NULL, .next = NULL };
+        l.prev = &l;
+        return alpm_find_satisfier(&l, q->str) != NULL;
       }
+    case FIELD_SIZE:
+      return match_size(&q->size, f->size(pkg));
+    case FIELD_DATE:
+      return match_date(&q->date, f->date(pkg));
+  }
+  return 0;
+}
+
+int query_eval(struct query *q, alpm_pkg_t *pkg) {
+  switch (q->type) {
+    case QUERY_TRUE:
+      return 1;
+    case QUERY_TERM:
+      return term_match(q, pkg);
+    case QUERY_NOT:
+      return !query_eval(q->lhs, pkg);
+    case QUERY_AND:
+      return query_eval(q->lhs, pkg) && query_eval(q->rhs, pkg);
+    case QUERY_OR:
+      return query_eval(q->lhs, pkg) || query_eval(q->rhs, pkg);
+  }
+  return 0;
+}
+
+/* evaluates q knowing only the name of a package's database; returns -1 if
+ * the result depends on other fields */
+int query_eval_db(struct query *q, const char *dbname) {
+  int l, r;
+  switch (q->type) {
+    case QUERY_TRUE:
+      return 1;
+    case QUERY_TERM:
+      if (q->field->str != get_dbname) { return -1; }
+      return term_match_str(q, dbname);
+    case QUERY_NOT:
+      l = query_eval_db(q->lhs, dbname);
+      return l == -1 ? -1 : !l;
+    case QUERY_AND:
+      if ((l = query_eval_db(q->lhs, dbname)) == 0) { return 0; }
+      if ((r = query_eval_db(q->rhs, dbname)) == 0) { return 0; }
+      return l == 1 && r == 1 ? 1 : -1;
+    case QUERY_OR:
+      if ((l = query_eval_db(q->lhs, dbname)) == 1) { return 1; }
+      if ((r = query_eval_db(q->rhs, dbname)) == 1) { return 1; }
+      return l == 0 && r == 0 ? 0 : -1;
+  }
+  return -1;
+}
+
+struct query_parser {
+  const char *str, *pos;
+};
+
+void query_error(struct query_parser *p, const char *msg) {
+  fprintf(stderr, "error: invalid query '%s': %s at offset %d\n",
+      p->str, msg, (int) (p->pos - p->str));
+  cleanup(1);
+}
+
+void query_skip_space(struct query_parser *p) {
+  while (isspace((unsigned char) *p->pos)) { p->pos++; }
+}
+
+/* consumes a keyword or operator if it is next in the input; words must be
+ * followed by a delimiter */
+int query_accept(struct query_parser *p, const char *word, const char *sym) {
+  size_t len;
+  query_skip_space(p);
+  if (sym && strncmp(p->pos, sym, (len = strlen(sym))) == 0) {
+    p->pos += len;
+    return 1;
+  }
+  if (word == NULL) { return 0; }
+  len = strlen(word);
+  if (strncasecmp(p->pos, word, len) == 0
+      && (p->pos[len] == '\0' || p->pos[len] == '(' || p->pos[len] == ')'
+        || isspace((unsigned char) p->pos[len]))) {
+    p->pos += len;
+    return 1;
+  }
+  return 0;
+}
+
+/* reads a bare or quoted value, returns a newly allocated string; bare values
+ * end at whitespace, parentheses, "&&", or "||" */
+char *query_value(struct query_parser *p) {
+  char *val, *v;
+  query_skip_space(p);
+  if ((v = val = malloc(strlen(p->pos) + 1)) == NULL) {
+    perror("malloc");
+    cleanup(1);
+  }
+  if (*p->pos == '"' || *p->pos == '\'') {
+    char quote = *p->pos++;
+    while (*p->pos && *p->pos != quote) {
+      if (*p->pos == '\\' && quote == '"' && p->pos[1]) { p->pos++; }
+      *v++ = *p->pos++;
+    }
+    if (*p->pos != quote) {
+      free(val);
+      query_error(p, "unterminated string");
+    }
+    p->pos++;
+  } else {
+    while (*p->pos && !strchr("()", *p->pos)
+        && strncmp(p->pos, "&&", 2) != 0 && strncmp(p->pos, "||", 2) != 0
+        && !isspace((unsigned char) *p->pos)) {
+      *v++ = *p->pos++;
+    }
+  }
+  *v = '\0';
+  if (*val == '\0') {
+    free(val);
+    query_error(p, "missing value");
+  }
+  return val;
+}
+
+struct query *query_parse_term(struct query_parser *p) {
+  enum match_mode mode = re ? MATCH_REGEX : exact ? MATCH_EXACT : MATCH_SUBSTR;
+  size_t len = strspn(p->pos, "abcdefghijklmnopqrstuvwxyz-");
+  struct query *q;
+  struct field *f;
+  int negate = 0;
+  char op = '\0', *val;
+
+  if (len == 0 || (f = field_find(p->pos, len)) == NULL) {
+    query_error(p, "unknown field");
+  }
+  p->pos += len;
+  query_skip_space(p);
+
+  if (f->type == FIELD_SIZE || f->type == FIELD_DATE) {
+    /* keep the comparison operator with the value */
+    char *cmp, *v;
+    size_t cmplen;
+    if (*p->pos == ':') { p->pos++; }
+    query_skip_space(p);
+    cmplen = strspn(p->pos, "=<>!");
+    if ((cmp = strndup(p->pos, cmplen)) == NULL) {
+      perror("malloc");
+      cleanup(1);
+    }
+    p->pos += cmplen;
+    v = query_value(p);
+    val = pu_asprintf("%s%s", cmp, v);
+    free(cmp);
+    free(v);
+    if (val == NULL) {
+      perror("malloc");
+      cleanup(1);
     }
   } else {
-    for (p = *pkgs; p; p = p->next) {
-      const char *s = func(p->data);
-      if (s && strcasestr(s, str)) {
-        matches = alpm_list_add(matches, p->data);
+    if (*p->pos == '!' && (p->pos[1] == '=' || p->pos[1] == '~')) {
+      negate = 1;
+      p->pos++;
+    }
+    if (*p->pos == '=' || *p->pos == '~' || *p->pos == ':') {
+      op = *p->pos++;
+    }
+    if (op == '=') {
+      mode = MATCH_EXACT;
+    } else if (op == '~') {
+      mode = MATCH_REGEX;
+    }
+    if (f->type == FIELD_DEPLIST || f->type == FIELD_SATISFIES) {
+      /* dependencies are never matched as regular expressions */
+      if (op == '~') {
+        query_error(p, "dependencies cannot be matched with a regex");
+      } else if (op != '=') {
+        mode = exact ? MATCH_EXACT : MATCH_SUBSTR;
       }
     }
+    val = query_value(p);
   }
-  for (p = matches; p; p = p->next) {
-    *pkgs = alpm_list_remove(*pkgs, p->data, ptr_cmp, NULL);
+
+  q = query_term(f, mode, val);
+  free(val);
+  return negate ? query_new(QUERY_NOT, q, NULL) : q;
+}
+
+struct query *query_parse_or(struct query_parser *p);
+
+struct query *query_parse_not(struct query_parser *p) {
+  struct query *q;
+  if (query_accept(p, "not", "!")) {
+    return query_new(QUERY_NOT, query_parse_not(p), NULL);
+  } else if (query_accept(p, NULL, "(")) {
+    q = query_parse_or(p);
+    if (!query_accept(p, NULL, ")")) { query_error(p, "expected ')'"); }
+    return q;
+  } else if (*p->pos == '\0' || *p->pos == ')') {
+    query_error(p, "expected a field");
   }
-  return matches;
+  return query_parse_term(p);
 }
 
-int depcmp(alpm_depend_t *d, alpm_depend_t *needle) {
-  if (needle->name_hash != d->name_hash || strcmp(needle->name, d->name) != 0) {
-    return 1;
+/* adjacent terms are implicitly joined with AND */
+struct query *query_parse_and(struct query_parser *p) {
+  struct query *q = query_parse_not(p);
+  while (1) {
+    const char *save;
+    query_skip_space(p);
+    save = p->pos;
+    if (*p->pos == '\0' || *p->pos == ')') { break; }
+    if (query_accept(p, "or", "||")) {
+      /* leave it for query_parse_or */
+      p->pos = save;
+      break;
+    }
+    query_accept(p, "and", "&&");
+    q = query_new(QUERY_AND, q, query_parse_not(p));
   }
+  return q;
+}
 
-  if (!exact && !needle->version) { return 0; }
+struct query *query_parse_or(struct query_parser *p) {
+  struct query *q = query_parse_and(p);
+  while (query_accept(p, "or", "||")) {
+    q = query_new(QUERY_OR, q, query_parse_and(p));
+  }
+  return q;
+}
 
-  if (needle->mod == d->mod
-      && alpm_pkg_vercmp(needle->version, d->version) == 0) {
-    return 0;
+struct query *query_parse(const char *str) {
+  struct query_parser p = { str, str };
+  struct query *q = query_parse_or(&p);
+  query_skip_space(&p);
+  if (*p.pos != '\0') { query_error(&p, "unexpected ')'"); }
+  return q;
+}
+
+/* packages must match both the field options and every --query */
+struct query *query_compile(void) {
+  struct query *q = query_from_opts();
+  alpm_list_t *i;
+
+  for (i = queries; i; i = i->next) {
+    q = query_join(QUERY_AND, q, query_parse(i->data));
   }
 
-  return 1;
+  /* an empty intersection matches everything, an empty union nothing */
+  if (q == NULL) {
+    q = query_new(QUERY_TRUE, NULL, NULL);
+    if (any) { q = query_new(QUERY_NOT, q, NULL); }
+  }
+  /* --invert has never had any effect together with --any */
+  if (invert && !any) {
+    q = query_new(QUERY_NOT, q, NULL);
+  }
+  return q;
 }
 
-alpm_list_t *filter_satisfies(alpm_list_t **pkgs, const char *depstr) {
-  alpm_list_t *matches = NULL;
+struct sort_item {
   alpm_pkg_t *pkg;
-  while ((pkg = alpm_find_satisfier(*pkgs, depstr))) {
-    *pkgs = alpm_list_remove(*pkgs, pkg, ptr_cmp, NULL);
-    matches = alpm_list_add(matches, pkg);
+  intmax_t key;
+  size_t seq;
+};
+
+/* returns < 0 if a sorts before b, ties keep search order */
+int sort_cmp(const void *p1, const void *p2) {
+  const struct sort_item *a = p1, *b = p2;
+  if (a->key != b->key) {
+    return (a->key < b->key) == !reverse ? -1 : 1;
   }
-  return matches;
+  return a->seq < b->seq ? -1 : a->seq > b->seq;
 }
 
-alpm_list_t *filter_deplist(alpm_list_t **pkgs, const char *str,
-    deplist_accessor *func) {
-  alpm_list_t *p, *matches = NULL;
-  alpm_depend_t *needle = alpm_dep_from_string(str);
-  if (needle == NULL) {
-    fprintf(stderr, "error: invalid dependency '%s'\n", str);
-    cleanup(1);
+void sort_swap(size_t i, size_t j) {
+  struct sort_item tmp = sorted[i];
+  sorted[i] = sorted[j];
+  sorted[j] = tmp;
+}
+
+/* With --limit the best matches are kept in a bounded heap with the worst of
+ * them at the root so that it can be replaced in O(log n); otherwise every
+ * match is kept.  Either way the result is sorted once at the end. */
+void sort_add(alpm_pkg_t *pkg) {
+  struct sort_item item = { pkg, field_value(sort_field, pkg), found };
+  size_t i, c;
+
+  if (limit && sorted_count == limit) {
+    if (sort_cmp(&item, &sorted[0]) >= 0) { return; }
+    sorted[0] = item;
+    for (i = 0; (c = 2 * i + 1) < sorted_count; i = c) {
+      if (c + 1 < sorted_count && sort_cmp(&sorted[c + 1], &sorted[c]) > 0) {
+        c++;
+      }
+      if (sort_cmp(&sorted[c], &sorted[i]) <= 0) { break; }
+      sort_swap(i, c);
+    }
+    return;
   }
-  for (p = *pkgs; p; p = p->next) {
-    alpm_list_t *deps = func(p->data);
-    if (alpm_list_find(deps, needle, (alpm_list_fn_cmp) depcmp)) {
-      matches = alpm_list_add(matches, p->data);
+
+  if (sorted_count == sorted_size) {
+    size_t newsize = sorted_size ? sorted_size * 2 : 64;
+    struct sort_item *newsorted = realloc(sorted, newsize * sizeof(*sorted));
+    if (newsorted == NULL) {
+      perror("malloc");
+      cleanup(1);
     }
+    sorted = newsorted;
+    sorted_size = newsize;
   }
-  for (p = matches; p; p = p->next) {
-    *pkgs = alpm_list_remove(*pkgs, p->data, ptr_cmp, NULL);
+  sorted[sorted_count] = item;
+  for (i = sorted_count++; limit && i > 0; i = (i - 1) / 2) {
+    if (sort_cmp(&sorted[i], &sorted[(i - 1) / 2]) <= 0) { break; }
+    sort_swap(i, (i - 1) / 2);
   }
-  alpm_dep_free(needle);
-  return matches;
 }
 
-alpm_list_t *filter_strlist(alpm_list_t **pkgs, const char *str,
-    strlist_accessor *func) {
-  alpm_list_t *p, *matches = NULL;
-  if (re) {
-    regex_t preg;
-    _regcomp(&preg, str, REG_EXTENDED | REG_ICASE | REG_NOSUB);
-    for (p = *pkgs; p; p = p->next) {
-      alpm_list_t *h = func(p->data);
-      for (; h; h = h->next ) {
-        if (regexec(&preg, h->data, 0, NULL, 0) == 0) {
-          matches = alpm_list_add(matches, p->data);
-          break;
-        }
-      }
+/* the search can stop early unless all matches need to be sorted */
+int search_done(void) {
+  return limit && found >= limit && !sort_field;
+}
+
+void output_match(alpm_pkg_t *pkg) {
+  match_count++;
+  if (sum_field) {
+    match_sum += field_value(sum_field, pkg);
+  }
+  if (!quiet && !count && !sum_field) {
+    pu_fprint_pkgspec(stdout, pkg);
+    fputc(osep, stdout);
+  }
+}
+
+void print_match(alpm_pkg_t *pkg) {
+  if (sort_field) {
+    sort_add(pkg);
+  } else {
+    output_match(pkg);
+  }
+  found++;
+}
+
+void print_results(void) {
+  size_t i;
+  if (sort_field) {
+    qsort(sorted, sorted_count, sizeof(struct sort_item), sort_cmp);
+    for (i = 0; i < sorted_count; i++) {
+      output_match(sorted[i].pkg);
     }
-    regfree(&preg);
-  } else if (exact) {
-    for (p = *pkgs; p; p = p->next) {
-      if (alpm_list_find_str(func(p->data), str)) {
-        matches = alpm_list_add(matches, p->data);
+  }
+  if (count) {
+    printf("%zu", match_count);
+    fputc(osep, stdout);
+  }
+  if (sum_field) {
+    printf("%jd", match_sum);
+    fputc(osep, stdout);
+  }
+}
+
+/* streams pkgs through the search criteria, stopping once enough matches
+ * have been found */
+void search_pkgs(alpm_list_t *pkgs) {
+  for (; pkgs && !search_done(); pkgs = pkgs->next) {
+    if (query_eval(query, pkgs->data)) { print_match(pkgs->data); }
+  }
+}
+
+/* packages from a database the query rules out by name never need to be
+ * loaded; packages without a database have a NULL dbname */
+int db_may_match(const char *dbname) {
+  return query_eval_db(query, dbname) != 0;
+}
+
+enum index_field {
+  INDEX_NAME,
+  INDEX_DESCRIPTION,
+  INDEX_PACKAGER,
+  INDEX_URL,
+  INDEX_FILES,
+  INDEX_NFIELDS,
+};
+
+alpm_list_t **index_values[INDEX_NFIELDS] = {
+  &name, &description, &packager, &url, &ownsfile,
+};
+
+/* the index can only answer queries that consist entirely of indexed fields
+ * (and the repo name) in the default intersection mode */
+int index_usable(void) {
+  return !invert && !any && !queries && !sort_field && !sum_field && (name || description || packager || url || ownsfile)
+    && !(base || arch || group || license || isize || dsize || size
+        || builddate || installdate || provides || depends || optdepends
+        || conflicts || replaces || satisfies);
+}
+
+char *index_path(alpm_db_t *db, struct stat *dbst) {
+  const char *dbpath = alpm_option_get_dbpath(handle);
+  const char *ext = alpm_option_get_dbext(handle);
+  const char *dbname = alpm_db_get_name(db);
+  char *dbfile = pu_asprintf("%ssync/%s%s", dbpath, dbname, ext), *path;
+  if (dbfile == NULL || stat(dbfile, dbst) != 0) {
+    free(dbfile);
+    return NULL;
+  }
+  path = pu_asprintf("%s.trgm", dbfile);
+  free(dbfile);
+  return path;
+}
+
+int index_build(alpm_db_t *db, const char *path, struct stat *dbst) {
+  pu_trigram_index_t *idx = pu_trigram_index_new(INDEX_NFIELDS);
+  alpm_list_t *p;
+  int ret = -1;
+
+  if (idx == NULL) { return -1; }
+  for (p = alpm_db_get_pkgcache(db); p; p = p->next) {
+    alpm_filelist_t *files = alpm_pkg_get_files(p->data);
+    size_t i;
+    if (pu_trigram_index_add_doc(idx, alpm_pkg_get_name(p->data)) == -1
+        || pu_trigram_index_add_str(idx, INDEX_NAME, alpm_pkg_get_name(p->data))
+        || pu_trigram_index_add_str(idx, INDEX_DESCRIPTION,
+            alpm_pkg_get_desc(p->data))
+        || pu_trigram_index_add_str(idx, INDEX_PACKAGER,
+            alpm_pkg_get_packager(p->data))
+        || pu_trigram_index_add_str(idx, INDEX_URL, alpm_pkg_get_url(p->data))) {
+      goto cleanup;
+    }
+    for (i = 0; files && i < files->count; i++) {
+      if (pu_trigram_index_add_str(idx, INDEX_FILES, files->files[i].name)) {
+        goto cleanup;
       }
     }
+  }
+  ret = pu_trigram_index_write(idx, path, dbst->st_size, dbst->st_mtime);
+
+cleanup:
+  pu_trigram_index_free(idx);
+  return ret;
+}
+
+/* loads the cached index for db, (re)building it if requested with --index */
+pu_trigram_index_t *index_load(alpm_db_t *db) {
+  pu_trigram_index_t *idx = NULL;
+  struct stat dbst;
+  char *path;
+
+  if ((path = index_path(db, &dbst)) == NULL) { return NULL; }
+  idx = pu_trigram_index_open(path, dbst.st_size, dbst.st_mtime);
+  if (idx == NULL && build_index) {
+    if (index_build(db, path, &dbst) == 0) {
+      idx = pu_trigram_index_open(path, dbst.st_size, dbst.st_mtime);
+    } else {
+      fprintf(stderr, "warning: could not write index '%s' (%s)\n",
+          path, strerror(errno));
+    }
+  }
+  free(path);
+  return idx;
+}
+
+int index_field_match(pu_trigram_index_t *idx, enum index_field field,
+    uint32_t doc, const char *str) {
+  const char *s;
+  uint32_t count = pu_trigram_index_doc_strs(idx, field, doc, &s);
+  for (; count; count--, s += strlen(s) + 1) {
+    if (field == INDEX_FILES ? match_file(s, str) : match_str(s, str)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* narrows cand to the documents that may match str */
+void index_narrow(pu_trigram_index_t *idx, enum index_field field,
+    const char *str, unsigned char *cand) {
+  if (re) {
+    alpm_list_t *l, *literals = pu_trigram_regex_literals(str);
+    for (l = literals; l; l = l->next) {
+      pu_trigram_index_filter(idx, field, l->data, cand);
+    }
+    FREELIST(literals);
   } else {
-    for (p = *pkgs; p; p = p->next) {
-      alpm_list_t *h = func(p->data);
-      for (; h; h = h->next) {
-        if (strcasestr(h->data, str)) {
-          matches = alpm_list_add(matches, p->data);
-          break;
-        }
+    pu_trigram_index_filter(idx, field, str, cand);
+  }
+}
+
+/* prints the packages in db matching the current query using only the index */
+void index_search(alpm_db_t *db, pu_trigram_index_t *idx) {
+  const char *dbname = alpm_db_get_name(db);
+  uint32_t doc, ndocs = pu_trigram_index_count(idx);
+  unsigned char *cand, *vcand, *fcand;
+  size_t f;
+  alpm_list_t *v;
+
+  if ((cand = malloc(ndocs * 3 + 1)) == NULL) {
+    perror("malloc");
+    cleanup(1);
+  }
+  vcand = cand + ndocs;
+  fcand = vcand + ndocs;
+  memset(cand, 1, ndocs);
+
+  for (f = 0; f < INDEX_NFIELDS; f++) {
+    if (*index_values[f] == NULL) { continue; }
+    memset(fcand, 0, ndocs);
+    for (v = *index_values[f]; v; v = v->next) {
+      const char *str = f == INDEX_FILES ? strip_root(v->data) : v->data;
+      memcpy(vcand, cand, ndocs);
+      index_narrow(idx, f, str, vcand);
+      for (doc = 0; doc < ndocs; doc++) { fcand[doc] |= vcand[doc]; }
+    }
+    memcpy(cand, fcand, ndocs);
+  }
+
+  for (doc = 0; doc < ndocs && !search_done(); doc++) {
+    if (!cand[doc]) { continue; }
+    for (f = 0; f < INDEX_NFIELDS; f++) {
+      int matched = 0;
+      for (v = *index_values[f]; v && !matched; v = v->next) {
+        matched = index_field_match(idx, f, doc, v->data);
+      }
+      if (*index_values[f] && !matched) { break; }
+    }
+    if (f == INDEX_NFIELDS) {
+      if (!quiet && !count) {
+        printf("%s/%s", dbname, pu_trigram_index_doc_name(idx, doc));
+        fputc(osep, stdout);
       }
+      match_count++;
+      found++;
     }
   }
-  for (p = matches; p; p = p->next) {
-    *pkgs = alpm_list_remove(*pkgs, p->data, ptr_cmp, NULL);
+
+  free(cand);
+}
+
+/* tests a term against a cache metadata record; returns -1 if the record
+ * does not hold the field */
+int term_match_cache(struct query *q, pu_cachemeta_pkg_t *pkg) {
+  struct field *f = q->field;
+  alpm_list_t *i;
+
+  switch (f->type) {
+    case FIELD_STR:
+      /* cached packages do not belong to a repo */
+      if (f->str == get_dbname) { return term_match_str(q, NULL); }
+      if (f->str == alpm_pkg_get_name) { return term_match_str(q, pkg->name); }
+      if (f->str == alpm_pkg_get_base) { return term_match_str(q, pkg->base); }
+      if (f->str == alpm_pkg_get_arch) { return term_match_str(q, pkg->arch); }
+      if (f->str == alpm_pkg_get_desc) { return term_match_str(q, pkg->desc); }
+      if (f->str == alpm_pkg_get_packager) {
+        return term_match_str(q, pkg->packager);
+      }
+      if (f->str == alpm_pkg_get_url) { return term_match_str(q, pkg->url); }
+      return -1;
+    case FIELD_STRLIST:
+      if (f->strlist == alpm_pkg_get_groups) {
+        return term_match_strlist(q, pkg->groups);
+      }
+      if (f->strlist == alpm_pkg_get_licenses) {
+        return term_match_strlist(q, pkg->licenses);
+      }
+      return -1;
+    case FIELD_FILES:
+      return pkg->has_files ? term_match_strlist(q, pkg->files) : -1;
+    case FIELD_DEPLIST:
+      if (f->deplist == alpm_pkg_get_provides) { i = pkg->provides; }
+      else if (f->deplist == alpm_pkg_get_depends) { i = pkg->depends; }
+      else if (f->deplist == alpm_pkg_get_optdepends) { i = pkg->optdepends; }
+      else if (f->deplist == alpm_pkg_get_conflicts) { i = pkg->conflicts; }
+      else if (f->deplist == alpm_pkg_get_replaces) { i = pkg->replaces; }
+      else { return -1; }
+      for (; i; i = i->next) {
+        alpm_depend_t *d = alpm_dep_from_string(i->data);
+        int matched = d && depmatch(d, q->dep, q->mode == MATCH_EXACT);
+        alpm_dep_free(d);
+        if (matched) { return 1; }
+      }
+      return 0;
+    case FIELD_SIZE:
+      if (f->size == alpm_pkg_get_isize) { return match_size(&q->size, pkg->isize); }
+      if (f->size == alpm_pkg_get_size) { return match_size(&q->size, pkg->size); }
+      /* package files have no download size */
+      return match_size(&q->size, 0);
+    case FIELD_DATE:
+      if (f->date == alpm_pkg_get_builddate) {
+        return match_date(&q->date, pkg->builddate);
+      }
+      /* nor an install date */
+      return match_date(&q->date, 0);
+    case FIELD_SATISFIES:
+      return -1;
   }
-  return matches;
+  return -1;
 }
 
-#define match(list, filter) \
-  if(list) { \
-    alpm_list_t *lp; \
-    for(lp = list; lp; lp = alpm_list_next(lp)) { \
-      void *i = lp->data; \
-      matches = alpm_list_join(matches, filter); \
-    } \
-    if(!any) { \
-      alpm_list_free(haystack); \
-      haystack = matches; \
-      matches = NULL; \
-    } \
-  }
-
-alpm_list_t *filter_pkgs(alpm_handle_t *handle, alpm_list_t *pkgs) {
-  alpm_list_t *matches = NULL, *haystack = alpm_list_copy(pkgs);
-  const char *root = alpm_option_get_root(handle);
-  const size_t rootlen = strlen(root);
-
-  match(name, filter_str(&haystack, i, alpm_pkg_get_name));
-  match(base, filter_str(&haystack, i, alpm_pkg_get_base));
-  match(description, filter_str(&haystack, i, alpm_pkg_get_desc));
-  match(packager, filter_str(&haystack, i, alpm_pkg_get_packager));
-  match(repo, filter_str(&haystack, i, get_dbname));
-  match(arch, filter_str(&haystack, i, alpm_pkg_get_arch));
-  match(group, filter_strlist(&haystack, i, alpm_pkg_get_groups));
-  match(license, filter_strlist(&haystack, i, alpm_pkg_get_licenses));
-  match(ownsfile, filter_filelist(&haystack, i, root, rootlen));
-  match(url, filter_str(&haystack, i, alpm_pkg_get_url));
-
-  match(isize, filter_size(&haystack, i, alpm_pkg_get_isize));
-  match(dsize, filter_size(&haystack, i, alpm_pkg_download_size));
-  match(size, filter_size(&haystack, i, alpm_pkg_get_size));
-
-  match(builddate, filter_date(&haystack, i, alpm_pkg_get_builddate));
-  match(installdate, filter_date(&haystack, i, alpm_pkg_get_installdate));
-
-  match(provides, filter_deplist(&haystack, i, alpm_pkg_get_provides));
-  match(depends, filter_deplist(&haystack, i, alpm_pkg_get_depends));
-  match(optdepends, filter_deplist(&haystack, i, alpm_pkg_get_optdepends));
-  match(conflicts, filter_deplist(&haystack, i, alpm_pkg_get_conflicts));
-  match(replaces, filter_deplist(&haystack, i, alpm_pkg_get_replaces));
-
-  match(satisfies, filter_satisfies(&haystack, i));
-
-  if (invert) {
-    matches = alpm_list_diff(pkgs, haystack, ptr_cmp);
-    alpm_list_free(haystack);
-    return matches;
-  } else {
-    return any ? matches : haystack;
+/* evaluates q against cache metadata, like query_eval_db; returns -1 if the
+ * result depends on fields the store does not hold */
+int query_eval_cache(struct query *q, pu_cachemeta_pkg_t *pkg) {
+  int l, r;
+  switch (q->type) {
+    case QUERY_TRUE:
+      return 1;
+    case QUERY_TERM:
+      return term_match_cache(q, pkg);
+    case QUERY_NOT:
+      l = query_eval_cache(q->lhs, pkg);
+      return l == -1 ? -1 : !l;
+    case QUERY_AND:
+      if ((l = query_eval_cache(q->lhs, pkg)) == 0) { return 0; }
+      if ((r = query_eval_cache(q->rhs, pkg)) == 0) { return 0; }
+      return l == 1 && r == 1 ? 1 : -1;
+    case QUERY_OR:
+      if ((l = query_eval_cache(q->lhs, pkg)) == 1) { return 1; }
+      if ((r = query_eval_cache(q->rhs, pkg)) == 1) { return 1; }
+      return l == 0 && r == 0 ? 0 : -1;
   }
+  return -1;
 }
 
-#undef match
+/* cache metadata can rule packages out without loading them */
+int cache_may_match(pu_cachemeta_pkg_t *pkg) {
+  return query_eval_cache(query, pkg) != 0;
+}
+
+void load_cache_pkgs(alpm_list_t **haystack) {
+  alpm_list_t *i, *pkgs = NULL;
+  pu_cachemeta_t *meta;
+  pu_pkg_load_t *loads;
+  size_t n, count = 0;
+  int needfiles = query_uses_field(query, FIELD_FILES);
+  char *metapath;
+
+  if ((metapath = pu_cachemeta_default_path(handle)) == NULL
+      || (meta = pu_cachemeta_open(metapath, needfiles)) == NULL) {
+    fprintf(stderr, "error: could not load cache metadata (%s)\n",
+        strerror(errno));
+    cleanup(1);
+  }
+  free(metapath);
+
+  for (i = alpm_option_get_cachedirs(handle); i; i = i->next) {
+    const char *path = i->data;
+    if (pu_cachemeta_scan_dir(meta, handle, path, needfiles, &pkgs) != 0) {
+      fprintf(stderr, "warning: could not read cache dir '%s' (%s)\n",
+          path, strerror(errno));
+    }
+  }
+  if (pu_cachemeta_write(meta) != 0 && errno != EACCES && errno != EROFS) {
+    fprintf(stderr, "warning: could not write cache metadata '%s' (%s)\n",
+        meta->path, strerror(errno));
+  }
+
+  if ((loads = calloc(alpm_list_count(pkgs) + 1, sizeof(pu_pkg_load_t))) == NULL) {
+    fprintf(stderr, "error: %s\n", strerror(errno));
+    cleanup(1);
+  }
+  for (i = pkgs; i; i = i->next) {
+    pu_cachemeta_pkg_t *cpkg = i->data;
+    if (cpkg->error) {
+      fprintf(stderr, "warning: could not load package '%s' (%s)\n",
+          cpkg->path, alpm_strerror(cpkg->error));
+    } else if (cache_may_match(cpkg)) {
+      loads[count++].path = cpkg->path;
+    }
+  }
+
+  pu_pkg_load_many_detached(handle, loads, count, needfiles, 0, &load_handles);
+  for (n = 0; n < count; n++) {
+    if (loads[n].pkg) {
+      *haystack = alpm_list_add(*haystack, loads[n].pkg);
+    } else {
+      fprintf(stderr, "warning: could not load package '%s' (%s)\n",
+          loads[n].path, alpm_strerror(loads[n].error));
+    }
+  }
+
+  free(loads);
+  alpm_list_free(pkgs);
+  pu_cachemeta_free(meta);
+}
 
 void usage(int ret) {
   FILE *stream = (ret ? stderr : stdout);
@@ -623,6 +1407,7 @@ void usage(int ret) {
   hputs("        pacsift (--help|--version)");
   hputs("options:");
   hputs("   --config=<path>      set an alternate configuration file");
+  hputs("   --daemon[=<socket>]  query a running pacutilsd instead");
   hputs("   --dbext=<ext>        set an alternate sync database extension");
   hputs("   --dbpath=<path>      set an alternate database location");
   hputs("   --root=<path>        set an alternate installation root");
@@ -630,9 +1415,16 @@ void usage(int ret) {
   hputs("   --null[=sep]         use <sep> to separate values (default NUL)");
   hputs("   --help               display this help information");
   hputs("   --version            display version information");
+  hputs("   --index              build or update the sync database search index");
 
   hputs("   --exists             exit with a non-zero value if no matches were found");
   hputs("   --not-exists         exit with a non-zero value if matches were found");
+  hputs("   --quiet              do not display matches, stop at the first match");
+  hputs("   --limit=<n>          stop searching after <n> matches");
+  hputs("   --sort=<field>       sort matches by a size or date field");
+  hputs("   --reverse            sort in descending order");
+  hputs("   --count              display the number of matches");
+  hputs("   --sum=<field>        display the total of a size field for all matches");
 
   hputs("   --invert             display packages which DO NOT match search criteria");
   hputs("   --any                display packages matching any search criteria");
@@ -678,6 +1470,10 @@ void usage(int ret) {
   hputs("   --build-date=<val>   search package build date");
   hputs("   --install-date=<val> search package install date");
   hputs("   --satisfies=<val>    find packages satisfying dependency <val>");
+
+  hputs(" Queries:");
+  hputs("   --query=<expr>       search packages matching the expression <expr>");
+  hputs("                        (e.g. \"(name~^py OR provides=foo) AND NOT repo=core\")");
 #undef hputs
 
   cleanup(ret);
@@ -691,10 +1487,12 @@ pu_config_t *parse_opts(int argc, char **argv) {
   char *short_opts = "QS";
   struct option long_opts[] = {
     { "config", required_argument, NULL, FLAG_CONFIG        },
+    { "daemon", optional_argument, NULL, FLAG_DAEMON        },
     { "dbext", required_argument, NULL, FLAG_DBEXT         },
     { "dbpath", required_argument, NULL, FLAG_DBPATH        },
     { "debug", no_argument, NULL, FLAG_DEBUG         },
     { "help", no_argument, NULL, FLAG_HELP          },
+    { "index", no_argument, &build_index, 1                  },
     { "sysroot", required_argument, NULL, FLAG_SYSROOT       },
     { "version", no_argument, NULL, FLAG_VERSION       },
 
@@ -710,6 +1508,13 @@ pu_config_t *parse_opts(int argc, char **argv) {
 
     { "exists", no_argument, &exists, FLAG_EXISTS        },
     { "not-exists", no_argument, &exists, FLAG_NOTEXISTS     },
+    { "quiet", no_argument, &quiet, 1                  },
+    { "limit", required_argument, NULL, FLAG_LIMIT         },
+
+    { "sort", required_argument, NULL, FLAG_SORT          },
+    { "reverse", no_argument, &reverse, 1                 },
+    { "count", no_argument, &count, 1                   },
+    { "sum", required_argument, NULL, FLAG_SUM           },
 
     { "null", optional_argument, NULL, FLAG_NULL          },
 
@@ -732,6 +1537,8 @@ pu_config_t *parse_opts(int argc, char **argv) {
 
     { "satisfies", required_argument, NULL, FLAG_SATISFIES     },
 
+    { "query", required_argument, NULL, FLAG_QUERY         },
+
     { "installed-size", required_argument, NULL, FLAG_ISIZE         },
     { "isize", required_argument, NULL, FLAG_ISIZE         },
     { "download-size", required_argument, NULL, FLAG_DSIZE         },
@@ -760,6 +1567,9 @@ pu_config_t *parse_opts(int argc, char **argv) {
       case FLAG_DBEXT:
         dbext = optarg;
         break;
+      case FLAG_DAEMON:
+        /* handled before parsing */
+        break;
       case FLAG_DBPATH:
         free(config->dbpath);
         config->dbpath = strdup(optarg);
@@ -771,6 +1581,32 @@ pu_config_t *parse_opts(int argc, char **argv) {
       case FLAG_HELP:
         usage(0);
         break;
+      case FLAG_LIMIT:
+        {
+          char *end;
+          errno = 0;
+          limit = strtoul(optarg, &end, 10);
+          if (errno || *end || end == optarg || *optarg == '-') {
+            fprintf(stderr, "error: invalid limit '%s'\n", optarg);
+            cleanup(1);
+          }
+        }
+        break;
+      case FLAG_SORT:
+        sort_field = field_find(optarg, strlen(optarg));
+        if (sort_field == NULL || (sort_field->type != FIELD_SIZE
+              && sort_field->type != FIELD_DATE)) {
+          fprintf(stderr, "error: cannot sort by '%s'\n", optarg);
+          cleanup(1);
+        }
+        break;
+      case FLAG_SUM:
+        sum_field = field_find(optarg, strlen(optarg));
+        if (sum_field == NULL || sum_field->type != FIELD_SIZE) {
+          fprintf(stderr, "error: cannot sum '%s'\n", optarg);
+          cleanup(1);
+        }
+        break;
       case FLAG_NULL:
         osep = optarg ? optarg[0] : '\0';
         isep = osep;
@@ -861,6 +1697,10 @@ pu_config_t *parse_opts(int argc, char **argv) {
         satisfies = alpm_list_add(satisfies, strdup(optarg));
         break;
 
+      case FLAG_QUERY:
+        queries = alpm_list_add(queries, strdup(optarg));
+        break;
+
       case '?':
         usage(1);
         break;
@@ -893,20 +1733,52 @@ void free_pkg(alpm_pkg_t *p) {
 }
 
 int main(int argc, char **argv) {
-  alpm_list_t *haystack = NULL, *matches = NULL, *i;
-  int ret = 0;
+  alpm_list_t *haystack = NULL;
+  const char *daemon_sock;
+  int ret = 0, from_stdin;
+
+  /* forward the whole invocation to a running pacutilsd if requested */
+  if ((daemon_sock = pu_daemon_option(argc, argv))) {
+    if ((ret = pu_daemon_run(daemon_sock, myname, argc, argv)) != -1) {
+      return ret;
+    }
+    fprintf(stderr, "warning: unable to contact pacutilsd at '%s' (%s)\n",
+        daemon_sock, strerror(errno));
+    ret = 0;
+  }
 
   if (!(config = parse_opts(argc, argv))) {
     goto cleanup;
   }
 
+  from_stdin = !isatty(fileno(stdin)) && errno != EBADF;
+
+  if (from_stdin && (srch_local || srch_sync || srch_cache)) {
+    fprintf(stderr,
+        "error: --local, --sync, and --cache cannot be used as filters\n");
+    ret = 1;
+    goto cleanup;
+  } else if (!from_stdin && !srch_local && !srch_sync && !srch_cache) {
+    srch_local = 1;
+    srch_sync = 1;
+  }
+
+  /* nothing needs to be printed, the first match settles the result */
+  if (quiet && !limit) {
+    limit = 1;
+  }
+
   if (!(handle = pu_initialize_handle_from_config(config))) {
     fprintf(stderr, "error: failed to initialize alpm.\n");
     ret = 1;
     goto cleanup;
   }
 
-  if (ownsfile && dbext == NULL) {
+  query = query_compile();
+
+  /* only sync packages need the larger files databases */
+  if (query_uses_field(query, FIELD_FILES) && dbext == NULL
+      && (srch_sync || from_stdin)) {
     dbext = FILESDBEXT;
   }
 
@@ -923,22 +1795,17 @@ int main(int argc, char **argv) {
     goto cleanup;
   }
 
-  if (!isatty(fileno(stdin)) && errno != EBADF) {
+  if (from_stdin) {
     char *buf = NULL;
     size_t len = 0;
     ssize_t read;
 
-    if (srch_local || srch_sync || srch_cache) {
-      fprintf(stderr,
-          "error: --local, --sync, and --cache cannot be used as filters\n");
-      ret = 1;
-      goto cleanup;
-    }
-
-    while ((read = getdelim(&buf, &len, isep, stdin)) != -1) {
+    while (!search_done() && (read = getdelim(&buf, &len, isep, stdin)) != -1) {
       alpm_pkg_t *pkg;
       if (buf[read - 1] == isep) { buf[read - 1] = '\0'; }
       if ((pkg = pu_find_pkgspec(handle, buf))) {
+        if (query_eval(query, pkg)) { print_match(pkg); }
+        /* sorted matches are only printed once the search is complete */
         haystack = alpm_list_add(haystack, pkg);
       } else {
         fprintf(stderr, "warning: could not locate pkg '%s'\n", buf);
@@ -947,74 +1814,40 @@ int main(int argc, char **argv) {
 
     free(buf);
   } else {
-    alpm_list_t *p, *s;
+    alpm_db_t *localdb = alpm_get_localdb(handle);
+    alpm_list_t *s;
 
-    if (!srch_local && !srch_sync && !srch_cache) {
-      srch_local = 1;
-      srch_sync = 1;
-    }
-
-    if (srch_local) {
-      for (p = alpm_db_get_pkgcache(alpm_get_localdb(handle)); p; p = p->next) {
-        haystack = alpm_list_add(haystack, p->data);
-      }
+    if (srch_local && db_may_match(alpm_db_get_name(localdb))) {
+      search_pkgs(alpm_db_get_pkgcache(localdb));
     }
     if (srch_sync) {
-      for (s = alpm_get_syncdbs(handle); s; s = s->next) {
-        for (p = alpm_db_get_pkgcache(s->data); p; p = p->next) {
-          haystack = alpm_list_add(haystack, p->data);
-        }
-      }
-    }
-    if (srch_cache) {
-      for (i = alpm_option_get_cachedirs(handle); i; i = i->next) {
-        const char *path = i->data;
-        DIR *dir = opendir(path);
-        struct dirent *entry;
-        if (!dir) {
-          fprintf(stderr, "warning: could not open cache dir '%s' (%s)\n",
-              path, strerror(errno));
+      int use_index = index_usable();
+      for (s = alpm_get_syncdbs(handle); s && !search_done(); s = s->next) {
+        pu_trigram_index_t *idx;
+        if (!db_may_match(alpm_db_get_name(s->data))) {
           continue;
+        } else if (use_index && (idx = index_load(s->data))) {
+          index_search(s->data, idx);
+          pu_trigram_index_free(idx);
+        } else {
+          search_pkgs(alpm_db_get_pkgcache(s->data));
         }
-        errno = 0;
-        while ((entry = readdir(dir))) {
-          if (strcmp(".", entry->d_name) == 0 || strcmp("..", entry->d_name) == 0) {
-            continue;
-          }
-          size_t path_len = strlen(path) + strlen(entry->d_name);
-          char *filename = malloc(path_len + 1);
-          int needfiles = ownsfile ? 1 : 0;
-          alpm_pkg_t *pkg = NULL;
-          sprintf(filename, "%s%s", path, entry->d_name);
-          if (alpm_pkg_load(handle, filename, needfiles, 0, &pkg) == 0) {
-            haystack = alpm_list_add(haystack, pkg);
-          } else {
-            fprintf(stderr, "warning: could not load package '%s' (%s)\n",
-                filename, alpm_strerror(alpm_errno(handle)));
-          }
-          free(filename);
-        }
-        if (errno != 0) {
-          fprintf(stderr, "warning: could not read cache dir '%s' (%s)\n",
-              path, strerror(errno));
-        }
-        closedir(dir);
       }
     }
+    if (srch_cache && !search_done() && db_may_match(NULL)) {
+      load_cache_pkgs(&haystack);
+      search_pkgs(haystack);
+    }
   }
 
-  matches = filter_pkgs(handle, haystack);
-  for (i = matches; i; i = i->next) {
-    pu_fprint_pkgspec(stdout, i->data);
-    fputc(osep, stdout);
-  }
-  if ((exists == FLAG_EXISTS && matches == NULL)
-      || (exists == FLAG_NOTEXISTS && matches != NULL)) {
+  print_results();
+
+  if ((exists == FLAG_EXISTS && !found)
+      || (exists == FLAG_NOTEXISTS && found)) {
     ret = 1;
   }
 
 cleanup:
-  alpm_list_free(matches);
   alpm_list_free_inner(haystack, (alpm_list_fn_free) free_pkg);
   alpm_list_free(haystack);
 
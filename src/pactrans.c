@@ -558,6 +558,8 @@ alpm_pkg_t *find_sync_pkg(char *pkgspec) {
 
 int load_pkg_files(void) {
   alpm_list_t *i, *remote = NULL, *remote_paths = NULL;
+  pu_pkg_load_t *loads;
+  size_t n, count = 0;
   int ret = 0;
   alpm_siglevel_t slr = alpm_option_get_remote_file_siglevel(handle);
   alpm_siglevel_t sll = alpm_option_get_local_file_siglevel(handle);
@@ -578,26 +580,38 @@ int load_pkg_files(void) {
     }
   }
 
-  for (i = files; i; i = i->next) {
-    alpm_siglevel_t sl = sll;
-    alpm_pkg_t *pkg;
+  if ((loads = calloc(alpm_list_count(files) + 1, sizeof(pu_pkg_load_t))) == NULL) {
+    pu_ui_error("%s", strerror(errno));
+    return 1;
+  }
+
+  for (i = files; i; i = i->next, count++) {
+    loads[count].level = sll;
 
     if (strstr(i->data, "://")) {
       char *path = _pu_list_shift(&remote_paths);
       free(i->data);
       i->data = path;
-      sl = slr;
+      loads[count].level = slr;
     }
 
-    if ( alpm_pkg_load(handle, i->data, 1, sl, &pkg) != 0) {
+    loads[count].path = i->data;
+  }
+
+  pu_pkg_load_many(handle, loads, count, 1);
+
+  for (n = 0; n < count; n++) {
+    if (loads[n].pkg == NULL) {
       fprintf(stderr, "error: could not load '%s' (%s)\n",
-          (char *) i->data, alpm_strerror(alpm_errno(handle)));
+          loads[n].path, alpm_strerror(loads[n].error));
       ret++;
     } else {
-      add = alpm_list_add(add, pkg);
+      add = alpm_list_add(add, loads[n].pkg);
     }
   }
 
+  free(loads);
+
   return ret;
 }
 
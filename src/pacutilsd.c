@@ -0,0 +1,424 @@
+/*
+ * Copyright 2026 Andrew Gregory <andrew.gregory.8@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#define _GNU_SOURCE /* accept4, on_exit */
+
+#include <errno.h>
+#include <getopt.h>
+#include <grp.h>
+#include <limits.h>
+#include <poll.h>
+#include <pwd.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <pacutils.h>
+
+#include "config-defaults.h"
+
+const char *myname = "pacutilsd", *myver = BUILDVER;
+
+enum longopt_flags {
+  FLAG_CONFIG = 1000,
+  FLAG_DBPATH,
+  FLAG_HELP,
+  FLAG_ROOT,
+  FLAG_SOCKET,
+  FLAG_SYSROOT,
+  FLAG_VERSION,
+};
+
+/* tools linked in with their main renamed, see Makefile */
+int pacfile_main(int argc, char **argv);
+int pacinfo_main(int argc, char **argv);
+int pacsift_main(int argc, char **argv);
+
+struct tool {
+  const char *name;
+  int (*main)(int argc, char **argv);
+} tools[] = {
+  { "pacfile", pacfile_main },
+  { "pacinfo", pacinfo_main },
+  { "pacsift", pacsift_main },
+  { NULL, NULL },
+};
+
+pu_config_t *config = NULL;
+alpm_handle_t *handle = NULL;
+char *socket_path = NULL, *sysroot = NULL;
+int verbose = 0;
+
+void usage(int ret) {
+  FILE *stream = (ret ? stderr : stdout);
+#define hputs(s) fputs(s"\n", stream);
+  hputs("pacutilsd - serve pacutils queries from preloaded databases");
+  hputs("usage:  pacutilsd [options]");
+  hputs("        pacutilsd (--help|--version)");
+  hputs("");
+  hputs("   --config=<path>    set an alternate configuration file");
+  hputs("   --dbpath=<path>    set an alternate database location");
+  hputs("   --root=<path>      set an alternate installation root");
+  hputs("   --sysroot=<path>   set an alternate system root");
+  hputs("   --socket=<path>    listen on an alternate socket");
+  hputs("   --verbose          log requests and reloads");
+  hputs("   --help             display this help information");
+  hputs("   --version          display version information");
+#undef hputs
+  exit(ret);
+}
+
+pu_config_t *parse_opts(int argc, char **argv) {
+  char *config_file = PACMANCONF;
+  pu_config_t *config = NULL;
+  int c;
+
+  char *short_opts = "";
+  struct option long_opts[] = {
+    { "config", required_argument, NULL, FLAG_CONFIG       },
+    { "dbpath", required_argument, NULL, FLAG_DBPATH       },
+    { "root", required_argument, NULL, FLAG_ROOT         },
+    { "sysroot", required_argument, NULL, FLAG_SYSROOT      },
+    { "socket", required_argument, NULL, FLAG_SOCKET       },
+
+    { "verbose", no_argument, &verbose, 1                 },
+
+    { "help", no_argument, NULL, FLAG_HELP         },
+    { "version", no_argument, NULL, FLAG_VERSION      },
+
+    { 0, 0, 0, 0 },
+  };
+
+  if ((config = pu_config_new()) == NULL) {
+    perror("malloc");
+    return NULL;
+  }
+
+  while ((c = getopt_long(argc, argv, short_opts, long_opts, NULL)) != -1) {
+    switch (c) {
+
+      case 0:
+        /* already handled */
+        break;
+
+      case FLAG_CONFIG:
+        config_file = optarg;
+        break;
+      case FLAG_DBPATH:
+        free(config->dbpath);
+        config->dbpath = strdup(optarg);
+        break;
+      case FLAG_ROOT:
+        free(config->rootdir);
+        config->rootdir = strdup(optarg);
+        break;
+      case FLAG_SYSROOT:
+        sysroot = optarg;
+        break;
+      case FLAG_SOCKET:
+        free(socket_path);
+        socket_path = strdup(optarg);
+        break;
+
+      case FLAG_HELP:
+        usage(0);
+        break;
+      case FLAG_VERSION:
+        pu_print_version(myname, myver);
+        exit(0);
+        break;
+
+      case '?':
+      default:
+        usage(1);
+        break;
+    }
+  }
+
+  if (optind < argc) {
+    pu_ui_error("unexpected argument '%s'", argv[optind]);
+    usage(1);
+  }
+
+  if (!pu_ui_config_load_sysroot(config, config_file, sysroot)) {
+    pu_ui_error("could not parse '%s'", config_file);
+    return NULL;
+  }
+
+  if (socket_path == NULL && (socket_path = pu_daemon_default_socket()) == NULL) {
+    pu_ui_error("%s", strerror(errno));
+    return NULL;
+  }
+
+  return config;
+}
+
+/* (re)initializes the handle and reads every database into memory so that
+ * forked children share it */
+int load_handle(void) {
+  alpm_list_t *i, *p;
+
+  pu_daemon_set_handle(NULL, NULL);
+  if (handle) {
+    alpm_release(handle);
+  }
+
+  if (!(handle = pu_initialize_handle_from_config(config))) {
+    pu_ui_error("failed to initialize alpm");
+    return -1;
+  }
+  pu_register_syncdbs(handle, config->repos);
+
+  for (p = alpm_db_get_pkgcache(alpm_get_localdb(handle)); p; p = p->next) {
+    alpm_pkg_get_desc(p->data);
+    alpm_pkg_get_files(p->data);
+  }
+  alpm_db_get_groupcache(alpm_get_localdb(handle));
+  for (i = alpm_get_syncdbs(handle); i; i = i->next) {
+    alpm_db_get_pkgcache(i->data);
+    alpm_db_get_groupcache(i->data);
+  }
+
+  pu_daemon_set_handle(config, handle);
+  if (verbose) {
+    fprintf(stderr, "loaded %zu local packages\n",
+        alpm_list_count(alpm_db_get_pkgcache(alpm_get_localdb(handle))));
+  }
+  return 0;
+}
+
+/* any change below the database directory may be a transaction, the handle
+ * is reloaded once the lock file is gone */
+int watch_dbpath(int ifd) {
+  const char *dbpath = alpm_option_get_dbpath(handle);
+  const uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+    | IN_CLOSE_WRITE | IN_ONLYDIR;
+  const char *dirs[] = { "", "local", "sync" };
+  size_t i;
+
+  for (i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++) {
+    char *path = pu_prepend_dir(dbpath, dirs[i]);
+    if (path == NULL) { return -1; }
+    if (inotify_add_watch(ifd, path, mask) == -1 && errno != ENOENT) {
+      pu_ui_warn("could not watch '%s' (%s)", path, strerror(errno));
+    }
+    free(path);
+  }
+  return 0;
+}
+
+int drain_events(int ifd) {
+  char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  int seen = 0;
+  while (read(ifd, buf, sizeof(buf)) > 0) {
+    seen = 1;
+  }
+  return seen;
+}
+
+void send_status(int status, void *arg) {
+  pu_daemon_request_t *req = arg;
+  fflush(NULL);
+  pu_daemon_reply(req, status);
+}
+
+int drop_privileges(pu_daemon_request_t *req) {
+  struct passwd *pw;
+  if (geteuid() != 0) {
+    if (req->uid != geteuid()) {
+      errno = EPERM;
+      return -1;
+    }
+    return 0;
+  } else if (req->uid == 0) {
+    return 0;
+  }
+  if ((pw = getpwuid(req->uid)) ? initgroups(pw->pw_name, req->gid)
+      : setgroups(0, NULL)) {
+    return -1;
+  }
+  if (setgid(req->gid) != 0 || setuid(req->uid) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+/* runs in a forked child, the tool's exit status is sent back on exit */
+void serve(int conn, int stale) {
+  pu_daemon_request_t req;
+  struct tool *t;
+  int fd;
+
+  signal(SIGCHLD, SIG_DFL);
+  signal(SIGPIPE, SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+  signal(SIGINT, SIG_DFL);
+
+  if (pu_daemon_request_read(conn, &req) != 0) {
+    if (verbose) { pu_ui_warn("invalid request (%s)", strerror(errno)); }
+    _exit(1);
+  }
+  if (verbose) {
+    fprintf(stderr, "request from pid %jd uid %jd: %s\n",
+        (intmax_t) req.pid, (intmax_t) req.uid, req.tool);
+  }
+
+  for (fd = 0; fd < 3; fd++) {
+    if (req.fds[fd] == -1) {
+      close(fd);
+    } else if (dup2(req.fds[fd], fd) == -1) {
+      _exit(1);
+    } else {
+      close(req.fds[fd]);
+      req.fds[fd] = -1;
+    }
+  }
+
+  for (t = tools; t->name && strcmp(t->name, req.tool) != 0; t++);
+  if (t->name == NULL) {
+    fprintf(stderr, "error: pacutilsd: unsupported tool '%s'\n", req.tool);
+    send_status(1, &req);
+    _exit(1);
+  }
+  if (drop_privileges(&req) != 0) {
+    fprintf(stderr, "error: pacutilsd: unable to switch to uid %jd (%s)\n",
+        (intmax_t) req.uid, strerror(errno));
+    send_status(1, &req);
+    _exit(1);
+  }
+  if (chdir(req.cwd) != 0) {
+    fprintf(stderr, "error: pacutilsd: unable to change directory to '%s' (%s)\n",
+        req.cwd, strerror(errno));
+    send_status(1, &req);
+    _exit(1);
+  }
+
+  /* the database is being changed, let the tool load it itself */
+  if (stale) {
+    pu_daemon_set_handle(NULL, NULL);
+  }
+
+  on_exit(send_status, &req);
+  optind = 0;
+  exit(t->main(req.argc, req.argv));
+}
+
+int main(int argc, char **argv) {
+  struct pollfd fds[2];
+  const char *lockfile;
+  int sfd = -1, ifd = -1, dirty = 0, ret = 0;
+
+  if (!(config = parse_opts(argc, argv))) {
+    ret = 1;
+    goto cleanup;
+  }
+
+  /* children are not waited for, they report to their clients directly */
+  signal(SIGCHLD, SIG_IGN);
+  signal(SIGPIPE, SIG_IGN);
+
+  if (load_handle() != 0) {
+    ret = 1;
+    goto cleanup;
+  }
+  lockfile = alpm_option_get_lockfile(handle);
+
+  if ((ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1
+      || watch_dbpath(ifd) != 0) {
+    pu_ui_error("unable to watch database (%s)", strerror(errno));
+    ret = 1;
+    goto cleanup;
+  }
+
+  if ((sfd = pu_daemon_listen(socket_path)) == -1) {
+    pu_ui_error("unable to listen on '%s' (%s)", socket_path, strerror(errno));
+    ret = 1;
+    goto cleanup;
+  }
+
+  fds[0].fd = sfd;
+  fds[0].events = POLLIN;
+  fds[1].fd = ifd;
+  fds[1].events = POLLIN;
+
+  while (1) {
+    /* check the lock again periodically while a transaction is running */
+    if (poll(fds, 2, dirty ? 1000 : -1) == -1) {
+      if (errno == EINTR) { continue; }
+      pu_ui_error("poll failed (%s)", strerror(errno));
+      ret = 1;
+      break;
+    }
+
+    if (fds[1].revents & POLLIN && drain_events(ifd)) {
+      dirty = 1;
+    }
+    if (dirty && access(lockfile, F_OK) != 0) {
+      if (verbose) { fprintf(stderr, "database changed, reloading\n"); }
+      if (load_handle() != 0) {
+        ret = 1;
+        break;
+      }
+      lockfile = alpm_option_get_lockfile(handle);
+      /* sync/ may have only just been created */
+      watch_dbpath(ifd);
+      drain_events(ifd);
+      dirty = 0;
+    }
+
+    if (fds[0].revents & POLLIN) {
+      int conn = accept4(sfd, NULL, NULL, SOCK_CLOEXEC);
+      pid_t pid;
+      if (conn == -1) {
+        if (errno != EINTR && errno != EAGAIN) {
+          pu_ui_warn("accept failed (%s)", strerror(errno));
+        }
+        continue;
+      }
+      if ((pid = fork()) == 0) {
+        close(sfd);
+        close(ifd);
+        serve(conn, dirty);
+      } else if (pid == -1) {
+        pu_ui_warn("fork failed (%s)", strerror(errno));
+      }
+      close(conn);
+    }
+  }
+
+cleanup:
+  if (sfd != -1) {
+    close(sfd);
+    unlink(socket_path);
+  }
+  if (ifd != -1) { close(ifd); }
+  pu_daemon_set_handle(NULL, NULL);
+  alpm_release(handle);
+  pu_config_free(config);
+  free(socket_path);
+
+  return ret;
+}
+
+/* vim: set ts=2 sw=2 noet: */
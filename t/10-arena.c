@@ -0,0 +1,89 @@
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "pacutils.h"
+
+#include "pacutils_test.h"
+
+FILE *stream = NULL;
+pu_arena_t *arena = NULL;
+
+void cleanup(void) {
+  pu_arena_free(arena);
+  if (stream) { fclose(stream); }
+}
+
+char logbuf[] =
+    "[2016-10-23 09:00] [mycaller] multi-line message\n"
+    "continued on line 2\n"
+    "[2016-10-24T11:23:45+0100] [ALPM] installed foo (1.0-1)\n";
+
+char mtreebuf[] =
+    "#mtree\n"
+    "/set type=file uid=0 gid=0 mode=644\n"
+    "./usr/bin/foo time=1453283269.4 size=10\n"
+    "./usr/bin/bar time=1453283270.1 type=link link=foo\\040x\n";
+
+int main(void) {
+  pu_log_reader_t *lr;
+  pu_log_entry_t *le;
+  pu_mtree_reader_t *mr;
+  pu_mtree_t *me, dest;
+  char *s, *big;
+  void *p;
+
+  ASSERT(atexit(cleanup) == 0);
+  ASSERT(arena = pu_arena_new(64));
+
+  tap_plan(16);
+
+  ASSERT(p = pu_arena_alloc(arena, 3));
+  tap_ok((uintptr_t) p % _Alignof(max_align_t) == 0, "aligned");
+  ASSERT(p = pu_arena_alloc(arena, 5));
+  tap_ok((uintptr_t) p % _Alignof(max_align_t) == 0, "aligned after odd size");
+  tap_is_str(pu_arena_strdup(arena, "foo"), "foo", "strdup");
+  tap_is_str(pu_arena_strndup(arena, "foobar", 3), "foo", "strndup");
+  ASSERT(s = pu_arena_calloc(arena, 4, 8));
+  tap_ok(memcmp(s, "\0\0\0\0\0\0\0\0", 8) == 0, "calloc zeroed");
+  tap_ok(pu_arena_calloc(arena, SIZE_MAX, 2) == NULL && errno == ENOMEM,
+      "calloc overflow");
+
+  ASSERT(big = malloc(1000));
+  memset(big, 'x', 999);
+  big[999] = '\0';
+  tap_is_str(pu_arena_strdup(arena, big), big, "larger than a chunk");
+  free(big);
+  tap_is_str(pu_arena_strdup(arena, "bar"), "bar", "after large allocation");
+
+  pu_arena_reset(arena);
+  tap_is_str(pu_arena_strdup(arena, "baz"), "baz", "after reset");
+
+  ASSERT(stream = fmemopen(logbuf, strlen(logbuf), "r"));
+  ASSERT(lr = pu_log_reader_open_stream(stream));
+  lr->arena = arena;
+  ASSERT(le = pu_log_reader_next(lr));
+  tap_is_str(le->caller, "mycaller", "log caller");
+  tap_is_str(le->message, "multi-line message\ncontinued on line 2\n",
+      "log multi-line message");
+  ASSERT(le = pu_log_reader_next(lr));
+  tap_is_str(le->message, "installed foo (1.0-1)\n", "log message");
+  tap_ok(pu_log_reader_next(lr) == NULL && lr->eof, "log eof");
+  pu_log_reader_free(lr);
+  fclose(stream);
+
+  ASSERT(stream = fmemopen(mtreebuf, strlen(mtreebuf), "r"));
+  ASSERT(mr = pu_mtree_reader_open_stream(stream));
+  mr->arena = arena;
+  ASSERT(me = pu_mtree_reader_next(mr, NULL));
+  tap_is_str(me->path, "usr/bin/foo", "mtree path");
+  ASSERT(me = pu_mtree_reader_next(mr, &dest));
+  tap_is_str(dest.link, "foo x", "mtree link into dest");
+  tap_ok(pu_mtree_reader_next(mr, &dest) == NULL && mr->eof, "mtree eof");
+  pu_mtree_reader_free(mr);
+  fclose(stream);
+  stream = NULL;
+
+  return 0;
+}
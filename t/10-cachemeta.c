@@ -0,0 +1,119 @@
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "pacutils_test.h"
+
+#include "pacutils.h"
+
+char *tmpdir = NULL, template[] = "/tmp/10-cachemeta.c-XXXXXX";
+char *store_path = NULL, *cachedir = NULL;
+int tmpfd = -1;
+pu_cachemeta_t *meta = NULL;
+alpm_list_t *pkgs = NULL;
+
+char store[] =
+    "PUCACHEMETA 2\n"
+    "FILE 1234 1700000000 5 %1$s/cache/foo-1.0-1-x86_64.pkg.tar.zst\n"
+    "NAME foo\n"
+    "VERSION 1.0-1\n"
+    "ARCH x86_64\n"
+    "SIZE 1234\n"
+    "ISIZE 4096\n"
+    "DEPEND glibc>=2.0\n"
+    "DEPEND bash\n"
+    "DESC two\\nlines \\\\n\n"
+    "HASFILES\n"
+    "PATH usr/\n"
+    "PATH usr/bin/foo\n"
+    "FILE 10 1700000000 0 %1$s/cache/bar.part\n"
+    "ERROR 31\n"
+    "FILE 99 1700000000 0 %1$s/other/baz-1-1-any.pkg.tar.zst\n"
+    "NAME baz\n"
+    "HASFILES\n"
+    "PATH usr/\n"
+    "PATH usr/new\\nline\n";
+
+void cleanup(void) {
+  pu_cachemeta_free(meta);
+  alpm_list_free(pkgs);
+  free(store_path);
+  free(cachedir);
+  if (tmpfd != -1) { close(tmpfd); }
+  if (tmpdir) { rmrfat(AT_FDCWD, tmpdir); }
+}
+
+int main(void) {
+  pu_cachemeta_pkg_t *pkg;
+  char *path;
+
+  ASSERT(atexit(cleanup) == 0);
+  ASSERT(tmpdir = mkdtemp(template));
+  ASSERT((tmpfd = open(tmpdir, O_DIRECTORY)) != -1);
+  ASSERT(store_path = pu_asprintf("%s/%s", tmpdir, "cachemeta"));
+  ASSERT(cachedir = pu_asprintf("%s/%s", tmpdir, "cache/"));
+  ASSERT(spew(tmpfd, "cachemeta", store, tmpdir) == 0);
+  ASSERT(mkdirat(tmpfd, "cache", 0755) == 0);
+  ASSERT(spew(tmpfd, "cache/foo-1.0-1-x86_64.pkg.tar.zst.sig", "") == 0);
+
+  tap_plan(23);
+
+  ASSERT(meta = pu_cachemeta_open(store_path, 1));
+  ASSERT(path = pu_asprintf("%s/cache/foo-1.0-1-x86_64.pkg.tar.zst", tmpdir));
+  pkg = pu_cachemeta_find(meta, path);
+  free(path);
+  tap_ok(pkg != NULL, "find record");
+  tap_is_str(pkg ? pkg->name : NULL, "foo", "name");
+  tap_is_str(pkg ? pkg->version : NULL, "1.0-1", "version");
+  tap_is_int(pkg ? pkg->filesize : 0, 1234, "filesize");
+  tap_is_int(pkg ? pkg->mtime.tv_nsec : 0, 5, "mtime nsec");
+  tap_is_int(pkg ? pkg->isize : 0, 4096, "isize");
+  tap_is_int(alpm_list_count(pkg ? pkg->depends : NULL), 2, "depends");
+  tap_is_int(alpm_list_count(pkg ? pkg->files : NULL), 2, "files");
+  tap_ok(pkg && pkg->has_files, "has files");
+  tap_is_str(pkg ? pkg->desc : NULL, "two\nlines \\n", "escaped value");
+
+  ASSERT(path = pu_asprintf("%s/cache/bar.part", tmpdir));
+  pkg = pu_cachemeta_find(meta, path);
+  free(path);
+  tap_is_int(pkg ? pkg->error : 0, 31, "error record");
+  tap_ok(!meta->modified, "not modified after load");
+
+  /* neither package exists on disk; the .sig file must be ignored */
+  tap_is_int(pu_cachemeta_scan_dir(meta, NULL, cachedir, 0, &pkgs), 0, "scan");
+  tap_ok(pkgs == NULL, "vanished packages dropped");
+  tap_ok(meta->modified, "modified after scan");
+  tap_is_int(pu_cachemeta_write(meta), 0, "write");
+  pu_cachemeta_free(meta);
+
+  ASSERT(meta = pu_cachemeta_open(store_path, 0));
+  ASSERT(path = pu_asprintf("%s/other/baz-1-1-any.pkg.tar.zst", tmpdir));
+  pkg = pu_cachemeta_find(meta, path);
+  free(path);
+  tap_is_str(pkg ? pkg->name : NULL, "baz", "other directories untouched");
+  ASSERT(path = pu_asprintf("%s/cache/foo-1.0-1-x86_64.pkg.tar.zst", tmpdir));
+  pkg = pu_cachemeta_find(meta, path);
+  free(path);
+  tap_ok(pkg == NULL, "vanished record not written");
+
+  /* file lists survive a store opened and written without them */
+  meta->modified = 1;
+  tap_is_int(pu_cachemeta_write(meta), 0, "write without files");
+  pu_cachemeta_free(meta);
+  ASSERT(meta = pu_cachemeta_open(store_path, 1));
+  ASSERT(path = pu_asprintf("%s/other/baz-1-1-any.pkg.tar.zst", tmpdir));
+  pkg = pu_cachemeta_find(meta, path);
+  free(path);
+  tap_ok(pkg && pkg->has_files, "has files kept");
+  tap_is_int(alpm_list_count(pkg ? pkg->files : NULL), 2, "files kept");
+  tap_is_str(pkg && pkg->files ? pkg->files->next->data : NULL, "usr/new\nline",
+      "escaped path");
+
+  pu_cachemeta_free(meta);
+  ASSERT(unlinkat(tmpfd, "cachemeta", 0) == 0);
+  ASSERT(spew(tmpfd, "cachemeta", "PUC") == 0);
+  ASSERT(meta = pu_cachemeta_open(store_path, 0));
+  tap_ok(meta->modified && meta->_count == 0, "truncated header rejected");
+
+  return 0;
+}
@@ -0,0 +1,82 @@
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "pacutils_test.h"
+
+#include "pacutils.h"
+
+char *tmpdir = NULL, template[] = "/tmp/10-daemon.c-XXXXXX";
+char *sock_path = NULL, *missing_path = NULL;
+int sfd = -1;
+
+void cleanup(void) {
+  free(sock_path);
+  free(missing_path);
+  if (sfd != -1) { close(sfd); }
+  if (tmpdir) { rmrfat(AT_FDCWD, tmpdir); }
+}
+
+/* echo the request back through the client's stdout */
+void serve(void) {
+  pu_daemon_request_t req;
+  int conn, i;
+  if ((conn = accept(sfd, NULL, NULL)) == -1
+      || pu_daemon_request_read(conn, &req) != 0) {
+    _exit(1);
+  }
+  dprintf(req.fds[1], "%s %d", req.tool, req.argc);
+  for (i = 0; i < req.argc; i++) { dprintf(req.fds[1], " [%s]", req.argv[i]); }
+  pu_daemon_reply(&req, req.pid == getppid() ? 3 : 4);
+  pu_daemon_request_free(&req);
+  _exit(0);
+}
+
+int main(void) {
+  char *argv[] = { "pacsift", "--daemon=x", "a b", "", "--", "--daemon", NULL };
+  char *noopt[] = { "pacsift", "--daemonize", "--", "--daemon", NULL };
+  char buf[256] = "";
+  int pipefd[2], stdout_fd, status;
+  ssize_t len;
+  pid_t pid;
+
+  ASSERT(atexit(cleanup) == 0);
+  ASSERT(tmpdir = mkdtemp(template));
+  ASSERT(sock_path = pu_asprintf("%s/%s", tmpdir, "pacutilsd.sock"));
+  ASSERT(missing_path = pu_asprintf("%s/%s", tmpdir, "missing.sock"));
+
+  tap_plan(6);
+
+  tap_is_str(pu_daemon_option(6, argv), "x", "socket option");
+  tap_ok(pu_daemon_option(4, noopt) == NULL, "option not matched");
+
+  ASSERT((sfd = pu_daemon_listen(sock_path)) != -1);
+  ASSERT((pid = fork()) != -1);
+  if (pid == 0) { serve(); }
+
+  /* the client hands over its stdout; point it at a pipe to read it back */
+  fflush(stdout);
+  ASSERT(pipe(pipefd) == 0);
+  ASSERT((stdout_fd = dup(1)) != -1);
+  ASSERT(dup2(pipefd[1], 1) != -1);
+  close(pipefd[1]);
+  status = pu_daemon_run(sock_path, "pacsift", 6, argv);
+  ASSERT(dup2(stdout_fd, 1) != -1);
+  close(stdout_fd);
+  tap_is_int(status, 3, "exit status");
+  ASSERT(waitpid(pid, NULL, 0) == pid);
+  ASSERT((len = read(pipefd[0], buf, sizeof(buf) - 1)) > 0);
+  close(pipefd[0]);
+  buf[len] = '\0';
+  tap_is_str(buf, "pacsift 6 [pacsift] [--daemon=x] [a b] [] [--] [--daemon]",
+      "request forwarded");
+
+  errno = 0;
+  tap_is_int(pu_daemon_run(missing_path, "pacsift", 6, argv), -1,
+      "no daemon");
+  tap_is_int(errno, ENOENT, "no daemon errno");
+
+  return 0;
+}
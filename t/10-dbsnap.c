@@ -0,0 +1,91 @@
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "pacutils_test.h"
+
+#include "pacutils.h"
+
+char *tmpdir = NULL, template[] = "/tmp/10-dbsnap.c-XXXXXX";
+char *snap_path = NULL;
+int tmpfd = -1;
+pu_dbsnap_t *snap = NULL;
+
+void cleanup(void) {
+  pu_dbsnap_free(snap);
+  free(snap_path);
+  if (tmpfd != -1) { close(tmpfd); }
+  if (tmpdir) { rmrfat(AT_FDCWD, tmpdir); }
+}
+
+int main(void) {
+  uint64_t s1, s2, t1, t2;
+  pu_dbsnap_files_t files;
+  uint32_t pkg;
+
+  ASSERT(atexit(cleanup) == 0);
+  ASSERT(tmpdir = mkdtemp(template));
+  ASSERT((tmpfd = open(tmpdir, O_DIRECTORY)) != -1);
+  ASSERT(snap_path = pu_asprintf("%s/%s", tmpdir, "dbsnap"));
+  ASSERT(mkdirat(tmpfd, "local", 0755) == 0);
+  ASSERT(mkdirat(tmpfd, "local/foo-1-1", 0755) == 0);
+  ASSERT(spew(tmpfd, "local/foo-1-1/desc", "%%NAME%%\nfoo\n") == 0);
+
+  ASSERT(snap = pu_dbsnap_new());
+  ASSERT(pu_dbsnap_add_pkg(snap) == 0);
+  ASSERT(pu_dbsnap_set_str(snap, PU_DBSNAP_NAME, "foo") == 0);
+  ASSERT(pu_dbsnap_set_str(snap, PU_DBSNAP_VERSION, "1-1") == 0);
+  ASSERT(pu_dbsnap_set_int(snap, PU_DBSNAP_ISIZE, 4096) == 0);
+  ASSERT(pu_dbsnap_add_item(snap, PU_DBSNAP_DEPENDS, "bar>=2") == 0);
+  ASSERT(pu_dbsnap_add_item(snap, PU_DBSNAP_DEPENDS, "glibc") == 0);
+  ASSERT(pu_dbsnap_add_file(snap, "usr/") == 0);
+  ASSERT(pu_dbsnap_add_file(snap, "usr/bin/") == 0);
+  ASSERT(pu_dbsnap_add_file(snap, "usr/bin/foo") == 0);
+  ASSERT(pu_dbsnap_add_file(snap, "usr/bin/foobar") == 0);
+  ASSERT(pu_dbsnap_add_file(snap, "usr/lib/") == 0);
+  ASSERT(pu_dbsnap_add_pkg(snap) == 1);
+  ASSERT(pu_dbsnap_set_str(snap, PU_DBSNAP_NAME, "bar") == 0);
+  ASSERT(pu_dbsnap_set_str(snap, PU_DBSNAP_VERSION, "1-1") == 0);
+  ASSERT(pu_dbsnap_add_item(snap, PU_DBSNAP_PROVIDES, "glibc") == 0);
+  ASSERT(pu_dbsnap_add_file(snap, "usr/bin/bar") == 0);
+  ASSERT(pu_dbsnap_write(snap, snap_path, 1, 2) == 0);
+  pu_dbsnap_free(snap);
+
+  tap_plan(19);
+
+  snap = pu_dbsnap_open(snap_path, 1, 3);
+  tap_ok(snap == NULL && errno == ESTALE, "stale snapshot rejected");
+
+  ASSERT(snap = pu_dbsnap_open(snap_path, 1, 2));
+  tap_is_int(pu_dbsnap_count(snap), 2, "package count");
+  tap_is_str(pu_dbsnap_str(snap, 0, PU_DBSNAP_NAME), "bar", "sorted by name");
+  tap_is_int(pu_dbsnap_find(snap, "baz"), UINT32_MAX, "find missing");
+  pkg = pu_dbsnap_find(snap, "foo");
+  tap_is_int(pkg, 1, "find");
+  tap_is_str(pu_dbsnap_str(snap, pkg, PU_DBSNAP_VERSION), "1-1", "version");
+  tap_ok(pu_dbsnap_str(snap, pkg, PU_DBSNAP_DESC) == NULL, "unset string");
+  tap_is_int(pu_dbsnap_int(snap, pkg, PU_DBSNAP_ISIZE), 4096, "isize");
+  tap_is_int(pu_dbsnap_list_count(snap, pkg, PU_DBSNAP_DEPENDS), 2, "depends");
+  tap_is_str(pu_dbsnap_list_item(snap, pkg, PU_DBSNAP_DEPENDS, 1), "glibc",
+      "depend");
+  tap_ok(pu_dbsnap_list_item(snap, pkg, PU_DBSNAP_DEPENDS, 1)
+      == pu_dbsnap_list_item(snap, 0, PU_DBSNAP_PROVIDES, 0),
+      "strings interned");
+  tap_is_int(pu_dbsnap_files_size(snap), 62, "file bytes");
+  tap_is_int(pu_dbsnap_files(snap, pkg, &files), 5, "file count");
+  pu_dbsnap_files_next(&files);
+  pu_dbsnap_files_next(&files);
+  tap_is_str(pu_dbsnap_files_next(&files), "usr/bin/foo", "third file");
+  tap_is_str(pu_dbsnap_files_next(&files), "usr/bin/foobar", "fourth file");
+  tap_is_str(pu_dbsnap_files_next(&files), "usr/lib/", "fifth file");
+  tap_ok(pu_dbsnap_files_next(&files) == NULL, "end of files");
+
+  ASSERT(pu_dbsnap_stamp(tmpdir, &s1, &s2) == 0);
+  ASSERT(pu_dbsnap_stamp(tmpdir, &t1, &t2) == 0);
+  tap_ok(s1 == t1 && s2 == t2, "stamp stable");
+  ASSERT(spew(tmpfd, "local/foo-1-1/desc", "%%NAME%%\nfoo\n\n") == 0);
+  ASSERT(pu_dbsnap_stamp(tmpdir, &t1, &t2) == 0);
+  tap_ok(s1 == t1 && s2 != t2, "stamp changes with desc");
+
+  return 0;
+}
@@ -23,6 +23,7 @@ char buf[] =
     "./usr time=1453283269.234514817 type=dir\n"
     "./usr/bin time=1453283269.447848157 type=dir\n"
     "./usr/bin/paccheck time=1453283269.447848157 size=23712 md5digest=adeb5af3c33e76f0e663394c88272c14 sha256digest=0669f596e333e053f61ee9a2c6b443a9a3ef2c2640fe6bf67acc502d67d9b51b\n"
+    "./usr/bin/pc time=1453283270.1 type=link link=../bin/paccheck\\040x\n"
     "";
 
 int main(void) {
@@ -31,7 +32,7 @@ int main(void) {
   ASSERT(stream = fmemopen(buf, strlen(buf), "r"));
   ASSERT(reader = pu_mtree_reader_open_stream(stream));
 
-  tap_plan(47);
+  tap_plan(53);
 
   tap_ok((e = pu_mtree_reader_next(reader, NULL)) != NULL, "next");
   tap_is_str(e->path, ".BUILDINFO", "path");
@@ -85,9 +86,17 @@ int main(void) {
   tap_is_int(e->mode, 0755, "mode");
   tap_is_int(e->size, 23712, "time");
   tap_is_str(e->md5digest, "adeb5af3c33e76f0e663394c88272c14", "md5");
+  tap_is_int(e->mtime, 1453283269, "mtime");
+  tap_ok(e->link == NULL, "no link");
   tap_ok(!reader->eof, "eof");
   pu_mtree_free(e);
 
+  tap_ok((e = pu_mtree_reader_next(reader, NULL)) != NULL, "next");
+  tap_is_str(e->type, "link", "type");
+  tap_is_int(e->mtime, 1453283270, "mtime");
+  tap_is_str(e->link, "../bin/paccheck x", "link");
+  pu_mtree_free(e);
+
   tap_ok(pu_mtree_reader_next(reader, NULL) == NULL, "next");
   tap_ok(reader->eof, "eof");
 
@@ -0,0 +1,47 @@
+#include <stdlib.h>
+
+#include "pacutils_test.h"
+
+#include "pacutils.h"
+
+#define COUNT 1000
+
+void count_calls(void *ctx, size_t i) {
+  unsigned int *calls = ctx;
+  __atomic_fetch_add(&calls[i], 1, __ATOMIC_RELAXED);
+}
+
+int check_calls(unsigned int *calls, size_t count) {
+  size_t i;
+  for (i = 0; i < count; i++) {
+    if (calls[i] != 1) { return 0; }
+  }
+  return 1;
+}
+
+int main(void) {
+  unsigned int calls[COUNT] = { 0 };
+  alpm_list_t *handles = NULL;
+
+  tap_plan(7);
+
+  tap_is_int(pu_parallel_jobs(3), 3, "explicit job count");
+  tap_ok(pu_parallel_jobs(0) >= 1, "default job count");
+
+  pu_parallel_for(COUNT, 4, count_calls, calls);
+  tap_ok(check_calls(calls, COUNT), "every index called once");
+
+  memset(calls, 0, sizeof(calls));
+  pu_parallel_for(3, 16, count_calls, calls);
+  tap_ok(check_calls(calls, 3), "more jobs than items");
+
+  memset(calls, 0, sizeof(calls));
+  pu_parallel_for(COUNT, 1, count_calls, calls);
+  tap_ok(check_calls(calls, COUNT), "single job");
+
+  tap_is_int(pu_pkg_load_many(NULL, NULL, 0, 0), 0, "empty load");
+  tap_ok(pu_pkg_load_many_detached(NULL, NULL, 0, 0, 0, &handles) == 0
+      && handles == NULL, "empty detached load");
+
+  return 0;
+}
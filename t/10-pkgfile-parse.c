@@ -0,0 +1,37 @@
+#include <string.h>
+
+#include "pacutils/util.h"
+
+#include "pacutils_test.h"
+
+char *field(const char *s, size_t len) {
+  static char buf[4][64];
+  static int n = 0;
+  n = (n + 1) % 4;
+  memcpy(buf[n], s, len);
+  buf[n][len] = '\0';
+  return buf[n];
+}
+
+int main(void) {
+  pu_pkgfile_t pf;
+
+  tap_plan(10);
+
+#define CHECK(in, ename, eversion, earch, esig) do { \
+    int ret = pu_pkgfile_parse(in, &pf); \
+    tap_is_str(ret == 0 ? field(pf.name, pf.namelen) : NULL, ename, in " name"); \
+    tap_is_str(ret == 0 ? field(pf.version, pf.versionlen) : NULL, eversion, in " version"); \
+    tap_is_str(ret == 0 ? field(pf.arch, pf.archlen) : NULL, earch, in " arch"); \
+    tap_is_int(ret == 0 && pf.sig, esig, in " sig"); \
+  } while(0)
+
+  CHECK("pacman-6.0.2-1-x86_64.pkg.tar.zst", "pacman", "6.0.2-1", "x86_64", 0);
+  CHECK("python-foo-bar-1:2.0+r3-2-any.pkg.tar.xz.sig", "python-foo-bar",
+      "1:2.0+r3-2", "any", 1);
+  tap_ok(pu_pkgfile_parse("foo-1-x86_64.pkg.tar.zst", &pf) == -1, "missing pkgrel");
+  tap_ok(pu_pkgfile_parse("-1-1-any.pkg.tar.zst", &pf) == -1, "empty name");
+
+#undef CHECK
+  return tap_finish();
+}
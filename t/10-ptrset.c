@@ -0,0 +1,38 @@
+#include "pacutils.h"
+
+#include "pacutils_test.h"
+
+int main(void) {
+  static int items[1000];
+  alpm_list_t *list = NULL, *l;
+  pu_ptrset_t *set;
+  size_t i, found = 0;
+
+  tap_plan(9);
+
+  ASSERT(set = pu_ptrset_new(0));
+  tap_is_int(pu_ptrset_add(set, &items[0]), 1, "add");
+  tap_is_int(pu_ptrset_add(set, &items[0]), 0, "add duplicate");
+  tap_is_int(pu_ptrset_add(set, NULL), -1, "add NULL");
+  tap_ok(!pu_ptrset_contains(set, &items[1]), "missing");
+  for (i = 1; i < 1000; i++) { ASSERT(pu_ptrset_add(set, &items[i]) == 1); }
+  tap_is_int(set->count, 1000, "count after growing");
+  for (i = 0; i < 1000; i++) { found += pu_ptrset_contains(set, &items[i]); }
+  tap_is_int(found, 1000, "contains after growing");
+
+  ASSERT(list = pu_ptrset_to_list(set));
+  tap_is_int(alpm_list_count(list), 1000, "to list");
+  pu_ptrset_free(set);
+
+  list = alpm_list_add(list, &items[0]);
+  ASSERT(set = pu_ptrset_from_list(list));
+  tap_is_int(set->count, 1000, "from list with duplicate");
+  for (l = list, found = 0; l; l = l->next) {
+    found += pu_ptrset_contains(set, l->data);
+  }
+  tap_is_int(found, 1001, "from list contains");
+
+  pu_ptrset_free(set);
+  alpm_list_free(list);
+  return tap_finish();
+}
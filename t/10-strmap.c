@@ -0,0 +1,54 @@
+#include "pacutils.h"
+
+#include "pacutils_test.h"
+
+int main(void) {
+  char key[32], *big;
+  alpm_list_t *list = NULL;
+  pu_strmap_t *map;
+  const char *interned;
+  void **slot;
+  int i, found = 0;
+
+  tap_plan(13);
+
+  ASSERT(map = pu_strmap_new(0));
+  ASSERT(pu_strmap_set(map, "foo", "bar") == 0);
+  tap_is_str(pu_strmap_get(map, "foo"), "bar", "get");
+  tap_ok(pu_strmap_get(map, "baz") == NULL, "get missing");
+  tap_ok(!pu_strmap_contains(map, "baz"), "contains missing");
+
+  strcpy(key, "foo");
+  interned = pu_strmap_intern(map, key);
+  tap_ok(interned != key, "key copied");
+  tap_ok(pu_strmap_intern(map, "foo") == interned, "key interned");
+  tap_is_str(pu_strmap_get(map, "foo"), "bar", "intern keeps value");
+
+  ASSERT(slot = pu_strmap_slot(map, "baz"));
+  tap_ok(*slot == NULL, "new slot empty");
+  tap_ok(pu_strmap_contains(map, "baz"), "slot adds key");
+
+  for (i = 0; i < 1000; i++) {
+    sprintf(key, "key%d", i);
+    ASSERT(pu_strmap_set(map, key, NULL) == 0);
+  }
+  for (i = 0; i < 1000; i++) {
+    sprintf(key, "key%d", i);
+    found += pu_strmap_contains(map, key);
+  }
+  tap_is_int(found, 1000, "contains after growing");
+  tap_ok(pu_strmap_intern(map, "foo") == interned, "interned key stable");
+  tap_is_int(map->count, 1002, "count");
+
+  ASSERT(big = calloc(10000, 1));
+  memset(big, 'x', 9999);
+  tap_is_str(pu_strmap_intern(map, big), big, "large key");
+  free(big);
+
+  ASSERT(list = pu_strmap_keys(map));
+  tap_is_int(alpm_list_count(list), 1003, "keys");
+  alpm_list_free(list);
+  pu_strmap_free(map, NULL);
+
+  return tap_finish();
+}
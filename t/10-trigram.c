@@ -0,0 +1,109 @@
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "pacutils_test.h"
+
+#include "pacutils.h"
+
+char *tmpdir = NULL, template[] = "/tmp/10-trigram.c-XXXXXX";
+char *idx_path = NULL;
+pu_trigram_index_t *idx = NULL;
+alpm_list_t *literals = NULL;
+
+void cleanup(void) {
+  pu_trigram_index_free(idx);
+  FREELIST(literals);
+  free(idx_path);
+  if (tmpdir) { rmrfat(AT_FDCWD, tmpdir); }
+}
+
+#define CANDIDATES(field, lit, exp) do { \
+    unsigned char cand[3]; \
+    char got[4]; \
+    memset(cand, 1, 3); \
+    ASSERT(pu_trigram_index_filter(idx, field, lit, cand) == 0); \
+    got[0] = cand[0] ? 'y' : 'n'; \
+    got[1] = cand[1] ? 'y' : 'n'; \
+    got[2] = cand[2] ? 'y' : 'n'; \
+    got[3] = '\0'; \
+    tap_is_str(got, exp, "candidates for '" lit "'"); \
+  } while(0)
+
+#define LITERALS(re, exp) do { \
+    alpm_list_t *l; \
+    char got[256] = ""; \
+    literals = pu_trigram_regex_literals(re); \
+    for (l = literals; l; l = l->next) { \
+      strcat(got, l->data); \
+      if (l->next) { strcat(got, ","); } \
+    } \
+    tap_is_str(got, exp, "literals for /" re "/"); \
+    FREELIST(literals); \
+  } while(0)
+
+int main(void) {
+  struct stat sbuf;
+  const char *s;
+
+  ASSERT(atexit(cleanup) == 0);
+  ASSERT(tmpdir = mkdtemp(template));
+  ASSERT(idx_path = pu_asprintf("%s/%s", tmpdir, "core.db.trgm"));
+
+  ASSERT(idx = pu_trigram_index_new(2));
+  ASSERT(pu_trigram_index_add_doc(idx, "pacman") == 0);
+  ASSERT(pu_trigram_index_add_str(idx, 0, "pacman") == 0);
+  ASSERT(pu_trigram_index_add_str(idx, 1, "usr/bin/pacman") == 0);
+  ASSERT(pu_trigram_index_add_str(idx, 1, "usr/lib/libalpm.so") == 0);
+  ASSERT(pu_trigram_index_add_doc(idx, "pacutils") == 1);
+  ASSERT(pu_trigram_index_add_str(idx, 0, "pacutils") == 0);
+  ASSERT(pu_trigram_index_add_str(idx, 1, "usr/bin/pacsift") == 0);
+  ASSERT(pu_trigram_index_add_str(idx, 1, "usr/lib/libpacutils.so") == 0);
+  ASSERT(pu_trigram_index_add_doc(idx, "glibc") == 2);
+  ASSERT(pu_trigram_index_add_str(idx, 0, "glibc") == 0);
+  ASSERT(pu_trigram_index_add_str(idx, 1, "usr/lib/libc.so.6") == 0);
+  ASSERT(pu_trigram_index_write(idx, idx_path, 1, 2) == 0);
+  pu_trigram_index_free(idx);
+
+  tap_plan(22);
+
+  idx = pu_trigram_index_open(idx_path, 1, 3);
+  tap_ok(idx == NULL && errno == ESTALE, "stale index rejected");
+
+  ASSERT(idx = pu_trigram_index_open(idx_path, 1, 2));
+  tap_is_int(pu_trigram_index_count(idx), 3, "document count");
+  tap_is_str(pu_trigram_index_doc_name(idx, 1), "pacutils", "document name");
+  tap_is_int(pu_trigram_index_doc_strs(idx, 1, 1, &s), 2, "string count");
+  tap_is_str(s, "usr/bin/pacsift", "first string");
+  tap_is_str(s + strlen(s) + 1, "usr/lib/libpacutils.so", "second string");
+
+  CANDIDATES(0, "PAC", "yyn");
+  CANDIDATES(0, "pacu", "nyn");
+  CANDIDATES(0, "xyz", "nnn");
+  CANDIDATES(0, "pa", "yyy");
+  CANDIDATES(1, "lib/lib", "yyy");
+  CANDIDATES(1, "libc.so", "nny");
+  CANDIDATES(1, "bin/pac", "yyn");
+
+  LITERALS("^libfoo\\.so", "libfoo.so");
+  LITERALS("foo.*bar", "foo,bar");
+  LITERALS("python3?-foo", "python,-foo");
+  LITERALS("ab+cde", "cde");
+  LITERALS("foo(bar)?baz[0-9]", "foo,baz");
+  LITERALS("foo|bar", "");
+  LITERALS("x{2,3}yyyy", "yyyy");
+
+  pu_trigram_index_free(idx);
+  idx = NULL;
+  ASSERT(stat(idx_path, &sbuf) == 0);
+  ASSERT(truncate(idx_path, sbuf.st_size * 3 / 4) == 0);
+  idx = pu_trigram_index_open(idx_path, 1, 2);
+  tap_ok(idx == NULL && errno == EINVAL, "truncated index rejected");
+  ASSERT(truncate(idx_path, sbuf.st_size / 2) == 0);
+  idx = pu_trigram_index_open(idx_path, 1, 2);
+  tap_ok(idx == NULL && errno == EINVAL, "truncated index rejected");
+
+  return 0;
+}
@@ -0,0 +1,35 @@
+#include "pacutils.h"
+
+#include "pacutils_test.h"
+
+int main(void) {
+  static int items[100];
+  alpm_list_t *list = NULL;
+  pu_vec_t *vec;
+  size_t i, inorder = 0;
+
+  tap_plan(5);
+
+  ASSERT(vec = pu_vec_new(1));
+  for (i = 0; i < 100; i++) { ASSERT(pu_vec_push(vec, &items[i]) == 0); }
+  tap_is_int(vec->count, 100, "count after growing");
+  for (i = 0; i < 100; i++) { inorder += vec->items[i] == &items[i]; }
+  tap_is_int(inorder, 100, "order kept");
+
+  ASSERT(list = pu_vec_to_list(vec));
+  tap_ok(alpm_list_nth(list, 42)->data == &items[42], "to list");
+  pu_vec_free(vec, NULL);
+
+  ASSERT(vec = pu_vec_from_list(list));
+  tap_is_int(vec->count, 100, "from list");
+  tap_ok(vec->items[99] == &items[99], "from list order");
+  pu_vec_free(vec, NULL);
+  alpm_list_free(list);
+
+  list = alpm_list_add(NULL, strdup("foo"));
+  ASSERT(vec = pu_vec_from_list(list));
+  alpm_list_free(list);
+  pu_vec_free(vec, free);
+
+  return tap_finish();
+}
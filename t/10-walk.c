@@ -0,0 +1,75 @@
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "pacutils_test.h"
+
+#include "pacutils.h"
+
+char *tmpdir = NULL, template[] = "/tmp/10-walk.c-XXXXXX";
+int tmpfd = -1;
+alpm_list_t *seen = NULL;
+pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+void cleanup(void) {
+  FREELIST(seen);
+  if (tmpfd != -1) { close(tmpfd); }
+  if (tmpdir) { rmrfat(AT_FDCWD, tmpdir); }
+}
+
+/* records entries relative to tmpdir, directories with a trailing slash and
+ * a '+' if reached through a flagged parent; "skip" is not descended into
+ * and "flag" sets the flag for its children */
+int record(void *ctx, pu_walk_entry_t *entry) {
+  size_t prefix = strlen(tmpdir) + 1;
+  char *rel;
+  (void) ctx;
+  if (entry->error) { return 0; }
+  rel = pu_asprintf("%s%s%s", entry->path + prefix,
+      entry->type == PU_WALK_DIR ? "/" : "", entry->flags ? "+" : "");
+  pthread_mutex_lock(&lock);
+  seen = alpm_list_add(seen, rel);
+  pthread_mutex_unlock(&lock);
+  if (strcmp(entry->name, "flag") == 0) { entry->flags = 1; }
+  return strcmp(entry->name, "skip") != 0;
+}
+
+char *walk(int jobs) {
+  static char buf[1024];
+  alpm_list_t *i;
+  FREELIST(seen);
+  buf[0] = '\0';
+  if (pu_walk(tmpdir, 0, jobs, record, NULL) != 0) { return NULL; }
+  seen = alpm_list_msort(seen, alpm_list_count(seen), (alpm_list_fn_cmp) strcmp);
+  for (i = seen; i; i = i->next) {
+    strcat(buf, i->data);
+    if (i->next) { strcat(buf, " "); }
+  }
+  return buf;
+}
+
+int main(void) {
+  const char *expected = "a/ a/b/ a/b/c a/b/d a/e flag/ flag/f+ flag/g/+ flag/g/h+"
+      " link skip/ top";
+  char *dirs[] = { "a", "a/b", "skip", "skip/x", "flag", "flag/g", NULL };
+  char *files[] = { "a/b/c", "a/b/d", "a/e", "skip/y", "flag/f", "flag/g/h",
+      "top", NULL };
+  char **c;
+
+  ASSERT(atexit(cleanup) == 0);
+  ASSERT(tmpdir = mkdtemp(template));
+  ASSERT((tmpfd = open(tmpdir, O_DIRECTORY)) != -1);
+  for (c = dirs; *c; c++) { ASSERT(mkdirat(tmpfd, *c, 0755) == 0); }
+  for (c = files; *c; c++) { ASSERT(spew(tmpfd, *c, "") == 0); }
+  ASSERT(symlinkat("a", tmpfd, "link") == 0);
+
+  tap_plan(3);
+
+  tap_is_str(walk(1), expected, "single job");
+  tap_is_str(walk(8), expected, "multiple jobs");
+  tap_ok(pu_walk("/nonexistent/10-walk", 0, 2, record, NULL) == 0,
+      "missing directory reported to callback");
+
+  return 0;
+}
@@ -0,0 +1,165 @@
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "pacutils_test.h"
+
+#include "pacutils.h"
+
+char *tmpdir = NULL, template[] = "/tmp/20-config-cache.c-XXXXXX";
+int tmpfd = -1;
+char *conf_path = NULL, *cache_path = NULL;
+pu_config_t *config = NULL, *cached = NULL;
+pu_config_reader_t *reader = NULL;
+alpm_list_t *deps = NULL;
+
+char pacman_conf[] =
+    "[options]\n"
+    "DBPath = /var/lib/pacman/\n"
+    "HoldPkg = pacman glibc\n"
+    "CheckSpace\n"
+    "SigLevel = Required\n"
+    "Include = %s/conf.d/*.conf\n"
+    "[core]\n"
+    "Server = http://example.com/$repo/os/$arch\n";
+
+void cleanup(void) {
+  pu_config_free(config);
+  pu_config_free(cached);
+  pu_config_reader_free(reader);
+  FREELIST(deps);
+  free(conf_path);
+  free(cache_path);
+
+  if (tmpfd != -1) { close(tmpfd); }
+  if (tmpdir) { rmrfat(AT_FDCWD, tmpdir); }
+}
+
+/* files must be older than the timestamp granularity to be cached */
+void backdate(const char *path) {
+  struct timespec ts[2] = { { 1700000000, 5 }, { 1700000000, 5 } };
+  ASSERT(utimensat(tmpfd, path, ts, 0) == 0);
+}
+
+int main(void) {
+  pu_repo_t *repo;
+  char *path;
+
+  ASSERT(atexit(cleanup) == 0);
+  ASSERT(tmpdir = mkdtemp(template));
+  ASSERT((tmpfd = open(tmpdir, O_DIRECTORY)) != -1);
+  ASSERT(conf_path = pu_asprintf("%s/%s", tmpdir, "pacman.conf"));
+  ASSERT(cache_path = pu_asprintf("%s/%s", tmpdir, "cache/config"));
+  ASSERT(spew(tmpfd, "pacman.conf", pacman_conf, tmpdir) == 0);
+  ASSERT(mkdirat(tmpfd, "conf.d", 0755) == 0);
+  ASSERT(spew(tmpfd, "conf.d/a.conf", "XferCommand = /bin/true\n") == 0);
+
+  ASSERT(config = pu_config_new());
+  ASSERT(reader = pu_config_reader_new(config, conf_path));
+  while (pu_config_reader_next(reader) != -1);
+  ASSERT(!reader->error);
+  deps = reader->_deps;
+  reader->_deps = NULL;
+
+  tap_plan(24);
+
+  tap_is_int(alpm_list_count(deps), 3, "dependency count");
+  ASSERT(path = pu_asprintf("%s/%s", tmpdir, "conf.d"));
+  tap_is_str(deps->next->data, path, "glob directory recorded");
+  free(path);
+
+  errno = 0;
+  tap_ok(pu_config_cache_write(cache_path, config, conf_path, NULL, deps) == -1
+      && errno == EAGAIN, "recently modified files are not cached");
+
+  backdate("pacman.conf");
+  backdate("conf.d/a.conf");
+  backdate("conf.d");
+  tap_is_int(pu_config_cache_write(cache_path, config, conf_path, NULL, deps),
+      0, "write cache");
+
+  cached = pu_config_cache_read(cache_path, conf_path, NULL);
+  tap_ok(cached != NULL, "read cache");
+  tap_is_str(cached ? cached->dbpath : NULL, "/var/lib/pacman/", "DBPath");
+  tap_is_str(cached ? cached->xfercommand : NULL, "/bin/true",
+      "included XferCommand");
+  tap_ok(cached && cached->gpgdir == NULL, "unset GPGDir");
+  tap_is_int(alpm_list_count(cached ? cached->holdpkgs : NULL), 2, "HoldPkg");
+  tap_is_int(cached ? cached->checkspace : -2, PU_CONFIG_BOOL_TRUE,
+      "CheckSpace");
+  tap_is_int(cached ? cached->color : -2, PU_CONFIG_BOOL_UNSET, "unset Color");
+  tap_is_int(cached ? cached->siglevel : 0, config->siglevel, "SigLevel");
+  repo = cached && cached->repos ? cached->repos->data : NULL;
+  tap_is_str(repo ? repo->name : NULL, "core", "repo name");
+  tap_is_str(repo && repo->servers ? repo->servers->data : NULL,
+      "http://example.com/$repo/os/$arch", "server left unresolved");
+  pu_config_free(cached);
+
+  cached = pu_config_cache_read(cache_path, "/etc/pacman.conf", NULL);
+  tap_ok(cached == NULL && errno == ESTALE, "different file");
+
+  cached = pu_config_cache_read(cache_path, conf_path, tmpdir);
+  tap_ok(cached == NULL && errno == ESTALE, "different sysroot");
+
+  ASSERT(fchmodat(tmpfd, "cache/config", 0666, 0) == 0);
+  cached = pu_config_cache_read(cache_path, conf_path, NULL);
+  tap_ok(cached == NULL && errno == EPERM, "writable cache ignored");
+  ASSERT(fchmodat(tmpfd, "cache/config", 0600, 0) == 0);
+
+  ASSERT(spew(tmpfd, "conf.d/b.conf", "GPGDir = /tmp/\n") == 0);
+  cached = pu_config_cache_read(cache_path, conf_path, NULL);
+  tap_ok(cached == NULL && errno == ESTALE, "new included file");
+
+  backdate("conf.d");
+  ASSERT(spew(tmpfd, "pacman.conf", pacman_conf, tmpdir) == 0);
+  cached = pu_config_cache_read(cache_path, conf_path, NULL);
+  tap_ok(cached == NULL && errno == ESTALE, "modified config");
+
+  /* root only uses the cache when asked to, nobody in a foreign base */
+  ASSERT(mkdirat(tmpfd, "xdg", 0700) == 0);
+  ASSERT(path = pu_asprintf("%s/%s", tmpdir, "xdg"));
+  ASSERT(setenv("XDG_CACHE_HOME", path, 1) == 0);
+  ASSERT(unsetenv("PACUTILS_CONFIG_CACHE") == 0);
+  free(path);
+  path = pu_config_cache_path(conf_path, NULL);
+  tap_ok(geteuid() == 0 ? path == NULL : path != NULL, "root needs opt-in");
+  free(path);
+  ASSERT(setenv("PACUTILS_CONFIG_CACHE", "1", 1) == 0);
+  path = pu_config_cache_path(conf_path, NULL);
+  tap_ok(path && strncmp(path, tmpdir, strlen(tmpdir)) == 0, "owned base");
+  free(path);
+  if (geteuid() == 0) {
+    ASSERT(fchownat(tmpfd, "xdg", 1, 1, 0) == 0);
+  } else {
+    ASSERT(setenv("XDG_CACHE_HOME", "/", 1) == 0);
+  }
+  path = pu_config_cache_path(conf_path, NULL);
+  tap_ok(path == NULL && errno == EPERM, "foreign base");
+  free(path);
+
+  /* directories matched by a wildcard directory component are recorded */
+  ASSERT(mkdirat(tmpfd, "nested", 0755) == 0);
+  ASSERT(mkdirat(tmpfd, "nested/a", 0755) == 0);
+  ASSERT(spew(tmpfd, "nested/a/x.conf", "GPGDir = /tmp/\n") == 0);
+  ASSERT(spew(tmpfd, "nested.conf", "[options]\nInclude = %s/nested/*/x.conf\n",
+        tmpdir) == 0);
+  pu_config_reader_free(reader);
+  pu_config_free(config);
+  FREELIST(deps);
+  ASSERT(path = pu_asprintf("%s/%s", tmpdir, "nested.conf"));
+  ASSERT(config = pu_config_new());
+  ASSERT(reader = pu_config_reader_new(config, path));
+  free(path);
+  while (pu_config_reader_next(reader) != -1);
+  ASSERT(!reader->error);
+  deps = reader->_deps;
+  reader->_deps = NULL;
+  ASSERT(path = pu_asprintf("%s/%s", tmpdir, "nested"));
+  tap_ok(alpm_list_find_str(deps, path) != NULL, "wildcard base recorded");
+  free(path);
+  ASSERT(path = pu_asprintf("%s/%s", tmpdir, "nested/a"));
+  tap_ok(alpm_list_find_str(deps, path) != NULL, "matched directory recorded");
+  free(path);
+
+  return 0;
+}
@@ -0,0 +1,160 @@
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "pacutils_test.h"
+
+#include "pacutils.h"
+
+char *tmpdir = NULL, template[] = "/tmp/20-depgraph.c-XXXXXX";
+char *root = NULL, *dbpath = NULL, buf[256];
+int dbfd = -1;
+alpm_handle_t *handle = NULL;
+pu_depgraph_t *graph = NULL;
+alpm_list_t *leaves = NULL, *cycles = NULL;
+
+void cleanup(void) {
+  alpm_list_t *c;
+  for (c = cycles; c; c = c->next) { alpm_list_free(c->data); }
+  alpm_list_free(cycles);
+  alpm_list_free(leaves);
+  pu_depgraph_free(graph);
+  free(root);
+  free(dbpath);
+  if (handle) { alpm_release(handle); }
+  if (dbfd != -1) { close(dbfd); }
+  if (tmpdir) { rmrfat(AT_FDCWD, tmpdir); }
+}
+
+/* depends and provides are newline separated */
+void add_pkg(const char *name, alpm_pkgreason_t reason, off_t size,
+    const char *depends, const char *provides) {
+  char path[PATH_MAX];
+  snprintf(path, PATH_MAX, "local/%s-1-1", name);
+  ASSERT(mkdirat(dbfd, path, 0755) == 0);
+  snprintf(path, PATH_MAX, "local/%s-1-1/desc", name);
+  ASSERT(spew(dbfd, path,
+          "%%NAME%%\n%s\n\n%%VERSION%%\n1-1\n\n%%SIZE%%\n%jd\n\n"
+          "%%REASON%%\n%d\n\n%%DEPENDS%%\n%s\n\n%%PROVIDES%%\n%s\n\n",
+          name, (intmax_t) size, reason, depends, provides) == 0);
+}
+
+alpm_pkg_t *get_pkg(const char *name) {
+  alpm_pkg_t *pkg = alpm_db_get_pkg(alpm_get_localdb(handle), name);
+  ASSERT(pkg);
+  return pkg;
+}
+
+/* joins sorted strings into buf */
+const char *join(alpm_list_t **strs, const char *sep) {
+  alpm_list_t *i;
+  *strs = alpm_list_msort(*strs, alpm_list_count(*strs),
+      (alpm_list_fn_cmp) strcmp);
+  buf[0] = '\0';
+  for (i = *strs; i; i = i->next) {
+    if (i != *strs) { strcat(buf, sep); }
+    strcat(buf, i->data);
+  }
+  return buf;
+}
+
+const char *names(alpm_list_t *pkgs) {
+  alpm_list_t *n = NULL, *i;
+  for (i = pkgs; i; i = i->next) {
+    ASSERT(alpm_list_append(&n, (void *) alpm_pkg_get_name(i->data)));
+  }
+  join(&n, " ");
+  alpm_list_free(n);
+  return buf;
+}
+
+#define CHECK_SIZE(pkg, exp, desc) \
+  tap_is_int(pu_depgraph_removable_size(graph, get_pkg(pkg)), exp, desc)
+
+int main(void) {
+  alpm_list_t *pkgs = NULL, *c, *cyclenames = NULL;
+  alpm_errno_t err;
+
+  ASSERT(atexit(cleanup) == 0);
+  ASSERT(tmpdir = mkdtemp(template));
+  ASSERT(root = pu_asprintf("%s/", tmpdir));
+  ASSERT(dbpath = pu_asprintf("%s/db", tmpdir));
+  ASSERT(mkdir(dbpath, 0755) == 0);
+  ASSERT((dbfd = open(dbpath, O_DIRECTORY)) != -1);
+  ASSERT(mkdirat(dbfd, "local", 0755) == 0);
+  ASSERT(spew(dbfd, "local/ALPM_DB_VERSION", "9\n") == 0);
+
+  /* chain */
+  add_pkg("chain-a", ALPM_PKG_REASON_EXPLICIT, 1, "chain-b", "");
+  add_pkg("chain-b", ALPM_PKG_REASON_DEPEND, 2, "chain-c", "");
+  add_pkg("chain-c", ALPM_PKG_REASON_DEPEND, 4, "", "");
+
+  /* explicitly installed package inside a chain */
+  add_pkg("expl-a", ALPM_PKG_REASON_EXPLICIT, 8, "expl-b", "");
+  add_pkg("expl-b", ALPM_PKG_REASON_EXPLICIT, 16, "expl-c", "");
+  add_pkg("expl-c", ALPM_PKG_REASON_DEPEND, 32, "", "");
+
+  /* diamond, with one side depending on a provision */
+  add_pkg("dia-top", ALPM_PKG_REASON_EXPLICIT, 64, "dia-left\ndia-right", "");
+  add_pkg("dia-left", ALPM_PKG_REASON_DEPEND, 128, "dia-bottom", "");
+  add_pkg("dia-right", ALPM_PKG_REASON_DEPEND, 256, "libbottom", "");
+  add_pkg("dia-bottom", ALPM_PKG_REASON_DEPEND, 512, "", "libbottom");
+
+  /* self-dependency */
+  add_pkg("self", ALPM_PKG_REASON_DEPEND, 1024, "self", "");
+
+  /* two-package cycle nothing depends on, with a dependency of its own */
+  add_pkg("cyc-a", ALPM_PKG_REASON_DEPEND, 2048, "cyc-b\ncyc-dep", "");
+  add_pkg("cyc-b", ALPM_PKG_REASON_DEPEND, 4096, "cyc-a", "");
+  add_pkg("cyc-dep", ALPM_PKG_REASON_DEPEND, 8192, "", "");
+
+  /* two-package cycle required by an explicit package */
+  add_pkg("held", ALPM_PKG_REASON_EXPLICIT, 16384, "held-a", "");
+  add_pkg("held-a", ALPM_PKG_REASON_DEPEND, 32768, "held-b", "");
+  add_pkg("held-b", ALPM_PKG_REASON_DEPEND, 65536, "held-a", "");
+
+  /* two installed providers of the same dependency */
+  add_pkg("prov-user", ALPM_PKG_REASON_EXPLICIT, 131072, "sh", "");
+  add_pkg("prov-one", ALPM_PKG_REASON_DEPEND, 262144, "", "sh");
+  add_pkg("prov-two", ALPM_PKG_REASON_DEPEND, 524288, "", "sh");
+
+  ASSERT(handle = alpm_initialize(root, dbpath, &err));
+  ASSERT(graph = pu_depgraph_new(
+          alpm_db_get_pkgcache(alpm_get_localdb(handle)), 0));
+
+  tap_plan(16);
+
+  CHECK_SIZE("chain-a", 7, "chain");
+  CHECK_SIZE("chain-b", 6, "chain tail");
+  CHECK_SIZE("expl-a", 8, "explicit dependency is kept");
+  CHECK_SIZE("expl-b", 48, "explicit package in a chain");
+  CHECK_SIZE("dia-top", 960, "diamond");
+  CHECK_SIZE("dia-left", 128, "shared dependency is evicted");
+  CHECK_SIZE("dia-right", 256, "shared provision is evicted");
+  ASSERT(alpm_list_append(&pkgs, get_pkg("dia-left")));
+  ASSERT(alpm_list_append(&pkgs, get_pkg("dia-right")));
+  tap_is_int(pu_depgraph_pkglist_removable_size(graph, pkgs), 896,
+      "removing both sides of a diamond");
+  alpm_list_free(pkgs);
+  CHECK_SIZE("self", 1024, "self-dependency");
+  CHECK_SIZE("cyc-a", 14336, "cycle");
+  CHECK_SIZE("held-b", 65536, "cycle required from outside");
+  CHECK_SIZE("prov-user", 393216, "first provider");
+  CHECK_SIZE("prov-two", 524288, "second provider");
+
+  ASSERT(pu_depgraph_leaves(graph, &leaves) == 0);
+  tap_is_str(names(leaves), "chain-a dia-top expl-a held prov-user", "leaves");
+
+  ASSERT(pu_depgraph_orphan_cycles(graph, &cycles) == 0);
+  tap_is_int(alpm_list_count(cycles), 2, "orphan cycle count");
+  for (c = cycles; c; c = c->next) {
+    ASSERT(alpm_list_append_strdup(&cyclenames, names(c->data)));
+  }
+  tap_is_str(join(&cyclenames, ", "), "cyc-a cyc-b, self", "orphan cycles");
+  alpm_list_free_inner(cyclenames, free);
+  alpm_list_free(cyclenames);
+
+  return tap_finish();
+}
+
+/* vim: set ts=2 sw=2 et: */
@@ -0,0 +1,84 @@
+/* pacsift.c sets up its own feature macros and must come first */
+#define main pacsift_main
+#include "../src/pacsift.c"
+#undef main
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "pacutils_test.h"
+
+char *tmpdir = NULL, template[] = "/tmp/20-pacsift-query.c-XXXXXX";
+char *root = NULL, *dbpath = NULL, *expr = NULL;
+struct query *q = NULL;
+
+void test_cleanup(void) {
+  query_free(q);
+  FREELIST(name);
+  free(expr);
+  free(root);
+  free(dbpath);
+  if (handle) { alpm_release(handle); }
+  if (tmpdir) { rmrfat(AT_FDCWD, tmpdir); }
+}
+
+#define CHECK_CACHE(str, exp) do { \
+    query_free(q); \
+    ASSERT(q = query_parse(str)); \
+    tap_is_int(query_eval_cache(q, &rec), exp, "cache metadata: " str); \
+  } while(0)
+
+#define CHECK_TERM(op, exp, desc) do { \
+    free(expr); \
+    ASSERT(expr = pu_asprintf("owns-file%s%susr/bin/foo", op, root)); \
+    query_free(q); \
+    ASSERT(q = query_parse(expr)); \
+    tap_is_str(q->type == QUERY_TERM ? q->str : NULL, exp, desc); \
+  } while(0)
+
+int main(void) {
+  pu_cachemeta_pkg_t rec = { .name = "foo", .size = 100 };
+  alpm_list_t groups = { .data = "base", .prev = &groups, .next = NULL };
+  alpm_errno_t err;
+
+  ASSERT(atexit(test_cleanup) == 0);
+  ASSERT(tmpdir = mkdtemp(template));
+  ASSERT(root = pu_asprintf("%s/", tmpdir));
+  ASSERT(dbpath = pu_asprintf("%s/db", tmpdir));
+  ASSERT(mkdir(dbpath, 0755) == 0);
+  ASSERT(handle = alpm_initialize(root, dbpath, &err));
+
+  tap_plan(12);
+
+  exact = 0;
+  CHECK_TERM("=", "usr/bin/foo", "exact term strips the root without --exact");
+  CHECK_TERM(":", expr + strlen("owns-file:"), "substring term keeps the root");
+
+  exact = 1;
+  CHECK_TERM("=", "usr/bin/foo", "exact term strips the root with --exact");
+  tap_is_str(strip_root(expr + strlen("owns-file=")), "usr/bin/foo",
+      "--exact strips the root from field options");
+
+  ASSERT(pu_list_append_str(&name, "foo"));
+  any = 0;
+  invert = 1;
+  query_free(q);
+  ASSERT(q = query_compile());
+  tap_ok(q->type == QUERY_NOT, "--invert negates the criteria");
+  any = 1;
+  query_free(q);
+  ASSERT(q = query_compile());
+  tap_ok(q->type == QUERY_TERM, "--invert is ignored with --any");
+
+  any = invert = 0;
+  rec.groups = &groups;
+  CHECK_CACHE("name=foo", 1);
+  CHECK_CACHE("name=foo and not size>50B", 0);
+  CHECK_CACHE("group=base or owns-file=usr/bin/foo", 1);
+  CHECK_CACHE("repo:core or name:bar", 0);
+  CHECK_CACHE("owns-file=usr/bin/foo", -1);
+  CHECK_CACHE("name=foo and satisfies=foo", -1);
+
+  return 0;
+}
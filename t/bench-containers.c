@@ -0,0 +1,94 @@
+/* Compares membership tests on alpm lists with the hash containers for the
+ * "add if not already seen" pattern used by the tools.  Not part of the test
+ * suite; run with `make bench`. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pacutils.h"
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench_ptr(size_t n, void **items) {
+  alpm_list_t *list = NULL;
+  pu_ptrset_t *set = pu_ptrset_new(0);
+  double start;
+  size_t i, pass;
+
+  start = now();
+  for (pass = 0; pass < 2; pass++) {
+    for (i = 0; i < n; i++) {
+      if (!alpm_list_find_ptr(list, items[i])) {
+        list = alpm_list_add(list, items[i]);
+      }
+    }
+  }
+  printf("%8zu pointers  alpm_list %10.6fs", n, now() - start);
+
+  start = now();
+  for (pass = 0; pass < 2; pass++) {
+    for (i = 0; i < n; i++) { pu_ptrset_add(set, items[i]); }
+  }
+  printf("  pu_ptrset %10.6fs\n", now() - start);
+
+  alpm_list_free(list);
+  pu_ptrset_free(set);
+}
+
+static void bench_str(size_t n, char **items) {
+  alpm_list_t *list = NULL;
+  pu_strmap_t *map = pu_strmap_new(0);
+  double start;
+  size_t i, pass;
+
+  start = now();
+  for (pass = 0; pass < 2; pass++) {
+    for (i = 0; i < n; i++) {
+      if (!alpm_list_find_str(list, items[i])) {
+        list = alpm_list_add(list, strdup(items[i]));
+      }
+    }
+  }
+  printf("%8zu strings   alpm_list %10.6fs", n, now() - start);
+
+  start = now();
+  for (pass = 0; pass < 2; pass++) {
+    for (i = 0; i < n; i++) {
+      if (!pu_strmap_contains(map, items[i])) { pu_strmap_intern(map, items[i]); }
+    }
+  }
+  printf("  pu_strmap %10.6fs\n", now() - start);
+
+  FREELIST(list);
+  pu_strmap_free(map, NULL);
+}
+
+int main(void) {
+  size_t sizes[] = { 100, 1000, 10000 }, s, i;
+
+  for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    size_t n = sizes[s];
+    void **ptrs = malloc(n * sizeof(void *));
+    char **strs = malloc(n * sizeof(char *));
+    for (i = 0; i < n; i++) {
+      ptrs[i] = malloc(1);
+      strs[i] = pu_asprintf("package-name-%zu", i);
+    }
+    bench_ptr(n, ptrs);
+    bench_str(n, strs);
+    for (i = 0; i < n; i++) {
+      free(ptrs[i]);
+      free(strs[i]);
+    }
+    free(ptrs);
+    free(strs);
+  }
+
+  return 0;
+}